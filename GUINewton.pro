@@ -16,18 +16,54 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    band.cpp \
+    batch.cpp \
     expr.cpp \
+    homotopy.cpp \
+    interval.cpp \
+    jobs.cpp \
+    json.cpp \
+    load.cpp \
+    lu.cpp \
     main.cpp \
     mainwindow.cpp \
+    mapped_file.cpp \
     matrix.cpp \
-    solve.cpp
+    poly.cpp \
+    pool.cpp \
+    profile.cpp \
+    program.cpp \
+    search.cpp \
+    solve.cpp \
+    solveworker.cpp \
+    system.cpp \
+    vecmath.cpp
 
 HEADERS += \
+    aligned.h \
+    band.h \
+    batch.h \
     common.h \
     expr.h \
+    homotopy.h \
+    interval.h \
+    jobs.h \
+    json.h \
+    load.h \
+    lu.h \
     mainwindow.h \
+    mapped_file.h \
     matrix.h \
-    solve.h
+    num.h \
+    poly.h \
+    pool.h \
+    profile.h \
+    program.h \
+    search.h \
+    solve.h \
+    solveworker.h \
+    system.h \
+    vecmath.h
 
 FORMS += \
     mainwindow.ui
@@ -0,0 +1,47 @@
+#ifndef ROOTS_ALIGNED_H
+#define ROOTS_ALIGNED_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Allocator of memory aligned to Align bytes, for buffers read with aligned
+// vector loads.
+template<typename T, size_t Align>
+class AlignedAllocator {
+public:
+	using value_type = T;
+
+	template<typename U>
+	struct rebind {
+		using other = AlignedAllocator<U, Align>;
+	};
+
+	AlignedAllocator() noexcept = default;
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, Align>&) noexcept {}
+
+	T* allocate(size_t n) {
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+	}
+
+	void deallocate(T* p, size_t) noexcept {
+		::operator delete(p, std::align_val_t(Align));
+	}
+};
+
+template<typename T, typename U, size_t Align>
+bool operator==(const AlignedAllocator<T, Align>&, const AlignedAllocator<U, Align>&) {
+	return true;
+}
+
+template<typename T, typename U, size_t Align>
+bool operator!=(const AlignedAllocator<T, Align>&, const AlignedAllocator<U, Align>&) {
+	return false;
+}
+
+// Vector whose data starts at a multiple of Align bytes.
+template<typename T, size_t Align = 64>
+using AlignedVector = std::vector<T, AlignedAllocator<T, Align>>;
+
+#endif // ROOTS_ALIGNED_H
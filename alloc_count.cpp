@@ -0,0 +1,51 @@
+#include "alloc_count.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+
+} // end anon
+
+size_t allocation_count() {
+	return allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+// Aligned allocations, made by AlignedAllocator. The size passed to
+// aligned_alloc must be a multiple of the alignment.
+void* operator new(size_t size, std::align_val_t align) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	size_t a = static_cast<size_t>(align);
+	size = size == 0 ? a : (size + a - 1) / a * a;
+	if (void* ptr = std::aligned_alloc(a, size)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+	std::free(ptr);
+}
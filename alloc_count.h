@@ -0,0 +1,12 @@
+#ifndef ROOTS_ALLOC_COUNT_H
+#define ROOTS_ALLOC_COUNT_H
+
+#include <cstddef>
+
+// Replacement of the global operator new which counts performed allocations.
+// Linking alloc_count.cpp into an executable enables the counting.
+
+// Returns the number of heap allocations made so far by the process.
+size_t allocation_count();
+
+#endif // ROOTS_ALLOC_COUNT_H
@@ -0,0 +1,196 @@
+#include "band.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+Bandwidth Bandwidth::of(const std::vector<Expr>& funcs, const std::vector<std::string>& vars) {
+	std::unordered_map<std::string, size_t> index;
+	for (size_t j = 0; j < vars.size(); ++j) {
+		index.emplace(vars[j], j);
+	}
+	Bandwidth bw;
+	for (size_t i = 0; i < funcs.size(); ++i) {
+		for (const auto& var : funcs[i].variables()) {
+			auto found = index.find(var);
+			if (found == index.end()) {
+				continue;
+			}
+			size_t j = found->second;
+			bw.lower = std::max(bw.lower, i > j ? i - j : 0);
+			bw.upper = std::max(bw.upper, j > i ? j - i : 0);
+		}
+	}
+	return bw;
+}
+
+bool Bandwidth::is_narrow(size_t n) const {
+	return 4 * (lower + upper + 1) <= n;
+}
+
+BandMatrix::BandMatrix(size_t n, Bandwidth bw) :
+	n(n),
+	bw(bw),
+	cells(n * (bw.lower + bw.upper + 1), 0.0) {}
+
+BandMatrix::BandMatrix(const Matrix& mat, Bandwidth bw) : BandMatrix(mat.get_height(), bw) {
+	if (mat.get_width() != n) {
+		throw std::invalid_argument("band matrix must be square");
+	}
+	for (size_t i = 0; i < n; ++i) {
+		size_t first = i - std::min(i, bw.lower);
+		size_t last = std::min(n - 1, i + bw.upper);
+		for (size_t j = first; j <= last; ++j) {
+			(*this)[{i, j}] = mat[{i, j}];
+		}
+	}
+}
+
+size_t BandMatrix::size() const {
+	return n;
+}
+
+Bandwidth BandMatrix::bandwidth() const {
+	return bw;
+}
+
+bool BandMatrix::in_band(size_t i, size_t j) const {
+	return j + bw.lower >= i && j <= i + bw.upper;
+}
+
+double BandMatrix::operator[](std::pair<size_t, size_t> idx) const {
+	auto [i, j] = idx;
+	if (!in_band(i, j)) {
+		return 0.0;
+	}
+	return cells[i * (bw.lower + bw.upper + 1) + (j + bw.lower - i)];
+}
+
+double& BandMatrix::operator[](std::pair<size_t, size_t> idx) {
+	auto [i, j] = idx;
+	if (!in_band(i, j)) {
+		throw std::out_of_range("band matrix entry outside of the band");
+	}
+	return cells[i * (bw.lower + bw.upper + 1) + (j + bw.lower - i)];
+}
+
+BandLU::BandLU(size_t n, Bandwidth bw) :
+	n(n),
+	bw(bw),
+	width(2 * bw.lower + bw.upper + 1),
+	lu(n * width),
+	pivots(n),
+	work(n) {}
+
+size_t BandLU::size() const {
+	return n;
+}
+
+Bandwidth BandLU::bandwidth() const {
+	return bw;
+}
+
+double& BandLU::at(size_t i, size_t j) {
+	return lu[i * width + (j + bw.lower - i)];
+}
+
+double BandLU::at(size_t i, size_t j) const {
+	return lu[i * width + (j + bw.lower - i)];
+}
+
+template<typename M>
+void BandLU::load(const M& mat) {
+	std::fill(lu.begin(), lu.end(), 0.0);
+	for (size_t i = 0; i < n; ++i) {
+		size_t first = i - std::min(i, bw.lower);
+		size_t last = std::min(n - 1, i + bw.upper);
+		for (size_t j = first; j <= last; ++j) {
+			at(i, j) = mat[{i, j}];
+		}
+	}
+}
+
+bool BandLU::factor(const BandMatrix& mat) {
+	auto mbw = mat.bandwidth();
+	if (mat.size() != n || mbw.lower != bw.lower || mbw.upper != bw.upper) {
+		throw std::invalid_argument("band matrix dimension mismatch in factorization");
+	}
+	load(mat);
+	return factor_loaded();
+}
+
+bool BandLU::factor(const Matrix& mat) {
+	if (mat.get_height() != n || mat.get_width() != n) {
+		throw std::invalid_argument("matrix dimension mismatch in factorization");
+	}
+	load(mat);
+	return factor_loaded();
+}
+
+// Gaussian elimination as in LU, restricted to the band. Multipliers stay in
+// the rows where they were computed, so that row interchanges of later steps
+// don't move them, and solve() applies interchanges step by step.
+bool BandLU::factor_loaded() {
+	constexpr double epsilon = std::numeric_limits<double>::epsilon();
+	for (size_t k = 0; k < n; ++k) {
+		size_t last_row = std::min(n - 1, k + bw.lower);
+		size_t last_col = std::min(n - 1, k + bw.lower + bw.upper);
+		size_t max = k;
+		for (size_t i = k+1; i <= last_row; ++i) {
+			if (std::abs(at(i, k)) > std::abs(at(max, k))) {
+				max = i;
+			}
+		}
+		double pivot = at(max, k);
+		if (!(std::abs(pivot) > epsilon) || !std::isfinite(pivot)) {
+			return false;
+		}
+		pivots[k] = max;
+		if (max != k) {
+			for (size_t j = k; j <= last_col; ++j) {
+				std::swap(at(k, j), at(max, j));
+			}
+		}
+		for (size_t i = k+1; i <= last_row; ++i) {
+			double ratio = at(i, k) / pivot;
+			at(i, k) = ratio;
+			if (ratio == 0.0) {
+				continue;
+			}
+			for (size_t j = k+1; j <= last_col; ++j) {
+				at(i, j) -= ratio * at(k, j);
+			}
+		}
+	}
+	return true;
+}
+
+void BandLU::solve(double* b) const {
+	for (size_t k = 0; k < n; ++k) {
+		std::swap(b[k], b[pivots[k]]);
+		size_t last_row = std::min(n - 1, k + bw.lower);
+		for (size_t i = k+1; i <= last_row; ++i) {
+			b[i] -= at(i, k) * b[k];
+		}
+	}
+	for (size_t i = n; i-- > 0;) {
+		double sum = b[i];
+		size_t last_col = std::min(n - 1, i + bw.lower + bw.upper);
+		for (size_t j = i+1; j <= last_col; ++j) {
+			sum -= at(i, j) * b[j];
+		}
+		b[i] = sum / at(i, i);
+	}
+}
+
+void BandLU::solve(const Matrix& b, Matrix& x) const {
+	for (size_t i = 0; i < n; ++i) {
+		work[i] = b[{i, 0}];
+	}
+	solve(work.data());
+	for (size_t i = 0; i < n; ++i) {
+		x[{i, 0}] = work[i];
+	}
+}
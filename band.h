@@ -0,0 +1,97 @@
+#ifndef ROOTS_BAND_H
+#define ROOTS_BAND_H
+
+#include "expr.h"
+#include "matrix.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Numbers of diagonals below and above the main diagonal which may hold
+// nonzero entries of a square matrix.
+struct Bandwidth {
+	size_t lower = 0;
+	size_t upper = 0;
+
+	// Returns the bandwidth of the Jacobian of the functions, with entry
+	// (i, j) being the derivative of function i by variable vars[j] and zero
+	// if the function doesn't use the variable.
+	static Bandwidth of(const std::vector<Expr>& funcs, const std::vector<std::string>& vars);
+
+	// Whether banded storage and factorization pay off for n x n matrices,
+	// which is when the band covers at most a quarter of every row.
+	bool is_narrow(size_t n) const;
+};
+
+// Square matrix storing only the entries within its band.
+class BandMatrix {
+private:
+	size_t n;
+	Bandwidth bw;
+	// Row i holds columns i - lower to i + upper.
+	std::vector<double> cells;
+
+public:
+	// Initializes a zero matrix.
+	BandMatrix(size_t n, Bandwidth bw);
+
+	// Copies the band of a dense n x n matrix, ignoring other entries.
+	BandMatrix(const Matrix& mat, Bandwidth bw);
+
+	size_t size() const;
+	Bandwidth bandwidth() const;
+	bool in_band(size_t i, size_t j) const;
+
+	// Indexing as in Matrix. Entries outside of the band are zero and can't
+	// be modified.
+	double operator[](std::pair<size_t, size_t> idx) const;
+	double& operator[](std::pair<size_t, size_t> idx);
+};
+
+// LU factorization with partial pivoting of a band matrix, taking O(n*b^2)
+// time and O(n*b) memory for bandwidth b, where dense factorization takes
+// O(n^3) and O(n^2). Row interchanges widen the upper band of U by the lower
+// bandwidth. Buffers are allocated once, so that repeated factorizations
+// don't allocate.
+class BandLU {
+private:
+	size_t n;
+	Bandwidth bw;
+	// Row i of the factors holds columns i - lower to i + lower + upper,
+	// with multipliers of L below the diagonal.
+	size_t width;
+	std::vector<double> lu;
+	// Row interchanged with row k in step k of the elimination.
+	std::vector<size_t> pivots;
+	// Intermediate results of solve().
+	mutable std::vector<double> work;
+
+	double& at(size_t i, size_t j);
+	double at(size_t i, size_t j) const;
+	// Copies the band of the matrix into lu.
+	template<typename M>
+	void load(const M& mat);
+	// Factorizes the matrix copied into lu.
+	bool factor_loaded();
+
+public:
+	BandLU(size_t n, Bandwidth bw);
+
+	size_t size() const;
+	Bandwidth bandwidth() const;
+
+	// Factorizes the matrix, which must have the same size and bandwidth.
+	// Returns false if the matrix is singular.
+	bool factor(const BandMatrix& mat);
+	// Factorizes the band of a dense n x n matrix, whose entries outside of
+	// the band must be zero.
+	bool factor(const Matrix& mat);
+
+	// Solves A x = b for the last factorized matrix, overwriting b with x.
+	void solve(double* b) const;
+	// Same as above, for column vectors b and x of height n.
+	void solve(const Matrix& b, Matrix& x) const;
+};
+
+#endif // ROOTS_BAND_H
@@ -0,0 +1,112 @@
+#include "band.h"
+
+#include "lu.h"
+#include "matrix.h"
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Band matrix with small diagonal entries, so that factorization needs row
+// interchanges.
+Matrix banded(size_t n, Bandwidth bw) {
+	return Matrix(n, n, [&](size_t i, size_t j) {
+		if (j + bw.lower < i || j > i + bw.upper) {
+			return 0.0;
+		}
+		if (i == j) {
+			return 0.1 + 0.01 * i;
+		}
+		return std::sin(1.0 + i * 7.0 + j * 3.0);
+	});
+}
+
+std::vector<double> column(const Matrix& m) {
+	std::vector<double> res(m.get_height());
+	for (size_t i = 0; i < res.size(); ++i) {
+		res[i] = m[{i, 0}];
+	}
+	return res;
+}
+
+} // end anon
+
+TEST(BandTest, Bandwidth) {
+	std::vector<Expr> funcs = {
+		Expr::parse("2*a - b"),
+		Expr::parse("b - a + c"),
+		Expr::parse("c*d - 1"),
+		Expr::parse("d - b^2 + 5"),
+	};
+	auto bw = Bandwidth::of(funcs, {"a", "b", "c", "d"});
+	EXPECT_EQ(bw.lower, 2) << "lower bandwidth";
+	EXPECT_EQ(bw.upper, 1) << "upper bandwidth";
+	bw = Bandwidth::of(funcs, {"d", "c", "b", "a"});
+	EXPECT_EQ(bw.lower, 3) << "lower bandwidth, reversed variables";
+	EXPECT_EQ(bw.upper, 3) << "upper bandwidth, reversed variables";
+	EXPECT_TRUE((Bandwidth{1, 1}).is_narrow(12));
+	EXPECT_FALSE((Bandwidth{1, 1}).is_narrow(11));
+}
+
+TEST(BandTest, Matrix) {
+	auto dense = banded(6, {1, 2});
+	BandMatrix band(dense, {1, 2});
+	const auto& cband = band;
+	for (size_t i = 0; i < 6; ++i) {
+		for (size_t j = 0; j < 6; ++j) {
+			double actual = cband[{i, j}];
+			double expected = dense[{i, j}];
+			EXPECT_EQ(actual, expected) << "entry " << i << ", " << j;
+		}
+	}
+	EXPECT_TRUE(band.in_band(3, 5));
+	EXPECT_FALSE(band.in_band(3, 1));
+	std::pair<size_t, size_t> outside = {5, 0};
+	EXPECT_THROW(band[outside] = 1.0, std::out_of_range);
+}
+
+TEST(BandTest, Solve) {
+	for (Bandwidth bw : {Bandwidth{0, 0}, Bandwidth{1, 1}, Bandwidth{2, 1}, Bandwidth{1, 3}}) {
+		size_t n = 30;
+		auto a = banded(n, bw);
+		Matrix b(n, 1, [](size_t i, size_t) { return 1.0 + i; });
+		LU<double> lu(n);
+		ASSERT_TRUE(lu.factor(a));
+		auto expected = column(b);
+		lu.solve(expected.data());
+
+		BandLU band(n, bw);
+		ASSERT_TRUE(band.factor(BandMatrix(a, bw)));
+		auto actual = column(b);
+		band.solve(actual.data());
+		for (size_t i = 0; i < n; ++i) {
+			EXPECT_NEAR(actual[i], expected[i], 1e-10 * (1.0 + std::abs(expected[i])))
+				<< "component " << i << " with bandwidth " << bw.lower << ", " << bw.upper;
+		}
+		// Factorization of the dense matrix and the matrix solve.
+		ASSERT_TRUE(band.factor(a));
+		Matrix x(n, 1);
+		band.solve(b, x);
+		for (size_t i = 0; i < n; ++i) {
+			double xi = x[{i, 0}];
+			EXPECT_EQ(xi, actual[i]) << "component " << i;
+		}
+	}
+}
+
+TEST(BandTest, Singular) {
+	Bandwidth bw{1, 1};
+	auto a = banded(10, bw);
+	for (size_t j = 0; j < 10; ++j) {
+		if (std::abs(int(j) - 4) <= 1) {
+			a[{4, j}] = 0.0;
+		}
+	}
+	BandLU band(10, bw);
+	EXPECT_FALSE(band.factor(a));
+	EXPECT_THROW(band.factor(BandMatrix(10, {2, 1})), std::invalid_argument);
+}
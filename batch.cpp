@@ -0,0 +1,221 @@
+#include "batch.h"
+
+#include "common.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+constexpr double epsilon = std::numeric_limits<double>::epsilon();
+
+std::vector<std::string> concat(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+	std::vector<std::string> res = a;
+	res.insert(res.end(), b.begin(), b.end());
+	return res;
+}
+
+// Convergence test of solve().
+bool equals(double a, double b, double abs_eps, double rel_eps) {
+	double delta = std::abs(a - b);
+	double scale = std::max(std::abs(a), std::abs(b));
+	return delta <= abs_eps || delta <= scale * rel_eps;
+}
+
+} // end anon
+
+BatchSolver::BatchSolver(const std::vector<Expr>& funcs, std::vector<std::string> vars,
+		std::vector<std::string> params) :
+	vars(std::move(vars)),
+	params(std::move(params)),
+	prog(Program::compile(funcs, concat(this->vars, this->params), false))
+{
+	if (funcs.size() != this->vars.size()) {
+		throw std::invalid_argument("batch solver requires a square system");
+	}
+}
+
+const std::vector<std::string>& BatchSolver::get_vars() const {
+	return vars;
+}
+
+const std::vector<std::string>& BatchSolver::get_params() const {
+	return params;
+}
+
+// Gaussian elimination with partial pivoting. Pivots are chosen and rows
+// swapped instance by instance, after which the elimination of a column is
+// the same for all instances and runs over contiguous arrays.
+void BatchSolver::eliminate(size_t count) {
+	size_t n = vars.size();
+	auto entry = [&](size_t i, size_t k) {
+		return jac.data() + (k*n + i) * count;
+	};
+	auto rhs = [&](size_t i) {
+		return y.data() + i * count;
+	};
+	ratio.resize(count);
+	singular.assign(count, 0);
+	for (size_t k = 0; k < n; ++k) {
+		for (size_t j = 0; j < count; ++j) {
+			size_t max = k;
+			for (size_t i = k+1; i < n; ++i) {
+				if (std::abs(entry(i, k)[j]) > std::abs(entry(max, k)[j])) {
+					max = i;
+				}
+			}
+			// Also catches NaN pivots.
+			if (!(std::abs(entry(max, k)[j]) > epsilon)) {
+				singular[j] = 1;
+			}
+			if (max != k) {
+				for (size_t c = k; c < n; ++c) {
+					std::swap(entry(k, c)[j], entry(max, c)[j]);
+				}
+				std::swap(rhs(k)[j], rhs(max)[j]);
+			}
+		}
+		const double* pivot = entry(k, k);
+		for (size_t i = k+1; i < n; ++i) {
+			const double* lead = entry(i, k);
+			for (size_t j = 0; j < count; ++j) {
+				ratio[j] = lead[j] / pivot[j];
+			}
+			for (size_t c = k+1; c < n; ++c) {
+				double* row = entry(i, c);
+				const double* above = entry(k, c);
+				for (size_t j = 0; j < count; ++j) {
+					row[j] -= ratio[j] * above[j];
+				}
+			}
+			double* b = rhs(i);
+			const double* b_above = rhs(k);
+			for (size_t j = 0; j < count; ++j) {
+				b[j] -= ratio[j] * b_above[j];
+			}
+		}
+	}
+	for (size_t i = n; i-- > 0;) {
+		double* s = step.data() + i * count;
+		std::copy(rhs(i), rhs(i) + count, s);
+		for (size_t c = i+1; c < n; ++c) {
+			const double* a = entry(i, c);
+			const double* s_below = step.data() + c * count;
+			for (size_t j = 0; j < count; ++j) {
+				s[j] -= a[j] * s_below[j];
+			}
+		}
+		const double* diag = entry(i, i);
+		for (size_t j = 0; j < count; ++j) {
+			s[j] /= diag[j];
+		}
+	}
+}
+
+std::vector<BatchResult>
+BatchSolver::solve(const Matrix& init, const Matrix& param_values, const Constraints& constr) {
+	size_t n = vars.size();
+	size_t p = params.size();
+	size_t count = init.get_height();
+	if (init.get_width() != n || param_values.get_width() != p
+			|| param_values.get_height() != count) {
+		throw std::invalid_argument("batch dimension mismatch");
+	}
+	std::vector<BatchResult> res(count);
+	pts.resize((n + p) * count);
+	lanes.resize(count);
+	for (size_t j = 0; j < count; ++j) {
+		lanes[j] = j;
+		for (size_t i = 0; i < n; ++i) {
+			pts[i*count + j] = init[{j, i}];
+		}
+		for (size_t i = 0; i < p; ++i) {
+			pts[(n + i)*count + j] = param_values[{j, i}];
+		}
+		res[j].status = BatchStatus::NoConvergence;
+		res[j].solution.iters = 0;
+		res[j].solution.max_diff = std::numeric_limits<double>::infinity();
+	}
+	y.resize(n * count);
+	jac.resize(n * n * count);
+	step.resize(n * count);
+	failed.resize(count);
+	diff_failed.resize(count);
+	// Stores the variables of active instance j in its result.
+	auto finish = [&](size_t j, BatchStatus status) {
+		auto& r = res[lanes[j]];
+		r.status = status;
+		r.solution.vars.clear();
+		for (size_t i = 0; i < n; ++i) {
+			r.solution.vars.emplace_back(vars[i], pts[i*count + j]);
+		}
+	};
+	for (size_t k = 1; k <= constr.max_iters && count > 0; ++k) {
+		prog.eval_batch(pts.data(), count, y.data(), failed.data(), scratch);
+		for (size_t i = 0; i < n; ++i) {
+			prog.diff_batch(i, pts.data(), count, jac.data() + i*n*count,
+					diff_failed.data(), scratch);
+			for (size_t j = 0; j < count; ++j) {
+				failed[j] |= diff_failed[j];
+			}
+		}
+		eliminate(count);
+		// From here on failed marks the instances to remove.
+		for (size_t j = 0; j < count; ++j) {
+			auto& sol = res[lanes[j]].solution;
+			sol.iters = k;
+			if (failed[j]) {
+				finish(j, BatchStatus::DomainError);
+				continue;
+			}
+			if (singular[j]) {
+				finish(j, BatchStatus::Singular);
+				failed[j] = 1;
+				continue;
+			}
+			bool same = true;
+			double max_diff = 0.0;
+			for (size_t i = 0; i < n; ++i) {
+				double& x = pts[i*count + j];
+				double x1 = x - step[i*count + j];
+				same = same && equals(x, x1, constr.abs_epsilon, constr.rel_epsilon);
+				max_diff = std::max(max_diff, std::abs(x1 - x));
+				x = x1;
+			}
+			sol.max_diff = max_diff;
+			if (k >= constr.min_iters && same) {
+				finish(j, BatchStatus::Converged);
+				failed[j] = 1;
+			}
+		}
+		// Compacts the arrays in place. Entries only move towards the front,
+		// never past entries not yet moved.
+		size_t active = 0;
+		for (size_t j = 0; j < count; ++j) {
+			if (!failed[j]) {
+				lanes[active++] = lanes[j];
+			}
+		}
+		if (active < count) {
+			for (size_t i = 0; i < n + p; ++i) {
+				size_t next = 0;
+				for (size_t j = 0; j < count; ++j) {
+					if (!failed[j]) {
+						pts[i*active + next++] = pts[i*count + j];
+					}
+				}
+			}
+			count = active;
+		}
+	}
+	for (size_t j = 0; j < count; ++j) {
+		finish(j, BatchStatus::NoConvergence);
+	}
+	return res;
+}
+
+std::vector<BatchResult> BatchSolver::solve(const Matrix& init, const Constraints& constr) {
+	return solve(init, Matrix(init.get_height(), 0), constr);
+}
@@ -0,0 +1,92 @@
+#ifndef ROOTS_BATCH_H
+#define ROOTS_BATCH_H
+
+#include "expr.h"
+#include "matrix.h"
+#include "program.h"
+#include "solve.h"
+
+#include <string>
+#include <vector>
+
+// Outcome of solving one instance of a batch, named as in SolveStatus.
+enum class BatchStatus {
+	Converged,
+	// Evaluation of a function or its derivatives failed with a domain error.
+	DomainError,
+	// The Jacobian was singular.
+	Singular,
+	// The iterates didn't settle within Constraints::max_iters.
+	NoConvergence,
+};
+
+struct BatchResult {
+	BatchStatus status;
+	// For instances that didn't converge, vars hold the last iterate and
+	// iters the number of iterations performed.
+	Solution solution;
+};
+
+// Solves many instances of one square system, which differ in the values of
+// parameters and in the initial points, with Newton's method. Instances are
+// stored by variable, so that every operation of an iteration is applied to
+// all instances at once with the SIMD kernels of Program::eval_batch(), and
+// linear systems are eliminated for all instances together. Instances which
+// converge or fail are removed from the arrays, so that later iterations only
+// work on those still iterating.
+//
+// Meant for small systems: the Jacobian takes one differentiation of the
+// whole program per variable and its elimination is dense, so that systems
+// of more than a few variables are solved faster by solve() with System,
+// instance by instance.
+//
+// Results may differ from solve() by rounding errors of the kernels.
+class BatchSolver {
+private:
+	std::vector<std::string> vars;
+	std::vector<std::string> params;
+	// Compiled with the variables followed by the parameters.
+	Program prog;
+	Program::Scratch scratch;
+	// Points of the active instances, the value of variable or parameter i
+	// of instance j being pts[i*count + j], and their indices in the batch.
+	std::vector<double> pts;
+	std::vector<size_t> lanes;
+	// Residuals, the Jacobian with entry (i, k) of instance j at
+	// jac[(k*n + i)*count + j] and the Newton step.
+	std::vector<double> y;
+	std::vector<double> jac;
+	std::vector<double> step;
+	// Row multipliers of the elimination.
+	std::vector<double> ratio;
+	std::vector<unsigned char> failed;
+	std::vector<unsigned char> diff_failed;
+	std::vector<unsigned char> singular;
+
+	// Solves jac * step = y for all active instances, flagging singular ones
+	// in singular.
+	void eliminate(size_t count);
+
+public:
+	// Throws MathError if a function uses a name that is neither a variable
+	// nor a parameter and std::invalid_argument if the system isn't square.
+	BatchSolver(const std::vector<Expr>& funcs, std::vector<std::string> vars,
+			std::vector<std::string> params = {});
+
+	const std::vector<std::string>& get_vars() const;
+	const std::vector<std::string>& get_params() const;
+
+	// Solves instances given by rows of init, holding initial values of the
+	// variables, and rows of param_values, holding the parameters. Results
+	// come in the order of the rows. Only min_iters, max_iters and the
+	// epsilons of the constraints are used, every instance taking Newton's
+	// method with the convergence test of solve(). Failures of instances are
+	// reported in their results and never thrown. Throws std::invalid_argument
+	// if the dimensions of the arguments don't match.
+	std::vector<BatchResult> solve(const Matrix& init, const Matrix& param_values,
+			const Constraints& constr);
+	// Same as above, for systems without parameters.
+	std::vector<BatchResult> solve(const Matrix& init, const Constraints& constr);
+};
+
+#endif // ROOTS_BATCH_H
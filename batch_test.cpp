@@ -0,0 +1,125 @@
+#include "batch.h"
+
+#include "common.h"
+#include "test_util.h"
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const Constraints default_constr;
+
+} // end anon
+
+TEST(BatchTest, Parameters) {
+	auto funcs = parse_all({"x^2 + y^2 - r", "x - c*y"});
+	BatchSolver solver(funcs, {"x", "y"}, {"r", "c"});
+	// More instances than a vector holds, with an odd remainder.
+	size_t count = 1001;
+	Matrix init(count, 2, [](size_t, size_t) { return 3.0; });
+	Matrix params(count, 2, [](size_t i, size_t j) {
+		return j == 0 ? 1.0 + 0.1 * i : 0.5 + std::sin(double(i));
+	});
+	// Some instances end up cycling between iterates a few ulps apart, as
+	// they do with solve().
+	Constraints constr;
+	constr.rel_epsilon = 1e-14;
+	auto results = solver.solve(init, params, constr);
+	ASSERT_EQ(results.size(), count);
+	for (size_t i = 0; i < count; ++i) {
+		double r = params[{i, 0}];
+		double c = params[{i, 1}];
+		double y = std::sqrt(r / (c*c + 1.0));
+		const auto& res = results[i];
+		ASSERT_EQ(res.status, BatchStatus::Converged) << "instance " << i;
+		ASSERT_EQ(res.solution.vars.size(), 2u);
+		EXPECT_EQ(res.solution.vars[0].first, "x");
+		EXPECT_EQ(res.solution.vars[1].first, "y");
+		EXPECT_NEAR(res.solution.vars[0].second, c * y, 1e-12) << "instance " << i;
+		EXPECT_NEAR(res.solution.vars[1].second, y, 1e-12) << "instance " << i;
+		EXPECT_LE(res.solution.max_diff, 1e-12);
+	}
+}
+
+TEST(BatchTest, SameAsSolve) {
+	auto funcs = parse_all({
+		"x^3 - 5*x^2 + 2*x - y + 13",
+		"x^3 + x^2 - 14*x - y - 19",
+		"2*y - x*z - 1",
+	});
+	size_t count = 37;
+	Matrix init(count, 3, [](size_t i, size_t j) {
+		return 5.0 + i * 0.5 - j * 2.0;
+	});
+	BatchSolver solver(funcs, {"x", "y", "z"});
+	auto results = solver.solve(init, default_constr);
+	for (size_t i = 0; i < count; ++i) {
+		std::vector<Binding> start = {
+			{"x", init[{i, 0}]},
+			{"y", init[{i, 1}]},
+			{"z", init[{i, 2}]},
+		};
+		auto expected = solve(funcs, start, default_constr);
+		const auto& actual = results[i];
+		ASSERT_EQ(actual.status, BatchStatus::Converged) << "instance " << i;
+		for (size_t j = 0; j < 3; ++j) {
+			EXPECT_NEAR(actual.solution.vars[j].second, expected.vars[j].second, 1e-12)
+				<< "instance " << i << ", variable " << j;
+		}
+		// Rounding differences may change the last, negligible step.
+		EXPECT_NEAR(double(actual.solution.iters), double(expected.iters), 1.0)
+			<< "instance " << i;
+	}
+}
+
+TEST(BatchTest, Failures) {
+	auto funcs = parse_all({"sqrt(x) - a"});
+	BatchSolver solver(funcs, {"x"}, {"a"});
+	Matrix init = {{2.0}, {-1.0}, {9.0}, {0.0}, {1.0}};
+	Matrix params = {{1.0}, {1.0}, {2.0}, {3.0}, {1e15}};
+	Constraints constr;
+	constr.max_iters = 7;
+	auto results = solver.solve(init, params, constr);
+	ASSERT_EQ(results.size(), 5u);
+	EXPECT_EQ(results[0].status, BatchStatus::Converged);
+	EXPECT_NEAR(results[0].solution.vars[0].second, 1.0, 1e-15);
+	// Square root of a negative number.
+	EXPECT_EQ(results[1].status, BatchStatus::DomainError);
+	EXPECT_EQ(results[1].solution.iters, 1u);
+	EXPECT_EQ(results[1].solution.vars[0].second, -1.0);
+	EXPECT_EQ(results[2].status, BatchStatus::Converged);
+	EXPECT_NEAR(results[2].solution.vars[0].second, 4.0, 1e-14);
+	// Derivative of the square root at zero.
+	EXPECT_EQ(results[3].status, BatchStatus::DomainError);
+	// Far from the root, the iterates only approach it slowly.
+	EXPECT_EQ(results[4].status, BatchStatus::NoConvergence);
+	EXPECT_EQ(results[4].solution.iters, 7u);
+}
+
+TEST(BatchTest, Singular) {
+	auto funcs = parse_all({"x^2 - a"});
+	BatchSolver solver(funcs, {"x"}, {"a"});
+	Matrix init = {{0.0}, {1.0}};
+	Matrix params = {{2.0}, {2.0}};
+	auto results = solver.solve(init, params, default_constr);
+	EXPECT_EQ(results[0].status, BatchStatus::Singular);
+	EXPECT_EQ(results[1].status, BatchStatus::Converged);
+	EXPECT_NEAR(results[1].solution.vars[0].second, std::sqrt(2.0), 1e-15);
+}
+
+TEST(BatchTest, Mismatch) {
+	auto funcs = parse_all({"x + y - a", "x - y"});
+	EXPECT_THROW(BatchSolver(funcs, {"x"}, {"y", "a"}), std::invalid_argument);
+	EXPECT_THROW(BatchSolver(funcs, {"x", "y"}), MathError);
+	BatchSolver solver(funcs, {"x", "y"}, {"a"});
+	EXPECT_THROW(solver.solve(Matrix(3, 2), Matrix(2, 1), default_constr),
+			std::invalid_argument);
+	EXPECT_THROW(solver.solve(Matrix(3, 1), Matrix(3, 1), default_constr),
+			std::invalid_argument);
+	EXPECT_THROW(solver.solve(Matrix(3, 2), default_constr), std::invalid_argument);
+	EXPECT_TRUE(solver.solve(Matrix(0, 2), Matrix(0, 1), default_constr).empty());
+}
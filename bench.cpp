@@ -0,0 +1,585 @@
+// Microbenchmarks of the expression engine, matrix operations and the solver.
+//
+// Usage: bench [--min-time=SECONDS] [FILTER...]
+//
+// Only benchmarks whose names contain one of the filters are run. Results are
+// written to stdout as a JSON document of the form:
+//   {"benchmarks": [{"name": ..., "iterations": ..., "ns_per_op": ...,
+//                    "allocs_per_op": ...}, ...]}
+
+#include "alloc_count.h"
+#include "band.h"
+#include "batch.h"
+#include "common.h"
+#include "expr.h"
+#include "homotopy.h"
+#include "load.h"
+#include "lu.h"
+#include "matrix.h"
+#include "pool.h"
+#include "program.h"
+#include "solve.h"
+#include "system.h"
+#include "vecmath.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// A named system of equations with its starting point.
+struct Problem {
+	std::string name;
+	std::vector<std::string> equations;
+	std::vector<Binding> init;
+};
+
+std::string var(const std::string& prefix, size_t i) {
+	return prefix + std::to_string(i);
+}
+
+// Broyden tridiagonal function:
+//   (3 - 2*x_i)*x_i - x_{i-1} - 2*x_{i+1} + 1 = 0
+// with x_0 = x_{n+1} = 0, starting at x_i = -1.
+Problem broyden(size_t n) {
+	Problem p;
+	p.name = "broyden/" + std::to_string(n);
+	for (size_t i = 1; i <= n; ++i) {
+		std::string eq = "(3 - 2*" + var("x", i) + ")*" + var("x", i);
+		if (i > 1) {
+			eq += " - " + var("x", i - 1);
+		}
+		if (i < n) {
+			eq += " - 2*" + var("x", i + 1);
+		}
+		eq += " + 1";
+		p.equations.push_back(eq);
+		p.init.emplace_back(var("x", i), -1.0);
+	}
+	return p;
+}
+
+// Extended Rosenbrock function, n must be even:
+//   10*(x_{2i} - x_{2i-1}^2) = 0
+//   1 - x_{2i-1} = 0
+// starting at (-1.2, 1, -1.2, 1, ...).
+Problem rosenbrock(size_t n) {
+	Problem p;
+	p.name = "rosenbrock/" + std::to_string(n);
+	for (size_t i = 1; i <= n; i += 2) {
+		p.equations.push_back("10*(" + var("x", i + 1) + " - " + var("x", i) + "^2)");
+		p.equations.push_back("1 - " + var("x", i));
+		p.init.emplace_back(var("x", i), -1.2);
+		p.init.emplace_back(var("x", i + 1), 1.0);
+	}
+	return p;
+}
+
+// Systems from solve_test.cpp and Kepler's equation.
+std::vector<Problem> test_systems() {
+	return {
+		{"sqrt", {"x^2 - 13.11"}, {{"x", 123.0}}},
+		{"kepler", {"x - 0.5*sin(x) - 1"}, {{"x", 1.0}}},
+		{"circle_line", {"x^2 + y^2 - 16", "y - (2*x - 3)"}, {{"x", 100}, {"y", 130}}},
+		{"exponents",
+			{"y^2 * (exp 1)^x - 3", "2*y*(exp 1)^x + 10*y^4"},
+			{{"x", 1}, {"y", -1}}},
+		{"nonlinear3",
+			{"x^3 - 5*x^2 + 2*x - y + 13", "x^3 + x^2 - 14*x - y - 19", "2*y - x*z - 1"},
+			{{"x", 20}, {"y", 5}, {"z", 0}}},
+	};
+}
+
+// Well conditioned, diagonally dominant square matrix.
+Matrix dense_matrix(size_t n) {
+	return Matrix(n, n, [&](size_t i, size_t j) {
+		return 1.0 / (1.0 + i + j) + (i == j ? double(n) : 0.0);
+	});
+}
+
+struct Result {
+	std::string name;
+	size_t iterations;
+	double ns_per_op;
+	double allocs_per_op;
+};
+
+class Runner {
+private:
+	std::vector<std::string> filters;
+	std::chrono::duration<double> min_time;
+	std::vector<Result> results;
+
+public:
+	Runner(std::vector<std::string> filters, double min_time);
+
+	// Runs the operation repeatedly, doubling the number of iterations until
+	// the measurement takes at least min_time.
+	void run(const std::string& name, const std::function<void()>& op);
+
+	void write_json(std::ostream& out) const;
+};
+
+Runner::Runner(std::vector<std::string> filters, double min_time) :
+	filters(std::move(filters)),
+	min_time(min_time) {}
+
+void Runner::run(const std::string& name, const std::function<void()>& op) {
+	if (!filters.empty()) {
+		bool match = false;
+		for (const auto& f : filters) {
+			match = match || name.find(f) != std::string::npos;
+		}
+		if (!match) {
+			return;
+		}
+	}
+	using clock = std::chrono::steady_clock;
+	// Warm up, so that lazily initialized state doesn't get measured.
+	op();
+	size_t iters = 1;
+	while (true) {
+		size_t allocs = allocation_count();
+		auto start = clock::now();
+		for (size_t i = 0; i < iters; ++i) {
+			op();
+		}
+		std::chrono::duration<double> elapsed = clock::now() - start;
+		allocs = allocation_count() - allocs;
+		if (elapsed >= min_time || iters >= (size_t(1) << 40)) {
+			results.push_back(Result{
+				name,
+				iters,
+				elapsed.count() * 1e9 / iters,
+				double(allocs) / iters,
+			});
+			std::cerr << name << ": " << results.back().ns_per_op << " ns/op" << std::endl;
+			return;
+		}
+		iters *= 2;
+	}
+}
+
+void Runner::write_json(std::ostream& out) const {
+	out << "{\"benchmarks\": [";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const auto& r = results[i];
+		char buf[64];
+		out << (i > 0 ? ",\n  " : "\n  ");
+		out << "{\"name\": \"" << r.name << "\"";
+		out << ", \"iterations\": " << r.iterations;
+		std::snprintf(buf, sizeof(buf), "%.3f", r.ns_per_op);
+		out << ", \"ns_per_op\": " << buf;
+		std::snprintf(buf, sizeof(buf), "%.3f", r.allocs_per_op);
+		out << ", \"allocs_per_op\": " << buf << "}";
+	}
+	out << "\n]}" << std::endl;
+}
+
+// Keeps the compiler from optimizing away benchmarked computations.
+volatile double sink;
+
+void bench_problem(Runner& runner, const Problem& p) {
+	std::vector<Expr> funcs;
+	for (const auto& eq : p.equations) {
+		funcs.push_back(Expr::parse(eq));
+	}
+	Expr::Env env(p.init.begin(), p.init.end());
+	Constraints constr;
+
+	runner.run("parse/" + p.name, [&]() {
+		for (const auto& eq : p.equations) {
+			auto expr = Expr::parse(eq);
+			sink = double(expr.value.index());
+		}
+	});
+	runner.run("eval/" + p.name, [&]() {
+		for (const auto& f : funcs) {
+			sink = f.eval(env);
+		}
+	});
+	runner.run("diff/" + p.name, [&]() {
+		for (const auto& f : funcs) {
+			for (const auto& b : p.init) {
+				sink = f.diff(b.first, env);
+			}
+		}
+	});
+	std::vector<Expr> optimized;
+	for (const auto& f : funcs) {
+		optimized.push_back(f.optimize());
+	}
+	runner.run("eval_optimized/" + p.name, [&]() {
+		for (const auto& f : optimized) {
+			sink = f.eval(env);
+		}
+	});
+	runner.run("diff_optimized/" + p.name, [&]() {
+		for (const auto& f : optimized) {
+			for (const auto& b : p.init) {
+				sink = f.diff(b.first, env);
+			}
+		}
+	});
+	std::vector<std::string> names;
+	std::vector<double> values;
+	for (const auto& b : p.init) {
+		names.push_back(b.first);
+		values.push_back(b.second);
+	}
+	auto prog = Program::compile(funcs, names);
+	Program::Scratch scratch;
+	std::vector<double> out(funcs.size());
+	runner.run("program_eval/" + p.name, [&]() {
+		prog.eval(values.data(), out.data(), scratch);
+		sink = out[0];
+	});
+	runner.run("program_diff/" + p.name, [&]() {
+		for (size_t j = 0; j < values.size(); ++j) {
+			prog.diff(j, values.data(), out.data(), scratch);
+			sink = out[0];
+		}
+	});
+	// One variable changes per evaluation, alternating between two values.
+	IncrementalEval inc(prog);
+	inc.set_all(values.data());
+	inc.update();
+	size_t step = 0;
+	runner.run("incremental_eval/" + p.name, [&]() {
+		size_t j = step % values.size();
+		double scale = (step / values.size()) % 2 == 0 ? 1.001 : 1.0;
+		inc.set(j, values[j] * scale);
+		inc.update();
+		sink = inc.output(0);
+		++step;
+	});
+	// Batches of points spread around the starting point, timed per point.
+	constexpr size_t batch = 256;
+	std::vector<double> batch_vars(values.size() * batch);
+	for (size_t i = 0; i < values.size(); ++i) {
+		for (size_t j = 0; j < batch; ++j) {
+			batch_vars[i * batch + j] = values[i] * (1.0 + 1e-3 * j);
+		}
+	}
+	std::vector<double> batch_out(funcs.size() * batch);
+	std::vector<unsigned char> failed(batch);
+	runner.run("program_eval_batch/" + p.name, [&]() {
+		prog.eval_batch(batch_vars.data(), batch, batch_out.data(), failed.data(), scratch);
+		sink = batch_out[0];
+	});
+	runner.run("program_diff_batch/" + p.name, [&]() {
+		for (size_t j = 0; j < values.size(); ++j) {
+			prog.diff_batch(j, batch_vars.data(), batch, batch_out.data(), failed.data(), scratch);
+			sink = batch_out[0];
+		}
+	});
+	System sys(funcs, names);
+	Matrix x(values.size(), 1, [&](size_t i, size_t) { return values[i]; });
+	Matrix y(funcs.size(), 1);
+	Matrix jac(funcs.size(), values.size());
+	runner.run("system_eval/" + p.name, [&]() {
+		sys.eval(x, y, jac, scratch);
+		sink = y[{0, 0}];
+	});
+	runner.run("solve/" + p.name, [&]() {
+		sink = solve(funcs, p.init, constr).max_diff;
+	});
+	SolverWorkspace ws(funcs.size(), p.init.size());
+	runner.run("solve_workspace/" + p.name, [&]() {
+		sink = solve(funcs, p.init, constr, ws).max_diff;
+	});
+	runner.run("solve_system/" + p.name, [&]() {
+		sink = solve(sys, values, constr, ws).max_diff;
+	});
+	// The batch of points above as starting points, solved one by one and
+	// all at once.
+	std::vector<std::vector<double>> points(batch, std::vector<double>(values.size()));
+	Matrix batch_init(batch, values.size(), [&](size_t j, size_t i) {
+		points[j][i] = batch_vars[i * batch + j];
+		return points[j][i];
+	});
+	runner.run("solve_points/" + p.name, [&]() {
+		for (const auto& point : points) {
+			try {
+				sink = solve(sys, point, constr, ws).max_diff;
+			}
+			catch (const MathError&) {
+			}
+		}
+	});
+	BatchSolver batch_solver(funcs, names);
+	runner.run("solve_batch/" + p.name, [&]() {
+		sink = batch_solver.solve(batch_init, constr)[0].solution.max_diff;
+	});
+	Constraints mixed_constr;
+	mixed_constr.mixed_precision = true;
+	runner.run("solve_mixed/" + p.name, [&]() {
+		sink = solve(funcs, p.init, mixed_constr, ws).max_diff;
+	});
+	Constraints predicted_constr;
+	predicted_constr.predicted_error = true;
+	runner.run("solve_predicted/" + p.name, [&]() {
+		sink = solve(funcs, p.init, predicted_constr, ws).max_diff;
+	});
+	Constraints chebyshev_constr;
+	chebyshev_constr.method = Method::Chebyshev;
+	runner.run("solve_chebyshev/" + p.name, [&]() {
+		sink = solve(funcs, p.init, chebyshev_constr, ws).max_diff;
+	});
+	if (funcs.size() == 1) {
+		Constraints halley_constr;
+		halley_constr.method = Method::Halley;
+		runner.run("solve_halley/" + p.name, [&]() {
+			sink = solve(funcs, p.init, halley_constr).max_diff;
+		});
+	}
+}
+
+void bench_matrix(Runner& runner, size_t n) {
+	auto mat = dense_matrix(n);
+	auto suffix = "/" + std::to_string(n);
+	runner.run("matrix_mul" + suffix, [&]() {
+		sink = (mat * mat)[{0, 0}];
+	});
+	// The difference reuses the storage of the sum.
+	runner.run("matrix_add_sub" + suffix, [&]() {
+		sink = (mat + mat - mat)[{0, 0}];
+	});
+	runner.run("matrix_inverse" + suffix, [&]() {
+		sink = (*mat.inverse())[{0, 0}];
+	});
+	LU<double> lu_double(n);
+	runner.run("lu_double" + suffix, [&]() {
+		sink = lu_double.factor(mat);
+	});
+	LU<float> lu_float(n);
+	runner.run("lu_float" + suffix, [&]() {
+		sink = lu_float.factor(mat);
+	});
+	Matrix rhs(n, 1, [](size_t i, size_t) { return 1.0 + i; });
+	Matrix x(n, 1);
+	MixedSolver mixed(n);
+	runner.run("mixed_solve" + suffix, [&]() {
+		sink = mixed.solve(mat, rhs, x);
+	});
+	// Tridiagonal part of the matrix, factorized densely and as a band.
+	Bandwidth tri = {1, 1};
+	Matrix band(n, n, [&](size_t i, size_t j) {
+		return j + 1 >= i && j <= i + 1 ? mat[{i, j}] : 0.0;
+	});
+	runner.run("lu_double_tridiagonal" + suffix, [&]() {
+		sink = lu_double.factor(band);
+	});
+	BandLU band_lu(n, tri);
+	runner.run("band_lu_tridiagonal" + suffix, [&]() {
+		sink = band_lu.factor(band);
+		band_lu.solve(rhs, x);
+	});
+}
+
+// Factorization of a large matrix by Gauss-Jordan inversion, the unblocked
+// LU and the blocked LU with increasing numbers of threads.
+void bench_parallel_lu(Runner& runner, size_t n) {
+	auto mat = dense_matrix(n);
+	auto suffix = "/" + std::to_string(n);
+	runner.run("matrix_inverse" + suffix, [&]() {
+		sink = (*mat.inverse())[{0, 0}];
+	});
+	LU<double> lu(n);
+	runner.run("lu_double" + suffix, [&]() {
+		sink = lu.factor(mat);
+	});
+	for (size_t threads = 1; threads <= 64; threads *= 2) {
+		ThreadPool pool(threads);
+		runner.run("lu_blocked" + suffix + "/threads=" + std::to_string(threads), [&]() {
+			sink = lu.factor(mat, pool);
+		});
+	}
+}
+
+// Parsing a large system one line at a time and with parse_equations() on
+// increasing numbers of threads.
+void bench_load(Runner& runner, size_t lines) {
+	std::string text;
+	for (size_t i = 0; i < lines; ++i) {
+		text += "x" + std::to_string(i) + " * sin(x" + std::to_string((i + 1) % lines)
+			+ ") - 2.5 * x" + std::to_string((i + 7) % lines) + "^2 = " + std::to_string(i % 10) + "\n";
+	}
+	auto suffix = "/" + std::to_string(lines);
+	runner.run("parse_lines" + suffix, [&]() {
+		std::vector<Expr> funcs;
+		size_t pos = 0;
+		while (pos < text.size()) {
+			size_t end = text.find('\n', pos);
+			funcs.push_back(Expr::parse(text.substr(pos, end - pos)));
+			pos = end + 1;
+		}
+		sink = funcs.size();
+	});
+	for (size_t threads = 1; threads <= 8; threads *= 2) {
+		runner.run("parse_equations" + suffix + "/threads=" + std::to_string(threads), [&]() {
+			sink = parse_equations(text, threads).funcs.size();
+		});
+	}
+}
+
+// Multi-start solving from a grid of points, most of which fail with domain
+// errors in the first iterations, caught as exceptions and returned as
+// statuses.
+void bench_failures(Runner& runner) {
+	std::vector<Expr> funcs = {
+		Expr::parse("ln(x) + y^2 - 1"),
+		Expr::parse("sqrt(y) - x + 0.5"),
+	};
+	std::vector<std::vector<Binding>> starts;
+	for (int i = -8; i < 8; ++i) {
+		for (int j = -8; j < 8; ++j) {
+			starts.push_back({{"x", i + 0.25}, {"y", j + 0.25}});
+		}
+	}
+	SolverWorkspace ws(2, 2);
+	Constraints constr;
+	runner.run("multistart_throw", [&]() {
+		size_t found = 0;
+		for (const auto& init : starts) {
+			try {
+				solve(funcs, init, constr, ws);
+				++found;
+			}
+			catch (const MathError&) {
+			}
+		}
+		sink = double(found);
+	});
+	runner.run("multistart_status", [&]() {
+		size_t found = 0;
+		for (const auto& init : starts) {
+			found += try_solve(funcs, init, constr, ws).ok();
+		}
+		sink = double(found);
+	});
+	Expr::Env env = {{"x", -1.0}, {"y", 1.0}};
+	runner.run("eval_failure_throw", [&]() {
+		try {
+			sink = funcs[0].eval(env);
+		}
+		catch (const MathError&) {
+		}
+	});
+	runner.run("eval_failure_status", [&]() {
+		sink = funcs[0].try_eval(env).val;
+	});
+}
+
+// All roots of polynomial systems by homotopy continuation, on one thread.
+void bench_homotopy(Runner& runner) {
+	std::vector<Problem> problems = {
+		{"katsura3",
+			{"a + 2*b + 2*c + 2*d - 1", "a^2 + 2*b^2 + 2*c^2 + 2*d^2 - a",
+				"2*a*b + 2*b*c + 2*c*d - b", "b^2 + 2*a*c + 2*b*d - c"},
+			{{"a", 0}, {"b", 0}, {"c", 0}, {"d", 0}}},
+	};
+	for (const auto& p : test_systems()) {
+		if (p.name != "kepler" && p.name != "exponents") {
+			problems.push_back(p);
+		}
+	}
+	HomotopyOptions opts;
+	opts.threads = 1;
+	for (const auto& p : problems) {
+		std::vector<Expr> funcs;
+		std::vector<std::string> names;
+		for (const auto& eq : p.equations) {
+			funcs.push_back(Expr::parse(eq));
+		}
+		for (const auto& b : p.init) {
+			names.push_back(b.first);
+		}
+		runner.run("homotopy/" + p.name, [&]() {
+			sink = double(homotopy(funcs, names, opts).roots.size());
+		});
+	}
+}
+
+// Elementary functions over arrays, with the C library as the baseline.
+void bench_vecmath(Runner& runner, size_t n) {
+	std::vector<double> x(n);
+	for (size_t i = 0; i < n; ++i) {
+		x[i] = 0.5 + 10.0 * i / n;
+	}
+	std::vector<double> out(n);
+	std::vector<unsigned char> bad(n);
+	auto suffix = "/" + std::string(vecmath::isa()) + "/" + std::to_string(n);
+	runner.run("vecmath_sin" + suffix, [&]() {
+		vecmath::sin(x.data(), out.data(), n);
+		sink = out[0];
+	});
+	runner.run("libm_sin/" + std::to_string(n), [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			out[i] = std::sin(x[i]);
+		}
+		sink = out[0];
+	});
+	runner.run("vecmath_exp" + suffix, [&]() {
+		vecmath::exp(x.data(), out.data(), n);
+		sink = out[0];
+	});
+	runner.run("libm_exp/" + std::to_string(n), [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			out[i] = std::exp(x[i]);
+		}
+		sink = out[0];
+	});
+	runner.run("vecmath_ln" + suffix, [&]() {
+		vecmath::ln(x.data(), out.data(), bad.data(), n);
+		sink = out[0];
+	});
+	runner.run("libm_ln/" + std::to_string(n), [&]() {
+		for (size_t i = 0; i < n; ++i) {
+			out[i] = std::log(x[i]);
+		}
+		sink = out[0];
+	});
+}
+
+} // end anon
+
+int main(int argc, char* argv[]) {
+	std::vector<std::string> filters;
+	double min_time = 0.2;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		std::string opt = "--min-time=";
+		if (arg.compare(0, opt.size(), opt) == 0) {
+			min_time = std::stod(arg.substr(opt.size()));
+		}
+		else {
+			filters.push_back(arg);
+		}
+	}
+	Runner runner(filters, min_time);
+
+	for (const auto& p : test_systems()) {
+		bench_problem(runner, p);
+	}
+	for (size_t n : {4, 16, 64}) {
+		bench_problem(runner, broyden(n));
+		bench_problem(runner, rosenbrock(n));
+	}
+	for (size_t n : {4, 16, 64, 256}) {
+		bench_matrix(runner, n);
+	}
+	bench_parallel_lu(runner, 1024);
+	bench_load(runner, 100000);
+	bench_failures(runner);
+	bench_vecmath(runner, 1024);
+	bench_homotopy(runner);
+
+	runner.write_json(std::cout);
+	return 0;
+}
@@ -0,0 +1,147 @@
+// Headless batch solver.
+//
+// Usage: roots-cli [-j THREADS] [FILE...]
+//
+// Reads systems from the given files, or from stdin when no files are given
+// ("-" stands for stdin too), solves them on a thread pool and writes one
+// JSON object per system to stdout, in input order. Every file is either in
+// JSON Lines or in block format, detected by its first non-blank character.
+// Systems in block format end at the end of their file. Every system is
+// solved on a single thread of the pool; the "threads" constraint starts
+// another pool for the system, which oversubscribes the processors.
+//
+// JSON Lines format, one system per line:
+//   {"id": 1, "equations": ["x^2 + y^2 = 16", "y = 2*x - 3"],
+//    "init": {"x": 100, "y": 130}, "constraints": {"max_iters": 50}}
+// where "id" is optional and copied to the output, and so are "constraints".
+//
+// Block format, systems separated by blank lines:
+//   # comment
+//   x^2 + y^2 = 16
+//   y = 2*x - 3
+//   let x = 100
+//   let y = 130
+//   set max_iters = 50
+//   set method = chebyshev
+//
+// Constraints are named as the members of Constraints, see set_constraint().
+// Output lines have the form:
+//   {"index": 0, "id": 1, "status": "ok", "iters": 7, "max_diff": 1e-17,
+//    "criterion": "step", "vars": {"x": 2.89, "y": 2.78}}
+//   {"index": 1, "status": "error", "error": "domain error"}
+
+#include "common.h"
+#include "expr.h"
+#include "jobs.h"
+#include "json.h"
+#include "pool.h"
+#include "solve.h"
+
+#include <deque>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Parses a non-negative decimal integer.
+std::optional<size_t> parse_count(const std::string& str) {
+	if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos) {
+		return std::nullopt;
+	}
+	try {
+		return std::stoul(str);
+	}
+	catch (const std::out_of_range&) {
+		return std::nullopt;
+	}
+}
+
+// Parses and solves the system, returning the output line.
+std::string run(const Job& job) {
+	Json::Object out;
+	out.emplace_back("index", Json(double(job.index)));
+	if (job.id) {
+		out.emplace_back("id", *job.id);
+	}
+	try {
+		if (job.error) {
+			throw ParseError(*job.error);
+		}
+		std::vector<Expr> funcs;
+		for (const auto& eq : job.equations) {
+			funcs.push_back(Expr::parse(eq).optimize());
+		}
+		auto sol = solve(funcs, job.init, job.constr);
+		Json::Object vars;
+		for (const auto& b : sol.vars) {
+			vars.emplace_back(b.first, Json(b.second));
+		}
+		out.emplace_back("status", "ok");
+		out.emplace_back("iters", Json(double(sol.iters)));
+		out.emplace_back("max_diff", Json(sol.max_diff));
+		out.emplace_back("criterion", criterion_name(sol.criterion));
+		out.emplace_back("vars", Json(std::move(vars)));
+	}
+	catch (const BaseError& err) {
+		out.emplace_back("status", "error");
+		out.emplace_back("error", err.what());
+	}
+	return Json(std::move(out)).dump();
+}
+
+} // end anon
+
+int main(int argc, char* argv[]) {
+	std::string usage = std::string("usage: ") + argv[0] + " [-j THREADS] [FILE...]";
+	size_t threads = 0;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "-j") {
+			auto count = i + 1 < argc ? parse_count(argv[++i]) : std::nullopt;
+			if (!count) {
+				std::cerr << argv[0] << ": -j expects a number of threads\n" << usage << std::endl;
+				return 2;
+			}
+			threads = *count;
+		}
+		else if (arg == "-h" || arg == "--help") {
+			std::cout << usage << std::endl;
+			return 0;
+		}
+		else {
+			files.push_back(arg);
+		}
+	}
+	try {
+		ThreadPool pool(threads);
+		// Results are written in input order, and at most window systems are
+		// in flight at any time, which bounds memory usage.
+		size_t window = 4 * pool.size();
+		std::deque<std::future<std::string>> pending;
+		auto flush = [&]() {
+			std::cout << pending.front().get() << '\n';
+			pending.pop_front();
+		};
+		JobReader reader(files);
+		Job job;
+		while (reader.read(job)) {
+			if (pending.size() >= window) {
+				flush();
+			}
+			pending.push_back(pool.submit([job = std::move(job)]() { return run(job); }));
+		}
+		while (!pending.empty()) {
+			flush();
+		}
+		std::cout.flush();
+	}
+	catch (const std::exception& err) {
+		std::cerr << argv[0] << ": " << err.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
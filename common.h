@@ -14,6 +14,10 @@ class MathError : public BaseError {
 	using BaseError::BaseError;
 };
 
+class CancelledError : public BaseError {
+	using BaseError::BaseError;
+};
+
 class ParseError : public BaseError {
 	using BaseError::BaseError;
 };
@@ -1,18 +1,25 @@
 #include "expr.h"
 
 #include "common.h"
+#include "num.h"
+#include "profile.h"
 
-#include <cfenv>
 #include <cmath>
+#include <cstring>
 #include <functional>
+#include <limits>
+#include <map>
 #include <sstream>
 #include <stdexcept>
+#include <tuple>
 
 Expr::Const::Const(double val) : val(val) {}
 
 Expr::Var::Var(std::string name) :
 	name(std::make_shared<std::string>(std::move(name))) {}
 
+Expr::Var::Var(std::shared_ptr<const std::string> name) : name(std::move(name)) {}
+
 Expr::Binary::Binary(BinaryOp type, Expr x, Expr y) :
 	type(type),
 	lhs(std::make_shared<Expr>(std::move(x))),
@@ -107,155 +114,139 @@ Expr::Vars Expr::variables() const {
 
 namespace {
 
-template<typename Fun>
-double checked(Fun fun) {
-	std::feclearexcept(FE_ALL_EXCEPT);
-	double y = fun();
-	if (std::fetestexcept(FE_DIVBYZERO | FE_INVALID)) {
-		throw MathError("domain error");
-	}
-	return y;
-}
-
-double ediv(double x, double y) {
-	return checked([=]() { return x / y; });
-}
-
-double epow(double x, double y) {
-	return checked([=]() { return std::pow(x ,y); });
-}
-
-double elog(double x) {
-	return checked([=]() { return std::log(x); });
-}
-
-double esqrt(double x) {
-	return checked([=]() { return std::sqrt(x); });
-}
-
-struct Float {
-	double val;
-
-	Float();
-	Float(double val);
+// Rewrites expressions bottom up, keeping a single copy of every distinct
+// subexpression.
+class Optimizer {
+private:
+	using Ptr = std::shared_ptr<const Expr>;
+	using Key = std::tuple<int, int, const Expr*, const Expr*>;
 
-	Float pow(Float y) const;
+	std::unordered_map<const Expr*, Ptr> done;
+	std::unordered_map<uint64_t, Ptr> consts;
+	std::unordered_map<std::string, Ptr> vars;
+	std::map<Key, Ptr> nodes;
 
-	Float sin() const;
-	Float cos() const;
-	Float ln() const;
-	Float exp() const;
-	Float sqrt() const;
-};
+	Ptr constant(double val);
+	Ptr rewrite(const Expr& expr);
 
-Float::Float() : val(0) {}
-Float::Float(double val) : val(val) {}
-
-Float operator+(Float x, Float y) { return Float(x.val + y.val); }
-Float operator-(Float x, Float y) { return Float(x.val - y.val); }
-Float operator*(Float x, Float y) { return Float(x.val * y.val); }
-Float operator/(Float x, Float y) { return Float(ediv(x.val, y.val)); }
-Float Float::pow(Float y) const { return Float(epow(val, y.val)); }
-
-Float operator-(Float x) { return Float(-x.val); }
-Float Float::sin() const { return Float(std::sin(val)); }
-Float Float::cos() const { return Float(std::cos(val)); }
-Float Float::ln() const { return Float(elog(val)); }
-Float Float::exp() const { return Float(std::exp(val)); }
-Float Float::sqrt() const { return Float(esqrt(val)); }
-
-// Dual number for forward mode automatic differentiation.
-// It contains a value (val), its derivative (deriv) and a boolean flag (cons)
-// indicating whether the number is a constant or not.
-struct Dual {
-	double val;
-	double deriv;
-	bool cons;
-
-	Dual();
-	Dual(double val);
-	Dual(double val, double deriv, bool cons);
-
-	Dual pow(Dual y) const;
-
-	Dual sin() const;
-	Dual cos() const;
-	Dual ln() const;
-	Dual exp() const;
-	Dual sqrt() const;
+public:
+	Ptr run(const Expr& expr);
 };
 
-Dual::Dual() : Dual(0.0, 0.0, true) {}
-Dual::Dual(double val) : Dual(val, 0.0, true) {}
-Dual::Dual(double val, double deriv, bool cons) : val(val), deriv(deriv), cons(cons) {}
-
-Dual operator+(Dual x, Dual y) {
-	return Dual(x.val + y.val, x.deriv + y.deriv, x.cons && y.cons);
-}
-
-Dual operator-(Dual x, Dual y) {
-	return Dual(x.val - y.val, x.deriv - y.deriv, x.cons && y.cons);
-}
-
-Dual operator*(Dual x, Dual y) {
-	return Dual(x.val * y.val,
-			(x.deriv * y.val) + (x.val * y.deriv),
-			x.cons && y.cons);
-}
-
-Dual operator/(Dual x, Dual y) {
-	return Dual(ediv(x.val, y.val),
-			ediv((x.deriv * y.val) - (x.val * y.deriv), y.val * y.val),
-			x.cons && y.cons);
+Optimizer::Ptr Optimizer::constant(double val) {
+	uint64_t bits;
+	std::memcpy(&bits, &val, sizeof(bits));
+	auto& ptr = consts[bits];
+	if (!ptr) {
+		ptr = std::make_shared<Expr>(val);
+	}
+	return ptr;
 }
 
-Dual Dual::pow(Dual y) const {
-	auto x = *this;
-	double out;
-	if (y.cons) {
-		// For constant exponents we use the basic (x^k)' = k * x^(k-1) formula
-		// with an exception for k = 1.
-		if (y.val == 1.0) {
-			out = x.deriv;
-		}
-		else {
-			out = y.val * epow(x.val, y.val - 1.0) * x.deriv;
+// Returns the value of the expression if it has constant operands and
+// evaluates without errors, errors are left to be reported at evaluation.
+// Differentiation checks more cases than evaluation, e.g. sqrt(0) has no
+// derivative, so the expression must be differentiable as well.
+std::optional<double> fold(const Expr& expr, std::initializer_list<const Expr*> args) {
+	for (auto arg : args) {
+		if (!std::holds_alternative<Const>(arg->value)) {
+			return std::nullopt;
 		}
 	}
-	else {
-		// For functional exponents we use the generalized power rule.
-		out = epow(x.val, y.val) *
-			(y.deriv * elog(x.val) + ediv(x.deriv * y.val, x.val));
+	FaultTrap trap;
+	expr.diff(std::string(), Env());
+	double val = expr.eval(Env());
+	if (trap.raised()) {
+		return std::nullopt;
 	}
-	return Dual(epow(x.val, y.val), out, x.cons && y.cons);
+	return val;
 }
 
-Dual operator-(Dual x) {
-	return Dual(-x.val, -x.deriv, x.cons);
+// Checks if multiplication by 1/x gives the same results as division by x,
+// that is if x is a power of two with a representable reciprocal.
+bool exact_reciprocal(double x) {
+	int exp;
+	return std::isfinite(x) && x != 0.0 &&
+		std::abs(std::frexp(x, &exp)) == 0.5 && std::isnormal(1.0 / x);
 }
 
-Dual Dual::sin() const {
-	return Dual(std::sin(val), std::cos(val) * deriv, cons);
+Optimizer::Ptr Optimizer::rewrite(const Expr& expr) {
+	return std::visit(overloaded {
+		[&](const Const& c) {
+			return constant(c.val);
+		},
+		[&](const Var& var) {
+			auto& ptr = vars[*var.name];
+			if (!ptr) {
+				ptr = std::make_shared<Expr>(expr);
+			}
+			return ptr;
+		},
+		[&](const Binary& bin) {
+			auto lhs = run(*bin.lhs);
+			auto rhs = run(*bin.rhs);
+			auto type = bin.type;
+			if (type == BinaryOp::Div && std::holds_alternative<Const>(rhs->value)) {
+				double div = std::get<Const>(rhs->value).val;
+				if (exact_reciprocal(div)) {
+					type = BinaryOp::Mul;
+					rhs = constant(1.0 / div);
+				}
+			}
+			Key key(0, int(type), lhs.get(), rhs.get());
+			auto found = nodes.find(key);
+			if (found != nodes.end()) {
+				return found->second;
+			}
+			Binary out(type, Expr(), Expr());
+			out.lhs = lhs;
+			out.rhs = rhs;
+			Expr res(std::move(out));
+			auto val = fold(res, {lhs.get(), rhs.get()});
+			auto ptr = val ? constant(*val) : std::make_shared<Expr>(std::move(res));
+			nodes.emplace(key, ptr);
+			return ptr;
+		},
+		[&](const Unary& un) {
+			auto arg = run(*un.arg);
+			Key key(1, int(un.type), arg.get(), nullptr);
+			auto found = nodes.find(key);
+			if (found != nodes.end()) {
+				return found->second;
+			}
+			Unary out(un.type, Expr());
+			out.arg = arg;
+			Expr res(std::move(out));
+			auto val = fold(res, {arg.get()});
+			auto ptr = val ? constant(*val) : std::make_shared<Expr>(std::move(res));
+			nodes.emplace(key, ptr);
+			return ptr;
+		},
+	}, expr.value);
 }
 
-Dual Dual::cos() const {
-	return Dual(std::cos(val), -std::sin(val) * deriv, cons);
+Optimizer::Ptr Optimizer::run(const Expr& expr) {
+	auto found = done.find(&expr);
+	if (found != done.end()) {
+		return found->second;
+	}
+	auto ptr = rewrite(expr);
+	done.emplace(&expr, ptr);
+	return ptr;
 }
 
-Dual Dual::ln() const {
-	return Dual(elog(val), ediv(deriv, val), cons);
-}
+} // end anon
 
-Dual Dual::exp() const {
-	return Dual(std::exp(val), std::exp(val) * deriv, cons);
+Expr Expr::optimize() const {
+	Optimizer opt;
+	return *opt.run(*this);
 }
 
-Dual Dual::sqrt() const {
-	return Dual(esqrt(val), ediv(deriv, 2 * esqrt(val)), cons);
-}
+namespace {
 
 template<typename Num>
 Num eval_rec(const Expr& expr, const std::function<Num(const std::string&)>& seed) {
+	PROFILE_COUNT(nodes);
 	return std::visit(overloaded {
 		[](const Const& c) {
 			return Num(c.val);
@@ -292,24 +283,94 @@ Num eval_rec(const Expr& expr, const std::function<Num(const std::string&)>& see
 	}, expr.value);
 }
 
+// Finds the node at which evaluation with a trap active fails, descending
+// into the first failing operand. Only called after a failure, so that
+// successful evaluations don't check every node.
+const Expr* failed_node(const Expr& expr, const std::function<Float(const std::string&)>& seed) {
+	auto fails = [&](const Expr& arg) {
+		FaultTrap trap;
+		eval_rec(arg, seed);
+		return trap.raised();
+	};
+	return std::visit(overloaded {
+		[&](const Binary& bin) {
+			if (fails(*bin.lhs)) {
+				return failed_node(*bin.lhs, seed);
+			}
+			if (fails(*bin.rhs)) {
+				return failed_node(*bin.rhs, seed);
+			}
+			return &expr;
+		},
+		[&](const Unary& un) {
+			if (fails(*un.arg)) {
+				return failed_node(*un.arg, seed);
+			}
+			return &expr;
+		},
+		[&](const auto&) {
+			return &expr;
+		},
+	}, expr.value);
+}
+
+// Reports a variable missing from the environment to the active trap, or
+// throws MathError if there's none.
+void undefined_variable(const std::string& var) {
+	if (auto trap = FaultTrap::active()) {
+		trap->undefined_variable(var);
+		return;
+	}
+	throw MathError("undefined variable " + var);
+}
+
 } // end anon
 
-double Expr::eval(const Env& env) const {
-	auto out = eval_rec<Float>(*this, [&](const std::string& var) {
+Expr::EvalResult Expr::try_eval(const Env& env) const noexcept {
+	PROFILE_SCOPE(Phase::Eval);
+	std::function<Float(const std::string&)> seed = [&](const std::string& var) {
+		PROFILE_SCOPE(Phase::Lookup);
 		auto it = env.find(var);
 		if (it == env.end()) {
-			throw MathError("undefined variable " + var);
+			undefined_variable(var);
+			return Float(std::numeric_limits<double>::quiet_NaN());
 		}
 		return Float(it->second);
-	});
-	return out.val;
+	};
+	FaultTrap trap;
+	double val = eval_rec(*this, seed).val;
+	if (!trap.raised()) {
+		return EvalResult{EvalStatus::Ok, val, nullptr};
+	}
+	auto status = trap.get_fault() == FaultTrap::Fault::UndefinedVariable
+		? EvalStatus::UndefinedVariable
+		: EvalStatus::DomainError;
+	return EvalResult{status, std::numeric_limits<double>::quiet_NaN(), failed_node(*this, seed)};
+}
+
+double Expr::eval(const Env& env) const {
+	auto res = try_eval(env);
+	switch (res.status) {
+	case EvalStatus::Ok:
+		break;
+	case EvalStatus::DomainError:
+		domain_error();
+		break;
+	case EvalStatus::UndefinedVariable:
+		undefined_variable(*std::get<Var>(res.node->value).name);
+		break;
+	}
+	return res.val;
 }
 
 double Expr::diff(const std::string& x, const Env& env) const {
+	PROFILE_SCOPE(Phase::Diff);
 	auto out = eval_rec<Dual>(*this, [&](const std::string& var) {
+		PROFILE_SCOPE(Phase::Lookup);
 		auto it = env.find(var);
 		if (it == env.end()) {
-			throw MathError("undefined variable " + var);
+			undefined_variable(var);
+			return Dual(std::numeric_limits<double>::quiet_NaN());
 		}
 		auto v = it->second;
 		if (var == x) {
@@ -322,6 +383,107 @@ double Expr::diff(const std::string& x, const Env& env) const {
 	return out.deriv;
 }
 
+namespace {
+
+double check_finite(double x) {
+	if (!std::isfinite(x)) {
+		domain_error();
+	}
+	return x;
+}
+
+} // end anon
+
+// Entries of the Hessian are mixed derivatives along pairs of coordinate
+// directions, so the upper triangle takes n(n+1)/2 hyper-dual evaluations.
+Matrix Expr::hessian(const std::vector<std::string>& vars, const Env& env) const {
+	PROFILE_SCOPE(Phase::Diff);
+	size_t n = vars.size();
+	Matrix res(n, n);
+	for (size_t i = 0; i < n; ++i) {
+		for (size_t j = i; j < n; ++j) {
+			auto out = eval_rec<HyperDual>(*this, [&](const std::string& var) {
+				PROFILE_SCOPE(Phase::Lookup);
+				auto it = env.find(var);
+				if (it == env.end()) {
+					undefined_variable(var);
+					return HyperDual(std::numeric_limits<double>::quiet_NaN());
+				}
+				double e1 = var == vars[i] ? 1.0 : 0.0;
+				double e2 = var == vars[j] ? 1.0 : 0.0;
+				return HyperDual(it->second, e1, e2, 0.0, e1 == 0.0 && e2 == 0.0);
+			});
+			res[{i, j}] = check_finite(out.e12);
+			res[{j, i}] = res[{i, j}];
+		}
+	}
+	return res;
+}
+
+double Expr::second_diff(const Env& dir, const Env& env) const {
+	PROFILE_SCOPE(Phase::Diff);
+	auto out = eval_rec<HyperDual>(*this, [&](const std::string& var) {
+		PROFILE_SCOPE(Phase::Lookup);
+		auto it = env.find(var);
+		if (it == env.end()) {
+			undefined_variable(var);
+			return HyperDual(std::numeric_limits<double>::quiet_NaN());
+		}
+		auto d = dir.find(var);
+		double e = d == dir.end() ? 0.0 : d->second;
+		return HyperDual(it->second, e, e, 0.0, e == 0.0);
+	});
+	return check_finite(out.e12);
+}
+
+Expr::Derivs Expr::derivs(const std::string& x, double v, int order) const {
+	PROFILE_SCOPE(Phase::Diff);
+	// Other variables evaluate to NaN when the failure is trapped.
+	auto seed = [&](const std::string& var) {
+		if (var != x) {
+			undefined_variable(var);
+			return std::numeric_limits<double>::quiet_NaN();
+		}
+		return v;
+	};
+	if (order < 2) {
+		auto out = eval_rec<Dual>(*this, [&](const std::string& var) {
+			return Dual(seed(var), 1.0, false);
+		});
+		return Derivs{out.val, out.deriv, 0.0};
+	}
+	auto out = eval_rec<Jet>(*this, [&](const std::string& var) {
+		return Jet(seed(var), 1.0, 0.0, false);
+	});
+	return Derivs{out.val, out.d1, out.d2};
+}
+
+Interval Expr::eval_interval(const IntervalEnv& env) const {
+	return eval_rec<Interval>(*this, [&](const std::string& var) {
+		auto it = env.find(var);
+		if (it == env.end()) {
+			throw MathError("undefined variable " + var);
+		}
+		return it->second;
+	});
+}
+
+Interval Expr::diff_interval(const std::string& x, const IntervalEnv& env) const {
+	auto out = eval_rec<IntervalDual>(*this, [&](const std::string& var) {
+		auto it = env.find(var);
+		if (it == env.end()) {
+			throw MathError("undefined variable " + var);
+		}
+		if (var == x) {
+			return IntervalDual(it->second, 1.0, false);
+		}
+		else {
+			return IntervalDual(it->second, 0.0, true);
+		}
+	});
+	return out.deriv;
+}
+
 void Expr::show_rec(std::string& buf) const {
 	return std::visit(overloaded {
 		[&](const Const& c) {
@@ -434,12 +596,12 @@ class Tokenizer {
 private:
 	static constexpr std::string_view operators = "=+-*/^";
 
-	std::string::const_iterator iter;
-	std::string::const_iterator end;
+	std::string_view::const_iterator iter;
+	std::string_view::const_iterator end;
 	Token token;
 
 public:
-	Tokenizer(const std::string& input);
+	Tokenizer(std::string_view input);
 
 private:
 	char get() const;
@@ -453,7 +615,7 @@ public:
 	const Token* operator->() const;
 };
 
-Tokenizer::Tokenizer(const std::string& input) :
+Tokenizer::Tokenizer(std::string_view input) :
 	iter(input.begin()),
 	end(input.end()) {}
 
@@ -561,9 +723,10 @@ const std::unordered_map<std::string, UnaryDef> unary_ops = {
 	{"sqrt", {UnaryOp::Sqrt, 2, true}},
 };
 
-Expr parse_expr(Tokenizer& tokens, int min_prec = 0);
+// Variables are interned in names, unless it's null.
+Expr parse_expr(Tokenizer& tokens, Interner* names, int min_prec = 0);
 
-Expr parse_atom(Tokenizer& tokens) {
+Expr parse_atom(Tokenizer& tokens, Interner* names) {
 	if ((tokens->type == TokenType::Op || tokens->type == TokenType::Ident) &&
 			unary_ops.count(tokens->text))
 	{
@@ -573,16 +736,16 @@ Expr parse_atom(Tokenizer& tokens) {
 		// Parenthesized function calls get the highest precedence.
 		// Other operators get treated according to their own precedence.
 		if (op.funcall && tokens->type == TokenType::LParen) {
-			expr = parse_atom(tokens);
+			expr = parse_atom(tokens, names);
 		}
 		else {
-			expr = parse_expr(tokens, op.prec + 1);
+			expr = parse_expr(tokens, names, op.prec + 1);
 		}
 		return Expr(Unary(op.op, expr));
 	}
 	else if (tokens->type == TokenType::LParen) {
 		tokens.read();
-		auto expr = parse_expr(tokens);
+		auto expr = parse_expr(tokens, names);
 		if (tokens->type != TokenType::RParen) {
 			std::ostringstream msg;
 			msg << "unexpected " << tokens->show()
@@ -593,7 +756,7 @@ Expr parse_atom(Tokenizer& tokens) {
 		return expr;
 	}
 	else if (tokens->type == TokenType::Ident) {
-		auto x = Expr(Var(tokens->text));
+		auto x = names ? Expr(Var(names->intern(tokens->text))) : Expr(Var(tokens->text));
 		tokens.read();
 		return x;
 	}
@@ -610,26 +773,24 @@ Expr parse_atom(Tokenizer& tokens) {
 	}
 }
 
-Expr parse_expr(Tokenizer& tokens, int min_prec) {
-	auto lhs = parse_atom(tokens);
+Expr parse_expr(Tokenizer& tokens, Interner* names, int min_prec) {
+	auto lhs = parse_atom(tokens, names);
 	while (tokens->type == TokenType::Op &&
 			binary_ops.count(tokens->text) &&
 			binary_ops.at(tokens->text).prec >= min_prec)
 	{
 		auto op = binary_ops.at(tokens->text);
 		tokens.read();
-		auto rhs = parse_expr(tokens, op.rassoc ? op.prec : op.prec + 1);
+		auto rhs = parse_expr(tokens, names, op.rassoc ? op.prec : op.prec + 1);
 		lhs = Expr(Binary(op.op, lhs, rhs));
 	}
 	return lhs;
 }
 
-} // end anon
-
-Expr Expr::parse(const std::string& input) {
+Expr parse_input(std::string_view input, Interner* names) {
 	auto tokens = Tokenizer(input);
 	tokens.read();
-	auto expr = parse_expr(tokens);
+	auto expr = parse_expr(tokens, names);
 	if (tokens->type != TokenType::Eof) {
 		std::ostringstream msg;
 		msg << "unexpected " << tokens->show()
@@ -638,3 +799,34 @@ Expr Expr::parse(const std::string& input) {
 	}
 	return expr;
 }
+
+} // end anon
+
+Expr Expr::parse(const std::string& input) {
+	return parse_input(input, nullptr);
+}
+
+Expr Expr::parse(std::string_view input, Interner& names) {
+	return parse_input(input, &names);
+}
+
+std::shared_ptr<const std::string> Interner::intern(std::string_view name) {
+	auto& shard = shards[std::hash<std::string_view>{}(name) % shard_count];
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto it = shard.table.find(name);
+	if (it != shard.table.end()) {
+		return it->second;
+	}
+	auto str = std::make_shared<const std::string>(name);
+	shard.table.emplace(*str, str);
+	return str;
+}
+
+size_t Interner::size() {
+	size_t res = 0;
+	for (auto& shard : shards) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		res += shard.table.size();
+	}
+	return res;
+}
@@ -1,12 +1,46 @@
 #ifndef ROOTS_EXPR_H
 #define ROOTS_EXPR_H
 
+#include "interval.h"
+#include "matrix.h"
+
+#include <array>
 #include <optional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <variant>
+#include <vector>
+
+// Table of variable names. Expressions parsed with the same interner share
+// one string per variable instead of holding a copy per occurrence. Safe to
+// use from multiple threads, which mostly don't wait for each other as names
+// are spread over independently locked shards.
+class Interner {
+private:
+	struct alignas(64) Shard {
+		std::mutex mutex;
+		// Keys view the interned strings.
+		std::unordered_map<std::string_view, std::shared_ptr<const std::string>> table;
+	};
+
+	static constexpr size_t shard_count = 64;
+	std::array<Shard, shard_count> shards;
+
+public:
+	Interner() = default;
+	Interner(const Interner&) = delete;
+	Interner& operator=(const Interner&) = delete;
+
+	// Returns the string equal to name, adding it if it's missing.
+	std::shared_ptr<const std::string> intern(std::string_view name);
+
+	// Number of distinct names.
+	size_t size();
+};
 
 // Tree structure representing a mathematical expression.
 class Expr {
@@ -21,6 +55,7 @@ public:
 		std::shared_ptr<const std::string> name;
 
 		Var(std::string name);
+		Var(std::shared_ptr<const std::string> name);
 	};
 
 	enum class BinaryOp {
@@ -88,10 +123,38 @@ public:
 	// Finds free variables in the expression.
 	Vars variables() const;
 
+	// Returns an equivalent expression which is cheaper to evaluate: constant
+	// subexpressions are folded, divisions by powers of two are replaced with
+	// multiplications and equal subexpressions are shared, so that they're
+	// compiled only once into a Program. Evaluation gives the same results and
+	// fails with domain errors in the same cases as for the original.
+	Expr optimize() const;
+
 	using Env = std::unordered_map<std::string, double>;
 
+	enum class EvalStatus {
+		Ok,
+		// An operation was applied outside of its domain.
+		DomainError,
+		// A variable is missing from the environment.
+		UndefinedVariable,
+	};
+
+	struct EvalResult {
+		EvalStatus status;
+		// Value of the expression, NaN on failure.
+		double val;
+		// Node at which evaluation failed, the operation or the undefined
+		// variable, or nullptr on success. Points into the evaluated tree.
+		const Expr* node;
+	};
+
+	// Evaluates the expression in the given environment, reporting the first
+	// failing node instead of throwing.
+	EvalResult try_eval(const Env& env) const noexcept;
+
 	// Evaluates the expression in the given environment.
-	// Throws MathError on failure.
+	// Throws MathError on failure, unless a FaultTrap is active.
 	double eval(const Env& env) const;
 
 	// Partially differentiates the expresstion in relation to given variable x
@@ -99,6 +162,44 @@ public:
 	// Throws MathError on failure.
 	double diff(const std::string& x, const Env& env) const;
 
+	// Computes the matrix of second partial derivatives in relation to the
+	// given variables in the given environment.
+	// Throws MathError on failure.
+	Matrix hessian(const std::vector<std::string>& vars, const Env& env) const;
+
+	// Computes the second derivative along direction dir, that is d^T H d
+	// where H is the Hessian and d holds values from dir for variables in
+	// dir and zeros for the other variables, in a single evaluation.
+	// Throws MathError on failure.
+	double second_diff(const Env& dir, const Env& env) const;
+
+	// Value of an expression in a single variable with its first two
+	// derivatives.
+	struct Derivs {
+		double val;
+		double d1;
+		double d2;
+	};
+
+	// Evaluates the expression at x = v together with its derivatives in
+	// relation to x, without an environment. With order 1 the second
+	// derivative isn't computed and d2 is zero. Doesn't allocate memory.
+	// Throws MathError on failure, including when there are other variables.
+	Derivs derivs(const std::string& x, double v, int order = 2) const;
+
+	using IntervalEnv = std::unordered_map<std::string, Interval>;
+
+	// Encloses the range of the expression over the box given by env.
+	// Points outside of the domain of the expression are ignored, so the
+	// result is empty iff evaluation fails everywhere in the box.
+	// Throws MathError on undefined variables.
+	Interval eval_interval(const IntervalEnv& env) const;
+
+	// Encloses the range of the partial derivative in relation to variable x
+	// over the box given by env.
+	// Throws MathError on undefined variables.
+	Interval diff_interval(const std::string& x, const IntervalEnv& env) const;
+
 private:
 	void show_rec(std::string& buf) const;
 public:
@@ -109,6 +210,8 @@ public:
 	// Parses an expression from string.
 	// On invalid input throws a ParseError.
 	static Expr parse(const std::string& input);
+	// Same as above, interning variable names in names.
+	static Expr parse(std::string_view input, Interner& names);
 };
 
 #endif // ROOTS_EXPR_H
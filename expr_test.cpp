@@ -1,8 +1,14 @@
 #include "expr.h"
 
 #include "common.h"
+#include "num.h"
 
+#include <cfenv>
 #include <cmath>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <variant>
 
 #include "gtest/gtest.h"
 
@@ -104,6 +110,42 @@ TEST(ExprTest, EvalError) {
 	expect_eval_throws(Expr(-1.0).sqrt(), "sqrt(-1)");
 }
 
+TEST(ExprTest, TryEval) {
+	auto ok = (Expr("x") + 1.0).try_eval({{"x", 2.0}});
+	EXPECT_EQ(ok.status, Expr::EvalStatus::Ok);
+	EXPECT_EQ(ok.val, 3.0);
+	EXPECT_EQ(ok.node, nullptr);
+
+	// The logarithm fails before the undefined y is looked up.
+	auto expr = Expr("x").ln() * Expr("y");
+	auto failed = expr.try_eval({{"x", -1.0}});
+	EXPECT_EQ(failed.status, Expr::EvalStatus::DomainError);
+	EXPECT_TRUE(std::isnan(failed.val));
+	EXPECT_EQ(failed.node, std::get<Expr::Binary>(expr.value).lhs.get()) << "ln node";
+
+	auto undefined = (Expr("x") * Expr("y")).try_eval({{"x", 1.0}});
+	EXPECT_EQ(undefined.status, Expr::EvalStatus::UndefinedVariable);
+	ASSERT_NE(undefined.node, nullptr);
+	EXPECT_EQ(*std::get<Expr::Var>(undefined.node->value).name, "y");
+}
+
+TEST(ExprTest, FaultTrap) {
+	FaultTrap outer;
+	EXPECT_NO_THROW(Expr("x").ln().diff("x", {{"x", -1.0}}));
+	EXPECT_EQ(outer.get_fault(), FaultTrap::Fault::DomainError);
+	{
+		FaultTrap inner;
+		EXPECT_NO_THROW((Expr("x") * Expr("y")).eval({{"x", 1.0}}));
+		EXPECT_EQ(inner.get_fault(), FaultTrap::Fault::UndefinedVariable);
+		ASSERT_NE(inner.get_var(), nullptr);
+		EXPECT_EQ(*inner.get_var(), "y");
+	}
+	// The first failure is kept.
+	EXPECT_NO_THROW(Expr("y").diff("x", {{"x", 1.0}}));
+	EXPECT_EQ(outer.get_fault(), FaultTrap::Fault::DomainError);
+	EXPECT_EQ(outer.get_var(), nullptr);
+}
+
 void compare_diff(
 		Expr expr,
 		const std::function<double(double, double)>& fun,
@@ -216,6 +258,160 @@ TEST(ExprTest, DiffError) {
 	expect_diff_throws(Expr("x").sqrt(), 0.0, "d/dx sqrt(x), x=0");
 }
 
+TEST(ExprTest, Derivs) {
+	struct Case {
+		std::string input;
+		std::function<double(double)> d1;
+		std::function<double(double)> d2;
+	};
+	std::vector<Case> cases = {
+		{"x^3 - 2*x", [](double x) { return 3*x*x - 2; }, [](double x) { return 6*x; }},
+		{"sin(x^2)",
+			[](double x) { return 2*x*std::cos(x*x); },
+			[](double x) { return 2*std::cos(x*x) - 4*x*x*std::sin(x*x); }},
+		{"exp(2*x) / x",
+			[](double x) { return std::exp(2*x) * (2*x - 1) / (x*x); },
+			[](double x) { return std::exp(2*x) * (4*x*x - 4*x + 2) / (x*x*x); }},
+		{"sqrt(x) + ln(x)",
+			[](double x) { return 0.5 / std::sqrt(x) + 1 / x; },
+			[](double x) { return -0.25 / (x * std::sqrt(x)) - 1 / (x*x); }},
+		{"x^x",
+			[](double x) { return std::pow(x, x) * (std::log(x) + 1); },
+			[](double x) {
+				double l = std::log(x) + 1;
+				return std::pow(x, x) * (l*l + 1/x);
+			}},
+	};
+	for (const auto& c : cases) {
+		auto expr = Expr::parse(c.input);
+		for (double x : {0.3, 1.0, 2.5}) {
+			auto d = expr.derivs("x", x);
+			EXPECT_DOUBLE_EQ(d.val, expr.eval({{"x", x}})) << c.input << " at " << x;
+			EXPECT_DOUBLE_EQ(d.d1, expr.diff("x", {{"x", x}})) << c.input << " at " << x;
+			EXPECT_NEAR(d.d1, c.d1(x), 1e-12 * (1 + std::abs(d.d1))) << c.input << " at " << x;
+			EXPECT_NEAR(d.d2, c.d2(x), 1e-12 * (1 + std::abs(d.d2))) << c.input << " at " << x;
+			auto d_first = expr.derivs("x", x, 1);
+			EXPECT_EQ(d_first.d1, d.d1) << c.input << " at " << x;
+			EXPECT_EQ(d_first.d2, 0.0) << c.input << " at " << x;
+		}
+	}
+	EXPECT_THROW(Expr::parse("x + y").derivs("x", 1.0), MathError);
+	EXPECT_THROW(Expr::parse("ln(x)").derivs("x", -1.0), MathError);
+}
+
+TEST(ExprTest, ReducedPower) {
+	double inf = std::numeric_limits<double>::infinity();
+	for (double k : {-1.0, 0.0, 0.5, 1.0, 2.0, 3.0, 4.0}) {
+		auto expr = Expr("x").pow(Expr(k));
+		for (double x : {-2.5, -1.0, 0.0, 0.3, 7.0, 1e200, inf, -inf}) {
+			// Reference result of std::pow with domain checks.
+			std::optional<double> expected;
+			std::feclearexcept(FE_ALL_EXCEPT);
+			double p = std::pow(x, k);
+			if (!std::fetestexcept(FE_DIVBYZERO | FE_INVALID)) {
+				expected = p;
+			}
+			Expr::Env env = {{"x", x}};
+			if (!expected) {
+				EXPECT_THROW(expr.eval(env), MathError) << "x^" << k << " at " << x;
+				continue;
+			}
+			double actual = expr.eval(env);
+			if (std::isfinite(*expected)) {
+				EXPECT_DOUBLE_EQ(actual, *expected) << "x^" << k << " at " << x;
+			}
+			else {
+				EXPECT_EQ(actual, *expected) << "x^" << k << " at " << x;
+			}
+		}
+	}
+	EXPECT_THROW(Expr("x").pow(Expr(-1.0)).eval({{"x", 0.0}}), MathError);
+	EXPECT_THROW(Expr("x").pow(Expr(0.5)).eval({{"x", -1.0}}), MathError);
+	EXPECT_THROW(Expr("x").pow(Expr(0.5)).diff("x", {{"x", 0.0}}), MathError);
+}
+
+TEST(ExprTest, Optimize) {
+	EXPECT_EQ(Expr::parse("2^3 + x").optimize().show(), "(8.000000 + x)");
+	EXPECT_EQ(Expr::parse("x / 4").optimize().show(), "(x * 0.250000)");
+	EXPECT_EQ(Expr::parse("x / 3").optimize().show(), "(x / 3.000000)");
+
+	// Equal subexpressions are shared.
+	auto expr = Expr::parse("sin(x*y) + cos(x*y)").optimize();
+	const auto& sum = std::get<Expr::Binary>(expr.value);
+	const auto& sin = std::get<Expr::Unary>(sum.lhs->value);
+	const auto& cos = std::get<Expr::Unary>(sum.rhs->value);
+	EXPECT_EQ(sin.arg, cos.arg);
+
+	// Results and errors are the same as for the original expression.
+	std::vector<std::string> inputs = {
+		"x^2 + 3*x/2 - 1/8",
+		"sqrt(0) + x",
+		"x/0",
+		"ln(0) * x",
+		"(-1)^0.5 + x",
+		"x^0.5 * y^(1/2)",
+		"exp(1)^x - sin(x/y)*cos(x/y)",
+		"x^-1 + (2 - 2)^-1",
+	};
+	std::vector<Expr::Env> envs = {
+		{{"x", 1.5}, {"y", 2.0}},
+		{{"x", 0.0}, {"y", 0.0}},
+		{{"x", -2.0}, {"y", 1e-300}},
+	};
+	for (const auto& input : inputs) {
+		auto orig = Expr::parse(input);
+		auto opt = orig.optimize();
+		for (const auto& env : envs) {
+			for (bool deriv : {false, true}) {
+				auto eval = [&](const Expr& e) -> std::optional<double> {
+					try {
+						return deriv ? e.diff("x", env) : e.eval(env);
+					}
+					catch (const MathError&) {
+						return std::nullopt;
+					}
+				};
+				auto expected = eval(orig);
+				auto actual = eval(opt);
+				std::string msg = input + (deriv ? " diff" : " eval") + " at x = " +
+					std::to_string(env.at("x"));
+				ASSERT_EQ(actual.has_value(), expected.has_value()) << msg;
+				if (expected && !std::isnan(*expected)) {
+					EXPECT_EQ(*actual, *expected) << msg;
+				}
+			}
+		}
+	}
+}
+
+TEST(ExprTest, Hessian) {
+	auto expr = Expr::parse("x^2*y + sin(x*y) + y/x");
+	double x = 1.5, y = -0.7;
+	double s = std::sin(x*y), c = std::cos(x*y);
+	double xx = 2*y - y*y*s + 2*y/(x*x*x);
+	double xy = 2*x + c - x*y*s - 1/(x*x);
+	double yy = -x*x*s;
+	auto h = expr.hessian({"x", "y"}, {{"x", x}, {"y", y}});
+	ASSERT_EQ(h.get_height(), 2u);
+	ASSERT_EQ(h.get_width(), 2u);
+	double h00 = h[{0, 0}], h01 = h[{0, 1}], h10 = h[{1, 0}], h11 = h[{1, 1}];
+	EXPECT_NEAR(h00, xx, 1e-12);
+	EXPECT_NEAR(h01, xy, 1e-12);
+	EXPECT_EQ(h10, h01);
+	EXPECT_NEAR(h11, yy, 1e-12);
+
+	// Second derivative along a direction is d^T H d.
+	double dx = 0.3, dy = -2.0;
+	double dd = expr.second_diff({{"x", dx}, {"y", dy}}, {{"x", x}, {"y", y}});
+	EXPECT_NEAR(dd, dx*dx*xx + 2*dx*dy*xy + dy*dy*yy, 1e-12);
+	// Variables missing from the direction are held constant.
+	dd = expr.second_diff({{"y", dy}}, {{"x", x}, {"y", y}});
+	EXPECT_NEAR(dd, dy*dy*yy, 1e-12);
+
+	EXPECT_THROW(expr.hessian({"x"}, {{"x", x}}), MathError);
+	EXPECT_THROW(Expr::parse("sqrt(x)").hessian({"x"}, {{"x", 0.0}}), MathError);
+}
+
 TEST(ExprTest, ParseBinaryPrecedence) {
 	auto input = "1 + 2 * 3 ^ 4 / 5 - 6 / 3 * 2 ^ -1"s;
 	double expected = 1.0 + (2.0 * std::pow(3.0, 4.0) / 5.0) - (6.0 / 3.0 * std::pow(2.0, -1.0));
@@ -272,6 +468,21 @@ TEST(ExprTest, ParseVariables) {
 	EXPECT_EQ(actual, expected) << "variables in " << input;
 }
 
+TEST(ExprTest, ParseInterned) {
+	Interner names;
+	auto lhs = Expr::parse("x * y"sv, names);
+	auto rhs = Expr::parse("sin(x)"sv, names);
+	const auto& mul = std::get<Expr::Binary>(lhs.value);
+	const auto& x1 = std::get<Expr::Var>(mul.lhs->value);
+	const auto& x2 = std::get<Expr::Var>(std::get<Expr::Unary>(rhs.value).arg->value);
+	EXPECT_EQ(x1.name, x2.name);
+	EXPECT_EQ(*x1.name, "x");
+	EXPECT_EQ(names.intern("y"), std::get<Expr::Var>(mul.rhs->value).name);
+	EXPECT_EQ(names.size(), 2u);
+	EXPECT_DOUBLE_EQ(lhs.eval({{"x", 2.0}, {"y", 3.0}}), 6.0);
+	EXPECT_THROW(Expr::parse("x +"sv, names), ParseError);
+}
+
 TEST(ExprTest, ParseNumbers) {
 	auto input = "0.75 + 0.0 + 12.34 - 10"s;
 	double expected = 0.75 + 12.34 - 10.0;
@@ -0,0 +1,471 @@
+#include "homotopy.h"
+
+#include "common.h"
+#include "poly.h"
+#include "pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+using Complex = std::complex<double>;
+using Point = std::vector<Complex>;
+
+constexpr double epsilon = std::numeric_limits<double>::epsilon();
+
+// The endgame starts at t = 1 - endgame_radius and halves the radius of its
+// loops until two successive estimates agree or the radius drops below
+// min_radius.
+constexpr double endgame_radius = 0.1;
+constexpr double min_radius = 1e-12;
+// Points of the loop around t = 1 used by the endgame, per winding.
+constexpr size_t loop_samples = 8;
+constexpr size_t max_winding = 16;
+
+double norm(const Point& x) {
+	double res = 0.0;
+	for (auto z : x) {
+		res = std::max(res, std::abs(z));
+	}
+	return res;
+}
+
+double distance(const Point& x, const Point& y) {
+	double res = 0.0;
+	for (size_t i = 0; i < x.size(); ++i) {
+		res = std::max(res, std::abs(x[i] - y[i]));
+	}
+	return res;
+}
+
+bool close(const Point& x, const Point& y, double tol) {
+	return distance(x, y) <= tol * (1.0 + std::max(norm(x), norm(y)));
+}
+
+// Solves a x = b by Gaussian elimination with partial pivoting, overwriting a
+// with its factors and b with x. Returns the ratio of the smallest pivot to
+// the largest one, zero if the matrix is singular.
+double solve_linear(size_t n, Complex* a, Complex* b) {
+	double min_pivot = std::numeric_limits<double>::infinity();
+	double max_pivot = 0.0;
+	for (size_t k = 0; k < n; ++k) {
+		size_t max = k;
+		for (size_t i = k+1; i < n; ++i) {
+			if (std::abs(a[i*n + k]) > std::abs(a[max*n + k])) {
+				max = i;
+			}
+		}
+		double pivot = std::abs(a[max*n + k]);
+		if (!(pivot > 0.0) || !std::isfinite(pivot)) {
+			return 0.0;
+		}
+		min_pivot = std::min(min_pivot, pivot);
+		max_pivot = std::max(max_pivot, pivot);
+		if (max != k) {
+			for (size_t j = k; j < n; ++j) {
+				std::swap(a[k*n + j], a[max*n + j]);
+			}
+			std::swap(b[k], b[max]);
+		}
+		for (size_t i = k+1; i < n; ++i) {
+			Complex ratio = a[i*n + k] / a[k*n + k];
+			for (size_t j = k+1; j < n; ++j) {
+				a[i*n + j] -= ratio * a[k*n + j];
+			}
+			b[i] -= ratio * b[k];
+		}
+	}
+	for (size_t i = n; i-- > 0;) {
+		for (size_t j = i+1; j < n; ++j) {
+			b[i] -= a[i*n + j] * b[j];
+		}
+		b[i] /= a[i*n + i];
+	}
+	return min_pivot / max_pivot;
+}
+
+enum class Outcome {
+	Ok,
+	// The norm of the point exceeded HomotopyOptions::max_norm.
+	Diverged,
+	// Step size or the number of steps ran out.
+	Stuck,
+};
+
+// Tracks paths of the homotopy, t being a function of a real parameter s
+// given by a callable returning t(s) and dt/ds. Holds the buffers of a
+// single path.
+class Tracker {
+private:
+	const std::vector<MultiPolynomial>& funcs;
+	const std::vector<size_t>& degrees;
+	Complex gamma;
+	const HomotopyOptions& opts;
+	size_t n;
+	// Value of the homotopy, its Jacobian by x, row-major, and its
+	// derivative by t.
+	Point h;
+	Point hx;
+	Point ht;
+	Point grad;
+	// Runge-Kutta stages, the point at which the next stage is computed and
+	// the result of the step.
+	Point k1, k2, k3, k4;
+	Point mid;
+	Point tmp;
+
+	// Evaluates the homotopy at (x, t).
+	void eval(const Point& x, Complex t) {
+		for (size_t i = 0; i < n; ++i) {
+			Complex f = funcs[i].eval(x.data(), grad.data());
+			double d = double(degrees[i]);
+			Complex lower = 1.0;
+			for (size_t k = 1; k < degrees[i]; ++k) {
+				lower *= x[i];
+			}
+			Complex g = lower * x[i] - 1.0;
+			h[i] = gamma * (1.0 - t) * g + t * f;
+			ht[i] = f - gamma * g;
+			for (size_t j = 0; j < n; ++j) {
+				hx[i*n + j] = t * grad[j];
+			}
+			hx[i*n + i] += gamma * (1.0 - t) * d * lower;
+		}
+	}
+
+	// Computes dx/ds at (x, t), where t changes by dt per unit of s.
+	bool tangent(const Point& x, Complex t, Complex dt, Point& out) {
+		eval(x, t);
+		for (size_t i = 0; i < n; ++i) {
+			out[i] = -ht[i] * dt;
+		}
+		return solve_linear(n, hx.data(), out.data()) > 0.0;
+	}
+
+	// Newton's method on H(x, t) = 0 for a fixed t.
+	bool correct(Point& x, Complex t) {
+		for (size_t iter = 0; iter < 3; ++iter) {
+			eval(x, t);
+			if (solve_linear(n, hx.data(), h.data()) == 0.0) {
+				return false;
+			}
+			for (size_t i = 0; i < n; ++i) {
+				x[i] -= h[i];
+			}
+			if (norm(h) <= opts.tolerance * (1.0 + norm(x))) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Takes a Runge-Kutta step of size ds from s, followed by correction,
+	// storing the new point in tmp.
+	template<typename Path>
+	bool step(const Point& x, double s, double ds, const Path& path) {
+		// Computes stage k at x + scale * ds * prev.
+		auto stage = [&](const Point* prev, double scale, Point& k) {
+			if (prev) {
+				for (size_t i = 0; i < n; ++i) {
+					mid[i] = x[i] + scale * ds * (*prev)[i];
+				}
+			}
+			auto [t, dt] = path(s + scale * ds);
+			return tangent(prev ? mid : x, t, dt, k);
+		};
+		if (!stage(nullptr, 0.0, k1) || !stage(&k1, 0.5, k2) || !stage(&k2, 0.5, k3)
+				|| !stage(&k3, 1.0, k4)) {
+			return false;
+		}
+		for (size_t i = 0; i < n; ++i) {
+			tmp[i] = x[i] + ds / 6.0 * (k1[i] + 2.0 * k2[i] + 2.0 * k3[i] + k4[i]);
+		}
+		return correct(tmp, path(s + ds).first);
+	}
+
+public:
+	size_t steps = 0;
+
+	Tracker(const std::vector<MultiPolynomial>& funcs, const std::vector<size_t>& degrees,
+			Complex gamma, const HomotopyOptions& opts) :
+		funcs(funcs),
+		degrees(degrees),
+		gamma(gamma),
+		opts(opts),
+		n(funcs.size()),
+		h(n),
+		hx(n * n),
+		ht(n),
+		grad(n),
+		k1(n),
+		k2(n),
+		k3(n),
+		k4(n),
+		mid(n),
+		tmp(n) {}
+
+	// Follows the path from s0 to s1, starting at x. The step size doubles
+	// after three successful steps in a row and halves after a failed one.
+	template<typename Path>
+	Outcome track(Point& x, double s0, double s1, const Path& path) {
+		double length = s1 - s0;
+		double ds = length / 16;
+		size_t successes = 0;
+		double s = s0;
+		while (s < s1) {
+			if (++steps > opts.max_steps || ds < length * 1e-14) {
+				return Outcome::Stuck;
+			}
+			ds = std::min(ds, s1 - s);
+			if (step(x, s, ds, path)) {
+				std::copy(tmp.begin(), tmp.end(), x.begin());
+				s = s + ds >= s1 ? s1 : s + ds;
+				if (norm(x) > opts.max_norm) {
+					return Outcome::Diverged;
+				}
+				if (++successes == 3) {
+					ds *= 2;
+					successes = 0;
+				}
+			}
+			else {
+				ds /= 2;
+				successes = 0;
+			}
+		}
+		return Outcome::Ok;
+	}
+
+	// Loops around t = 1 at radius r starting at x, which lies at t = 1 - r,
+	// until the path closes. Stores the mean of the points of the loops in
+	// est, the number of loops in winding and the largest distance of a
+	// point from the mean in spread.
+	Outcome loop(Point& x, double r, Point& est, size_t& winding, double& spread) {
+		auto circle = [r](double angle) {
+			Complex z = std::polar(r, angle);
+			return std::make_pair(1.0 - z, Complex(0.0, -1.0) * z);
+		};
+		Point start = x;
+		std::vector<Point> samples;
+		double arc = 2 * M_PI / loop_samples;
+		for (size_t c = 1; c <= max_winding; ++c) {
+			for (size_t k = 0; k < loop_samples; ++k) {
+				samples.push_back(x);
+				double from = arc * ((c - 1) * loop_samples + k);
+				auto out = track(x, from, from + arc, circle);
+				if (out != Outcome::Ok) {
+					return out;
+				}
+			}
+			if (close(x, start, 1e3 * opts.tolerance)) {
+				winding = c;
+				est.assign(n, 0.0);
+				for (const auto& p : samples) {
+					for (size_t i = 0; i < n; ++i) {
+						est[i] += p[i];
+					}
+				}
+				for (auto& z : est) {
+					z /= double(samples.size());
+				}
+				spread = 0.0;
+				for (const auto& p : samples) {
+					spread = std::max(spread, distance(p, est));
+				}
+				// Continues from the point the loop closed at exactly.
+				x = start;
+				return Outcome::Ok;
+			}
+		}
+		return Outcome::Stuck;
+	}
+
+	// Whether x is a root of the target system up to errors of the endgame,
+	// which the residuals are compared with relative to the magnitudes of
+	// the terms, or absolutely when they're small.
+	bool is_root(const Point& x) {
+		for (size_t i = 0; i < n; ++i) {
+			double scale = 0.0;
+			for (const auto& term : funcs[i].get_terms()) {
+				double mag = std::abs(term.coeff);
+				for (size_t j = 0; j < n; ++j) {
+					mag *= std::pow(std::abs(x[j]), term.exps[j]);
+				}
+				scale += mag;
+			}
+			if (!(std::abs(funcs[i].eval(x.data(), nullptr)) <= 1e-6 * (1.0 + scale))) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Refines a root of the target system with Newton's method. Returns
+	// true if the iteration converges quadratically, which it doesn't at
+	// singular roots. x is left unchanged if the Jacobian is singular.
+	bool refine(Point& x) {
+		Point start = x;
+		for (size_t iter = 0; iter < 8; ++iter) {
+			eval(x, 1.0);
+			if (solve_linear(n, hx.data(), h.data()) == 0.0) {
+				x = start;
+				return false;
+			}
+			for (size_t i = 0; i < n; ++i) {
+				x[i] -= h[i];
+			}
+			if (norm(h) <= 1e3 * epsilon * (1.0 + norm(x))) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+// Tracks the path starting at x.
+PathResult track_path(Tracker& tracker, Point x, const HomotopyOptions& opts) {
+	PathResult res;
+	auto line = [](double s) {
+		return std::make_pair(Complex(s), Complex(1.0));
+	};
+	auto finish = [&](PathStatus status) {
+		res.status = status;
+		res.point = x;
+		res.steps = tracker.steps;
+		return res;
+	};
+	auto fail = [&](Outcome out) {
+		return finish(out == Outcome::Diverged ? PathStatus::AtInfinity : PathStatus::Failed);
+	};
+	auto out = tracker.track(x, 0.0, 1.0 - endgame_radius, line);
+	if (out != Outcome::Ok) {
+		return fail(out);
+	}
+	// The endgame accepts an estimate when it agrees with the previous one
+	// and the loop shrank. Points of loops around paths diverging to infinity
+	// instead spread further apart as the radius decreases, much further than
+	// the norm of their mean, which ends the path once seen twice in a row.
+	// Loops of larger radii may also spread out at first when they enclose
+	// branch points of other paths, but not as far. Such loops permute the
+	// paths and their points average to something else than a root, which
+	// is_root() rejects.
+	Point prev;
+	double prev_spread = std::numeric_limits<double>::infinity();
+	size_t growing = 0;
+	for (double r = endgame_radius; r >= min_radius; r /= 2) {
+		if (r < endgame_radius) {
+			out = tracker.track(x, 1.0 - 2 * r, 1.0 - r, line);
+			if (out != Outcome::Ok) {
+				return fail(out);
+			}
+		}
+		Point est;
+		size_t winding = 0;
+		double spread = 0.0;
+		out = tracker.loop(x, r, est, winding, spread);
+		if (out != Outcome::Ok) {
+			return fail(out);
+		}
+		growing = spread > prev_spread && spread > 1.0 + norm(est) ? growing + 1 : 0;
+		if (growing == 2) {
+			return finish(PathStatus::AtInfinity);
+		}
+		if (!prev.empty() && spread <= prev_spread && close(est, prev, 1e2 * opts.tolerance)
+				&& tracker.is_root(est)) {
+			res.winding = winding;
+			x = est;
+			if (winding > 1) {
+				return finish(PathStatus::Singular);
+			}
+			bool regular = tracker.refine(x);
+			return finish(regular ? PathStatus::Regular : PathStatus::Singular);
+		}
+		prev = std::move(est);
+		prev_spread = spread;
+	}
+	return finish(PathStatus::Failed);
+}
+
+} // end anon
+
+HomotopyResult
+homotopy(const std::vector<Expr>& funcs, const std::vector<std::string>& vars,
+		const HomotopyOptions& opts)
+{
+	if (funcs.size() != vars.size()) {
+		throw std::invalid_argument("homotopy requires a square system");
+	}
+	size_t n = vars.size();
+	std::vector<MultiPolynomial> polys;
+	std::vector<size_t> degrees;
+	size_t paths = 1;
+	for (size_t i = 0; i < n; ++i) {
+		auto poly = MultiPolynomial::from_expr(funcs[i], vars);
+		if (!poly) {
+			throw MathError("equation " + std::to_string(i + 1) + " isn't a polynomial");
+		}
+		size_t d = poly->degree();
+		if (d == 0) {
+			throw MathError("equation " + std::to_string(i + 1) + " is constant");
+		}
+		if (paths > opts.max_paths / d) {
+			throw MathError("too many homotopy paths");
+		}
+		paths *= d;
+		polys.push_back(std::move(*poly));
+		degrees.push_back(d);
+	}
+	std::mt19937_64 gen(opts.seed);
+	std::uniform_real_distribution<double> dist(0.0, 2 * M_PI);
+	Complex gamma = std::polar(1.0, dist(gen));
+
+	HomotopyResult res;
+	res.vars = vars;
+	res.paths.resize(paths);
+	ThreadPool pool(opts.threads);
+	pool.parallel_for(paths, [&](size_t p) {
+		// Start solutions are numbered in mixed radix, with digit i choosing
+		// the root of unity of variable i.
+		Point start(n);
+		size_t rest = p;
+		for (size_t i = 0; i < n; ++i) {
+			size_t d = degrees[i];
+			start[i] = std::polar(1.0, 2 * M_PI * double(rest % d) / double(d));
+			rest /= d;
+		}
+		Tracker tracker(polys, degrees, gamma, opts);
+		res.paths[p] = track_path(tracker, std::move(start), opts);
+	});
+
+	for (const auto& path : res.paths) {
+		if (path.status != PathStatus::Regular && path.status != PathStatus::Singular) {
+			continue;
+		}
+		bool seen = false;
+		for (const auto& root : res.roots) {
+			seen = seen || close(root, path.point, std::sqrt(opts.tolerance));
+		}
+		if (seen) {
+			continue;
+		}
+		res.roots.push_back(path.point);
+		double imag = 0.0;
+		for (auto z : path.point) {
+			imag = std::max(imag, std::abs(z.imag()));
+		}
+		if (imag <= opts.real_tolerance * (1.0 + norm(path.point))) {
+			Solution sol;
+			sol.iters = path.steps;
+			sol.max_diff = imag;
+			for (size_t i = 0; i < n; ++i) {
+				sol.vars.emplace_back(vars[i], path.point[i].real());
+			}
+			res.real_roots.push_back(std::move(sol));
+		}
+	}
+	return res;
+}
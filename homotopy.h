@@ -0,0 +1,87 @@
+#ifndef ROOTS_HOMOTOPY_H
+#define ROOTS_HOMOTOPY_H
+
+#include "expr.h"
+#include "solve.h"
+
+#include <complex>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct HomotopyOptions {
+	// Maximal number of paths tracked, which is the product of the degrees
+	// of the equations.
+	size_t max_paths = 100000;
+	// Number of threads used, zero means one per hardware thread.
+	size_t threads = 0;
+	// Seed of the random complex constant of the homotopy. Paths cross
+	// each other only for a zero-measure set of constants, which makes
+	// crossings practically impossible.
+	uint64_t seed = 1;
+	// Relative accuracy of points on the paths required from the corrector.
+	double tolerance = 1e-10;
+	// Maximal number of steps of a single path, endgame included.
+	size_t max_steps = 10000;
+	// Points with a larger norm are considered to lie on paths diverging to
+	// infinity.
+	double max_norm = 1e8;
+	// Relative imaginary part below which roots are considered real.
+	double real_tolerance = 1e-8;
+};
+
+enum class PathStatus {
+	// Ends in a root with a nonsingular Jacobian.
+	Regular,
+	// Ends in a root with a singular Jacobian, such as a multiple root.
+	Singular,
+	// Diverges, the system having fewer roots than the total degree.
+	AtInfinity,
+	// Step size or the number of steps ran out before reaching the end.
+	Failed,
+};
+
+struct PathResult {
+	PathStatus status;
+	// End point of the path for Regular and Singular paths, the last point
+	// reached for the others.
+	std::vector<std::complex<double>> point;
+	// Number of loops around t = 1 after which the path closed in the
+	// endgame, greater than one only for singular roots.
+	size_t winding = 0;
+	size_t steps = 0;
+};
+
+struct HomotopyResult {
+	std::vector<std::string> vars;
+	// Results of all paths, in the order of start solutions.
+	std::vector<PathResult> paths;
+	// Distinct end points of Regular and Singular paths.
+	std::vector<std::vector<std::complex<double>>> roots;
+	// Real roots among them. iters holds the number of steps of the path
+	// and max_diff the imaginary part dropped.
+	std::vector<Solution> real_roots;
+};
+
+// Finds all isolated complex roots of a square polynomial system by
+// total-degree homotopy continuation. The start system
+//   x_i^d_i - 1 = 0
+// where d_i is the degree of equation i, has d_1 * ... * d_n known roots, and
+// every one of them is tracked along
+//   H(x, t) = gamma * (1 - t) * G(x) + t * F(x)
+// from t = 0 to t = 1, where G is the start system, F the target system and
+// gamma a random complex constant. Steps are predicted with the fourth order
+// Runge-Kutta method and corrected with Newton's method, their size adapting
+// to the corrector's convergence. Close to t = 1 the Cauchy endgame loops
+// around t = 1 in the complex plane and averages the points of the loop,
+// which converges to singular roots as well as to regular ones. Paths are
+// tracked in parallel.
+//
+// Throws MathError if an equation isn't a polynomial in vars, is constant or
+// if there are more than max_paths paths, and std::invalid_argument if the
+// system isn't square.
+HomotopyResult
+homotopy(const std::vector<Expr>& funcs, const std::vector<std::string>& vars,
+		const HomotopyOptions& opts = HomotopyOptions());
+
+#endif // ROOTS_HOMOTOPY_H
@@ -0,0 +1,145 @@
+#include "homotopy.h"
+
+#include "common.h"
+#include "test_util.h"
+
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Expects the functions to vanish at every root.
+void expect_roots(const std::vector<Expr>& funcs, const HomotopyResult& res, double error) {
+	for (const auto& root : res.roots) {
+		Expr::Env env;
+		double imag = 0.0;
+		for (size_t i = 0; i < root.size(); ++i) {
+			env[res.vars[i]] = root[i].real();
+			imag = std::max(imag, std::abs(root[i].imag()));
+		}
+		// Complex roots can only be checked through real parts when they're
+		// real.
+		if (imag > 1e-8) {
+			continue;
+		}
+		for (const auto& f : funcs) {
+			EXPECT_NEAR(f.eval(env), 0.0, error) << f.show();
+		}
+	}
+}
+
+size_t count(const HomotopyResult& res, PathStatus status) {
+	size_t n = 0;
+	for (const auto& path : res.paths) {
+		n += path.status == status;
+	}
+	return n;
+}
+
+} // end anon
+
+TEST(HomotopyTest, CircleLine) {
+	auto funcs = parse_all({"x^2 + y^2 - 16", "y - (2*x - 3)"});
+	auto res = homotopy(funcs, {"x", "y"});
+	ASSERT_EQ(res.paths.size(), 2u);
+	EXPECT_EQ(count(res, PathStatus::Regular), 2u);
+	ASSERT_EQ(res.real_roots.size(), 2u);
+	double x1 = (6.0 + std::sqrt(71.0)) / 5.0;
+	double x2 = (6.0 - std::sqrt(71.0)) / 5.0;
+	for (const auto& sol : res.real_roots) {
+		double x = sol.vars[0].second;
+		double y = sol.vars[1].second;
+		EXPECT_NEAR(std::min(std::abs(x - x1), std::abs(x - x2)), 0.0, 1e-14);
+		EXPECT_NEAR(y, 2 * x - 3, 1e-14);
+	}
+}
+
+TEST(HomotopyTest, AllRoots) {
+	// Katsura's system with 8 isolated roots, as many as the total degree.
+	auto funcs = parse_all({
+		"a + 2*b + 2*c + 2*d - 1",
+		"a^2 + 2*b^2 + 2*c^2 + 2*d^2 - a",
+		"2*a*b + 2*b*c + 2*c*d - b",
+		"b^2 + 2*a*c + 2*b*d - c",
+	});
+	auto res = homotopy(funcs, {"a", "b", "c", "d"});
+	EXPECT_EQ(res.paths.size(), 8u);
+	EXPECT_EQ(count(res, PathStatus::Regular), 8u);
+	EXPECT_EQ(res.roots.size(), 8u);
+	EXPECT_EQ(res.real_roots.size(), 6u);
+	expect_roots(funcs, res, 1e-14);
+
+	// Roots of products of univariate polynomials.
+	funcs = parse_all({"(x - 1)*(x - 2)*(x - 3)", "(y + 1)*(y - 4)"});
+	res = homotopy(funcs, {"x", "y"});
+	EXPECT_EQ(res.real_roots.size(), 6u);
+	expect_roots(funcs, res, 1e-14);
+}
+
+TEST(HomotopyTest, Infinity) {
+	// The total degree is 4, but there are 3 roots of x^3 = 1.
+	auto funcs = parse_all({"x^2 - y", "x*y - 1"});
+	auto res = homotopy(funcs, {"x", "y"});
+	EXPECT_EQ(count(res, PathStatus::AtInfinity), 1u);
+	EXPECT_EQ(res.roots.size(), 3u);
+	ASSERT_EQ(res.real_roots.size(), 1u);
+	EXPECT_NEAR(res.real_roots[0].vars[0].second, 1.0, 1e-15);
+	EXPECT_NEAR(res.real_roots[0].vars[1].second, 1.0, 1e-15);
+
+	// Parallel lines.
+	res = homotopy(parse_all({"x + y - 1", "x + y - 2"}), {"x", "y"});
+	EXPECT_EQ(count(res, PathStatus::AtInfinity), 1u);
+	EXPECT_TRUE(res.roots.empty());
+}
+
+TEST(HomotopyTest, Singular) {
+	// Line tangent to the circle, both paths ending in the double root.
+	auto res = homotopy(parse_all({"x^2 + y^2 - 1", "y - 1"}), {"x", "y"});
+	ASSERT_EQ(res.paths.size(), 2u);
+	for (const auto& path : res.paths) {
+		EXPECT_EQ(path.status, PathStatus::Singular);
+		EXPECT_EQ(path.winding, 2u);
+	}
+	ASSERT_EQ(res.roots.size(), 1u);
+	EXPECT_NEAR(std::abs(res.roots[0][0]), 0.0, 1e-8);
+	EXPECT_NEAR(std::abs(res.roots[0][1] - 1.0), 0.0, 1e-8);
+
+	res = homotopy(parse_all({"(x - 1)^2 * (x + 2)"}), {"x"});
+	EXPECT_EQ(res.roots.size(), 2u);
+	EXPECT_EQ(count(res, PathStatus::Singular), 2u);
+	expect_roots(parse_all({"(x - 1)^2 * (x + 2)"}), res, 1e-10);
+}
+
+TEST(HomotopyTest, Threads) {
+	auto funcs = parse_all({
+		"x^3 - 5*x^2 + 2*x - y + 13",
+		"x^3 + x^2 - 14*x - y - 19",
+		"2*y - x*z - 1",
+	});
+	HomotopyOptions opts;
+	opts.threads = 1;
+	auto serial = homotopy(funcs, {"x", "y", "z"}, opts);
+	opts.threads = 4;
+	auto parallel = homotopy(funcs, {"x", "y", "z"}, opts);
+	ASSERT_EQ(serial.paths.size(), 18u);
+	for (size_t i = 0; i < serial.paths.size(); ++i) {
+		EXPECT_EQ(serial.paths[i].status, parallel.paths[i].status) << "path " << i;
+		EXPECT_EQ(serial.paths[i].point, parallel.paths[i].point) << "path " << i;
+	}
+	// Both roots found by solve() from different starting points.
+	EXPECT_EQ(serial.real_roots.size(), 2u);
+	expect_roots(funcs, serial, 1e-12);
+}
+
+TEST(HomotopyTest, Errors) {
+	EXPECT_THROW(homotopy(parse_all({"sin(x)"}), {"x"}), MathError);
+	EXPECT_THROW(homotopy(parse_all({"x + y", "7"}), {"x", "y"}), MathError);
+	EXPECT_THROW(homotopy(parse_all({"x + y"}), {"x", "y"}), std::invalid_argument);
+	EXPECT_THROW(homotopy(parse_all({"x + z", "x - y"}), {"x", "y"}), MathError);
+	HomotopyOptions opts;
+	opts.max_paths = 5;
+	EXPECT_THROW(homotopy(parse_all({"x^2 - 1", "y^3 - 1"}), {"x", "y"}, opts), MathError);
+}
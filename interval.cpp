@@ -0,0 +1,358 @@
+#include "interval.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr double inf = std::numeric_limits<double>::infinity();
+constexpr double pi = 3.14159265358979323846;
+
+// Bounds computed in floating point are moved one ulp outwards. Basic
+// operations are correctly rounded and the libm functions we use are accurate
+// to within one ulp, so the exact bound is never lost. NaN bounds come from
+// indeterminate forms such as inf - inf and are widened to infinity.
+double down(double x) {
+	if (std::isnan(x)) {
+		return -inf;
+	}
+	return std::isfinite(x) ? std::nextafter(x, -inf) : x;
+}
+
+double up(double x) {
+	if (std::isnan(x)) {
+		return inf;
+	}
+	return std::isfinite(x) ? std::nextafter(x, inf) : x;
+}
+
+// Sums, products and reciprocals are widened only if they're inexact, which
+// is detected with error-free transformations, so that e.g. exponents computed
+// from integers remain integers.
+bool exact_sum(double x, double y, double s) {
+	double t = s - x;
+	return std::isfinite(s) && (x - (s - t)) + (y - t) == 0.0;
+}
+
+double add_down(double x, double y) {
+	double s = x + y;
+	return exact_sum(x, y, s) ? s : down(s);
+}
+
+double add_up(double x, double y) {
+	double s = x + y;
+	return exact_sum(x, y, s) ? s : up(s);
+}
+
+// Products in which zero times infinity is zero, as bounds are limits.
+double mul_down(double x, double y) {
+	if (x == 0.0 || y == 0.0) {
+		return 0.0;
+	}
+	double p = x * y;
+	return std::isfinite(p) && std::fma(x, y, -p) == 0.0 ? p : down(p);
+}
+
+double mul_up(double x, double y) {
+	if (x == 0.0 || y == 0.0) {
+		return 0.0;
+	}
+	double p = x * y;
+	return std::isfinite(p) && std::fma(x, y, -p) == 0.0 ? p : up(p);
+}
+
+double recip_down(double x) {
+	double r = 1.0 / x;
+	return std::isfinite(r) && std::fma(r, x, -1.0) == 0.0 ? r : down(r);
+}
+
+double recip_up(double x) {
+	double r = 1.0 / x;
+	return std::isfinite(r) && std::fma(r, x, -1.0) == 0.0 ? r : up(r);
+}
+
+// Checks conservatively whether peak + 2*pi*k lies in [lo, hi] for some k.
+bool hits_period(double lo, double hi, double peak) {
+	double t_lo = (lo - peak) / (2 * pi);
+	double t_hi = (hi - peak) / (2 * pi);
+	double slack = 1e-9 * (1.0 + std::max(std::abs(t_lo), std::abs(t_hi)));
+	return std::floor(t_hi + slack) >= std::ceil(t_lo - slack);
+}
+
+Interval with_def(Interval x, bool defined) {
+	x.defined = defined;
+	return x;
+}
+
+// Range of sin or cos, peak being the argument at which fun reaches 1.
+Interval trig(Interval x, double (*fun)(double), double peak) {
+	if (x.is_empty()) {
+		return Interval::empty();
+	}
+	if (!std::isfinite(x.lo) || !std::isfinite(x.hi) || x.width() >= 2 * pi) {
+		return with_def(Interval(-1.0, 1.0), x.defined);
+	}
+	double a = fun(x.lo);
+	double b = fun(x.hi);
+	double lo = std::max(-1.0, down(std::min(a, b)));
+	double hi = std::min(1.0, up(std::max(a, b)));
+	if (hits_period(x.lo, x.hi, peak)) {
+		hi = 1.0;
+	}
+	if (hits_period(x.lo, x.hi, peak + pi)) {
+		lo = -1.0;
+	}
+	return with_def(Interval(lo, hi), x.defined);
+}
+
+bool is_integer(double x) {
+	return std::isfinite(x) && std::trunc(x) == x;
+}
+
+// Power with an integer exponent, defined for negative bases as well.
+Interval int_pow(Interval x, double n) {
+	if (n == 0.0) {
+		return with_def(Interval(1.0), x.defined);
+	}
+	if (n < 0.0) {
+		return Interval(1.0) / int_pow(x, -n);
+	}
+	double a = std::pow(x.lo, n);
+	double b = std::pow(x.hi, n);
+	bool even = std::fmod(n, 2.0) == 0.0;
+	if (!even || x.lo >= 0.0) {
+		return with_def(Interval(down(a), up(b)), x.defined);
+	}
+	if (x.hi <= 0.0) {
+		return with_def(Interval(down(b), up(a)), x.defined);
+	}
+	return with_def(Interval(0.0, up(std::max(a, b))), x.defined);
+}
+
+} // end anon
+
+Interval::Interval() : Interval(0.0) {}
+Interval::Interval(double x) : lo(x), hi(x), defined(true) {}
+Interval::Interval(double lo, double hi) : lo(lo), hi(hi), defined(true) {}
+
+Interval Interval::empty() {
+	return with_def(Interval(inf, -inf), false);
+}
+
+Interval Interval::entire() {
+	return Interval(-inf, inf);
+}
+
+bool Interval::is_empty() const {
+	return !(lo <= hi);
+}
+
+bool Interval::contains(double x) const {
+	return lo <= x && x <= hi;
+}
+
+bool Interval::interior_contains(Interval other) const {
+	return lo < other.lo && other.hi < hi;
+}
+
+double Interval::width() const {
+	return is_empty() ? 0.0 : hi - lo;
+}
+
+double Interval::mid() const {
+	if (std::isinf(lo) && std::isinf(hi)) {
+		return 0.0;
+	}
+	if (std::isinf(lo) || std::isinf(hi)) {
+		return std::isinf(lo) ? hi : lo;
+	}
+	return lo + (hi - lo) / 2;
+}
+
+double Interval::mag() const {
+	return std::max(std::abs(lo), std::abs(hi));
+}
+
+Interval operator+(Interval x, Interval y) {
+	if (x.is_empty() || y.is_empty()) {
+		return Interval::empty();
+	}
+	return with_def(Interval(add_down(x.lo, y.lo), add_up(x.hi, y.hi)), x.defined && y.defined);
+}
+
+Interval operator-(Interval x, Interval y) {
+	if (x.is_empty() || y.is_empty()) {
+		return Interval::empty();
+	}
+	return with_def(Interval(add_down(x.lo, -y.hi), add_up(x.hi, -y.lo)), x.defined && y.defined);
+}
+
+Interval operator*(Interval x, Interval y) {
+	if (x.is_empty() || y.is_empty()) {
+		return Interval::empty();
+	}
+	Interval res(
+		std::min(std::min(mul_down(x.lo, y.lo), mul_down(x.lo, y.hi)),
+			std::min(mul_down(x.hi, y.lo), mul_down(x.hi, y.hi))),
+		std::max(std::max(mul_up(x.lo, y.lo), mul_up(x.lo, y.hi)),
+			std::max(mul_up(x.hi, y.lo), mul_up(x.hi, y.hi))));
+	return with_def(res, x.defined && y.defined);
+}
+
+Interval operator/(Interval x, Interval y) {
+	if (x.is_empty() || y.is_empty() || (y.lo == 0.0 && y.hi == 0.0)) {
+		return Interval::empty();
+	}
+	if (y.lo == 0.0) {
+		return with_def(x * Interval(recip_down(y.hi), inf), false);
+	}
+	if (y.hi == 0.0) {
+		return with_def(x * Interval(-inf, recip_up(y.lo)), false);
+	}
+	if (y.contains(0.0)) {
+		return with_def(Interval::entire(), false);
+	}
+	return with_def(x * Interval(recip_down(y.hi), recip_up(y.lo)), y.defined && x.defined);
+}
+
+Interval operator-(Interval x) {
+	if (x.is_empty()) {
+		return x;
+	}
+	return with_def(Interval(-x.hi, -x.lo), x.defined);
+}
+
+Interval intersect(Interval x, Interval y) {
+	Interval res(std::max(x.lo, y.lo), std::min(x.hi, y.hi));
+	return res.is_empty() ? Interval::empty() : with_def(res, x.defined && y.defined);
+}
+
+Interval hull(Interval x, Interval y) {
+	if (x.is_empty()) {
+		return y;
+	}
+	if (y.is_empty()) {
+		return x;
+	}
+	return with_def(Interval(std::min(x.lo, y.lo), std::max(x.hi, y.hi)),
+			x.defined && y.defined);
+}
+
+Interval Interval::pow(Interval y) const {
+	auto x = *this;
+	if (x.is_empty() || y.is_empty()) {
+		return Interval::empty();
+	}
+	if (y.lo == y.hi && is_integer(y.lo)) {
+		return int_pow(x, y.lo);
+	}
+	// Negative bases are in the domain only for integer exponents.
+	if (x.lo < 0.0 && std::ceil(y.lo) <= std::floor(y.hi)) {
+		return with_def(Interval::entire(), false);
+	}
+	// Zero base is in the domain only for positive exponents.
+	bool defined = x.defined && y.defined && (x.lo > 0.0 || (x.lo == 0.0 && y.lo > 0.0));
+	return with_def((y * x.ln()).exp(), defined);
+}
+
+Interval Interval::sin() const {
+	return trig(*this, [](double x) { return std::sin(x); }, pi / 2);
+}
+
+Interval Interval::cos() const {
+	return trig(*this, [](double x) { return std::cos(x); }, 0.0);
+}
+
+Interval Interval::ln() const {
+	auto x = intersect(*this, Interval(0.0, inf));
+	if (x.is_empty() || x.hi == 0.0) {
+		return Interval::empty();
+	}
+	double lo = x.lo == 0.0 ? -inf : down(std::log(x.lo));
+	return with_def(Interval(lo, up(std::log(x.hi))), defined && this->lo > 0.0);
+}
+
+Interval Interval::exp() const {
+	if (is_empty()) {
+		return *this;
+	}
+	return with_def(Interval(std::max(0.0, down(std::exp(lo))), up(std::exp(hi))), defined);
+}
+
+Interval Interval::sqrt() const {
+	auto x = intersect(*this, Interval(0.0, inf));
+	if (x.is_empty()) {
+		return x;
+	}
+	return with_def(Interval(std::max(0.0, down(std::sqrt(x.lo))), up(std::sqrt(x.hi))),
+			defined && lo >= 0.0);
+}
+
+IntervalDual::IntervalDual() : IntervalDual(0.0) {}
+IntervalDual::IntervalDual(double val) : IntervalDual(val, 0.0, true) {}
+IntervalDual::IntervalDual(Interval val, Interval deriv, bool cons) :
+	val(val), deriv(deriv), cons(cons) {}
+
+IntervalDual operator+(IntervalDual x, IntervalDual y) {
+	return IntervalDual(x.val + y.val, x.deriv + y.deriv, x.cons && y.cons);
+}
+
+IntervalDual operator-(IntervalDual x, IntervalDual y) {
+	return IntervalDual(x.val - y.val, x.deriv - y.deriv, x.cons && y.cons);
+}
+
+IntervalDual operator*(IntervalDual x, IntervalDual y) {
+	return IntervalDual(x.val * y.val,
+			(x.deriv * y.val) + (x.val * y.deriv),
+			x.cons && y.cons);
+}
+
+IntervalDual operator/(IntervalDual x, IntervalDual y) {
+	return IntervalDual(x.val / y.val,
+			((x.deriv * y.val) - (x.val * y.deriv)) / (y.val * y.val),
+			x.cons && y.cons);
+}
+
+IntervalDual IntervalDual::pow(IntervalDual y) const {
+	auto x = *this;
+	Interval out;
+	if (y.cons) {
+		if (y.val.lo == 1.0 && y.val.hi == 1.0) {
+			out = x.deriv;
+		}
+		else {
+			out = y.val * x.val.pow(y.val - 1.0) * x.deriv;
+		}
+	}
+	else {
+		out = x.val.pow(y.val) *
+			(y.deriv * x.val.ln() + (x.deriv * y.val) / x.val);
+	}
+	return IntervalDual(x.val.pow(y.val), out, x.cons && y.cons);
+}
+
+IntervalDual operator-(IntervalDual x) {
+	return IntervalDual(-x.val, -x.deriv, x.cons);
+}
+
+IntervalDual IntervalDual::sin() const {
+	return IntervalDual(val.sin(), val.cos() * deriv, cons);
+}
+
+IntervalDual IntervalDual::cos() const {
+	return IntervalDual(val.cos(), -val.sin() * deriv, cons);
+}
+
+IntervalDual IntervalDual::ln() const {
+	return IntervalDual(val.ln(), deriv / val, cons);
+}
+
+IntervalDual IntervalDual::exp() const {
+	auto y = val.exp();
+	return IntervalDual(y, y * deriv, cons);
+}
+
+IntervalDual IntervalDual::sqrt() const {
+	return IntervalDual(val.sqrt(), deriv / (2.0 * val.sqrt()), cons);
+}
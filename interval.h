@@ -0,0 +1,79 @@
+#ifndef ROOTS_INTERVAL_H
+#define ROOTS_INTERVAL_H
+
+// Closed interval of real numbers with outwardly rounded arithmetic: the result
+// of every operation contains all results of the operation applied to members
+// of its operands. Operations never throw, points outside of the domain of a
+// function are ignored instead. Interval with no members is empty, interval
+// containing infinite bounds is unbounded.
+struct Interval {
+	double lo;
+	double hi;
+	// Cleared when some operation producing the interval ignored a point
+	// outside of its domain, as in decorations of IEEE 1788.
+	bool defined;
+
+	Interval();
+	// Constructs a degenerate interval containing a single point.
+	Interval(double x);
+	Interval(double lo, double hi);
+
+	static Interval empty();
+	static Interval entire();
+
+	bool is_empty() const;
+	bool contains(double x) const;
+	// Returns true if the other interval is a subset of this one's interior.
+	bool interior_contains(Interval other) const;
+	double width() const;
+	double mid() const;
+	// Maximal absolute value of the members.
+	double mag() const;
+
+	Interval pow(Interval y) const;
+
+	Interval sin() const;
+	Interval cos() const;
+	Interval ln() const;
+	Interval exp() const;
+	Interval sqrt() const;
+};
+
+Interval operator+(Interval x, Interval y);
+Interval operator-(Interval x, Interval y);
+Interval operator*(Interval x, Interval y);
+Interval operator/(Interval x, Interval y);
+Interval operator-(Interval x);
+
+// Intersection of intervals.
+Interval intersect(Interval x, Interval y);
+// Smallest interval containing both intervals.
+Interval hull(Interval x, Interval y);
+
+// Dual number with interval components, encloses values and partial
+// derivatives of an expression over a box.
+struct IntervalDual {
+	Interval val;
+	Interval deriv;
+	bool cons;
+
+	IntervalDual();
+	IntervalDual(double val);
+	IntervalDual(Interval val, Interval deriv, bool cons);
+
+	IntervalDual pow(IntervalDual y) const;
+
+	IntervalDual sin() const;
+	IntervalDual cos() const;
+	IntervalDual ln() const;
+	IntervalDual exp() const;
+	IntervalDual sqrt() const;
+};
+
+IntervalDual operator+(IntervalDual x, IntervalDual y);
+IntervalDual operator-(IntervalDual x, IntervalDual y);
+IntervalDual operator*(IntervalDual x, IntervalDual y);
+IntervalDual operator/(IntervalDual x, IntervalDual y);
+IntervalDual operator-(IntervalDual x);
+
+#endif // ROOTS_INTERVAL_H
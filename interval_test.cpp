@@ -0,0 +1,98 @@
+#include "interval.h"
+
+#include "common.h"
+#include "expr.h"
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr double inf = std::numeric_limits<double>::infinity();
+
+void expect_encloses(Interval x, double lo, double hi) {
+	EXPECT_LE(x.lo, lo) << "lower bound";
+	EXPECT_GE(x.hi, hi) << "upper bound";
+	if (std::isfinite(lo)) {
+		EXPECT_NEAR(x.lo, lo, 1e-12 * (1.0 + std::abs(lo))) << "lower bound";
+	}
+	if (std::isfinite(hi)) {
+		EXPECT_NEAR(x.hi, hi, 1e-12 * (1.0 + std::abs(hi))) << "upper bound";
+	}
+}
+
+} // end anon
+
+TEST(IntervalTest, Arithmetic) {
+	Interval x(1, 2);
+	Interval y(-3, 4);
+	expect_encloses(x + y, -2, 6);
+	expect_encloses(x - y, -3, 5);
+	expect_encloses(x * y, -6, 8);
+	expect_encloses(y / x, -3, 4);
+	expect_encloses(-y, -4, 3);
+	// Results are rounded outwards, so 0.1 + 0.2 is enclosed even though
+	// it isn't representable.
+	auto sum = Interval(0.1) + Interval(0.2);
+	EXPECT_LT(sum.lo, sum.hi);
+	EXPECT_TRUE(sum.contains(0.1 + 0.2));
+	EXPECT_TRUE(sum.defined);
+}
+
+TEST(IntervalTest, Division) {
+	auto x = Interval(1, 2) / Interval(-1, 1);
+	EXPECT_EQ(x.lo, -inf);
+	EXPECT_EQ(x.hi, inf);
+	EXPECT_FALSE(x.defined);
+	x = Interval(1, 2) / Interval(0, 4);
+	expect_encloses(x, 0.25, inf);
+	EXPECT_FALSE(x.defined);
+	EXPECT_TRUE((Interval(1) / Interval(0)).is_empty());
+}
+
+TEST(IntervalTest, Functions) {
+	expect_encloses(Interval(1, 4).sqrt(), 1, 2);
+	expect_encloses(Interval(0, std::exp(1.0)).ln(), -inf, 1);
+	expect_encloses(Interval(0, 1).exp(), 1, std::exp(1.0));
+	expect_encloses(Interval(0, 1).sin(), 0, std::sin(1.0));
+	expect_encloses(Interval(1, 2).sin(), std::sin(1.0), 1);
+	expect_encloses(Interval(3, 7).cos(), -1, 1);
+	expect_encloses(Interval(-2, 3).pow(2), 0, 9);
+	expect_encloses(Interval(-2, 3).pow(3), -8, 27);
+	expect_encloses(Interval(1, 4).pow(0.5), 1, 2);
+	expect_encloses(Interval(2, 4).pow(-1), 0.25, 0.5);
+}
+
+TEST(IntervalTest, Domain) {
+	auto x = Interval(-4, 4).sqrt();
+	expect_encloses(x, 0, 2);
+	EXPECT_FALSE(x.defined);
+	EXPECT_TRUE(Interval(-4, -1).sqrt().is_empty());
+	EXPECT_TRUE(Interval(-4, 0).ln().is_empty());
+	EXPECT_TRUE(Interval(-4, -1).pow(0.5).is_empty());
+	EXPECT_TRUE(Interval(4, 9).sqrt().defined);
+	// Empty intervals propagate.
+	EXPECT_TRUE((Interval::empty() + Interval(1)).is_empty());
+	EXPECT_TRUE(Interval::empty().sin().is_empty());
+}
+
+TEST(IntervalTest, Expr) {
+	auto expr = Expr::parse("x^2 + sin(y)/x");
+	Expr::IntervalEnv env = {{"x", Interval(1, 2)}, {"y", Interval(0, 1)}};
+	auto y = expr.eval_interval(env);
+	// Every point evaluation lies in the enclosure.
+	for (double x = 1; x <= 2; x += 0.125) {
+		for (double v = 0; v <= 1; v += 0.125) {
+			double fx = expr.eval({{"x", x}, {"y", v}});
+			double dx = expr.diff("x", {{"x", x}, {"y", v}});
+			EXPECT_TRUE(y.contains(fx)) << "value at " << x << ", " << v;
+			EXPECT_TRUE(expr.diff_interval("x", env).contains(dx)) << "derivative at " << x << ", " << v;
+		}
+	}
+	expect_encloses(Expr::parse("2*x - 1").diff_interval("x", env), 2, 2);
+	EXPECT_THROW(expr.eval_interval({{"x", Interval(1)}}), MathError);
+	// Function undefined in the whole box has empty range.
+	EXPECT_TRUE(Expr::parse("ln(x - 3)").eval_interval(env).is_empty());
+}
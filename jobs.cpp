@@ -0,0 +1,264 @@
+#include "jobs.h"
+
+#include "common.h"
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+
+std::string trim(const std::string& str) {
+	auto begin = str.find_first_not_of(" \t\r");
+	if (begin == std::string::npos) {
+		return "";
+	}
+	auto end = str.find_last_not_of(" \t\r");
+	return str.substr(begin, end - begin + 1);
+}
+
+bool starts_with(const std::string& str, const std::string& prefix) {
+	return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Parses the whole string as a number.
+std::optional<double> parse_number(const std::string& str) {
+	size_t len = 0;
+	double x = 0.0;
+	try {
+		x = std::stod(str, &len);
+	}
+	catch (const std::exception&) {
+		return std::nullopt;
+	}
+	if (len != str.size()) {
+		return std::nullopt;
+	}
+	return x;
+}
+
+// Splits "name = value" into its parts. Values are numbers, or strings if
+// strings are allowed.
+std::pair<std::string, Json> parse_assignment(const std::string& str, bool strings) {
+	auto eq = str.find('=');
+	if (eq == std::string::npos) {
+		throw ParseError("expecting assignment in '" + str + "'");
+	}
+	auto name = trim(str.substr(0, eq));
+	auto value = trim(str.substr(eq + 1));
+	auto x = parse_number(value);
+	if (name.empty() || value.empty() || (!x && !strings)) {
+		throw ParseError("invalid assignment '" + str + "'");
+	}
+	if (!x) {
+		return {name, Json(value)};
+	}
+	return {name, Json(*x)};
+}
+
+double get_number(const Json& json, const std::string& what) {
+	if (auto x = std::get_if<double>(&json.value)) {
+		return *x;
+	}
+	throw ParseError(what + " must be a number");
+}
+
+void read_json_job(Job& job, const std::string& line) {
+	auto json = Json::parse(line);
+	if (!std::holds_alternative<Json::Object>(json.value)) {
+		throw ParseError("system must be a JSON object");
+	}
+	if (auto id = json.find("id")) {
+		job.id = *id;
+	}
+	auto eqs = json.find("equations");
+	if (eqs == nullptr || !std::holds_alternative<Json::Array>(eqs->value)) {
+		throw ParseError("missing array of equations");
+	}
+	for (const auto& eq : std::get<Json::Array>(eqs->value)) {
+		auto str = std::get_if<std::string>(&eq.value);
+		if (str == nullptr) {
+			throw ParseError("equations must be strings");
+		}
+		job.equations.push_back(*str);
+	}
+	auto init = json.find("init");
+	if (init == nullptr || !std::holds_alternative<Json::Object>(init->value)) {
+		throw ParseError("missing object of initial values");
+	}
+	for (const auto& member : std::get<Json::Object>(init->value)) {
+		job.init.emplace_back(member.first, get_number(member.second, "initial value"));
+	}
+	if (auto constr = json.find("constraints")) {
+		if (!std::holds_alternative<Json::Object>(constr->value)) {
+			throw ParseError("constraints must be an object");
+		}
+		for (const auto& member : std::get<Json::Object>(constr->value)) {
+			set_constraint(job.constr, member.first, member.second);
+		}
+	}
+}
+
+// Converts the value of a constraint holding a count.
+size_t get_count(const std::string& name, double value) {
+	// size_t's maximum rounds up to a power of two, which is out of range.
+	// NaN fails every comparison.
+	if (!(value >= 0.0 && value < double(std::numeric_limits<size_t>::max()))
+			|| value != std::floor(value)) {
+		throw ParseError("constraint '" + name + "' must be a non-negative integer");
+	}
+	return static_cast<size_t>(value);
+}
+
+Method get_method(const Json& json) {
+	auto str = std::get_if<std::string>(&json.value);
+	if (str != nullptr && *str == "newton") {
+		return Method::Newton;
+	}
+	if (str != nullptr && *str == "halley") {
+		return Method::Halley;
+	}
+	if (str != nullptr && *str == "chebyshev") {
+		return Method::Chebyshev;
+	}
+	throw ParseError("constraint 'method' must be newton, halley or chebyshev");
+}
+
+} // end anon
+
+void set_constraint(Constraints& constr, const std::string& name, const Json& json) {
+	auto value = [&]() { return get_number(json, "constraint '" + name + "'"); };
+	if (name == "min_iters") {
+		constr.min_iters = get_count(name, value());
+	}
+	else if (name == "max_iters") {
+		constr.max_iters = get_count(name, value());
+	}
+	else if (name == "abs_epsilon") {
+		constr.abs_epsilon = value();
+	}
+	else if (name == "rel_epsilon") {
+		constr.rel_epsilon = value();
+	}
+	else if (name == "residual_abs") {
+		constr.residual_abs = value();
+	}
+	else if (name == "residual_rel") {
+		constr.residual_rel = value();
+	}
+	else if (name == "predicted_error") {
+		constr.predicted_error = value() != 0.0;
+	}
+	else if (name == "mixed_precision") {
+		constr.mixed_precision = value() != 0.0;
+	}
+	else if (name == "threads") {
+		constr.threads = get_count(name, value());
+	}
+	else if (name == "expand_polynomials") {
+		constr.expand_polynomials = value() != 0.0;
+	}
+	else if (name == "method") {
+		constr.method = get_method(json);
+	}
+	else {
+		throw ParseError("unknown constraint '" + name + "'");
+	}
+}
+
+JobReader::JobReader(std::vector<std::string> files) :
+	files(std::move(files)),
+	next_file(0),
+	input(nullptr),
+	jsonl(false),
+	count(0)
+{
+	if (this->files.empty()) {
+		this->files.push_back("-");
+	}
+}
+
+bool JobReader::open_next() {
+	if (next_file >= files.size()) {
+		return false;
+	}
+	const auto& name = files[next_file++];
+	if (name == "-") {
+		input = &std::cin;
+	}
+	else {
+		file = std::ifstream(name);
+		if (!file) {
+			throw std::runtime_error("can't open file " + name);
+		}
+		input = &file;
+	}
+	// Detect the format by the first non-blank character.
+	*input >> std::ws;
+	jsonl = input->peek() == '{';
+	return true;
+}
+
+// Returns false at the end of the current file.
+bool JobReader::next_line(std::string& line) {
+	return input != nullptr && std::getline(*input, line);
+}
+
+bool JobReader::read(Job& job) {
+	job = Job();
+	job.index = count;
+	std::string line;
+	bool found = false;
+	while (true) {
+		if (!next_line(line)) {
+			// The end of a file ends the block as a blank line does, and the
+			// next file may be in the other format.
+			if (found || !open_next()) {
+				break;
+			}
+			continue;
+		}
+		auto text = trim(line);
+		if (text.empty()) {
+			if (found) {
+				break;
+			}
+			continue;
+		}
+		if (starts_with(text, "#")) {
+			continue;
+		}
+		found = true;
+		try {
+			if (jsonl) {
+				read_json_job(job, text);
+				break;
+			}
+			else if (starts_with(text, "let ")) {
+				auto a = parse_assignment(text.substr(4), false);
+				job.init.emplace_back(a.first, std::get<double>(a.second.value));
+			}
+			else if (starts_with(text, "set ")) {
+				auto a = parse_assignment(text.substr(4), true);
+				set_constraint(job.constr, a.first, a.second);
+			}
+			else {
+				job.equations.push_back(text);
+			}
+		}
+		catch (const ParseError& err) {
+			if (!job.error) {
+				job.error = err.what();
+			}
+			if (jsonl) {
+				break;
+			}
+		}
+	}
+	if (found) {
+		++count;
+	}
+	return found;
+}
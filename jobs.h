@@ -0,0 +1,55 @@
+#ifndef ROOTS_JOBS_H
+#define ROOTS_JOBS_H
+
+#include "expr.h"
+#include "json.h"
+#include "solve.h"
+
+#include <fstream>
+#include <istream>
+#include <optional>
+#include <string>
+#include <vector>
+
+// System read from the input of roots-cli, not parsed yet.
+struct Job {
+	size_t index;
+	std::optional<Json> id;
+	std::vector<std::string> equations;
+	std::vector<Binding> init;
+	Constraints constr;
+	// Set if the input was malformed.
+	std::optional<std::string> error;
+};
+
+// Sets the constraint of the given name, named as the member of Constraints.
+// Values are numbers, with zero being false for flags, except for "method",
+// which is one of "newton", "halley" and "chebyshev".
+// Throws ParseError for unknown names and for values the constraint can't take.
+void set_constraint(Constraints& constr, const std::string& name, const Json& value);
+
+// Reads jobs one at a time from a sequence of files, "-" standing for stdin.
+// Every file is either in JSON Lines or in block format, detected by its first
+// non-blank character, and a block never continues past the end of its file.
+class JobReader {
+private:
+	std::vector<std::string> files;
+	size_t next_file;
+	std::ifstream file;
+	std::istream* input;
+	bool jsonl;
+	size_t count;
+
+	bool open_next();
+	bool next_line(std::string& line);
+
+public:
+	// Reads stdin when no files are given.
+	JobReader(std::vector<std::string> files);
+
+	// Returns false when there are no more systems.
+	// Throws std::runtime_error if a file can't be opened.
+	bool read(Job& job);
+};
+
+#endif // ROOTS_JOBS_H
@@ -0,0 +1,128 @@
+#include "jobs.h"
+
+#include "common.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+std::string write_file(const std::string& name, const std::string& text) {
+	auto path = testing::TempDir() + name;
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out << text;
+	return path;
+}
+
+std::vector<Job> read_all(const std::vector<std::string>& files) {
+	JobReader reader(files);
+	std::vector<Job> jobs;
+	Job job;
+	while (reader.read(job)) {
+		jobs.push_back(std::move(job));
+	}
+	return jobs;
+}
+
+} // end anon
+
+TEST(JobsTest, Blocks) {
+	auto path = write_file("jobs_test_blocks.txt",
+		"# first\n"
+		"x^2 + y^2 = 16\n"
+		"y = 2*x - 3\n"
+		"let x = 100\n"
+		"let y = 130\n"
+		"set max_iters = 50\n"
+		"set method = chebyshev\n"
+		"\n\n"
+		"z - 1\n"
+		"let z = 0\n"
+		"let w\n");
+	auto jobs = read_all({path});
+	ASSERT_EQ(jobs.size(), 2u);
+	EXPECT_EQ(jobs[0].index, 0u);
+	EXPECT_EQ(jobs[0].equations, (std::vector<std::string>{"x^2 + y^2 = 16", "y = 2*x - 3"}));
+	EXPECT_EQ(jobs[0].init, (std::vector<Binding>{{"x", 100}, {"y", 130}}));
+	EXPECT_EQ(jobs[0].constr.max_iters, 50u);
+	EXPECT_EQ(jobs[0].constr.method, Method::Chebyshev);
+	EXPECT_FALSE(jobs[0].error);
+	EXPECT_EQ(jobs[1].index, 1u);
+	EXPECT_EQ(jobs[1].equations, std::vector<std::string>{"z - 1"});
+	EXPECT_TRUE(jobs[1].error);
+	std::remove(path.c_str());
+	EXPECT_THROW(read_all({path}), std::runtime_error);
+}
+
+TEST(JobsTest, FileBoundary) {
+	// The first file doesn't end with a newline, nor with a blank line.
+	auto c = write_file("jobs_test_c.txt", "x^2 - 2\nlet x = 1");
+	auto d = write_file("jobs_test_d.txt", "y^2 - 3\nlet y = 1\n");
+	auto e = write_file("jobs_test_e.txt",
+		"{\"id\": 7, \"equations\": [\"z = 4\"], \"init\": {\"z\": 0},"
+		" \"constraints\": {\"method\": \"halley\", \"max_iters\": 7}}\n");
+	auto jobs = read_all({c, d, e, c});
+	ASSERT_EQ(jobs.size(), 4u);
+	EXPECT_EQ(jobs[0].equations, std::vector<std::string>{"x^2 - 2"});
+	EXPECT_EQ(jobs[0].init, (std::vector<Binding>{{"x", 1}}));
+	EXPECT_EQ(jobs[1].equations, std::vector<std::string>{"y^2 - 3"});
+	EXPECT_EQ(jobs[1].init, (std::vector<Binding>{{"y", 1}}));
+	// The format is detected anew for every file.
+	EXPECT_EQ(jobs[2].equations, std::vector<std::string>{"z = 4"});
+	ASSERT_TRUE(jobs[2].id);
+	EXPECT_FALSE(jobs[2].error);
+	EXPECT_EQ(jobs[2].constr.method, Method::Halley);
+	EXPECT_EQ(jobs[2].constr.max_iters, 7u);
+	EXPECT_EQ(jobs[3].equations, std::vector<std::string>{"x^2 - 2"});
+	EXPECT_FALSE(jobs[3].error);
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		EXPECT_EQ(jobs[i].index, i);
+	}
+	for (const auto& path : {c, d, e}) {
+		std::remove(path.c_str());
+	}
+}
+
+TEST(JobsTest, SetConstraint) {
+	Constraints constr;
+	set_constraint(constr, "abs_epsilon", 1e-9);
+	EXPECT_EQ(constr.abs_epsilon, 1e-9);
+	set_constraint(constr, "mixed_precision", 1.0);
+	EXPECT_TRUE(constr.mixed_precision);
+	set_constraint(constr, "expand_polynomials", 1.0);
+	EXPECT_TRUE(constr.expand_polynomials);
+	set_constraint(constr, "threads", 4.0);
+	EXPECT_EQ(constr.threads, 4u);
+	EXPECT_THROW(set_constraint(constr, "threads", -1.0), ParseError);
+	EXPECT_THROW(set_constraint(constr, "max_iter", 5.0), ParseError);
+
+	set_constraint(constr, "max_iters", 0.0);
+	EXPECT_EQ(constr.max_iters, 0u);
+	set_constraint(constr, "min_iters", 1e15);
+	EXPECT_EQ(constr.min_iters, size_t(1e15));
+	for (double value : {-1.0, 2.5, 1e30, std::ldexp(1.0, 64), HUGE_VAL, std::nan("")}) {
+		try {
+			set_constraint(constr, "max_iters", value);
+			ADD_FAILURE() << value;
+		}
+		catch (const ParseError& err) {
+			EXPECT_NE(std::string(err.what()).find("max_iters"), std::string::npos) << err.what();
+		}
+	}
+	EXPECT_EQ(constr.max_iters, 0u);
+
+	set_constraint(constr, "method", "chebyshev");
+	EXPECT_EQ(constr.method, Method::Chebyshev);
+	set_constraint(constr, "method", "halley");
+	EXPECT_EQ(constr.method, Method::Halley);
+	EXPECT_THROW(set_constraint(constr, "method", "secant"), ParseError);
+	EXPECT_THROW(set_constraint(constr, "method", 1.0), ParseError);
+	EXPECT_THROW(set_constraint(constr, "max_iters", "many"), ParseError);
+	EXPECT_THROW(set_constraint(constr, "solver", "newton"), ParseError);
+}
@@ -0,0 +1,347 @@
+#include "json.h"
+
+#include "common.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+Json::Json() : value(nullptr) {}
+Json::Json(Value val) : value(std::move(val)) {}
+Json::Json(double x) : value(x) {}
+Json::Json(bool x) : value(x) {}
+Json::Json(std::string str) : value(std::move(str)) {}
+Json::Json(const char* str) : value(std::string(str)) {}
+Json::Json(Array arr) : value(std::move(arr)) {}
+Json::Json(Object obj) : value(std::move(obj)) {}
+
+const Json* Json::find(const std::string& key) const {
+	if (auto obj = std::get_if<Object>(&value)) {
+		for (const auto& member : *obj) {
+			if (member.first == key) {
+				return &member.second;
+			}
+		}
+	}
+	return nullptr;
+}
+
+std::string json_quote(const std::string& str) {
+	std::string out = "\"";
+	for (char c : str) {
+		switch (c) {
+		case '"':  out.append("\\\""); break;
+		case '\\': out.append("\\\\"); break;
+		case '\b': out.append("\\b"); break;
+		case '\f': out.append("\\f"); break;
+		case '\n': out.append("\\n"); break;
+		case '\r': out.append("\\r"); break;
+		case '\t': out.append("\\t"); break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				char buf[8];
+				std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+				out.append(buf);
+			}
+			else {
+				out.push_back(c);
+			}
+		}
+	}
+	out.push_back('"');
+	return out;
+}
+
+std::string json_number(double x) {
+	if (!std::isfinite(x)) {
+		return "null";
+	}
+	char buf[32];
+	for (int prec = 15; prec <= 17; ++prec) {
+		std::snprintf(buf, sizeof(buf), "%.*g", prec, x);
+		if (std::strtod(buf, nullptr) == x) {
+			break;
+		}
+	}
+	return buf;
+}
+
+std::string Json::dump() const {
+	return std::visit(overloaded {
+		[](std::nullptr_t) {
+			return std::string("null");
+		},
+		[](bool b) {
+			return std::string(b ? "true" : "false");
+		},
+		[](double x) {
+			return json_number(x);
+		},
+		[](const std::string& str) {
+			return json_quote(str);
+		},
+		[](const Array& arr) {
+			std::string out = "[";
+			for (size_t i = 0; i < arr.size(); ++i) {
+				if (i > 0) {
+					out.append(",");
+				}
+				out.append(arr[i].dump());
+			}
+			out.append("]");
+			return out;
+		},
+		[](const Object& obj) {
+			std::string out = "{";
+			for (size_t i = 0; i < obj.size(); ++i) {
+				if (i > 0) {
+					out.append(",");
+				}
+				out.append(json_quote(obj[i].first));
+				out.append(":");
+				out.append(obj[i].second.dump());
+			}
+			out.append("}");
+			return out;
+		},
+	}, value);
+}
+
+namespace {
+
+// Recursive descent JSON parser.
+class Parser {
+private:
+	const std::string& input;
+	size_t pos;
+
+public:
+	Parser(const std::string& input);
+
+private:
+	[[noreturn]] void fail(const std::string& msg) const;
+	char peek() const;
+	void skip_space();
+	void expect(char c);
+	bool consume_literal(const char* lit);
+	std::string parse_string();
+	double parse_number();
+	Json parse_array();
+	Json parse_object();
+
+public:
+	Json parse_value();
+	void finish();
+};
+
+Parser::Parser(const std::string& input) : input(input), pos(0) {}
+
+void Parser::fail(const std::string& msg) const {
+	std::ostringstream out;
+	out << msg << " at offset " << pos;
+	throw ParseError(out.str());
+}
+
+char Parser::peek() const {
+	return pos < input.size() ? input[pos] : 0;
+}
+
+void Parser::skip_space() {
+	while (pos < input.size() && std::string_view(" \t\r\n").find(input[pos]) != std::string_view::npos) {
+		++pos;
+	}
+}
+
+void Parser::expect(char c) {
+	skip_space();
+	if (peek() != c) {
+		fail(std::string("expecting '") + c + "'");
+	}
+	++pos;
+}
+
+bool Parser::consume_literal(const char* lit) {
+	std::string_view view(lit);
+	if (input.compare(pos, view.size(), view) == 0) {
+		pos += view.size();
+		return true;
+	}
+	return false;
+}
+
+void append_utf8(std::string& out, unsigned long code) {
+	if (code < 0x80) {
+		out.push_back(static_cast<char>(code));
+	}
+	else if (code < 0x800) {
+		out.push_back(static_cast<char>(0xc0 | (code >> 6)));
+		out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+	}
+	else if (code < 0x10000) {
+		out.push_back(static_cast<char>(0xe0 | (code >> 12)));
+		out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+		out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+	}
+	else {
+		out.push_back(static_cast<char>(0xf0 | (code >> 18)));
+		out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+		out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+		out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+	}
+}
+
+std::string Parser::parse_string() {
+	expect('"');
+	std::string out;
+	auto hex4 = [&]() {
+		if (pos + 4 > input.size()) {
+			fail("truncated unicode escape");
+		}
+		char* end;
+		auto digits = input.substr(pos, 4);
+		unsigned long code = std::strtoul(digits.c_str(), &end, 16);
+		if (end != digits.c_str() + 4) {
+			fail("invalid unicode escape");
+		}
+		pos += 4;
+		return code;
+	};
+	while (true) {
+		if (pos >= input.size()) {
+			fail("unterminated string");
+		}
+		char c = input[pos++];
+		if (c == '"') {
+			break;
+		}
+		if (static_cast<unsigned char>(c) < 0x20) {
+			fail("control character in string");
+		}
+		if (c != '\\') {
+			out.push_back(c);
+			continue;
+		}
+		char esc = peek();
+		++pos;
+		switch (esc) {
+		case '"':  out.push_back('"'); break;
+		case '\\': out.push_back('\\'); break;
+		case '/':  out.push_back('/'); break;
+		case 'b':  out.push_back('\b'); break;
+		case 'f':  out.push_back('\f'); break;
+		case 'n':  out.push_back('\n'); break;
+		case 'r':  out.push_back('\r'); break;
+		case 't':  out.push_back('\t'); break;
+		case 'u': {
+			unsigned long code = hex4();
+			if (code >= 0xd800 && code < 0xdc00 && consume_literal("\\u")) {
+				unsigned long low = hex4();
+				code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+			}
+			append_utf8(out, code);
+			break;
+		}
+		default:
+			fail("invalid escape sequence");
+		}
+	}
+	return out;
+}
+
+double Parser::parse_number() {
+	const char* begin = input.c_str() + pos;
+	char* end;
+	double x = std::strtod(begin, &end);
+	if (end == begin || !(std::isdigit(*begin) || *begin == '-')) {
+		fail("invalid number");
+	}
+	pos += end - begin;
+	return x;
+}
+
+Json Parser::parse_array() {
+	expect('[');
+	Json::Array arr;
+	skip_space();
+	if (peek() == ']') {
+		++pos;
+		return Json(std::move(arr));
+	}
+	while (true) {
+		arr.push_back(parse_value());
+		skip_space();
+		if (peek() == ',') {
+			++pos;
+			continue;
+		}
+		expect(']');
+		return Json(std::move(arr));
+	}
+}
+
+Json Parser::parse_object() {
+	expect('{');
+	Json::Object obj;
+	skip_space();
+	if (peek() == '}') {
+		++pos;
+		return Json(std::move(obj));
+	}
+	while (true) {
+		skip_space();
+		auto key = parse_string();
+		expect(':');
+		obj.emplace_back(std::move(key), parse_value());
+		skip_space();
+		if (peek() == ',') {
+			++pos;
+			continue;
+		}
+		expect('}');
+		return Json(std::move(obj));
+	}
+}
+
+Json Parser::parse_value() {
+	skip_space();
+	char c = peek();
+	if (c == '{') {
+		return parse_object();
+	}
+	else if (c == '[') {
+		return parse_array();
+	}
+	else if (c == '"') {
+		return Json(parse_string());
+	}
+	else if (consume_literal("null")) {
+		return Json();
+	}
+	else if (consume_literal("true")) {
+		return Json(true);
+	}
+	else if (consume_literal("false")) {
+		return Json(false);
+	}
+	else if (c == '-' || std::isdigit(c)) {
+		return Json(parse_number());
+	}
+	fail("unexpected character");
+}
+
+void Parser::finish() {
+	skip_space();
+	if (pos != input.size()) {
+		fail("trailing characters");
+	}
+}
+
+} // end anon
+
+Json Json::parse(const std::string& input) {
+	Parser parser(input);
+	auto json = parser.parse_value();
+	parser.finish();
+	return json;
+}
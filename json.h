@@ -0,0 +1,47 @@
+#ifndef ROOTS_JSON_H
+#define ROOTS_JSON_H
+
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Minimal JSON document model, used for machine-readable input and output.
+class Json {
+public:
+	using Array = std::vector<Json>;
+	// Object members are kept in the order of appearance.
+	using Object = std::vector<std::pair<std::string, Json>>;
+	using Value = std::variant<std::nullptr_t, bool, double, std::string, Array, Object>;
+
+	Value value;
+
+	Json();
+	Json(Value val);
+	Json(double x);
+	Json(bool x);
+	Json(std::string str);
+	Json(const char* str);
+	Json(Array arr);
+	Json(Object obj);
+
+	// Returns the member of an object with the given key.
+	// Returns null if the value is not an object or there's no such member.
+	const Json* find(const std::string& key) const;
+
+	// Returns the compact string representation of the value.
+	std::string dump() const;
+
+	// Parses a JSON document.
+	// On invalid input throws a ParseError.
+	static Json parse(const std::string& input);
+};
+
+// Returns a quoted and escaped JSON string literal.
+std::string json_quote(const std::string& str);
+
+// Returns the shortest representation of a number that parses back to the
+// same double. Non-finite numbers, not representable in JSON, become null.
+std::string json_number(double x);
+
+#endif // ROOTS_JSON_H
@@ -0,0 +1,57 @@
+#include "json.h"
+
+#include "common.h"
+
+#include <cmath>
+
+#include "gtest/gtest.h"
+
+TEST(JsonTest, ParseScalars) {
+	EXPECT_TRUE(std::holds_alternative<std::nullptr_t>(Json::parse("null").value));
+	EXPECT_EQ(std::get<bool>(Json::parse(" true ").value), true);
+	EXPECT_EQ(std::get<bool>(Json::parse("false").value), false);
+	EXPECT_DOUBLE_EQ(std::get<double>(Json::parse("-12.5e-1").value), -1.25);
+	EXPECT_EQ(std::get<std::string>(Json::parse("\"a\\\"b\\n\\u00e9\"").value), "a\"b\n\xc3\xa9");
+}
+
+TEST(JsonTest, ParseNested) {
+	auto json = Json::parse(R"({"equations": ["x^2 - 2", "y = x"], "init": {"x": 1, "y": 2}})");
+	auto eqs = json.find("equations");
+	ASSERT_NE(eqs, nullptr) << "equations member";
+	const auto& arr = std::get<Json::Array>(eqs->value);
+	ASSERT_EQ(arr.size(), 2) << "number of equations";
+	EXPECT_EQ(std::get<std::string>(arr[1].value), "y = x");
+	auto init = json.find("init");
+	ASSERT_NE(init, nullptr) << "init member";
+	const auto& obj = std::get<Json::Object>(init->value);
+	ASSERT_EQ(obj.size(), 2) << "number of initial values";
+	EXPECT_EQ(obj[0].first, "x") << "member order";
+	EXPECT_EQ(obj[1].first, "y") << "member order";
+	EXPECT_EQ(json.find("missing"), nullptr);
+}
+
+TEST(JsonTest, ParseErrors) {
+	EXPECT_THROW(Json::parse(""), ParseError);
+	EXPECT_THROW(Json::parse("{\"a\" 1}"), ParseError);
+	EXPECT_THROW(Json::parse("[1, 2"), ParseError);
+	EXPECT_THROW(Json::parse("\"abc"), ParseError);
+	EXPECT_THROW(Json::parse("nul"), ParseError);
+	EXPECT_THROW(Json::parse("1 2"), ParseError);
+	EXPECT_THROW(Json::parse("+1"), ParseError);
+}
+
+TEST(JsonTest, Dump) {
+	Json json(Json::Object{
+		{"name", "a\tb"},
+		{"values", Json::Array{1.0, 0.1, true, Json()}},
+		{"nan", std::nan("")},
+	});
+	EXPECT_EQ(json.dump(), R"({"name":"a\tb","values":[1,0.1,true,null],"nan":null})");
+}
+
+TEST(JsonTest, NumberRoundTrip) {
+	for (double x : {0.1, 1.0 / 3.0, std::sqrt(13.11), -2.5e-300, 1e300}) {
+		auto str = json_number(x);
+		EXPECT_EQ(std::get<double>(Json::parse(str).value), x) << str;
+	}
+}
@@ -0,0 +1,154 @@
+#include "load.h"
+
+#include "common.h"
+#include "mapped_file.h"
+#include "pool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <optional>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+
+namespace {
+
+// Chunks are small enough for several of them to go to each thread, which
+// balances the load when lines differ in length, but not so small that
+// scheduling them costs more than parsing them.
+constexpr size_t chunks_per_thread = 8;
+constexpr size_t min_chunk = 1 << 16;
+
+struct Chunk {
+	std::string_view text;
+	std::vector<Expr> funcs;
+	// Lines of the equations within the chunk, counted from zero.
+	std::vector<size_t> lines;
+	// Number of lines read, not including those after an error.
+	size_t line_count = 0;
+	// Line within the chunk and message of the first error.
+	std::optional<std::pair<size_t, std::string>> error;
+	// Interned variable names in the order of their first occurrence.
+	std::vector<const std::string*> vars;
+};
+
+// Splits text into about count chunks, each ending with a newline except
+// possibly the last one.
+std::vector<Chunk> split(std::string_view text, size_t count) {
+	size_t size = std::max(min_chunk, (text.size() + count - 1) / count);
+	std::vector<Chunk> chunks;
+	size_t pos = 0;
+	while (pos < text.size()) {
+		size_t end = text.size();
+		if (text.size() - pos > size) {
+			size_t newline = text.find('\n', pos + size - 1);
+			end = newline == std::string_view::npos ? text.size() : newline + 1;
+		}
+		chunks.emplace_back();
+		chunks.back().text = text.substr(pos, end - pos);
+		pos = end;
+	}
+	return chunks;
+}
+
+bool skipped(std::string_view line) {
+	auto it = std::find_if(line.begin(), line.end(), [](char c) {
+		return !std::isspace(static_cast<unsigned char>(c));
+	});
+	return it == line.end() || *it == '#';
+}
+
+// Appends variables of the expression not in seen to vars, from left to
+// right.
+void first_occurrences(const Expr& expr, std::unordered_set<const std::string*>& seen,
+		std::vector<const std::string*>& vars) {
+	std::visit(overloaded {
+		[](const Expr::Const&) {},
+		[&](const Expr::Var& var) {
+			if (seen.insert(var.name.get()).second) {
+				vars.push_back(var.name.get());
+			}
+		},
+		[&](const Expr::Binary& bin) {
+			first_occurrences(*bin.lhs, seen, vars);
+			first_occurrences(*bin.rhs, seen, vars);
+		},
+		[&](const Expr::Unary& un) {
+			first_occurrences(*un.arg, seen, vars);
+		},
+	}, expr.value);
+}
+
+// Parses the lines of the chunk, stopping at the first invalid one.
+void parse_chunk(Chunk& chunk, Interner& names) {
+	std::string_view text = chunk.text;
+	size_t pos = 0;
+	while (pos < text.size()) {
+		size_t end = std::min(text.find('\n', pos), text.size());
+		auto line = text.substr(pos, end - pos);
+		size_t index = chunk.line_count++;
+		pos = end + 1;
+		if (skipped(line)) {
+			continue;
+		}
+		try {
+			chunk.funcs.push_back(Expr::parse(line, names));
+			chunk.lines.push_back(index);
+		}
+		catch (const ParseError& err) {
+			chunk.error.emplace(index, err.what());
+			return;
+		}
+	}
+	std::unordered_set<const std::string*> seen;
+	for (const auto& f : chunk.funcs) {
+		first_occurrences(f, seen, chunk.vars);
+	}
+}
+
+} // end anon
+
+Equations parse_equations(std::string_view text, size_t threads) {
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	Interner names;
+	auto chunks = split(text, threads * chunks_per_thread);
+	if (chunks.size() == 1) {
+		parse_chunk(chunks[0], names);
+	}
+	else if (chunks.size() > 1) {
+		ThreadPool pool(std::min(threads, chunks.size()));
+		pool.parallel_for(chunks.size(), [&](size_t i) {
+			parse_chunk(chunks[i], names);
+		});
+	}
+	// Names are interned, so that they're identified by their addresses.
+	Equations res;
+	std::unordered_set<const std::string*> seen;
+	size_t first_line = 1;
+	for (auto& chunk : chunks) {
+		if (chunk.error) {
+			auto line = first_line + chunk.error->first;
+			throw ParseError("line " + std::to_string(line) + ": " + chunk.error->second);
+		}
+		std::move(chunk.funcs.begin(), chunk.funcs.end(), std::back_inserter(res.funcs));
+		for (size_t line : chunk.lines) {
+			res.lines.push_back(first_line + line);
+		}
+		for (auto name : chunk.vars) {
+			if (seen.insert(name).second) {
+				res.vars.push_back(*name);
+			}
+		}
+		first_line += chunk.line_count;
+	}
+	return res;
+}
+
+Equations load_equations(const std::string& path, size_t threads) {
+	MappedFile file(path);
+	return parse_equations(std::string_view(file.data(), file.size()), threads);
+}
@@ -0,0 +1,31 @@
+#ifndef ROOTS_LOAD_H
+#define ROOTS_LOAD_H
+
+#include "expr.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Equations of a system parsed from text.
+struct Equations {
+	std::vector<Expr> funcs;
+	// Line of each equation, counted from one.
+	std::vector<size_t> lines;
+	// Variables in the order of their first occurrence.
+	std::vector<std::string> vars;
+};
+
+// Parses text holding one equation per line, skipping blank lines and lines
+// starting with '#'. The text is split into chunks at line boundaries, which
+// are parsed in parallel on the given number of threads, zero meaning one per
+// hardware thread. Variable names are interned across all equations, so that
+// every variable is stored once however many times it occurs.
+// Throws ParseError for the first invalid line, giving its number.
+Equations parse_equations(std::string_view text, size_t threads = 0);
+
+// Same as above for the file at path, which is memory-mapped rather than read.
+// Throws std::system_error if the file can't be mapped.
+Equations load_equations(const std::string& path, size_t threads = 0);
+
+#endif // ROOTS_LOAD_H
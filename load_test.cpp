@@ -0,0 +1,149 @@
+#include "load.h"
+
+#include "common.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <variant>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Collects the strings held by variable nodes of the expression.
+void var_names(const Expr& expr, std::vector<const std::string*>& out) {
+	std::visit(overloaded {
+		[](const Expr::Const&) {},
+		[&](const Expr::Var& var) { out.push_back(var.name.get()); },
+		[&](const Expr::Binary& bin) {
+			var_names(*bin.lhs, out);
+			var_names(*bin.rhs, out);
+		},
+		[&](const Expr::Unary& un) { var_names(*un.arg, out); },
+	}, expr.value);
+}
+
+// Large enough to be split into many chunks.
+std::string big_system(size_t lines) {
+	std::string text;
+	for (size_t i = 0; i < lines; ++i) {
+		text += "x" + std::to_string(i % 97) + " * sin(y) + " + std::to_string(i)
+			+ " * z^2 = " + std::to_string(i % 13) + "\n";
+		if (i % 100 == 0) {
+			text += "# comment\n\n";
+		}
+	}
+	return text;
+}
+
+} // end anon
+
+TEST(LoadTest, Parse) {
+	std::string text =
+		"# A system.\n"
+		"x^2 + y^2 = 4\n"
+		"\n"
+		"   \t\n"
+		"  # indented comment\n"
+		"x - sin(z)\r\n"
+		"z = y";
+	auto eqs = parse_equations(text, 1);
+	ASSERT_EQ(eqs.funcs.size(), 3u);
+	EXPECT_EQ(eqs.lines, (std::vector<size_t>{2, 6, 7}));
+	EXPECT_EQ(eqs.vars, (std::vector<std::string>{"x", "y", "z"}));
+	for (size_t i = 0; i < 3; ++i) {
+		EXPECT_EQ(eqs.funcs[i].show(), Expr::parse(std::string(
+				i == 0 ? "x^2 + y^2 = 4" : i == 1 ? "x - sin(z)" : "z = y")).show());
+	}
+	std::vector<const std::string*> names;
+	for (const auto& f : eqs.funcs) {
+		var_names(f, names);
+	}
+	// x, y, x, z, z, y
+	ASSERT_EQ(names.size(), 6u);
+	EXPECT_EQ(names[0], names[2]);
+	EXPECT_EQ(names[1], names[5]);
+	EXPECT_EQ(names[3], names[4]);
+	EXPECT_TRUE(parse_equations("", 4).funcs.empty());
+	EXPECT_TRUE(parse_equations("\n# nothing\n", 4).funcs.empty());
+}
+
+TEST(LoadTest, Parallel) {
+	auto text = big_system(20000);
+	auto serial = parse_equations(text, 1);
+	auto parallel = parse_equations(text, 4);
+	ASSERT_EQ(serial.funcs.size(), 20000u);
+	ASSERT_EQ(parallel.funcs.size(), 20000u);
+	EXPECT_EQ(parallel.lines, serial.lines);
+	EXPECT_EQ(parallel.vars, serial.vars);
+	EXPECT_EQ(parallel.vars.size(), 99u);
+	EXPECT_EQ(parallel.vars[0], "x0");
+	EXPECT_EQ(parallel.vars[1], "y");
+	EXPECT_EQ(parallel.vars[2], "z");
+	EXPECT_EQ(parallel.lines[1], 4u);
+	for (size_t i = 0; i < 20000; i += 997) {
+		EXPECT_EQ(parallel.funcs[i].show(), serial.funcs[i].show()) << "equation " << i;
+	}
+	// One string per variable, shared by equations from all chunks.
+	std::unordered_map<std::string, const std::string*> names;
+	for (const auto& f : parallel.funcs) {
+		std::vector<const std::string*> vars;
+		var_names(f, vars);
+		for (auto name : vars) {
+			auto it = names.emplace(*name, name).first;
+			EXPECT_EQ(it->second, name) << *name;
+		}
+	}
+	EXPECT_EQ(names.size(), 99u);
+}
+
+TEST(LoadTest, Errors) {
+	auto text = big_system(20000);
+	auto with_error = [&](size_t line, const std::string& content) {
+		size_t pos = 0;
+		for (size_t i = 1; i < line; ++i) {
+			pos = text.find('\n', pos) + 1;
+		}
+		return text.substr(0, pos) + content + "\n" + text.substr(pos);
+	};
+	auto message = [](const std::string& text, size_t threads) {
+		try {
+			parse_equations(text, threads);
+		}
+		catch (const ParseError& err) {
+			return std::string(err.what());
+		}
+		return std::string("no error");
+	};
+	auto bad = with_error(15000, "x + * y");
+	EXPECT_EQ(message(bad, 4).rfind("line 15000: unexpected", 0), 0u) << message(bad, 4);
+	EXPECT_EQ(message(bad, 4), message(bad, 1));
+	// The first error is reported, whichever chunk finishes first.
+	auto twice = with_error(7, "sin(x");
+	twice = twice.substr(0, twice.size() - 1) + "\n)\n";
+	EXPECT_EQ(message(twice, 4).rfind("line 7: ", 0), 0u) << message(twice, 4);
+	EXPECT_EQ(message("x\ny\n2 $ 3\n", 1).rfind("line 3: unrecognized symbol", 0), 0u);
+}
+
+TEST(LoadTest, File) {
+	auto path = testing::TempDir() + "load_test.txt";
+	auto text = big_system(5000);
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out << text;
+	}
+	auto loaded = load_equations(path, 2);
+	auto parsed = parse_equations(text, 1);
+	EXPECT_EQ(loaded.lines, parsed.lines);
+	EXPECT_EQ(loaded.vars, parsed.vars);
+	ASSERT_EQ(loaded.funcs.size(), parsed.funcs.size());
+	EXPECT_EQ(loaded.funcs.back().show(), parsed.funcs.back().show());
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	}
+	EXPECT_TRUE(load_equations(path).funcs.empty());
+	std::remove(path.c_str());
+	EXPECT_THROW(load_equations(path), std::system_error);
+}
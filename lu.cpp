@@ -0,0 +1,328 @@
+#include "lu.h"
+
+#include "pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// Columns of a panel of the blocked factorization. The panel is factorized
+// by a single thread, so it must stay narrow, while the trailing update does
+// a multiplication with an inner dimension of block_size, which gets more
+// efficient as the panel gets wider.
+constexpr size_t block_size = 64;
+// Tiles of the trailing update, each a task of the pool.
+constexpr size_t tile_rows = 64;
+constexpr size_t tile_cols = 256;
+
+// Subtracts L * U from rows [r0, r1) and columns [c0, c1) of a, a row-major
+// matrix with rows of length n, where L is columns [k0, k0 + k) of a and U
+// rows [k0, k0 + k).
+// Every entry accumulates the products in the order of p, the same as k rank
+// one updates would. Rows are updated four at a time, so that every load of
+// U serves four of them, and the innermost loop runs over contiguous columns.
+template<typename T>
+void update(T* a, size_t n, size_t k0, size_t k, size_t r0, size_t r1,
+		size_t c0, size_t c1) {
+	const T* u = a + k0*n;
+	size_t i = r0;
+	for (; i + 4 <= r1; i += 4) {
+		T* a0 = a + i*n;
+		T* a1 = a0 + n;
+		T* a2 = a1 + n;
+		T* a3 = a2 + n;
+		for (size_t p = 0; p < k; ++p) {
+			const T* row = u + p*n;
+			T l0 = a0[k0 + p];
+			T l1 = a1[k0 + p];
+			T l2 = a2[k0 + p];
+			T l3 = a3[k0 + p];
+			for (size_t j = c0; j < c1; ++j) {
+				T x = row[j];
+				a0[j] -= l0 * x;
+				a1[j] -= l1 * x;
+				a2[j] -= l2 * x;
+				a3[j] -= l3 * x;
+			}
+		}
+	}
+	for (; i < r1; ++i) {
+		T* ai = a + i*n;
+		for (size_t p = 0; p < k; ++p) {
+			const T* row = u + p*n;
+			T l = ai[k0 + p];
+			for (size_t j = c0; j < c1; ++j) {
+				ai[j] -= l * row[j];
+			}
+		}
+	}
+}
+
+} // end anon
+
+template<typename T>
+LU<T>::LU(size_t n) :
+	n(n),
+	lu(n * n),
+	perm(n),
+	work(n) {}
+
+template<typename T>
+size_t LU<T>::size() const {
+	return n;
+}
+
+template<typename T>
+void LU<T>::load(const Matrix& mat) {
+	if (mat.get_height() != n || mat.get_width() != n) {
+		throw std::invalid_argument("matrix dimension mismatch in factorization");
+	}
+	for (size_t i = 0; i < n; ++i) {
+		perm[i] = i;
+		const double* row = mat.data() + i * mat.get_stride();
+		for (size_t j = 0; j < n; ++j) {
+			lu[i*n + j] = static_cast<T>(row[j]);
+		}
+	}
+}
+
+// Doolittle's algorithm with row pivoting. Pivots are treated as zero by
+// the same absolute epsilon as Matrix::inverse uses.
+template<typename T>
+bool LU<T>::factor(const Matrix& mat) {
+	load(mat);
+	constexpr double epsilon = std::numeric_limits<double>::epsilon();
+	for (size_t k = 0; k < n; ++k) {
+		size_t max = k;
+		for (size_t i = k+1; i < n; ++i) {
+			if (std::abs(lu[i*n + k]) > std::abs(lu[max*n + k])) {
+				max = i;
+			}
+		}
+		T pivot = lu[max*n + k];
+		if (!(std::abs(pivot) > epsilon) || !std::isfinite(pivot)) {
+			return false;
+		}
+		if (max != k) {
+			for (size_t j = 0; j < n; ++j) {
+				std::swap(lu[k*n + j], lu[max*n + j]);
+			}
+			std::swap(perm[k], perm[max]);
+		}
+		const T* row_k = &lu[k*n];
+		for (size_t i = k+1; i < n; ++i) {
+			T* row_i = &lu[i*n];
+			T ratio = row_i[k] / pivot;
+			row_i[k] = ratio;
+			for (size_t j = k+1; j < n; ++j) {
+				row_i[j] -= ratio * row_k[j];
+			}
+		}
+	}
+	return true;
+}
+
+// Every entry receives the same updates in the same order as in the
+// unblocked algorithm, only grouped differently, so that results only differ
+// where the compiler fuses multiplications and subtractions differently.
+template<typename T>
+template<typename ForEach>
+bool LU<T>::factor_tiles(const Matrix& mat, const ForEach& for_each) {
+	load(mat);
+	constexpr double epsilon = std::numeric_limits<double>::epsilon();
+	for (size_t k0 = 0; k0 < n; k0 += block_size) {
+		size_t k1 = std::min(n, k0 + block_size);
+		// Factorizes columns [k0, k1) of the rows from k0 on. Whole rows are
+		// swapped, which applies the interchanges to the columns of L left
+		// of the panel and to the columns right of it, updated below.
+		for (size_t k = k0; k < k1; ++k) {
+			size_t max = k;
+			for (size_t i = k+1; i < n; ++i) {
+				if (std::abs(lu[i*n + k]) > std::abs(lu[max*n + k])) {
+					max = i;
+				}
+			}
+			T pivot = lu[max*n + k];
+			if (!(std::abs(pivot) > epsilon) || !std::isfinite(pivot)) {
+				return false;
+			}
+			if (max != k) {
+				std::swap_ranges(&lu[k*n], &lu[k*n] + n, &lu[max*n]);
+				std::swap(perm[k], perm[max]);
+			}
+			const T* row_k = &lu[k*n];
+			for (size_t i = k+1; i < n; ++i) {
+				T* row_i = &lu[i*n];
+				T ratio = row_i[k] / pivot;
+				row_i[k] = ratio;
+				for (size_t j = k+1; j < k1; ++j) {
+					row_i[j] -= ratio * row_k[j];
+				}
+			}
+		}
+		if (k1 == n) {
+			break;
+		}
+		// Rows [k0, k1) of U right of the panel, by forward substitution
+		// with the unit lower triangle of the panel, in column tiles.
+		size_t col_tiles = (n - k1 + tile_cols - 1) / tile_cols;
+		for_each(col_tiles, [&](size_t t) {
+			size_t c0 = k1 + t * tile_cols;
+			size_t c1 = std::min(n, c0 + tile_cols);
+			for (size_t i = k0+1; i < k1; ++i) {
+				update(lu.data(), n, k0, i - k0, i, i+1, c0, c1);
+			}
+		});
+		// Subtracts the product of the panel's L and the rows of U from the
+		// trailing submatrix.
+		size_t row_tiles = (n - k1 + tile_rows - 1) / tile_rows;
+		for_each(row_tiles * col_tiles, [&](size_t t) {
+			size_t r0 = k1 + (t / col_tiles) * tile_rows;
+			size_t r1 = std::min(n, r0 + tile_rows);
+			size_t c0 = k1 + (t % col_tiles) * tile_cols;
+			size_t c1 = std::min(n, c0 + tile_cols);
+			update(lu.data(), n, k0, k1 - k0, r0, r1, c0, c1);
+		});
+	}
+	return true;
+}
+
+template<typename T>
+bool LU<T>::factor(const Matrix& mat, ThreadPool& pool) {
+	return factor_tiles(mat, [&](size_t count, const auto& fun) {
+		pool.parallel_for(count, fun);
+	});
+}
+
+template<typename T>
+bool LU<T>::factor_blocked(const Matrix& mat) {
+	return factor_tiles(mat, [](size_t count, const auto& fun) {
+		for (size_t t = 0; t < count; ++t) {
+			fun(t);
+		}
+	});
+}
+
+template<typename T>
+void LU<T>::solve(double* b) const {
+	// Forward substitution with the permuted right hand side. Results are
+	// accumulated in precision T and written to b at the end.
+	T* out = work.data();
+	for (size_t i = 0; i < n; ++i) {
+		T sum = static_cast<T>(b[perm[i]]);
+		const T* row = &lu[i*n];
+		for (size_t j = 0; j < i; ++j) {
+			sum -= row[j] * out[j];
+		}
+		out[i] = sum;
+	}
+	for (size_t i = n; i-- > 0;) {
+		T sum = out[i];
+		const T* row = &lu[i*n];
+		for (size_t j = i+1; j < n; ++j) {
+			sum -= row[j] * out[j];
+		}
+		out[i] = sum / row[i];
+	}
+	for (size_t i = 0; i < n; ++i) {
+		b[i] = static_cast<double>(out[i]);
+	}
+}
+
+template class LU<float>;
+template class LU<double>;
+
+MixedSolver::MixedSolver(size_t n) :
+	low(n),
+	high(n),
+	res(n),
+	corr(n),
+	fallback(false),
+	steps(0) {}
+
+namespace {
+
+double max_abs(const std::vector<double>& v) {
+	double res = 0.0;
+	for (double x : v) {
+		res = std::max(res, std::abs(x));
+	}
+	return res;
+}
+
+} // end anon
+
+bool MixedSolver::solve(const Matrix& a, const Matrix& b, Matrix& x) {
+	size_t n = low.size();
+	fallback = false;
+	steps = 0;
+	auto solve_high = [&]() {
+		fallback = true;
+		if (!high.factor(a)) {
+			return false;
+		}
+		for (size_t i = 0; i < n; ++i) {
+			corr[i] = b[{i, 0}];
+		}
+		high.solve(corr.data());
+		for (size_t i = 0; i < n; ++i) {
+			x[{i, 0}] = corr[i];
+		}
+		return true;
+	};
+	if (!low.factor(a)) {
+		return solve_high();
+	}
+	for (size_t i = 0; i < n; ++i) {
+		corr[i] = b[{i, 0}];
+	}
+	low.solve(corr.data());
+	for (size_t i = 0; i < n; ++i) {
+		x[{i, 0}] = corr[i];
+	}
+	// Refinement stops once the residual is at the level of double precision
+	// rounding errors, and is considered stalled when a step doesn't at least
+	// halve the residual.
+	constexpr double epsilon = std::numeric_limits<double>::epsilon();
+	double prev = std::numeric_limits<double>::infinity();
+	while (true) {
+		double scale = 0.0;
+		for (size_t i = 0; i < n; ++i) {
+			double sum = b[{i, 0}];
+			double mag = std::abs(sum);
+			for (size_t j = 0; j < n; ++j) {
+				sum -= a[{i, j}] * x[{j, 0}];
+				mag += std::abs(a[{i, j}] * x[{j, 0}]);
+			}
+			res[i] = sum;
+			scale = std::max(scale, mag);
+		}
+		double norm = max_abs(res);
+		if (!std::isfinite(norm)) {
+			return solve_high();
+		}
+		if (norm <= n * epsilon * scale) {
+			return true;
+		}
+		if (norm > 0.5 * prev || steps >= max_steps) {
+			return solve_high();
+		}
+		prev = norm;
+		low.solve(res.data());
+		for (size_t i = 0; i < n; ++i) {
+			x[{i, 0}] += res[i];
+		}
+		++steps;
+	}
+}
+
+bool MixedSolver::used_fallback() const {
+	return fallback;
+}
+
+size_t MixedSolver::refinement_steps() const {
+	return steps;
+}
@@ -0,0 +1,83 @@
+#ifndef ROOTS_LU_H
+#define ROOTS_LU_H
+
+#include "matrix.h"
+
+#include <vector>
+
+class ThreadPool;
+
+// LU factorization with partial pivoting of a square matrix, computed in
+// precision T. Buffers are allocated once for the given size, so that
+// repeated factorizations don't allocate.
+template<typename T>
+class LU {
+private:
+	size_t n;
+	// Row-major L and U factors, L has an implicit unit diagonal.
+	std::vector<T> lu;
+	// Row permutation: row i of the factors is row perm[i] of the matrix.
+	std::vector<size_t> perm;
+	// Intermediate results of solve().
+	mutable std::vector<T> work;
+
+	// Copies the matrix to the factors and resets the permutation.
+	void load(const Matrix& mat);
+	// Blocked factorization, calling for_each(count, fun) to run fun(t) for
+	// every tile t of an update.
+	template<typename ForEach>
+	bool factor_tiles(const Matrix& mat, const ForEach& for_each);
+
+public:
+	explicit LU(size_t n);
+
+	size_t size() const;
+
+	// Factorizes the matrix, which must be n x n.
+	// Returns false if the matrix is singular.
+	bool factor(const Matrix& mat);
+	// Same as above with a right-looking blocked algorithm: panels of
+	// columns are factorized one at a time and the remaining rows and
+	// columns are updated by tiles, in parallel on the pool. Gives the same
+	// factors as the unblocked algorithm up to rounding, and is faster from
+	// a few hundred rows on, even on a single thread.
+	// Must not be called from a task running on the pool.
+	bool factor(const Matrix& mat, ThreadPool& pool);
+	// Same as above on the calling thread.
+	bool factor_blocked(const Matrix& mat);
+
+	// Solves A x = b for the last factorized matrix, overwriting b with x.
+	// Arithmetic is done in precision T.
+	void solve(double* b) const;
+};
+
+// Solves linear systems by factorizing the matrix in single precision and
+// recovering double precision accuracy through iterative refinement with
+// double precision residuals. Falls back to a double precision factorization
+// when refinement doesn't converge.
+class MixedSolver {
+private:
+	LU<float> low;
+	LU<double> high;
+	std::vector<double> res;
+	std::vector<double> corr;
+	bool fallback;
+	size_t steps;
+
+public:
+	// Maximal number of refinement steps.
+	static constexpr size_t max_steps = 10;
+
+	explicit MixedSolver(size_t n);
+
+	// Solves A x = b, where b and x are column vectors of height n.
+	// Returns false if the matrix is singular.
+	bool solve(const Matrix& a, const Matrix& b, Matrix& x);
+
+	// Whether the last solve fell back to double precision.
+	bool used_fallback() const;
+	// Number of refinement steps performed by the last solve.
+	size_t refinement_steps() const;
+};
+
+#endif // ROOTS_LU_H
@@ -0,0 +1,155 @@
+#include "lu.h"
+
+#include "matrix.h"
+#include "pool.h"
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+Matrix hilbert(size_t n) {
+	return Matrix(n, n, [](size_t i, size_t j) {
+		return 1.0 / (1.0 + i + j);
+	});
+}
+
+// Right hand side for which the solution is a vector of ones.
+Matrix ones_rhs(const Matrix& a) {
+	size_t n = a.get_height();
+	return Matrix(n, 1, [&](size_t i, size_t) {
+		double sum = 0.0;
+		for (size_t j = 0; j < n; ++j) {
+			sum += a[{i, j}];
+		}
+		return sum;
+	});
+}
+
+} // end anon
+
+TEST(LUTest, Solve) {
+	Matrix a = {
+		{0, 2, 1},
+		{1, 1, 1},
+		{4, 1, -2},
+	};
+	LU<double> lu(3);
+	ASSERT_TRUE(lu.factor(a));
+	std::vector<double> b = {7, 6, 0};
+	lu.solve(b.data());
+	EXPECT_DOUBLE_EQ(b[0], 1);
+	EXPECT_DOUBLE_EQ(b[1], 2);
+	EXPECT_DOUBLE_EQ(b[2], 3);
+
+	LU<float> lu_f(3);
+	ASSERT_TRUE(lu_f.factor(a));
+	b = {7, 6, 0};
+	lu_f.solve(b.data());
+	EXPECT_NEAR(b[0], 1, 1e-6);
+	EXPECT_NEAR(b[1], 2, 1e-6);
+	EXPECT_NEAR(b[2], 3, 1e-6);
+}
+
+TEST(LUTest, Singular) {
+	Matrix a = {
+		{1, 2},
+		{2, 4},
+	};
+	LU<double> lu(2);
+	EXPECT_FALSE(lu.factor(a));
+	LU<float> lu_f(2);
+	EXPECT_FALSE(lu_f.factor(a));
+	EXPECT_THROW(lu.factor(Matrix(3, 3)), std::invalid_argument);
+}
+
+TEST(LUTest, Blocked) {
+	// Several panels, the last one partial, and tiles with remainders of
+	// rows and columns. Entries of the matrix are unordered, so that most
+	// columns need a row interchange.
+	size_t n = 300;
+	Matrix a(n, n, [](size_t i, size_t j) {
+		return std::sin(1.0 + i * (j + 3.0));
+	});
+	LU<double> plain(n);
+	LU<double> blocked(n);
+	ThreadPool pool(3);
+	ASSERT_TRUE(plain.factor(a));
+	ASSERT_TRUE(blocked.factor(a, pool));
+	std::vector<double> expected(n);
+	std::vector<double> actual(n);
+	for (size_t i = 0; i < n; ++i) {
+		expected[i] = actual[i] = 1.0 + i;
+	}
+	plain.solve(expected.data());
+	blocked.solve(actual.data());
+	for (size_t i = 0; i < n; ++i) {
+		EXPECT_NEAR(actual[i], expected[i], 1e-12 * (1.0 + std::abs(expected[i])));
+	}
+	// Without a pool, tiles are only processed in another order.
+	std::vector<double> serial(n);
+	for (size_t i = 0; i < n; ++i) {
+		serial[i] = 1.0 + i;
+	}
+	ASSERT_TRUE(blocked.factor_blocked(a));
+	blocked.solve(serial.data());
+	EXPECT_EQ(serial, actual);
+
+	// Rows proportional by a power of two stay so exactly during the
+	// elimination, until one cancels the other.
+	for (size_t j = 0; j < n; ++j) {
+		a[{200, j}] = 2.0 * a[{3, j}];
+	}
+	EXPECT_FALSE(plain.factor(a));
+	EXPECT_FALSE(blocked.factor(a, pool));
+	EXPECT_FALSE(blocked.factor_blocked(a));
+	EXPECT_THROW(blocked.factor(Matrix(n, n+1), pool), std::invalid_argument);
+}
+
+TEST(LUTest, MixedRefinement) {
+	auto a = hilbert(5);
+	auto b = ones_rhs(a);
+	MixedSolver solver(5);
+	Matrix x(5, 1);
+	ASSERT_TRUE(solver.solve(a, b, x));
+	EXPECT_FALSE(solver.used_fallback());
+	EXPECT_GT(solver.refinement_steps(), 0u);
+	for (size_t i = 0; i < 5; ++i) {
+		double actual = x[{i, 0}];
+		EXPECT_NEAR(actual, 1.0, 1e-9);
+	}
+}
+
+TEST(LUTest, MixedFallback) {
+	// Condition number of the 10x10 Hilbert matrix is about 1e13, far too
+	// large for refinement of a single precision factorization to converge.
+	auto a = hilbert(10);
+	auto b = ones_rhs(a);
+	MixedSolver solver(10);
+	Matrix x(10, 1);
+	ASSERT_TRUE(solver.solve(a, b, x));
+	EXPECT_TRUE(solver.used_fallback());
+	LU<double> lu(10);
+	ASSERT_TRUE(lu.factor(a));
+	std::vector<double> expected(10);
+	for (size_t i = 0; i < 10; ++i) {
+		expected[i] = b[{i, 0}];
+	}
+	lu.solve(expected.data());
+	for (size_t i = 0; i < 10; ++i) {
+		double actual = x[{i, 0}];
+		EXPECT_DOUBLE_EQ(actual, expected[i]);
+	}
+}
+
+TEST(LUTest, MixedSingular) {
+	Matrix a = {
+		{1, 2},
+		{2, 4},
+	};
+	MixedSolver solver(2);
+	Matrix x(2, 1);
+	EXPECT_FALSE(solver.solve(a, Matrix{{1}, {2}}, x));
+}
@@ -1,5 +1,6 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "solveworker.h"
 #include "expr.h"
 #include <vector>
 #include "solve.h"
@@ -22,10 +23,17 @@ MainWindow::MainWindow(QWidget *parent)
 	ui->tableFuncs->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
 	ui->tableAns->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
 	ui->tableEval->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+	ui->cancelButton->setEnabled(false);
+	ui->solveProgressBar->setValue(0);
+	SolveWorker::registerTypes();
 }
 
 MainWindow::~MainWindow()
 {
+	if (solveThread != nullptr) {
+		solveCancel->store(true);
+		solveThread->wait();
+	}
     delete ui;
 }
 
@@ -35,6 +43,18 @@ void showError(const std::exception& err) {
 	box.setFixedSize(500, 200);
 }
 
+void MainWindow::addVariables(const Expr& expr)
+{
+	for (const auto& var : expr.variables()) {
+		if (varColumns.count(var) == 0) {
+			int idx = ui->initialValuesTable->columnCount();
+			ui->initialValuesTable->insertColumn(idx);
+			ui->initialValuesTable->setItem(0, idx, new QTableWidgetItem(QString::fromStdString(var)));
+			varColumns.emplace(var, idx);
+		}
+	}
+}
+
 void MainWindow::on_addButton_clicked()
 {
 	QString fx = ui->plainTextFunctionEdit->toPlainText();
@@ -47,17 +67,10 @@ void MainWindow::on_addButton_clicked()
 		showError(err);
 		return;
 	}
-	std::unordered_set<std::string> present;
-	for (int i = 0; i < ui->initialValuesTable->columnCount(); ++i) {
-		present.insert(ui->initialValuesTable->item(0, i)->text().toStdString());
-	}
-	for (const auto& exp : expFx.variables()) {
-		if (present.count(exp) == 0) {
-			size_t idx = ui->initialValuesTable->columnCount();
-			ui->initialValuesTable->insertColumn(idx);
-			ui->initialValuesTable->setItem(0, idx, new QTableWidgetItem(QString::fromStdString(exp)));
-		}
-	}
+	addVariables(expFx);
+	// The cache entry must exist before the item is set, so that the
+	// resulting cellChanged signal finds it up to date.
+	funcs.push_back(ParsedFunc{fx, expFx, ""});
 	ui->tableFuncs->insertRow(ui->tableFuncs->rowCount());
 	auto item = new QTableWidgetItem(fx);
 	item->setToolTip(QString::fromStdString(expFx.show()));
@@ -66,12 +79,24 @@ void MainWindow::on_addButton_clicked()
 }
 
 void MainWindow::on_tableFuncs_cellChanged(int row, int col) {
-	auto str = ui->tableFuncs->item(row, col)->text().toStdString();
+	auto item = ui->tableFuncs->item(row, col);
+	if (static_cast<size_t>(row) >= funcs.size()) {
+		funcs.resize(row + 1);
+	}
+	auto& func = funcs[row];
+	if (func.expr && func.text == item->text()) {
+		return;
+	}
+	func.text = item->text();
 	try {
-		auto exp = Expr::parse(str);
-		ui->tableFuncs->item(row, col)->setToolTip(QString::fromStdString(exp.show()));
+		func.expr = Expr::parse(func.text.toStdString());
+		func.error.clear();
+		item->setToolTip(QString::fromStdString(func.expr->show()));
+		addVariables(*func.expr);
 	}
 	catch (const ParseError& err) {
+		func.expr.reset();
+		func.error = err.what();
 		showError(err);
 	}
 }
@@ -83,19 +108,16 @@ void MainWindow::on_solveButton_clicked()
 	ui->tableAns->setRowCount(0);
 	ui->tableEval->setRowCount(0);
 
-    std::vector<Expr> funcs;
+    std::vector<Expr> exprs;
     std::vector<Binding> inits;
 
-    for(int i = 0; i < ui->tableFuncs->rowCount(); i++){
-		auto str = ui->tableFuncs->item(i, 0)->text().toStdString();
-		try {
-			funcs.push_back(Expr::parse(str));
-		}
-		catch (const ParseError& err) {
-			showError(err);
+	for (const auto& func : funcs) {
+		if (!func.expr) {
+			showError(ParseError(func.error));
 			return;
 		}
-    }
+		exprs.push_back(*func.expr);
+	}
 
     for(int i = 0; i < ui->initialValuesTable->columnCount(); i++){
 		auto item = ui->initialValuesTable->item(1, i);
@@ -121,15 +143,49 @@ void MainWindow::on_solveButton_clicked()
     constr.rel_epsilon = ui->relSpinBox->value() *
 		std::pow(10.0, ui->relMagSpinBox->value());
 
-	Solution solution;
-	try {
-        solution = solve(funcs, inits, constr);
-	}
-	catch (const MathError& err) {
-		showError(err);
-		return;
+	solveCancel = std::make_shared<std::atomic<bool>>(false);
+	auto worker = new SolveWorker(std::move(exprs), std::move(inits), std::move(constr), solveCancel);
+	solveThread = new QThread(this);
+	worker->moveToThread(solveThread);
+	connect(solveThread, &QThread::started, worker, &SolveWorker::run);
+	connect(worker, &SolveWorker::progress, this, &MainWindow::onSolveProgress);
+	connect(worker, &SolveWorker::solved, this, &MainWindow::onSolved);
+	connect(worker, &SolveWorker::failed, this, &MainWindow::onSolveFailed);
+	connect(worker, &SolveWorker::cancelled, this, &MainWindow::onSolveCancelled);
+	connect(worker, &SolveWorker::finished, this, &MainWindow::onSolveFinished);
+	// Quit directly from the worker thread, so that the thread can finish even
+	// when the GUI thread is blocked waiting for it.
+	connect(worker, &SolveWorker::finished, solveThread, &QThread::quit, Qt::DirectConnection);
+	connect(solveThread, &QThread::finished, worker, &QObject::deleteLater);
+	connect(solveThread, &QThread::finished, solveThread, &QObject::deleteLater);
+
+	ui->solveButton->setEnabled(false);
+	ui->pushButton->setEnabled(false);
+	ui->cancelButton->setEnabled(true);
+	ui->solveProgressBar->setMaximum(ui->maxIterationsSpinBox->value());
+	ui->solveProgressBar->setValue(0);
+	ui->solveProgressBar->setFormat("solving...");
+	solveThread->start();
+}
+
+void MainWindow::on_cancelButton_clicked()
+{
+	if (solveCancel) {
+		solveCancel->store(true);
+		ui->cancelButton->setEnabled(false);
 	}
+}
+
+void MainWindow::onSolveProgress(int iteration, double maxDiff)
+{
+	ui->solveProgressBar->setValue(iteration);
+	ui->solveProgressBar->setFormat(QString("iteration %1, max diff %2")
+		.arg(iteration)
+		.arg(maxDiff));
+}
 
+void MainWindow::onSolved(Solution solution, QVector<double> values)
+{
 	ui->iterationsAns->setText(QString::number(solution.iters));
 	ui->maxDiffAns->setText(QString::number(solution.max_diff));
 	for (const auto& p : solution.vars) {
@@ -138,16 +194,36 @@ void MainWindow::on_solveButton_clicked()
 		ui->tableAns->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(p.first)));
 		ui->tableAns->setItem(i, 1, new QTableWidgetItem(QString::number(p.second)));
 	}
-	auto env = Expr::Env(solution.vars.begin(), solution.vars.end());
-	for (const auto& f : funcs) {
+	for (double value : values) {
 		int i = ui->tableEval->rowCount();
 		ui->tableEval->insertRow(i);
-		ui->tableEval->setItem(i, 0, new QTableWidgetItem(QString::number(f.eval(env))));
+		ui->tableEval->setItem(i, 0, new QTableWidgetItem(QString::number(value)));
 	}
 }
 
+void MainWindow::onSolveFailed(QString message)
+{
+	showError(MathError(message.toStdString()));
+}
+
+void MainWindow::onSolveCancelled()
+{
+	ui->solveProgressBar->setFormat("cancelled");
+}
+
+void MainWindow::onSolveFinished()
+{
+	solveThread = nullptr;
+	solveCancel.reset();
+	ui->solveButton->setEnabled(true);
+	ui->pushButton->setEnabled(true);
+	ui->cancelButton->setEnabled(false);
+}
+
 void MainWindow::on_pushButton_clicked()
 {
+	funcs.clear();
+	varColumns.clear();
 	ui->initialValuesTable->setColumnCount(0);
 	ui->tableFuncs->setRowCount(0);
 	ui->iterationsAns->clear();
@@ -2,6 +2,18 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QThread>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "expr.h"
+#include "solve.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -25,7 +37,38 @@ private slots:
 
     void on_pushButton_clicked();
 
+	void on_cancelButton_clicked();
+
+	void onSolveProgress(int iteration, double maxDiff);
+
+	void onSolved(Solution solution, QVector<double> values);
+
+	void onSolveFailed(QString message);
+
+	void onSolveCancelled();
+
+	void onSolveFinished();
+
 private:
+	// Adds initial value columns for variables of the expression which are
+	// not present in the table yet.
+	void addVariables(const Expr& expr);
+
+	// Function from tableFuncs, parsed when added or edited.
+	struct ParsedFunc {
+		QString text;
+		// Empty if the text is not a valid expression.
+		std::optional<Expr> expr;
+		std::string error;
+	};
+
     Ui::MainWindow *ui;
+	// Parsed functions, in the order of tableFuncs rows.
+	std::vector<ParsedFunc> funcs;
+	// Columns of initialValuesTable indexed by variable name.
+	std::unordered_map<std::string, int> varColumns;
+	// Thread of the running solve and its cancellation flag, null when idle.
+	QThread *solveThread = nullptr;
+	std::shared_ptr<std::atomic<bool>> solveCancel;
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,54 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+[[noreturn]] void fail(const std::string& what, const std::string& path) {
+	throw std::system_error(errno, std::generic_category(), what + " " + path);
+}
+
+} // end anon
+
+MappedFile::MappedFile(const std::string& path) : addr(nullptr), len(0) {
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		fail("can't open", path);
+	}
+	struct stat st;
+	if (::fstat(fd, &st) < 0) {
+		::close(fd);
+		fail("can't stat", path);
+	}
+	len = static_cast<size_t>(st.st_size);
+	// Empty files can't be mapped, but they don't need to be.
+	if (len > 0) {
+		addr = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr == MAP_FAILED) {
+			addr = nullptr;
+			::close(fd);
+			fail("can't map", path);
+		}
+	}
+	::close(fd);
+}
+
+MappedFile::~MappedFile() {
+	if (addr != nullptr) {
+		::munmap(addr, len);
+	}
+}
+
+const char* MappedFile::data() const {
+	return static_cast<const char*>(addr);
+}
+
+size_t MappedFile::size() const {
+	return len;
+}
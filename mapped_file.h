@@ -0,0 +1,24 @@
+#ifndef ROOTS_MAPPED_FILE_H
+#define ROOTS_MAPPED_FILE_H
+
+#include <string>
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+private:
+	void* addr;
+	size_t len;
+
+public:
+	// Maps the file. Throws std::system_error on failure.
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data() const;
+	size_t size() const;
+};
+
+#endif // ROOTS_MAPPED_FILE_H
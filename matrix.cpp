@@ -1,13 +1,23 @@
 #include "matrix.h"
 
+#include "profile.h"
+
 #include <functional>
 #include <limits>
 #include <sstream>
 
-Matrix::Matrix(size_t height, size_t width) :
+Matrix::Matrix(size_t height, size_t width, size_t stride) :
 	height(height),
 	width(width),
-	cells(std::vector(height * width, 0.0)) {}
+	stride(stride),
+	cells(height * stride, 0.0) {}
+
+Matrix::Matrix(size_t height, size_t width) : Matrix(height, width, width) {}
+
+Matrix Matrix::padded(size_t height, size_t width) {
+	constexpr size_t line = alignment / sizeof(double);
+	return Matrix(height, width, (width + line - 1) / line * line);
+}
 
 Matrix::Matrix(std::initializer_list<std::initializer_list<double>> init) {
 	height = init.size();
@@ -20,7 +30,8 @@ Matrix::Matrix(std::initializer_list<std::initializer_list<double>> init) {
 			}
 		}
 	}
-	cells = std::vector(height * width, 0.0);
+	stride = width;
+	cells.assign(height * width, 0.0);
 	size_t i = 0;
 	for (const auto& row : init) {
 		size_t j = 0;
@@ -36,30 +47,84 @@ size_t Matrix::get_height() const { return height; }
 
 size_t Matrix::get_width() const { return width; }
 
+size_t Matrix::get_stride() const { return stride; }
+
+double* Matrix::data() { return cells.data(); }
+
+const double* Matrix::data() const { return cells.data(); }
+
 double Matrix::operator[](std::pair<size_t, size_t> idx) const {
-	return cells[width * idx.first + idx.second];
+	return cells[stride * idx.first + idx.second];
 }
 
 double& Matrix::operator[](std::pair<size_t, size_t> idx) {
-	return cells[width * idx.first + idx.second];
+	return cells[stride * idx.first + idx.second];
+}
+
+Matrix& Matrix::operator+=(const Matrix& rhs) {
+	return apply_in_place(std::plus<double>{}, rhs);
+}
+
+Matrix& Matrix::operator-=(const Matrix& rhs) {
+	return apply_in_place(std::minus<double>{}, rhs);
+}
+
+Matrix& Matrix::operator*=(double rhs) {
+	for (size_t i = 0; i < height; ++i) {
+		double* row = data() + i * stride;
+		for (size_t j = 0; j < width; ++j) {
+			row[j] *= rhs;
+		}
+	}
+	return *this;
 }
 
 Matrix operator+(const Matrix& lhs, const Matrix& rhs) {
 	return lhs.apply(std::plus<double>{}, rhs);
 }
 
+Matrix operator+(Matrix&& lhs, const Matrix& rhs) {
+	return std::move(lhs).apply(std::plus<double>{}, rhs);
+}
+
+Matrix operator+(const Matrix& lhs, Matrix&& rhs) {
+	return std::move(rhs).apply(std::plus<double>{}, lhs);
+}
+
+Matrix operator+(Matrix&& lhs, Matrix&& rhs) {
+	return std::move(lhs).apply(std::plus<double>{}, rhs);
+}
+
 Matrix operator-(const Matrix& lhs, const Matrix& rhs) {
 	return lhs.apply(std::minus<double>{}, rhs);
 }
 
+Matrix operator-(Matrix&& lhs, const Matrix& rhs) {
+	return std::move(lhs).apply(std::minus<double>{}, rhs);
+}
+
+Matrix operator-(const Matrix& lhs, Matrix&& rhs) {
+	rhs.apply_in_place([](double r, double l) { return l - r; }, lhs);
+	return std::move(rhs);
+}
+
+Matrix operator-(Matrix&& lhs, Matrix&& rhs) {
+	return std::move(lhs).apply(std::minus<double>{}, rhs);
+}
+
 Matrix operator*(const Matrix& lhs, const Matrix& rhs) {
-	if (lhs.width != rhs.height) {
+	Matrix res(lhs.height, rhs.width);
+	multiply(lhs, rhs, res);
+	return res;
+}
+
+void multiply(const Matrix& lhs, const Matrix& rhs, Matrix& res) {
+	if (lhs.width != rhs.height || res.height != lhs.height || res.width != rhs.width) {
 		throw std::invalid_argument("matrix dimension mismatch in multiplication");
 	}
 	size_t len = lhs.width;
 	size_t height = lhs.height;
 	size_t width = rhs.width;
-	Matrix res(height, width);
 	for (size_t i = 0; i < height; ++i) {
 		for (size_t j = 0; j < width; ++j) {
 			res[{i, j}] = 0.0;
@@ -68,7 +133,6 @@ Matrix operator*(const Matrix& lhs, const Matrix& rhs) {
 			}
 		}
 	}
-	return res;
 }
 
 namespace {
@@ -81,22 +145,36 @@ bool zero(double x) {
 
 } // end anon
 
-// Inversion uses the basic Gauss-Jordan elimination algorithm.
 std::optional<Matrix> Matrix::inverse() const {
 	if (width != height) {
 		return std::nullopt;
 	}
+	Matrix res(height, width);
+	Matrix aug(height, 2*width);
+	if (!inverse(res, aug)) {
+		return std::nullopt;
+	}
+	return res;
+}
+
+// Inversion uses the basic Gauss-Jordan elimination algorithm.
+bool Matrix::inverse(Matrix& res, Matrix& aug) const {
+	PROFILE_SCOPE(Phase::Inverse);
+	if (width != height) {
+		return false;
+	}
 	size_t n = width;
+	if (res.height != n || res.width != n || aug.height != n || aug.width != 2*n) {
+		throw std::invalid_argument("matrix dimension mismatch in inversion");
+	}
+	Matrix& mat = aug;
 	// Fill the augmented matrix.
-	Matrix mat(n, 2*n);
 	for (size_t i = 0; i < n; ++i) {
 		for (size_t j = 0; j < n; ++j) {
 			mat[{i, j}] = (*this)[{i, j}];
+			mat[{i, n + j}] = i == j ? 1.0 : 0.0;
 		}
 	}
-	for (size_t i = 0; i < n; ++i) {
-		mat[{i, n + i}] = 1.0;
-	}
 	// Do the elimination.
 	for (size_t k = 0; k < n; ++k) {
 		size_t max = k;
@@ -106,7 +184,7 @@ std::optional<Matrix> Matrix::inverse() const {
 			}
 		}
 		if (zero(mat[{max, k}])) {
-			return std::nullopt;
+			return false;
 		}
 		if (max != k) {
 			for (size_t i = k; i < 2*n; ++i) {
@@ -130,13 +208,12 @@ std::optional<Matrix> Matrix::inverse() const {
 		}
 		mat[{k, k}] = 1.0;
 	}
-	Matrix res(n, n);
 	for (size_t i = 0; i < n; ++i) {
 		for (size_t j = 0; j < n; ++j) {
 			res[{i, j}] = mat[{i, n + j}];
 		}
 	}
-	return res;
+	return true;
 }
 
 std::string Matrix::show() const {
@@ -1,22 +1,36 @@
 #ifndef ROOTS_MATRIX_H
 #define ROOTS_MATRIX_H
 
+#include "aligned.h"
+
 #include <initializer_list>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
-// Matrix of doubles.
+// Matrix of doubles, stored by rows. Storage starts at a multiple of
+// Matrix::alignment bytes, and rows follow each other at a distance of
+// get_stride() cells, which is the width unless the matrix is padded.
 class Matrix {
 private:
 	size_t height;
 	size_t width;
-	std::vector<double> cells;
+	size_t stride;
+	AlignedVector<double> cells;
+
+	Matrix(size_t height, size_t width, size_t stride);
 
 public:
+	static constexpr size_t alignment = 64;
+
 	// Initializes a zero matrix with given dimensions.
 	Matrix(size_t height, size_t width);
+	// Initializes a zero matrix whose rows are padded to a multiple of
+	// alignment bytes, so that every row starts aligned. Padding cells are
+	// zero and ignored by all operations.
+	static Matrix padded(size_t height, size_t width);
 
 	// Initializes a matrix from the given seed.
 	// Seed is a callable with signature equivalent to:
@@ -29,21 +43,57 @@ public:
 
 	size_t get_height() const;
 	size_t get_width() const;
+	// Distance in cells between the starts of consecutive rows.
+	size_t get_stride() const;
+
+	// Cells in rows of get_stride() cells, for kernels working on the
+	// storage in place. Cell (i, j) is data()[i * get_stride() + j].
+	double* data();
+	const double* data() const;
 
 	// Matrix indexing - first argument is the row, second is the column.
 	double operator[](std::pair<size_t, size_t> idx) const;
 	double& operator[](std::pair<size_t, size_t> idx);
 
+	// Returns the matrix of op(lhs, rhs) applied to pairs of corresponding
+	// cells of this matrix and rhs. Applied to a temporary, the result
+	// reuses its storage.
+	template<typename Op>
+	Matrix apply(const Op& op, const Matrix& rhs) const&;
 	template<typename Op>
-	Matrix apply(const Op& op, const Matrix &rhs) const;
+	Matrix apply(const Op& op, const Matrix& rhs) &&;
+	// Same as apply(), storing the result in this matrix.
+	template<typename Op>
+	Matrix& apply_in_place(const Op& op, const Matrix& rhs);
+
+	Matrix& operator+=(const Matrix& rhs);
+	Matrix& operator-=(const Matrix& rhs);
+	Matrix& operator*=(double rhs);
 
+	// Sums and differences reuse the storage of a temporary operand.
 	friend Matrix operator+(const Matrix& lhs, const Matrix& rhs);
+	friend Matrix operator+(Matrix&& lhs, const Matrix& rhs);
+	friend Matrix operator+(const Matrix& lhs, Matrix&& rhs);
+	friend Matrix operator+(Matrix&& lhs, Matrix&& rhs);
 	friend Matrix operator-(const Matrix& lhs, const Matrix& rhs);
+	friend Matrix operator-(Matrix&& lhs, const Matrix& rhs);
+	friend Matrix operator-(const Matrix& lhs, Matrix&& rhs);
+	friend Matrix operator-(Matrix&& lhs, Matrix&& rhs);
 	friend Matrix operator*(const Matrix& lhs, const Matrix& rhs);
 
+	// Multiplies lhs by rhs, storing the result in res. The result matrix must
+	// already have matching dimensions and can't alias any of the operands.
+	friend void multiply(const Matrix& lhs, const Matrix& rhs, Matrix& res);
+
 	// Inverts the matrix. If matrix is not invertible, returns nothing.
 	std::optional<Matrix> inverse() const;
 
+	// Inverts the matrix without allocating. The result is stored in res,
+	// which must be an n x n matrix, while aug is used as scratch space for
+	// the augmented matrix and must be n x 2n.
+	// Returns false if the matrix is not invertible.
+	bool inverse(Matrix& res, Matrix& aug) const;
+
 	// Returns the string representation of the matrix.
 	std::string show() const;
 };
@@ -58,17 +108,31 @@ Matrix::Matrix(size_t height, size_t width, const Seed& seed) : Matrix(height, w
 }
 
 template<typename Op>
-Matrix Matrix::apply(const Op& op, const Matrix& rhs) const {
+Matrix Matrix::apply(const Op& op, const Matrix& rhs) const& {
+	Matrix res = *this;
+	res.apply_in_place(op, rhs);
+	return res;
+}
+
+template<typename Op>
+Matrix Matrix::apply(const Op& op, const Matrix& rhs) && {
+	apply_in_place(op, rhs);
+	return std::move(*this);
+}
+
+template<typename Op>
+Matrix& Matrix::apply_in_place(const Op& op, const Matrix& rhs) {
 	if (width != rhs.width || height != rhs.height) {
 		throw std::invalid_argument("matrix dimension mismatch in binary operation");
 	}
-	Matrix res(height, width);
 	for (size_t i = 0; i < height; ++i) {
+		double* row = data() + i * stride;
+		const double* rhs_row = rhs.data() + i * rhs.stride;
 		for (size_t j = 0; j < width; ++j) {
-			res[{i, j}] = op((*this)[{i, j}], rhs[{i, j}]);
+			row[j] = op(row[j], rhs_row[j]);
 		}
 	}
-	return res;
+	return *this;
 }
 
 #endif // ROOTS_MATRIX_H
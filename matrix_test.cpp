@@ -2,6 +2,9 @@
 
 #include "gtest/gtest.h"
 
+#include <cstdint>
+#include <utility>
+
 void expect_matrix_eq(const Matrix& actual, const Matrix& expected) {
 	ASSERT_EQ(actual.get_height(), expected.get_height()) << "matrix height";
 	ASSERT_EQ(actual.get_width(), expected.get_width()) << "matrix width";
@@ -68,6 +71,91 @@ TEST(MatrixTest, Sub) {
 	expect_matrix_eq(actual, expected);
 }
 
+TEST(MatrixTest, Temporaries) {
+	Matrix lhs = {
+		{0.6, 0.3},
+		{0.2, 0.7},
+	};
+	Matrix rhs = {
+		{1.3, 0.1},
+		{-1.5, 0.6},
+	};
+	Matrix sum = {
+		{1.9, 0.4},
+		{-1.3, 1.3},
+	};
+	Matrix diff = {
+		{-0.7, 0.2},
+		{1.7, 0.1},
+	};
+	// Results take over the storage of temporary operands.
+	Matrix tmp = lhs;
+	const double* storage = tmp.data();
+	Matrix actual = std::move(tmp) + rhs;
+	EXPECT_EQ(actual.data(), storage);
+	expect_matrix_eq(actual, sum);
+	tmp = rhs;
+	storage = tmp.data();
+	actual = lhs + std::move(tmp);
+	EXPECT_EQ(actual.data(), storage);
+	expect_matrix_eq(actual, sum);
+	tmp = lhs;
+	storage = tmp.data();
+	actual = std::move(tmp) - rhs;
+	EXPECT_EQ(actual.data(), storage);
+	expect_matrix_eq(actual, diff);
+	tmp = rhs;
+	storage = tmp.data();
+	actual = lhs - std::move(tmp);
+	EXPECT_EQ(actual.data(), storage);
+	expect_matrix_eq(actual, diff);
+	expect_matrix_eq(Matrix(lhs) - Matrix(rhs), diff);
+	expect_matrix_near(lhs - rhs + rhs - lhs, Matrix(2, 2), 1e-15);
+
+	actual = lhs;
+	actual += rhs;
+	expect_matrix_eq(actual, sum);
+	actual -= rhs;
+	actual -= rhs;
+	actual *= -2.0;
+	expect_matrix_near(actual, diff * Matrix{{-2.0, 0.0}, {0.0, -2.0}}, 1e-15);
+	EXPECT_THROW(actual += Matrix(2, 3), std::invalid_argument);
+	EXPECT_THROW(Matrix(3, 2) - std::move(actual), std::invalid_argument);
+}
+
+TEST(MatrixTest, Padded) {
+	Matrix mat = Matrix::padded(3, 5);
+	EXPECT_EQ(mat.get_height(), 3u);
+	EXPECT_EQ(mat.get_width(), 5u);
+	EXPECT_EQ(mat.get_stride(), 8u);
+	for (size_t i = 0; i < 3; ++i) {
+		const double* row = mat.data() + i * mat.get_stride();
+		EXPECT_EQ(reinterpret_cast<uintptr_t>(row) % Matrix::alignment, 0u);
+	}
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(Matrix(3, 5).data()) % Matrix::alignment, 0u);
+	EXPECT_EQ(Matrix(3, 5).get_stride(), 5u);
+	EXPECT_EQ(Matrix::padded(2, 16).get_stride(), 16u);
+
+	Matrix dense(3, 5, [](size_t i, size_t j) { return 1.0 + i * 5 + j; });
+	for (size_t i = 0; i < 3; ++i) {
+		for (size_t j = 0; j < 5; ++j) {
+			mat[{i, j}] = dense[{i, j}];
+		}
+	}
+	EXPECT_DOUBLE_EQ(mat.data()[2 * 8 + 4], 15.0);
+	// Operations mixing layouts keep the layout of their first operand.
+	Matrix twice = mat + dense;
+	EXPECT_EQ(twice.get_stride(), 8u);
+	expect_matrix_eq(twice, dense.apply([](double x, double) { return 2.0 * x; }, dense));
+	expect_matrix_eq(dense - mat, Matrix(3, 5));
+	Matrix square(5, 5, [](size_t i, size_t j) { return i == j ? 2.0 : 0.0; });
+	expect_matrix_eq(mat * square, twice);
+	// Padding stays untouched.
+	twice *= 3.0;
+	EXPECT_EQ(twice.data()[5], 0.0);
+	EXPECT_EQ(mat.show(), dense.show());
+}
+
 TEST(MatrixTest, Mul) {
 	Matrix lhs = {
 		{0.6, 0.3, 0.1},
@@ -0,0 +1,490 @@
+#ifndef ROOTS_NUM_H
+#define ROOTS_NUM_H
+
+// Number types used for evaluation of expressions. Operations report domain
+// errors by throwing MathError, or to the active FaultTrap if there's one.
+
+#include "common.h"
+#include "profile.h"
+
+#include <cfenv>
+#include <cmath>
+#include <string>
+
+// Collects failures of evaluations on the current thread for its lifetime.
+// While a trap is active, domain errors and undefined variables are recorded
+// in it instead of being thrown as MathError, and the failed operations
+// return NaN or infinity, so that callers expecting failures don't pay for
+// unwinding. Traps can be nested, the innermost one being active.
+class FaultTrap {
+public:
+	enum class Fault {
+		None,
+		DomainError,
+		UndefinedVariable,
+	};
+
+private:
+	static inline thread_local FaultTrap* current = nullptr;
+	FaultTrap* prev;
+	Fault fault = Fault::None;
+	const std::string* var = nullptr;
+
+public:
+	FaultTrap() noexcept : prev(current) { current = this; }
+	~FaultTrap() { current = prev; }
+
+	FaultTrap(const FaultTrap&) = delete;
+	FaultTrap& operator=(const FaultTrap&) = delete;
+
+	// Returns the trap active on the current thread, if any.
+	static FaultTrap* active() noexcept { return current; }
+
+	// Records a failure unless one is already recorded. The variable must
+	// outlive the trap.
+	void domain_error() noexcept {
+		if (fault == Fault::None) {
+			fault = Fault::DomainError;
+		}
+	}
+	void undefined_variable(const std::string& name) noexcept {
+		if (fault == Fault::None) {
+			fault = Fault::UndefinedVariable;
+			var = &name;
+		}
+	}
+
+	// First recorded failure, with the name of the variable for undefined
+	// variables.
+	bool raised() const noexcept { return fault != Fault::None; }
+	Fault get_fault() const noexcept { return fault; }
+	const std::string* get_var() const noexcept { return var; }
+};
+
+// Reports a domain error to the active trap, or throws MathError if there's
+// none.
+inline void domain_error() {
+	if (auto trap = FaultTrap::active()) {
+		trap->domain_error();
+		return;
+	}
+	throw MathError("domain error");
+}
+
+template<typename Fun>
+double checked(Fun fun) {
+	PROFILE_COUNT(fenv_checks);
+	std::feclearexcept(FE_ALL_EXCEPT);
+	double y = fun();
+	if (std::fetestexcept(FE_DIVBYZERO | FE_INVALID)) {
+		domain_error();
+	}
+	return y;
+}
+
+inline double ediv(double x, double y) {
+	return checked([=]() { return x / y; });
+}
+
+// Computes powers with small integer exponents using multiplications and
+// powers of positive numbers with exponent 1/2 using a square root. Such
+// powers never raise domain errors, so they don't need to be checked.
+// Returns false for other arguments.
+inline bool reduced_pow(double x, double y, double& out) {
+	if (y == 2.0) {
+		out = x * x;
+	}
+	else if (y == 3.0) {
+		out = x * x * x;
+	}
+	else if (y == 1.0) {
+		out = x;
+	}
+	else if (y == 0.0) {
+		out = 1.0;
+	}
+	else if (y == 4.0) {
+		double sq = x * x;
+		out = sq * sq;
+	}
+	else if (y == -1.0 && x != 0.0) {
+		out = 1.0 / x;
+	}
+	else if (y == 0.5 && x > 0.0) {
+		out = std::sqrt(x);
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+inline double epow(double x, double y) {
+	double out;
+	if (reduced_pow(x, y, out)) {
+		return out;
+	}
+	return checked([=]() { return std::pow(x ,y); });
+}
+
+inline double elog(double x) {
+	return checked([=]() { return std::log(x); });
+}
+
+inline double esqrt(double x) {
+	return checked([=]() { return std::sqrt(x); });
+}
+
+// Computes sine and cosine of the same argument, which compilers merge into
+// a single sincos call.
+inline void sin_cos(double x, double& s, double& c) {
+	s = std::sin(x);
+	c = std::cos(x);
+}
+
+struct Float {
+	double val;
+
+	Float();
+	Float(double val);
+
+	Float pow(Float y) const;
+
+	Float sin() const;
+	Float cos() const;
+	Float ln() const;
+	Float exp() const;
+	Float sqrt() const;
+};
+
+inline Float::Float() : val(0) {}
+inline Float::Float(double val) : val(val) {}
+
+inline Float operator+(Float x, Float y) { return Float(x.val + y.val); }
+inline Float operator-(Float x, Float y) { return Float(x.val - y.val); }
+inline Float operator*(Float x, Float y) { return Float(x.val * y.val); }
+inline Float operator/(Float x, Float y) { return Float(ediv(x.val, y.val)); }
+inline Float Float::pow(Float y) const { return Float(epow(val, y.val)); }
+
+inline Float operator-(Float x) { return Float(-x.val); }
+inline Float Float::sin() const { return Float(std::sin(val)); }
+inline Float Float::cos() const { return Float(std::cos(val)); }
+inline Float Float::ln() const { return Float(elog(val)); }
+inline Float Float::exp() const { return Float(std::exp(val)); }
+inline Float Float::sqrt() const { return Float(esqrt(val)); }
+
+// Dual number for forward mode automatic differentiation.
+// It contains a value (val), its derivative (deriv) and a boolean flag (cons)
+// indicating whether the number is a constant or not.
+struct Dual {
+	double val;
+	double deriv;
+	bool cons;
+
+	Dual();
+	Dual(double val);
+	Dual(double val, double deriv, bool cons);
+
+	Dual pow(Dual y) const;
+
+	Dual sin() const;
+	Dual cos() const;
+	Dual ln() const;
+	Dual exp() const;
+	Dual sqrt() const;
+};
+
+inline Dual::Dual() : Dual(0.0, 0.0, true) {}
+inline Dual::Dual(double val) : Dual(val, 0.0, true) {}
+inline Dual::Dual(double val, double deriv, bool cons) : val(val), deriv(deriv), cons(cons) {}
+
+inline Dual operator+(Dual x, Dual y) {
+	return Dual(x.val + y.val, x.deriv + y.deriv, x.cons && y.cons);
+}
+
+inline Dual operator-(Dual x, Dual y) {
+	return Dual(x.val - y.val, x.deriv - y.deriv, x.cons && y.cons);
+}
+
+inline Dual operator*(Dual x, Dual y) {
+	return Dual(x.val * y.val,
+			(x.deriv * y.val) + (x.val * y.deriv),
+			x.cons && y.cons);
+}
+
+inline Dual operator/(Dual x, Dual y) {
+	return Dual(ediv(x.val, y.val),
+			ediv((x.deriv * y.val) - (x.val * y.deriv), y.val * y.val),
+			x.cons && y.cons);
+}
+
+inline Dual Dual::pow(Dual y) const {
+	auto x = *this;
+	double out;
+	double val = epow(x.val, y.val);
+	if (y.cons) {
+		// For constant exponents we use the basic (x^k)' = k * x^(k-1) formula
+		// with an exception for k = 1.
+		if (y.val == 1.0) {
+			out = x.deriv;
+		}
+		else {
+			out = y.val * epow(x.val, y.val - 1.0) * x.deriv;
+		}
+	}
+	else {
+		// For functional exponents we use the generalized power rule.
+		out = val * (y.deriv * elog(x.val) + ediv(x.deriv * y.val, x.val));
+	}
+	return Dual(val, out, x.cons && y.cons);
+}
+
+inline Dual operator-(Dual x) {
+	return Dual(-x.val, -x.deriv, x.cons);
+}
+
+inline Dual Dual::sin() const {
+	double s, c;
+	sin_cos(val, s, c);
+	return Dual(s, c * deriv, cons);
+}
+
+inline Dual Dual::cos() const {
+	double s, c;
+	sin_cos(val, s, c);
+	return Dual(c, -s * deriv, cons);
+}
+
+inline Dual Dual::ln() const {
+	return Dual(elog(val), ediv(deriv, val), cons);
+}
+
+inline Dual Dual::exp() const {
+	double y = std::exp(val);
+	return Dual(y, y * deriv, cons);
+}
+
+inline Dual Dual::sqrt() const {
+	return Dual(esqrt(val), ediv(deriv, 2 * esqrt(val)), cons);
+}
+
+// Second order jet: value with its first (d1) and second (d2) derivative,
+// equivalent to a dual number whose components are dual numbers. Value and
+// first derivative are computed exactly as in Dual, including domain checks.
+// Second derivatives aren't checked, instead they may end up infinite or NaN.
+struct Jet {
+	double val;
+	double d1;
+	double d2;
+	bool cons;
+
+	Jet();
+	Jet(double val);
+	Jet(double val, double d1, double d2, bool cons);
+
+	Jet pow(Jet y) const;
+
+	Jet sin() const;
+	Jet cos() const;
+	Jet ln() const;
+	Jet exp() const;
+	Jet sqrt() const;
+};
+
+inline Jet::Jet() : Jet(0.0, 0.0, 0.0, true) {}
+inline Jet::Jet(double val) : Jet(val, 0.0, 0.0, true) {}
+inline Jet::Jet(double val, double d1, double d2, bool cons) :
+	val(val), d1(d1), d2(d2), cons(cons) {}
+
+inline Jet operator+(Jet x, Jet y) {
+	return Jet(x.val + y.val, x.d1 + y.d1, x.d2 + y.d2, x.cons && y.cons);
+}
+
+inline Jet operator-(Jet x, Jet y) {
+	return Jet(x.val - y.val, x.d1 - y.d1, x.d2 - y.d2, x.cons && y.cons);
+}
+
+inline Jet operator*(Jet x, Jet y) {
+	return Jet(x.val * y.val,
+			(x.d1 * y.val) + (x.val * y.d1),
+			(x.d2 * y.val) + 2 * (x.d1 * y.d1) + (x.val * y.d2),
+			x.cons && y.cons);
+}
+
+inline Jet operator/(Jet x, Jet y) {
+	double q = ediv(x.val, y.val);
+	double q1 = ediv((x.d1 * y.val) - (x.val * y.d1), y.val * y.val);
+	double q2 = (x.d2 - 2 * q1 * y.d1 - q * y.d2) / y.val;
+	return Jet(q, q1, q2, x.cons && y.cons);
+}
+
+// Applies a function with derivatives f1 and f2 at x.val, using the chain rule.
+inline Jet chain(Jet x, double f, double f1, double f2) {
+	return Jet(f, f1 * x.d1, f2 * x.d1 * x.d1 + f1 * x.d2, x.cons);
+}
+
+inline Jet Jet::pow(Jet y) const {
+	auto x = *this;
+	if (y.cons) {
+		if (y.val == 1.0) {
+			return Jet(epow(x.val, y.val), x.d1, x.d2, x.cons && y.cons);
+		}
+		double f1 = y.val * epow(x.val, y.val - 1.0);
+		double f2 = y.val == 2.0 ? 2.0 : y.val * (y.val - 1.0) * std::pow(x.val, y.val - 2.0);
+		auto out = chain(x, epow(x.val, y.val), f1, f2);
+		out.cons = x.cons && y.cons;
+		return out;
+	}
+	// For functional exponents x^y = exp(y * ln(x)).
+	auto out = (y * x.ln()).exp();
+	out.val = epow(x.val, y.val);
+	out.d1 = out.val *
+		(y.d1 * elog(x.val) + ediv(x.d1 * y.val, x.val));
+	return out;
+}
+
+inline Jet operator-(Jet x) {
+	return Jet(-x.val, -x.d1, -x.d2, x.cons);
+}
+
+inline Jet Jet::sin() const {
+	double s, c;
+	sin_cos(val, s, c);
+	return chain(*this, s, c, -s);
+}
+
+inline Jet Jet::cos() const {
+	double s, c;
+	sin_cos(val, s, c);
+	return chain(*this, c, -s, -c);
+}
+
+inline Jet Jet::ln() const {
+	auto out = chain(*this, elog(val), 1.0 / val, -1.0 / (val * val));
+	out.d1 = ediv(d1, val);
+	return out;
+}
+
+inline Jet Jet::exp() const {
+	double y = std::exp(val);
+	return chain(*this, y, y, y);
+}
+
+inline Jet Jet::sqrt() const {
+	double y = esqrt(val);
+	auto out = chain(*this, y, 1.0 / (2 * y), -1.0 / (4 * y * y * y));
+	out.d1 = ediv(d1, 2 * esqrt(val));
+	return out;
+}
+
+// Hyper-dual number val + e1*E1 + e2*E2 + e12*E1*E2, where E1^2 = E2^2 = 0.
+// Seeding variables with the E1 and E2 components of two directions gives
+// the derivatives along both directions in e1 and e2 and the mixed second
+// derivative in e12, free of truncation errors. The cons flag is set if the
+// number doesn't depend on seeded variables. Values are checked for domain
+// errors as in Float, derivatives aren't and may end up infinite or NaN.
+struct HyperDual {
+	double val;
+	double e1;
+	double e2;
+	double e12;
+	bool cons;
+
+	HyperDual();
+	HyperDual(double val);
+	HyperDual(double val, double e1, double e2, double e12, bool cons);
+
+	HyperDual pow(HyperDual y) const;
+
+	HyperDual sin() const;
+	HyperDual cos() const;
+	HyperDual ln() const;
+	HyperDual exp() const;
+	HyperDual sqrt() const;
+};
+
+inline HyperDual::HyperDual() : HyperDual(0.0) {}
+inline HyperDual::HyperDual(double val) : HyperDual(val, 0.0, 0.0, 0.0, true) {}
+inline HyperDual::HyperDual(double val, double e1, double e2, double e12, bool cons) :
+	val(val), e1(e1), e2(e2), e12(e12), cons(cons) {}
+
+inline HyperDual operator+(HyperDual x, HyperDual y) {
+	return HyperDual(x.val + y.val, x.e1 + y.e1, x.e2 + y.e2, x.e12 + y.e12,
+			x.cons && y.cons);
+}
+
+inline HyperDual operator-(HyperDual x, HyperDual y) {
+	return HyperDual(x.val - y.val, x.e1 - y.e1, x.e2 - y.e2, x.e12 - y.e12,
+			x.cons && y.cons);
+}
+
+inline HyperDual operator*(HyperDual x, HyperDual y) {
+	return HyperDual(x.val * y.val,
+			x.e1 * y.val + x.val * y.e1,
+			x.e2 * y.val + x.val * y.e2,
+			x.e12 * y.val + x.e1 * y.e2 + x.e2 * y.e1 + x.val * y.e12,
+			x.cons && y.cons);
+}
+
+inline HyperDual operator/(HyperDual x, HyperDual y) {
+	double q = ediv(x.val, y.val);
+	double q1 = (x.e1 - q * y.e1) / y.val;
+	double q2 = (x.e2 - q * y.e2) / y.val;
+	double q12 = (x.e12 - q1 * y.e2 - q2 * y.e1 - q * y.e12) / y.val;
+	return HyperDual(q, q1, q2, q12, x.cons && y.cons);
+}
+
+// Applies a function with derivatives f1 and f2 at x.val, using the chain rule.
+inline HyperDual chain(HyperDual x, double f, double f1, double f2) {
+	return HyperDual(f, f1 * x.e1, f1 * x.e2, f2 * x.e1 * x.e2 + f1 * x.e12, x.cons);
+}
+
+inline HyperDual HyperDual::pow(HyperDual y) const {
+	auto x = *this;
+	if (y.cons) {
+		if (y.val == 1.0) {
+			return HyperDual(epow(x.val, y.val), x.e1, x.e2, x.e12, x.cons);
+		}
+		double f1 = y.val * std::pow(x.val, y.val - 1.0);
+		double f2 = y.val == 2.0 ? 2.0 : y.val * (y.val - 1.0) * std::pow(x.val, y.val - 2.0);
+		auto out = chain(x, epow(x.val, y.val), f1, f2);
+		out.cons = x.cons && y.cons;
+		return out;
+	}
+	// For functional exponents x^y = exp(y * ln(x)).
+	auto out = (y * x.ln()).exp();
+	out.val = epow(x.val, y.val);
+	return out;
+}
+
+inline HyperDual operator-(HyperDual x) {
+	return HyperDual(-x.val, -x.e1, -x.e2, -x.e12, x.cons);
+}
+
+inline HyperDual HyperDual::sin() const {
+	double s, c;
+	sin_cos(val, s, c);
+	return chain(*this, s, c, -s);
+}
+
+inline HyperDual HyperDual::cos() const {
+	double s, c;
+	sin_cos(val, s, c);
+	return chain(*this, c, -s, -c);
+}
+
+inline HyperDual HyperDual::ln() const {
+	return chain(*this, elog(val), 1.0 / val, -1.0 / (val * val));
+}
+
+inline HyperDual HyperDual::exp() const {
+	double y = std::exp(val);
+	return chain(*this, y, y, y);
+}
+
+inline HyperDual HyperDual::sqrt() const {
+	double y = esqrt(val);
+	return chain(*this, y, 1.0 / (2 * y), -1.0 / (4 * y * y * y));
+}
+
+#endif // ROOTS_NUM_H
@@ -0,0 +1,611 @@
+#include "poly.h"
+
+#include "common.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+
+namespace {
+
+using Coeffs = std::vector<double>;
+
+void trim(Coeffs& c) {
+	while (!c.empty() && c.back() == 0.0) {
+		c.pop_back();
+	}
+}
+
+Coeffs add(const Coeffs& x, const Coeffs& y, double sign) {
+	Coeffs res(std::max(x.size(), y.size()), 0.0);
+	for (size_t i = 0; i < x.size(); ++i) {
+		res[i] += x[i];
+	}
+	for (size_t i = 0; i < y.size(); ++i) {
+		res[i] += sign * y[i];
+	}
+	trim(res);
+	return res;
+}
+
+Coeffs mul(const Coeffs& x, const Coeffs& y) {
+	if (x.empty() || y.empty()) {
+		return {};
+	}
+	Coeffs res(x.size() + y.size() - 1, 0.0);
+	for (size_t i = 0; i < x.size(); ++i) {
+		for (size_t j = 0; j < y.size(); ++j) {
+			res[i + j] += x[i] * y[j];
+		}
+	}
+	trim(res);
+	return res;
+}
+
+double constant(const Coeffs& c) {
+	return c.empty() ? 0.0 : c[0];
+}
+
+// Evaluates an operation on constants through Expr, so that domain errors are
+// detected exactly as in normal evaluation.
+std::optional<Coeffs> fold(const Expr& expr) {
+	auto val = expr.try_eval(Expr::Env());
+	if (val.status != Expr::EvalStatus::Ok) {
+		return std::nullopt;
+	}
+	Coeffs res = {val.val};
+	trim(res);
+	return res;
+}
+
+std::optional<Coeffs> to_coeffs(const Expr& expr, std::string& var) {
+	return std::visit(overloaded {
+		[](const Expr::Const& c) -> std::optional<Coeffs> {
+			Coeffs res = {c.val};
+			trim(res);
+			return res;
+		},
+		[&](const Expr::Var& v) -> std::optional<Coeffs> {
+			if (var.empty()) {
+				var = *v.name;
+			}
+			else if (var != *v.name) {
+				return std::nullopt;
+			}
+			return Coeffs{0.0, 1.0};
+		},
+		[&](const Expr::Binary& bin) -> std::optional<Coeffs> {
+			auto lhs = to_coeffs(*bin.lhs, var);
+			auto rhs = lhs ? to_coeffs(*bin.rhs, var) : std::nullopt;
+			if (!lhs || !rhs) {
+				return std::nullopt;
+			}
+			bool const_rhs = rhs->size() <= 1;
+			switch (bin.type) {
+			case Expr::BinaryOp::Add:
+				return add(*lhs, *rhs, 1.0);
+			case Expr::BinaryOp::Sub:
+				return add(*lhs, *rhs, -1.0);
+			case Expr::BinaryOp::Mul:
+				if (lhs->size() + rhs->size() > Polynomial::max_degree + 2) {
+					return std::nullopt;
+				}
+				return mul(*lhs, *rhs);
+			case Expr::BinaryOp::Div:
+				if (!const_rhs) {
+					return std::nullopt;
+				}
+				if (lhs->size() <= 1) {
+					return fold(Expr(constant(*lhs)) / Expr(constant(*rhs)));
+				}
+				if (rhs->empty()) {
+					return std::nullopt;
+				}
+				for (auto& c : *lhs) {
+					c /= (*rhs)[0];
+				}
+				return lhs;
+			case Expr::BinaryOp::Pow: {
+				if (!const_rhs) {
+					return std::nullopt;
+				}
+				double n = constant(*rhs);
+				if (lhs->size() <= 1) {
+					return fold(Expr(constant(*lhs)).pow(Expr(n)));
+				}
+				if (n < 0 || n != std::trunc(n) ||
+						(lhs->size() - 1) * n > Polynomial::max_degree) {
+					return std::nullopt;
+				}
+				Coeffs res = {1.0};
+				for (double i = 0; i < n; ++i) {
+					res = mul(res, *lhs);
+				}
+				return res;
+			}
+			}
+			return std::nullopt;
+		},
+		[&](const Expr::Unary& un) -> std::optional<Coeffs> {
+			auto arg = to_coeffs(*un.arg, var);
+			if (!arg) {
+				return std::nullopt;
+			}
+			if (un.type == Expr::UnaryOp::Neg) {
+				for (auto& c : *arg) {
+					c = -c;
+				}
+				return arg;
+			}
+			if (arg->size() > 1) {
+				return std::nullopt;
+			}
+			return fold(Expr(Expr::Unary(un.type, Expr(constant(*arg)))));
+		},
+	}, expr.value);
+}
+
+// Terms of a polynomial in several variables by their exponents.
+using Terms = std::map<std::vector<uint32_t>, double>;
+
+void trim(Terms& t) {
+	for (auto it = t.begin(); it != t.end();) {
+		it = it->second == 0.0 ? t.erase(it) : std::next(it);
+	}
+}
+
+size_t degree(const std::vector<uint32_t>& exps) {
+	size_t res = 0;
+	for (auto e : exps) {
+		res += e;
+	}
+	return res;
+}
+
+size_t degree(const Terms& t) {
+	size_t res = 0;
+	for (const auto& term : t) {
+		res = std::max(res, degree(term.first));
+	}
+	return res;
+}
+
+// Returns the value of a polynomial without variables.
+std::optional<double> constant(const Terms& t) {
+	if (t.empty()) {
+		return 0.0;
+	}
+	if (t.size() == 1 && degree(t.begin()->first) == 0) {
+		return t.begin()->second;
+	}
+	return std::nullopt;
+}
+
+Terms add(const Terms& x, const Terms& y, double sign) {
+	Terms res = x;
+	for (const auto& term : y) {
+		res[term.first] += sign * term.second;
+	}
+	trim(res);
+	return res;
+}
+
+Terms mul(const Terms& x, const Terms& y) {
+	Terms res;
+	for (const auto& a : x) {
+		for (const auto& b : y) {
+			auto exps = a.first;
+			for (size_t i = 0; i < exps.size(); ++i) {
+				exps[i] += b.first[i];
+			}
+			res[exps] += a.second * b.second;
+		}
+	}
+	trim(res);
+	return res;
+}
+
+std::optional<Terms> fold(const Expr& expr, size_t vars) {
+	auto c = fold(expr);
+	if (!c) {
+		return std::nullopt;
+	}
+	Terms res;
+	if (!c->empty()) {
+		res[std::vector<uint32_t>(vars, 0)] = (*c)[0];
+	}
+	return res;
+}
+
+std::optional<Terms> to_terms(const Expr& expr, const std::vector<std::string>& vars) {
+	size_t n = vars.size();
+	return std::visit(overloaded {
+		[&](const Expr::Const& c) -> std::optional<Terms> {
+			Terms res = {{std::vector<uint32_t>(n, 0), c.val}};
+			trim(res);
+			return res;
+		},
+		[&](const Expr::Var& v) -> std::optional<Terms> {
+			auto it = std::find(vars.begin(), vars.end(), *v.name);
+			if (it == vars.end()) {
+				return std::nullopt;
+			}
+			std::vector<uint32_t> exps(n, 0);
+			exps[it - vars.begin()] = 1;
+			return Terms{{exps, 1.0}};
+		},
+		[&](const Expr::Binary& bin) -> std::optional<Terms> {
+			auto lhs = to_terms(*bin.lhs, vars);
+			auto rhs = lhs ? to_terms(*bin.rhs, vars) : std::nullopt;
+			if (!lhs || !rhs) {
+				return std::nullopt;
+			}
+			auto lhs_const = constant(*lhs);
+			auto rhs_const = constant(*rhs);
+			switch (bin.type) {
+			case Expr::BinaryOp::Add:
+				return add(*lhs, *rhs, 1.0);
+			case Expr::BinaryOp::Sub:
+				return add(*lhs, *rhs, -1.0);
+			case Expr::BinaryOp::Mul:
+				if (degree(*lhs) + degree(*rhs) > Polynomial::max_degree) {
+					return std::nullopt;
+				}
+				return mul(*lhs, *rhs);
+			case Expr::BinaryOp::Div:
+				if (!rhs_const) {
+					return std::nullopt;
+				}
+				if (lhs_const) {
+					return fold(Expr(*lhs_const) / Expr(*rhs_const), n);
+				}
+				if (*rhs_const == 0.0) {
+					return std::nullopt;
+				}
+				for (auto& term : *lhs) {
+					term.second /= *rhs_const;
+				}
+				return lhs;
+			case Expr::BinaryOp::Pow: {
+				if (!rhs_const) {
+					return std::nullopt;
+				}
+				double e = *rhs_const;
+				if (lhs_const) {
+					return fold(Expr(*lhs_const).pow(Expr(e)), n);
+				}
+				if (e < 0 || e != std::trunc(e) || degree(*lhs) * e > Polynomial::max_degree) {
+					return std::nullopt;
+				}
+				Terms res = {{std::vector<uint32_t>(n, 0), 1.0}};
+				for (double i = 0; i < e; ++i) {
+					res = mul(res, *lhs);
+				}
+				return res;
+			}
+			}
+			return std::nullopt;
+		},
+		[&](const Expr::Unary& un) -> std::optional<Terms> {
+			auto arg = to_terms(*un.arg, vars);
+			if (!arg) {
+				return std::nullopt;
+			}
+			if (un.type == Expr::UnaryOp::Neg) {
+				for (auto& term : *arg) {
+					term.second = -term.second;
+				}
+				return arg;
+			}
+			auto arg_const = constant(*arg);
+			if (!arg_const) {
+				return std::nullopt;
+			}
+			return fold(Expr(Expr::Unary(un.type, Expr(*arg_const))), n);
+		},
+	}, expr.value);
+}
+
+struct ComplexEval {
+	std::complex<double> val;
+	std::complex<double> deriv;
+	// Bound of the rounding error of val, up to a constant factor.
+	double error;
+};
+
+// Complex evaluation of the polynomial and its derivative.
+ComplexEval eval_complex(const Coeffs& c, std::complex<double> z) {
+	std::complex<double> p = c.back();
+	std::complex<double> d = 0.0;
+	double abs_z = std::abs(z);
+	double e = std::abs(c.back());
+	for (size_t i = c.size() - 1; i-- > 0;) {
+		d = d * z + p;
+		p = p * z + c[i];
+		e = e * abs_z + std::abs(c[i]);
+	}
+	return {p, d, e * std::numeric_limits<double>::epsilon()};
+}
+
+bool has_var(const Expr& expr) {
+	return std::visit(overloaded {
+		[](const Expr::Const&) { return false; },
+		[](const Expr::Var&) { return true; },
+		[](const Expr::Binary& bin) { return has_var(*bin.lhs) || has_var(*bin.rhs); },
+		[](const Expr::Unary& un) { return has_var(*un.arg); },
+	}, expr.value);
+}
+
+// Checks if the expression is a product of constant subexpressions and powers
+// of variables, which converts to coefficients without multiplying out sums.
+bool is_monomial(const Expr& expr) {
+	if (!has_var(expr)) {
+		return true;
+	}
+	return std::visit(overloaded {
+		[](const Expr::Const&) { return true; },
+		[](const Expr::Var&) { return true; },
+		[](const Expr::Binary& bin) {
+			switch (bin.type) {
+			case Expr::BinaryOp::Mul:
+				return is_monomial(*bin.lhs) && is_monomial(*bin.rhs);
+			case Expr::BinaryOp::Div:
+			case Expr::BinaryOp::Pow:
+				return is_monomial(*bin.lhs) && !has_var(*bin.rhs);
+			default:
+				return false;
+			}
+		},
+		[](const Expr::Unary& un) {
+			return un.type == Expr::UnaryOp::Neg && is_monomial(*un.arg);
+		},
+	}, expr.value);
+}
+
+} // end anon
+
+bool Polynomial::is_expanded(const Expr& expr) {
+	return std::visit(overloaded {
+		[&](const Expr::Binary& bin) {
+			if (bin.type == Expr::BinaryOp::Add || bin.type == Expr::BinaryOp::Sub) {
+				return is_expanded(*bin.lhs) && is_expanded(*bin.rhs);
+			}
+			return is_monomial(expr);
+		},
+		[&](const Expr::Unary& un) {
+			if (un.type == Expr::UnaryOp::Neg) {
+				return is_expanded(*un.arg);
+			}
+			return is_monomial(expr);
+		},
+		[&](const auto&) {
+			return true;
+		},
+	}, expr.value);
+}
+
+Polynomial::Polynomial(std::string var, std::vector<double> coeffs) :
+	var(std::move(var)),
+	coeffs(std::move(coeffs))
+{
+	trim(this->coeffs);
+}
+
+std::optional<Polynomial> Polynomial::from_expr(const Expr& expr) {
+	std::string var;
+	auto coeffs = to_coeffs(expr, var);
+	if (!coeffs || var.empty()) {
+		return std::nullopt;
+	}
+	return Polynomial(std::move(var), std::move(*coeffs));
+}
+
+const std::string& Polynomial::get_var() const {
+	return var;
+}
+
+const std::vector<double>& Polynomial::get_coeffs() const {
+	return coeffs;
+}
+
+size_t Polynomial::degree() const {
+	return coeffs.empty() ? 0 : coeffs.size() - 1;
+}
+
+double Polynomial::eval(double x) const {
+	double p = 0.0;
+	for (size_t i = coeffs.size(); i-- > 0;) {
+		p = p * x + coeffs[i];
+	}
+	return p;
+}
+
+std::pair<double, double> Polynomial::eval_diff(double x) const {
+	if (coeffs.empty()) {
+		return {0.0, 0.0};
+	}
+	double p = coeffs.back();
+	double d = 0.0;
+	for (size_t i = coeffs.size() - 1; i-- > 0;) {
+		d = d * x + p;
+		p = p * x + coeffs[i];
+	}
+	return {p, d};
+}
+
+Expr::Derivs Polynomial::eval_derivs(double x) const {
+	if (coeffs.empty()) {
+		return {0.0, 0.0, 0.0};
+	}
+	double p = coeffs.back();
+	double d = 0.0;
+	double dd = 0.0;
+	for (size_t i = coeffs.size() - 1; i-- > 0;) {
+		dd = dd * x + d;
+		d = d * x + p;
+		p = p * x + coeffs[i];
+	}
+	return {p, d, 2 * dd};
+}
+
+// Aberth-Ehrlich iteration refines all roots simultaneously: every
+// approximation takes a Newton step corrected by the repulsion from the other
+// approximations, which converges cubically for simple roots. Starting points
+// are spread on a circle which encloses all roots.
+std::vector<std::complex<double>> Polynomial::roots() const {
+	using Complex = std::complex<double>;
+	if (coeffs.empty()) {
+		throw MathError("zero polynomial has infinitely many roots");
+	}
+	// Zero roots are factored out exactly.
+	size_t zeros = 0;
+	while (coeffs[zeros] == 0.0) {
+		++zeros;
+	}
+	std::vector<Complex> res(zeros, 0.0);
+	Coeffs c(coeffs.begin() + zeros, coeffs.end());
+	size_t n = c.size() - 1;
+	if (n == 0) {
+		return res;
+	}
+	// Geometric mean of the roots as the radius, bounded by Cauchy's bound.
+	double bound = 0.0;
+	for (size_t i = 0; i < n; ++i) {
+		bound = std::max(bound, std::abs(c[i] / c[n]));
+	}
+	double radius = std::min(1.0 + bound, std::pow(std::abs(c[0] / c[n]), 1.0 / n));
+	std::vector<Complex> z(n);
+	for (size_t k = 0; k < n; ++k) {
+		double angle = 2 * M_PI * k / n + 0.4;
+		z[k] = std::polar(radius, angle);
+	}
+	constexpr double eps = std::numeric_limits<double>::epsilon();
+	constexpr size_t max_iters = 500;
+	std::vector<bool> done(n, false);
+	size_t remaining = n;
+	for (size_t iter = 0; iter < max_iters && remaining > 0; ++iter) {
+		for (size_t k = 0; k < n; ++k) {
+			if (done[k]) {
+				continue;
+			}
+			auto ev = eval_complex(c, z[k]);
+			if (ev.val == 0.0) {
+				done[k] = true;
+				--remaining;
+				continue;
+			}
+			Complex ratio = ev.val / ev.deriv;
+			Complex sum = 0.0;
+			for (size_t j = 0; j < n; ++j) {
+				if (j != k) {
+					sum += 1.0 / (z[k] - z[j]);
+				}
+			}
+			Complex step = ratio / (1.0 - ratio * sum);
+			if (!std::isfinite(step.real()) || !std::isfinite(step.imag())) {
+				continue;
+			}
+			z[k] -= step;
+			// Value indistinguishable from rounding errors means that the
+			// approximation can't be improved further apart from this last
+			// step, which is how iteration ends at multiple roots.
+			if (std::abs(step) <= 4 * eps * std::abs(z[k]) ||
+					std::abs(ev.val) <= 4 * n * ev.error) {
+				done[k] = true;
+				--remaining;
+			}
+		}
+	}
+	if (remaining > 0) {
+		throw MathError("root finding didn't converge");
+	}
+	res.insert(res.end(), z.begin(), z.end());
+	return res;
+}
+
+std::vector<double> Polynomial::real_roots() const {
+	std::vector<double> res;
+	for (auto z : roots()) {
+		if (std::abs(z.imag()) <= 1e-7 * (1.0 + std::abs(z))) {
+			res.push_back(z.real());
+		}
+	}
+	std::sort(res.begin(), res.end());
+	return res;
+}
+
+MultiPolynomial::MultiPolynomial(size_t vars, std::vector<Term> terms) :
+	vars(vars),
+	terms(std::move(terms)) {}
+
+std::optional<MultiPolynomial>
+MultiPolynomial::from_expr(const Expr& expr, const std::vector<std::string>& vars) {
+	auto terms = to_terms(expr, vars);
+	if (!terms) {
+		return std::nullopt;
+	}
+	std::vector<Term> res;
+	for (const auto& term : *terms) {
+		res.push_back({term.second, term.first});
+	}
+	return MultiPolynomial(vars.size(), std::move(res));
+}
+
+const std::vector<MultiPolynomial::Term>& MultiPolynomial::get_terms() const {
+	return terms;
+}
+
+size_t MultiPolynomial::get_vars() const {
+	return vars;
+}
+
+size_t MultiPolynomial::degree() const {
+	size_t res = 0;
+	for (const auto& term : terms) {
+		res = std::max(res, ::degree(term.exps));
+	}
+	return res;
+}
+
+std::complex<double>
+MultiPolynomial::eval(const std::complex<double>* x, std::complex<double>* grad) const {
+	using Complex = std::complex<double>;
+	auto power = [](Complex z, uint32_t e) {
+		Complex res = 1.0;
+		for (uint32_t i = 0; i < e; ++i) {
+			res *= z;
+		}
+		return res;
+	};
+	Complex res = 0.0;
+	if (grad) {
+		std::fill(grad, grad + vars, 0.0);
+	}
+	for (const auto& term : terms) {
+		const auto& exps = term.exps;
+		Complex prod = term.coeff;
+		for (size_t i = 0; i < vars; ++i) {
+			prod *= power(x[i], exps[i]);
+		}
+		res += prod;
+		if (!grad) {
+			continue;
+		}
+		// Products of all factors but one, without dividing by variables
+		// which may be zero.
+		for (size_t i = 0; i < vars; ++i) {
+			if (exps[i] == 0) {
+				continue;
+			}
+			Complex d = term.coeff * double(exps[i]) * power(x[i], exps[i] - 1);
+			for (size_t j = 0; j < vars; ++j) {
+				if (j != i) {
+					d *= power(x[j], exps[j]);
+				}
+			}
+			grad[i] += d;
+		}
+	}
+	return res;
+}
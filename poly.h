@@ -0,0 +1,94 @@
+#ifndef ROOTS_POLY_H
+#define ROOTS_POLY_H
+
+#include "expr.h"
+
+#include <complex>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Polynomial in a single variable with real coefficients.
+class Polynomial {
+private:
+	std::string var;
+	// Coefficients in order of increasing degree, without trailing zeros.
+	std::vector<double> coeffs;
+
+public:
+	// Maximal degree of polynomials recognized by from_expr().
+	static constexpr size_t max_degree = 64;
+
+	Polynomial(std::string var, std::vector<double> coeffs);
+
+	// Converts an expression in one variable built of constants, addition,
+	// subtraction, multiplication, negation, division by constants and powers
+	// with non-negative integer constant exponents. Subexpressions without
+	// variables are evaluated. Returns nullopt for all other expressions and
+	// for expressions whose constant parts fail to evaluate.
+	static std::optional<Polynomial> from_expr(const Expr& expr);
+
+	// Checks if the expression is a sum of terms built of constants and
+	// powers of variables, so that from_expr() doesn't multiply out sums.
+	// Coefficients of expanded products of sums, such as (x - 2)^20, lose
+	// accuracy to cancellation near clustered roots, where Horner's scheme
+	// then evaluates the expression much less accurately than its tree.
+	static bool is_expanded(const Expr& expr);
+
+	const std::string& get_var() const;
+	const std::vector<double>& get_coeffs() const;
+	size_t degree() const;
+
+	// Evaluates the polynomial using Horner's scheme.
+	double eval(double x) const;
+	// Evaluates the polynomial and its derivative in a single Horner pass.
+	std::pair<double, double> eval_diff(double x) const;
+	// Evaluates the polynomial and its first two derivatives.
+	Expr::Derivs eval_derivs(double x) const;
+
+	// Finds all complex roots using the Aberth-Ehrlich method. Roots are
+	// repeated according to their multiplicity. Throws MathError for the zero
+	// polynomial and if the iteration doesn't converge.
+	std::vector<std::complex<double>> roots() const;
+	// Returns real roots from roots(), in increasing order. Roots with
+	// imaginary parts small relative to their magnitude are considered real.
+	std::vector<double> real_roots() const;
+};
+
+// Polynomial in several variables with real coefficients, as a sum of terms.
+class MultiPolynomial {
+public:
+	struct Term {
+		double coeff;
+		// Exponent of every variable.
+		std::vector<uint32_t> exps;
+	};
+
+private:
+	size_t vars;
+	// Terms with distinct exponents and nonzero coefficients.
+	std::vector<Term> terms;
+
+public:
+	MultiPolynomial(size_t vars, std::vector<Term> terms);
+
+	// Converts an expression in the given variables built of the same
+	// operations as for Polynomial::from_expr(), with the same limit of the
+	// total degree. Returns nullopt for all other expressions, including
+	// those using variables not in vars.
+	static std::optional<MultiPolynomial>
+	from_expr(const Expr& expr, const std::vector<std::string>& vars);
+
+	const std::vector<Term>& get_terms() const;
+	size_t get_vars() const;
+	// Total degree, the maximal sum of exponents of a term.
+	size_t degree() const;
+
+	// Evaluates the polynomial at a complex point, storing its gradient in
+	// grad unless it's null.
+	std::complex<double> eval(const std::complex<double>* x, std::complex<double>* grad) const;
+};
+
+#endif // ROOTS_POLY_H
@@ -0,0 +1,145 @@
+#include "poly.h"
+
+#include "common.h"
+#include "expr.h"
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <complex>
+#include <vector>
+
+namespace {
+
+void expect_coeffs_eq(const std::string& input, const std::vector<double>& expected) {
+	auto poly = Polynomial::from_expr(Expr::parse(input));
+	ASSERT_TRUE(poly.has_value()) << input;
+	const auto& actual = poly->get_coeffs();
+	ASSERT_EQ(actual.size(), expected.size()) << input;
+	for (size_t i = 0; i < expected.size(); ++i) {
+		EXPECT_DOUBLE_EQ(actual[i], expected[i]) << input << ", coefficient " << i;
+	}
+}
+
+void expect_roots_near(const std::vector<double>& actual, const std::vector<double>& expected,
+		double error)
+{
+	ASSERT_EQ(actual.size(), expected.size()) << "number of roots";
+	for (size_t i = 0; i < expected.size(); ++i) {
+		EXPECT_NEAR(actual[i], expected[i], error) << "root " << i;
+	}
+}
+
+} // end anon
+
+TEST(PolyTest, FromExpr) {
+	expect_coeffs_eq("x^2 - 13.11", {-13.11, 0, 1});
+	expect_coeffs_eq("(x + 1)^3", {1, 3, 3, 1});
+	expect_coeffs_eq("-(2*y)/4 + 3", {3, -0.5});
+	expect_coeffs_eq("x*(x - 1) - x^2", {0, -1});
+	expect_coeffs_eq("(exp 1)*x + sqrt(4)", {2, std::exp(1.0)});
+	expect_coeffs_eq("x^(1 + 1)", {0, 0, 1});
+	EXPECT_EQ(Polynomial::from_expr(Expr::parse("x^2 - 13.11"))->get_var(), "x");
+
+	for (auto input : {"sin(x)", "x^y", "x^0.5", "x^(-1)", "1/x", "x + y", "7", "x/0",
+			"x + ln(-1)", "x^100"}) {
+		EXPECT_FALSE(Polynomial::from_expr(Expr::parse(input)).has_value()) << input;
+	}
+}
+
+TEST(PolyTest, IsExpanded) {
+	for (auto input : {"2", "x", "3*x^2 - x/2 + 1", "-(x^3) + 2^3*x", "x*x*x - x^2/4"}) {
+		EXPECT_TRUE(Polynomial::is_expanded(Expr::parse(input))) << input;
+	}
+	for (auto input : {"(x - 2)^20 - 1", "(x + 1)*(x - 1)", "x*(x + 1)", "(x^2 + 1)/3"}) {
+		EXPECT_FALSE(Polynomial::is_expanded(Expr::parse(input))) << input;
+	}
+}
+
+TEST(PolyTest, Eval) {
+	auto expr = Expr::parse("3*x^4 - 2*x^3 + x - 7");
+	auto poly = *Polynomial::from_expr(expr);
+	EXPECT_EQ(poly.degree(), 4u);
+	for (double x : {-2.5, -1.0, 0.0, 0.5, 3.0}) {
+		EXPECT_DOUBLE_EQ(poly.eval(x), expr.eval({{"x", x}})) << "value at " << x;
+		auto y = poly.eval_diff(x);
+		EXPECT_DOUBLE_EQ(y.first, expr.eval({{"x", x}})) << "value at " << x;
+		EXPECT_DOUBLE_EQ(y.second, expr.diff("x", {{"x", x}})) << "derivative at " << x;
+	}
+}
+
+TEST(PolyTest, Roots) {
+	auto poly = *Polynomial::from_expr(Expr::parse("x^3 - 6*x^2 + 11*x - 6"));
+	expect_roots_near(poly.real_roots(), {1, 2, 3}, 1e-12);
+
+	poly = *Polynomial::from_expr(Expr::parse("x^2 + 1"));
+	auto roots = poly.roots();
+	ASSERT_EQ(roots.size(), 2u);
+	EXPECT_TRUE(poly.real_roots().empty());
+	for (auto z : roots) {
+		EXPECT_NEAR(std::abs(z.imag()), 1.0, 1e-12);
+		EXPECT_NEAR(z.real(), 0.0, 1e-12);
+	}
+
+	// Zero roots are found exactly.
+	poly = *Polynomial::from_expr(Expr::parse("x^4 - x^2"));
+	expect_roots_near(poly.real_roots(), {-1, 0, 0, 1}, 1e-12);
+
+	// Multiple roots are found with reduced accuracy.
+	poly = *Polynomial::from_expr(Expr::parse("(x - 1)^2 * (x + 2)"));
+	expect_roots_near(poly.real_roots(), {-2, 1, 1}, 1e-7);
+
+	// Wilkinson's polynomial of degree 10.
+	Expr w = Expr(1.0);
+	for (int i = 1; i <= 10; ++i) {
+		w = w * (Expr(std::string("x")) - Expr(double(i)));
+	}
+	poly = *Polynomial::from_expr(w);
+	expect_roots_near(poly.real_roots(), {1, 2, 3, 4, 5, 6, 7, 8, 9, 10}, 1e-8);
+
+	EXPECT_THROW(Polynomial("x", {}).roots(), MathError);
+	EXPECT_TRUE(Polynomial("x", {5}).roots().empty());
+}
+
+TEST(PolyTest, MultiFromExpr) {
+	std::vector<std::string> vars = {"x", "y"};
+	auto poly = MultiPolynomial::from_expr(Expr::parse("(x + y)^2 - 2*x*y + y/2 - 3"), vars);
+	ASSERT_TRUE(poly.has_value());
+	EXPECT_EQ(poly->degree(), 2u);
+	EXPECT_EQ(poly->get_vars(), 2u);
+	// x^2, y^2, y/2 and the constant.
+	EXPECT_EQ(poly->get_terms().size(), 4u);
+
+	for (auto input : {"sin(x)", "x^y", "x^0.5", "1/x", "x + z", "x/0", "x + ln(-1)",
+			"(x*y)^33"}) {
+		EXPECT_FALSE(MultiPolynomial::from_expr(Expr::parse(input), vars).has_value()) << input;
+	}
+	poly = MultiPolynomial::from_expr(Expr::parse("x - x + 7"), vars);
+	ASSERT_TRUE(poly.has_value());
+	EXPECT_EQ(poly->degree(), 0u);
+}
+
+TEST(PolyTest, MultiEval) {
+	std::vector<std::string> vars = {"x", "y", "z"};
+	auto expr = Expr::parse("3*x^3*y - 2*y*z^2 + x - 7 + (x - z)^2");
+	auto poly = *MultiPolynomial::from_expr(expr, vars);
+	for (auto point : std::vector<std::vector<double>>{{0, 0, 0}, {1.5, -2, 0.5}, {-1, 3, 2}}) {
+		Expr::Env env;
+		std::vector<std::complex<double>> x;
+		for (size_t i = 0; i < vars.size(); ++i) {
+			env[vars[i]] = point[i];
+			x.push_back(point[i]);
+		}
+		std::vector<std::complex<double>> grad(vars.size());
+		auto val = poly.eval(x.data(), grad.data());
+		EXPECT_NEAR(val.real(), expr.eval(env), 1e-12);
+		EXPECT_EQ(val.imag(), 0.0);
+		for (size_t i = 0; i < vars.size(); ++i) {
+			EXPECT_NEAR(grad[i].real(), expr.diff(vars[i], env), 1e-12) << "by " << vars[i];
+		}
+	}
+	// x^2 + 1 at x = i.
+	poly = *MultiPolynomial::from_expr(Expr::parse("x^2 + 1"), {"x"});
+	std::complex<double> i(0.0, 1.0);
+	EXPECT_EQ(poly.eval(&i, nullptr), 0.0);
+}
@@ -0,0 +1,93 @@
+#include "pool.h"
+
+ThreadPool::ThreadPool(size_t threads) : stopping(false) {
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	workers.reserve(threads);
+	for (size_t i = 0; i < threads; ++i) {
+		workers.emplace_back([this]() { work(); });
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	ready.notify_all();
+	for (auto& w : workers) {
+		w.join();
+	}
+}
+
+size_t ThreadPool::size() const {
+	return workers.size();
+}
+
+void ThreadPool::work() {
+	while (true) {
+		std::function<void()> task;
+		Loop call;
+		size_t i = 0;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			ready.wait(lock, [this]() {
+				return stopping || !tasks.empty() || loop.next < loop.n;
+			});
+			if (loop.next < loop.n) {
+				call.call = loop.call;
+				call.fun = loop.fun;
+				i = loop.next++;
+			}
+			else if (tasks.empty()) {
+				return;
+			}
+			else {
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+		}
+		if (!call.call) {
+			task();
+			continue;
+		}
+		std::exception_ptr err;
+		try {
+			call.call(call.fun, i);
+		}
+		catch (...) {
+			err = std::current_exception();
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		if (err && !loop.err) {
+			loop.err = err;
+		}
+		if (--loop.unfinished == 0) {
+			loop_done.notify_one();
+		}
+	}
+}
+
+void ThreadPool::run_loop(size_t n, const void* fun, void (*call)(const void* fun, size_t i)) {
+	if (n == 0) {
+		return;
+	}
+	std::lock_guard<std::mutex> serial(loop_mutex);
+	std::exception_ptr err;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		loop.call = call;
+		loop.fun = fun;
+		loop.n = n;
+		loop.next = 0;
+		loop.unfinished = n;
+		ready.notify_all();
+		loop_done.wait(lock, [this]() { return loop.unfinished == 0; });
+		err = std::move(loop.err);
+		loop = Loop();
+	}
+	if (err) {
+		std::rethrow_exception(err);
+	}
+}
@@ -0,0 +1,87 @@
+#ifndef ROOTS_POOL_H
+#define ROOTS_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed size pool of worker threads executing submitted tasks in FIFO order.
+class ThreadPool {
+private:
+	// Calls of the running parallel_for(), which workers claim one index at
+	// a time before taking queued tasks.
+	struct Loop {
+		void (*call)(const void* fun, size_t i) = nullptr;
+		const void* fun = nullptr;
+		size_t n = 0;
+		size_t next = 0;
+		size_t unfinished = 0;
+		std::exception_ptr err;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	Loop loop;
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::condition_variable loop_done;
+	// Held by parallel_for() for its whole duration, one loop runs at a time.
+	std::mutex loop_mutex;
+	bool stopping;
+
+	void work();
+	void run_loop(size_t n, const void* fun, void (*call)(const void* fun, size_t i));
+
+public:
+	// Starts the given number of threads. Zero means one thread per
+	// hardware thread.
+	explicit ThreadPool(size_t threads = 0);
+	// Finishes all queued tasks and joins the threads.
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t size() const;
+
+	// Schedules fun for execution. Returns a future with its result, which
+	// also carries any exception thrown by the task.
+	template<typename Fun>
+	std::future<std::invoke_result_t<Fun>> submit(Fun fun);
+
+	// Calls fun(i) for every i in [0, n) using the pool and waits for
+	// completion. Rethrows the first exception thrown by any call.
+	// Doesn't allocate memory, unless a call throws, so that it can be used
+	// in loops which must not allocate.
+	// Must not be called from a task running on the same pool.
+	template<typename Fun>
+	void parallel_for(size_t n, const Fun& fun);
+};
+
+template<typename Fun>
+std::future<std::invoke_result_t<Fun>> ThreadPool::submit(Fun fun) {
+	using Result = std::invoke_result_t<Fun>;
+	// std::function requires copyable callables, hence the shared_ptr.
+	auto task = std::make_shared<std::packaged_task<Result()>>(std::move(fun));
+	auto future = task->get_future();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.emplace_back([task]() { (*task)(); });
+	}
+	ready.notify_one();
+	return future;
+}
+
+template<typename Fun>
+void ThreadPool::parallel_for(size_t n, const Fun& fun) {
+	run_loop(n, &fun, [](const void* f, size_t i) { (*static_cast<const Fun*>(f))(i); });
+}
+
+#endif // ROOTS_POOL_H
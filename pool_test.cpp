@@ -0,0 +1,83 @@
+#include "pool.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(PoolTest, Submit) {
+	ThreadPool pool(4);
+	EXPECT_EQ(pool.size(), 4) << "number of threads";
+	std::vector<std::future<int>> futures;
+	for (int i = 0; i < 100; ++i) {
+		futures.push_back(pool.submit([i]() { return i * i; }));
+	}
+	for (int i = 0; i < 100; ++i) {
+		EXPECT_EQ(futures[i].get(), i * i) << "result of task " << i;
+	}
+}
+
+TEST(PoolTest, Exception) {
+	ThreadPool pool(2);
+	auto future = pool.submit([]() -> int { throw std::runtime_error("task failed"); });
+	EXPECT_THROW(future.get(), std::runtime_error);
+}
+
+TEST(PoolTest, ParallelFor) {
+	ThreadPool pool(3);
+	std::vector<int> out(1000, 0);
+	pool.parallel_for(out.size(), [&](size_t i) { out[i] = int(i) + 1; });
+	for (size_t i = 0; i < out.size(); ++i) {
+		ASSERT_EQ(out[i], int(i) + 1) << "element " << i;
+	}
+	EXPECT_THROW(
+		pool.parallel_for(10, [](size_t i) {
+			if (i == 7) {
+				throw std::runtime_error("iteration failed");
+			}
+		}),
+		std::runtime_error);
+}
+
+TEST(PoolTest, ConcurrentLoops) {
+	// Loops started from different threads run one after another.
+	ThreadPool pool(2);
+	std::vector<int> out(2000, 0);
+	std::thread other([&]() {
+		for (int k = 0; k < 20; ++k) {
+			pool.parallel_for(1000, [&](size_t i) { ++out[i]; });
+		}
+	});
+	for (int k = 0; k < 20; ++k) {
+		pool.parallel_for(1000, [&](size_t i) { ++out[1000 + i]; });
+	}
+	other.join();
+	for (size_t i = 0; i < out.size(); ++i) {
+		ASSERT_EQ(out[i], 20) << "element " << i;
+	}
+	// All calls run even when some throw.
+	std::atomic<int> calls{0};
+	EXPECT_THROW(
+		pool.parallel_for(100, [&](size_t i) {
+			++calls;
+			if (i % 10 == 0) {
+				throw std::runtime_error("iteration failed");
+			}
+		}),
+		std::runtime_error);
+	EXPECT_EQ(calls.load(), 100);
+	pool.parallel_for(0, [](size_t) { FAIL() << "no calls"; });
+}
+
+TEST(PoolTest, Drain) {
+	std::atomic<int> done{0};
+	{
+		ThreadPool pool(2);
+		for (int i = 0; i < 50; ++i) {
+			pool.submit([&]() { ++done; });
+		}
+	}
+	EXPECT_EQ(done.load(), 50) << "tasks finished before destruction";
+}
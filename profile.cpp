@@ -0,0 +1,110 @@
+#include "profile.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+
+thread_local Profiler* active_profiler = nullptr;
+
+} // end anon
+
+const char* phase_name(Phase phase) {
+	const char* name = "";
+	switch (phase) {
+	case Phase::Lookup:  name = "lookup"; break;
+	case Phase::Eval:    name = "eval"; break;
+	case Phase::Diff:    name = "diff"; break;
+	case Phase::Inverse: name = "inverse"; break;
+	case Phase::Update:  name = "update"; break;
+	}
+	return name;
+}
+
+const Profile::Stats& Profile::operator[](Phase phase) const {
+	return phases[static_cast<size_t>(phase)];
+}
+
+Profile::Stats& Profile::operator[](Phase phase) {
+	return phases[static_cast<size_t>(phase)];
+}
+
+std::string Profile::chrome_trace() const {
+	// Chrome expects timestamps in microseconds.
+	auto micros = [](std::chrono::nanoseconds t) {
+		char buf[32];
+		std::snprintf(buf, sizeof(buf), "%.3f", t.count() / 1000.0);
+		return std::string(buf);
+	};
+	std::string out = "{\"traceEvents\": [";
+	for (size_t i = 0; i < events.size(); ++i) {
+		const auto& ev = events[i];
+		out.append(i > 0 ? ",\n  " : "\n  ");
+		out.append("{\"name\": \"");
+		out.append(phase_name(ev.phase));
+		out.append("\", \"cat\": \"roots\", \"ph\": \"X\", \"ts\": ");
+		out.append(micros(ev.start));
+		out.append(", \"dur\": ");
+		out.append(micros(ev.duration));
+		out.append(", \"pid\": 1, \"tid\": 1}");
+	}
+	out.append("\n], \"displayTimeUnit\": \"ns\", \"otherData\": {");
+	out.append("\"nodes\": " + std::to_string(nodes));
+	out.append(", \"fenv_checks\": " + std::to_string(fenv_checks));
+	for (size_t i = 0; i < phase_count; ++i) {
+		auto name = std::string(phase_name(static_cast<Phase>(i)));
+		out.append(", \"" + name + "_calls\": " + std::to_string(phases[i].calls));
+		out.append(", \"" + name + "_ns\": " + std::to_string(phases[i].time.count()));
+	}
+	out.append("}}\n");
+	return out;
+}
+
+Profiler::Profiler(Profile& profile) :
+	profile(profile),
+	start(std::chrono::steady_clock::now())
+{
+	if (active_profiler != nullptr) {
+		throw std::logic_error("nested profilers");
+	}
+	active_profiler = this;
+}
+
+Profiler::~Profiler() {
+	active_profiler = nullptr;
+}
+
+Profiler* Profiler::active() {
+	return active_profiler;
+}
+
+Profile& Profiler::get_profile() {
+	return profile;
+}
+
+std::chrono::steady_clock::time_point Profiler::get_start() const {
+	return start;
+}
+
+ProfileScope::ProfileScope(Phase phase) :
+	profiler(Profiler::active()),
+	phase(phase)
+{
+	if (profiler != nullptr) {
+		start = std::chrono::steady_clock::now();
+	}
+}
+
+ProfileScope::~ProfileScope() {
+	if (profiler == nullptr) {
+		return;
+	}
+	auto duration = std::chrono::steady_clock::now() - start;
+	auto& profile = profiler->get_profile();
+	auto& stats = profile[phase];
+	stats.calls += 1;
+	stats.time += duration;
+	if (phase != Phase::Lookup) {
+		profile.events.push_back(Profile::Event{phase, start - profiler->get_start(), duration});
+	}
+}
@@ -0,0 +1,114 @@
+#ifndef ROOTS_PROFILE_H
+#define ROOTS_PROFILE_H
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Phases of the computation distinguished by the profiler.
+enum class Phase {
+	// Variable lookup during evaluation.
+	Lookup,
+	// Evaluation of a function.
+	Eval,
+	// Partial differentiation of a function.
+	Diff,
+	// Jacobian inversion.
+	Inverse,
+	// Computation of the next iterate.
+	Update,
+};
+
+constexpr size_t phase_count = 5;
+
+// Returns the name of the phase.
+const char* phase_name(Phase phase);
+
+// Profiling data collected on a single thread.
+struct Profile {
+	struct Stats {
+		size_t calls = 0;
+		// Total wall time, including nested phases.
+		std::chrono::nanoseconds time{0};
+	};
+
+	struct Event {
+		Phase phase;
+		// Start relative to the beginning of profiling.
+		std::chrono::nanoseconds start;
+		std::chrono::nanoseconds duration;
+	};
+
+	// Statistics indexed by phase.
+	std::array<Stats, phase_count> phases;
+	// Number of expression nodes visited during evaluation.
+	size_t nodes = 0;
+	// Number of floating point environment checks.
+	size_t fenv_checks = 0;
+	// Timeline of all phases apart from Lookup, which is too fine grained.
+	std::vector<Event> events;
+
+	const Stats& operator[](Phase phase) const;
+	Stats& operator[](Phase phase);
+
+	// Exports events in the Chrome trace event JSON format, readable by
+	// chrome://tracing and Perfetto.
+	std::string chrome_trace() const;
+};
+
+// Collects profiling data from the current thread into the given profile
+// for the lifetime of the object. Profilers can't be nested.
+class Profiler {
+private:
+	Profile& profile;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	Profiler(Profile& profile);
+	~Profiler();
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	// Returns the profiler active on the current thread, if any.
+	static Profiler* active();
+
+	Profile& get_profile();
+	std::chrono::steady_clock::time_point get_start() const;
+};
+
+// Records time spent in a phase until the end of the scope.
+class ProfileScope {
+private:
+	Profiler* profiler;
+	Phase phase;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	ProfileScope(Phase phase);
+	~ProfileScope();
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+// Instrumentation macros. They are compiled only when ROOTS_PROFILE is defined,
+// so that regular builds don't pay for the checks.
+#ifdef ROOTS_PROFILE
+#define ROOTS_PROFILE_CONCAT_(a, b) a##b
+#define ROOTS_PROFILE_CONCAT(a, b) ROOTS_PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(phase) \
+	ProfileScope ROOTS_PROFILE_CONCAT(profile_scope_, __LINE__)(phase)
+#define PROFILE_COUNT(counter) \
+	do { \
+		if (auto profiler_ = Profiler::active()) { \
+			++profiler_->get_profile().counter; \
+		} \
+	} while (0)
+#else
+#define PROFILE_SCOPE(phase) do {} while (0)
+#define PROFILE_COUNT(counter) do {} while (0)
+#endif
+
+#endif // ROOTS_PROFILE_H
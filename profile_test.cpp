@@ -0,0 +1,68 @@
+#include "profile.h"
+
+#include "expr.h"
+#include "solve.h"
+
+#include "gtest/gtest.h"
+
+// This test is compiled with ROOTS_PROFILE defined.
+
+TEST(ProfileTest, Expr) {
+	auto expr = Expr::parse("x^2 + sin(y)/x");
+	Expr::Env env = {{"x", 2.0}, {"y", 1.0}};
+	Profile profile;
+	{
+		Profiler profiler(profile);
+		expr.eval(env);
+		expr.diff("x", env);
+	}
+	EXPECT_EQ(profile[Phase::Eval].calls, 1) << "eval calls";
+	EXPECT_EQ(profile[Phase::Diff].calls, 1) << "diff calls";
+	EXPECT_EQ(profile[Phase::Lookup].calls, 6) << "variable lookups";
+	EXPECT_EQ(profile.nodes, 16) << "visited nodes";
+	EXPECT_EQ(profile.fenv_checks, 3) << "fenv checks";
+	EXPECT_EQ(profile.events.size(), 2) << "trace events";
+}
+
+TEST(ProfileTest, Inactive) {
+	auto expr = Expr::parse("x^2");
+	Profile profile;
+	{
+		Profiler profiler(profile);
+	}
+	expr.eval({{"x", 1.0}});
+	EXPECT_EQ(profile[Phase::Eval].calls, 0) << "eval calls";
+	EXPECT_EQ(profile.nodes, 0) << "visited nodes";
+}
+
+TEST(ProfileTest, Solve) {
+	std::vector<Expr> funcs = {
+		Expr::parse("x^2 + y^2 - 16"),
+		Expr::parse("y - (2*x - 3)"),
+	};
+	Constraints constr;
+	constr.profile = true;
+	auto sol = solve(funcs, {{"x", 100}, {"y", 130}}, constr);
+	const auto& profile = sol.profile;
+	EXPECT_EQ(profile[Phase::Inverse].calls, sol.iters) << "inverse calls";
+	EXPECT_EQ(profile[Phase::Update].calls, sol.iters) << "update calls";
+	EXPECT_EQ(profile[Phase::Eval].calls, 2 * sol.iters) << "eval calls";
+	EXPECT_EQ(profile[Phase::Diff].calls, 4 * sol.iters) << "diff calls";
+	EXPECT_EQ(Profiler::active(), nullptr) << "profiler after solve";
+
+	constr.profile = false;
+	sol = solve(funcs, {{"x", 100}, {"y", 130}}, constr);
+	EXPECT_EQ(sol.profile[Phase::Inverse].calls, 0) << "inverse calls without profiling";
+}
+
+TEST(ProfileTest, ChromeTrace) {
+	Profile profile;
+	profile.events.push_back({Phase::Eval, std::chrono::nanoseconds(1500), std::chrono::nanoseconds(250)});
+	profile.events.push_back({Phase::Inverse, std::chrono::nanoseconds(2000), std::chrono::nanoseconds(1000)});
+	profile.nodes = 7;
+	auto trace = profile.chrome_trace();
+	EXPECT_NE(trace.find("{\"name\": \"eval\", \"cat\": \"roots\", \"ph\": \"X\", \"ts\": 1.500, \"dur\": 0.250"),
+		std::string::npos) << trace;
+	EXPECT_NE(trace.find("\"name\": \"inverse\""), std::string::npos) << trace;
+	EXPECT_NE(trace.find("\"nodes\": 7"), std::string::npos) << trace;
+}
@@ -0,0 +1,835 @@
+#include "program.h"
+
+#include "common.h"
+#include "mapped_file.h"
+#include "num.h"
+#include "vecmath.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <functional>
+#include <system_error>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+
+using Op = Program::Op;
+using Node = Program::Node;
+
+// Binary file layout, all integers in native byte order:
+//   Header
+//   double   consts[const_count]
+//   Node     nodes[node_count]
+//   uint32_t outputs[output_count]
+//   uint32_t name_offsets[var_count + 1]
+//   char     names[names_size]
+//   uint32_t dep_offsets[output_count + 1]  (only with sparsity)
+//   uint32_t deps[dep_count]                (only with sparsity)
+// Every section starts at an offset aligned to 8 bytes.
+
+constexpr char magic[8] = {'R', 'O', 'O', 'T', 'S', 'P', 'R', 'G'};
+constexpr uint32_t version = 1;
+constexpr uint32_t byte_order = 0x01020304;
+constexpr uint32_t flag_sparsity = 1;
+
+struct Header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t flags;
+	uint32_t reserved;
+	uint64_t node_count;
+	uint64_t const_count;
+	uint64_t var_count;
+	uint64_t output_count;
+	uint64_t names_size;
+	uint64_t dep_count;
+};
+
+static_assert(sizeof(Node) == 12, "unexpected node layout");
+static_assert(sizeof(Header) % 8 == 0, "unexpected header layout");
+
+size_t align(size_t offset) {
+	return (offset + 7) & ~size_t(7);
+}
+
+bool is_binary(Op op) {
+	return op >= Op::Add && op <= Op::Pow;
+}
+
+bool is_unary(Op op) {
+	return op >= Op::Neg && op <= Op::Sqrt;
+}
+
+Op binary_op(Expr::BinaryOp op) {
+	Op out = Op::Add;
+	switch (op) {
+	case Expr::BinaryOp::Add: out = Op::Add; break;
+	case Expr::BinaryOp::Sub: out = Op::Sub; break;
+	case Expr::BinaryOp::Mul: out = Op::Mul; break;
+	case Expr::BinaryOp::Div: out = Op::Div; break;
+	case Expr::BinaryOp::Pow: out = Op::Pow; break;
+	}
+	return out;
+}
+
+Op unary_op(Expr::UnaryOp op) {
+	Op out = Op::Neg;
+	switch (op) {
+	case Expr::UnaryOp::Neg:  out = Op::Neg; break;
+	case Expr::UnaryOp::Sin:  out = Op::Sin; break;
+	case Expr::UnaryOp::Cos:  out = Op::Cos; break;
+	case Expr::UnaryOp::Ln:   out = Op::Ln; break;
+	case Expr::UnaryOp::Exp:  out = Op::Exp; break;
+	case Expr::UnaryOp::Sqrt: out = Op::Sqrt; break;
+	}
+	return out;
+}
+
+// Translates expression trees into program nodes.
+class Compiler {
+private:
+	std::vector<Node>& nodes;
+	std::vector<double>& consts;
+	std::unordered_map<std::string, uint32_t> var_index;
+	std::unordered_map<uint32_t, uint32_t> var_nodes;
+	std::unordered_map<uint64_t, uint32_t> const_nodes;
+	std::unordered_map<const Expr*, uint32_t> shared;
+	std::map<std::tuple<Op, uint32_t, uint32_t>, uint32_t> op_nodes;
+
+	uint32_t push(Node node);
+	uint32_t push_op(Node node);
+
+public:
+	Compiler(std::vector<Node>& nodes, std::vector<double>& consts,
+			const std::vector<std::string>& vars);
+
+	uint32_t compile(const Expr& expr);
+};
+
+Compiler::Compiler(std::vector<Node>& nodes, std::vector<double>& consts,
+		const std::vector<std::string>& vars) :
+	nodes(nodes),
+	consts(consts)
+{
+	for (size_t i = 0; i < vars.size(); ++i) {
+		var_index.emplace(vars[i], static_cast<uint32_t>(i));
+	}
+}
+
+uint32_t Compiler::push(Node node) {
+	nodes.push_back(node);
+	return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+// Operations are shared by structure, so that equal subexpressions of
+// different functions are computed once.
+uint32_t Compiler::push_op(Node node) {
+	auto key = std::make_tuple(node.op, node.lhs, node.rhs);
+	auto found = op_nodes.find(key);
+	if (found != op_nodes.end()) {
+		return found->second;
+	}
+	auto id = push(node);
+	op_nodes.emplace(key, id);
+	return id;
+}
+
+uint32_t Compiler::compile(const Expr& expr) {
+	auto it = shared.find(&expr);
+	if (it != shared.end()) {
+		return it->second;
+	}
+	uint32_t id = std::visit(overloaded {
+		[&](const Expr::Const& c) {
+			uint64_t bits;
+			std::memcpy(&bits, &c.val, sizeof(bits));
+			auto found = const_nodes.find(bits);
+			if (found != const_nodes.end()) {
+				return found->second;
+			}
+			consts.push_back(c.val);
+			auto id = push(Node{Op::Const, static_cast<uint32_t>(consts.size() - 1), 0});
+			const_nodes.emplace(bits, id);
+			return id;
+		},
+		[&](const Expr::Var& var) {
+			auto idx = var_index.find(*var.name);
+			if (idx == var_index.end()) {
+				throw MathError("undefined variable " + *var.name);
+			}
+			auto found = var_nodes.find(idx->second);
+			if (found != var_nodes.end()) {
+				return found->second;
+			}
+			auto id = push(Node{Op::Var, idx->second, 0});
+			var_nodes.emplace(idx->second, id);
+			return id;
+		},
+		[&](const Expr::Binary& bin) {
+			auto lhs = compile(*bin.lhs);
+			auto rhs = compile(*bin.rhs);
+			return push_op(Node{binary_op(bin.type), lhs, rhs});
+		},
+		[&](const Expr::Unary& un) {
+			auto arg = compile(*un.arg);
+			return push_op(Node{unary_op(un.type), arg, 0});
+		},
+	}, expr.value);
+	shared.emplace(&expr, id);
+	return id;
+}
+
+template<typename Num>
+Num apply(Op op, Num lhs, Num rhs) {
+	Num out;
+	switch (op) {
+	case Op::Add:  out = lhs + rhs; break;
+	case Op::Sub:  out = lhs - rhs; break;
+	case Op::Mul:  out = lhs * rhs; break;
+	case Op::Div:  out = lhs / rhs; break;
+	case Op::Pow:  out = lhs.pow(rhs); break;
+	case Op::Neg:  out = -lhs; break;
+	case Op::Sin:  out = lhs.sin(); break;
+	case Op::Cos:  out = lhs.cos(); break;
+	case Op::Ln:   out = lhs.ln(); break;
+	case Op::Exp:  out = lhs.exp(); break;
+	case Op::Sqrt: out = lhs.sqrt(); break;
+	case Op::Const:
+	case Op::Var:
+		break;
+	}
+	return out;
+}
+
+template<typename T>
+void append(std::string& out, const T* data, size_t count) {
+	out.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+	out.resize(align(out.size()), '\0');
+}
+
+template<typename T>
+Program::Span<T> section(const char* base, size_t size, size_t& offset, uint64_t count) {
+	if (count > (size - std::min(size, offset)) / sizeof(T)) {
+		throw ParseError("invalid program file: truncated");
+	}
+	Program::Span<T> span;
+	span.ptr = reinterpret_cast<const T*>(base + offset);
+	span.len = count;
+	offset = align(offset + count * sizeof(T));
+	return span;
+}
+
+} // end anon
+
+Program::Program() = default;
+Program::Program(Program&& other) {
+	*this = std::move(other);
+}
+
+Program& Program::operator=(Program&& other) {
+	node_buf = std::move(other.node_buf);
+	const_buf = std::move(other.const_buf);
+	output_buf = std::move(other.output_buf);
+	name_offset_buf = std::move(other.name_offset_buf);
+	name_buf = std::move(other.name_buf);
+	dep_offset_buf = std::move(other.dep_offset_buf);
+	dep_buf = std::move(other.dep_buf);
+	file = std::move(other.file);
+	nodes = other.nodes;
+	consts = other.consts;
+	outputs = other.outputs;
+	name_offsets = other.name_offsets;
+	names = other.names;
+	dep_offsets = other.dep_offsets;
+	deps = other.deps;
+	// Moving a short string doesn't preserve its buffer.
+	if (!file) {
+		attach();
+	}
+	return *this;
+}
+
+Program::~Program() = default;
+
+void Program::attach() {
+	nodes = {node_buf.data(), node_buf.size()};
+	consts = {const_buf.data(), const_buf.size()};
+	outputs = {output_buf.data(), output_buf.size()};
+	name_offsets = {name_offset_buf.data(), name_offset_buf.size()};
+	names = {name_buf.data(), name_buf.size()};
+	dep_offsets = {dep_offset_buf.data(), dep_offset_buf.size()};
+	deps = {dep_buf.data(), dep_buf.size()};
+}
+
+Program Program::compile(const std::vector<Expr>& funcs,
+		const std::vector<std::string>& vars, bool sparsity)
+{
+	Program prog;
+	Compiler compiler(prog.node_buf, prog.const_buf, vars);
+	for (const auto& f : funcs) {
+		prog.output_buf.push_back(compiler.compile(f));
+	}
+	prog.name_offset_buf.push_back(0);
+	for (const auto& v : vars) {
+		prog.name_buf.append(v);
+		prog.name_offset_buf.push_back(static_cast<uint32_t>(prog.name_buf.size()));
+	}
+	if (sparsity) {
+		// Depth first search from every output, with visited nodes marked by
+		// the number of the output.
+		std::vector<size_t> mark(prog.node_buf.size(), 0);
+		std::vector<uint32_t> stack;
+		prog.dep_offset_buf.push_back(0);
+		for (size_t i = 0; i < prog.output_buf.size(); ++i) {
+			size_t first = prog.dep_buf.size();
+			stack.push_back(prog.output_buf[i]);
+			mark[prog.output_buf[i]] = i + 1;
+			while (!stack.empty()) {
+				const auto& node = prog.node_buf[stack.back()];
+				stack.pop_back();
+				if (node.op == Op::Var) {
+					prog.dep_buf.push_back(node.lhs);
+					continue;
+				}
+				uint32_t operands[2] = {node.lhs, node.rhs};
+				size_t count = is_binary(node.op) ? 2 : is_unary(node.op) ? 1 : 0;
+				for (size_t k = 0; k < count; ++k) {
+					if (mark[operands[k]] != i + 1) {
+						mark[operands[k]] = i + 1;
+						stack.push_back(operands[k]);
+					}
+				}
+			}
+			std::sort(prog.dep_buf.begin() + first, prog.dep_buf.end());
+			prog.dep_offset_buf.push_back(static_cast<uint32_t>(prog.dep_buf.size()));
+		}
+	}
+	prog.attach();
+	return prog;
+}
+
+std::string Program::serialize() const {
+	Header header;
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.byte_order = byte_order;
+	header.flags = has_sparsity() ? flag_sparsity : 0;
+	header.reserved = 0;
+	header.node_count = nodes.size();
+	header.const_count = consts.size();
+	header.var_count = var_count();
+	header.output_count = outputs.size();
+	header.names_size = names.size();
+	header.dep_count = deps.size();
+	std::string out;
+	append(out, &header, 1);
+	append(out, consts.ptr, consts.size());
+	append(out, nodes.ptr, nodes.size());
+	append(out, outputs.ptr, outputs.size());
+	append(out, name_offsets.ptr, name_offsets.size());
+	append(out, names.ptr, names.size());
+	if (has_sparsity()) {
+		append(out, dep_offsets.ptr, dep_offsets.size());
+		append(out, deps.ptr, deps.size());
+	}
+	return out;
+}
+
+void Program::save(const std::string& path) const {
+	auto data = serialize();
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(data.data(), data.size());
+	out.close();
+	if (!out) {
+		throw std::system_error(errno, std::generic_category(), "can't write " + path);
+	}
+}
+
+Program Program::load(const std::string& path) {
+	Program prog;
+	prog.file = std::make_unique<MappedFile>(path);
+	const char* base = prog.file->data();
+	size_t size = prog.file->size();
+	if (size < sizeof(Header)) {
+		throw ParseError("invalid program file: truncated header");
+	}
+	Header header;
+	std::memcpy(&header, base, sizeof(header));
+	if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+		throw ParseError("invalid program file: bad magic number");
+	}
+	if (header.version != version) {
+		throw ParseError("invalid program file: unsupported version " + std::to_string(header.version));
+	}
+	if (header.byte_order != byte_order) {
+		throw ParseError("invalid program file: incompatible byte order");
+	}
+	size_t offset = align(sizeof(Header));
+	prog.consts = section<double>(base, size, offset, header.const_count);
+	prog.nodes = section<Node>(base, size, offset, header.node_count);
+	prog.outputs = section<uint32_t>(base, size, offset, header.output_count);
+	prog.name_offsets = section<uint32_t>(base, size, offset, header.var_count + 1);
+	prog.names = section<char>(base, size, offset, header.names_size);
+	if (header.flags & flag_sparsity) {
+		prog.dep_offsets = section<uint32_t>(base, size, offset, header.output_count + 1);
+		prog.deps = section<uint32_t>(base, size, offset, header.dep_count);
+	}
+	prog.validate();
+	return prog;
+}
+
+// Checks that all indices are in range, so that evaluation doesn't need to.
+void Program::validate() const {
+	auto fail = [](const std::string& msg) {
+		throw ParseError("invalid program file: " + msg);
+	};
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const auto& node = nodes[i];
+		if (node.op == Op::Const) {
+			if (node.lhs >= consts.size()) {
+				fail("constant index out of range");
+			}
+		}
+		else if (node.op == Op::Var) {
+			if (node.lhs >= var_count()) {
+				fail("variable index out of range");
+			}
+		}
+		else if (is_binary(node.op)) {
+			if (node.lhs >= i || node.rhs >= i) {
+				fail("operand doesn't precede node");
+			}
+		}
+		else if (is_unary(node.op)) {
+			if (node.lhs >= i) {
+				fail("operand doesn't precede node");
+			}
+			// Evaluation reads the unused operand along with the used one.
+			if (node.rhs != 0) {
+				fail("unary operation with a second operand");
+			}
+		}
+		else {
+			fail("unknown operation");
+		}
+	}
+	for (auto out : outputs) {
+		if (out >= nodes.size()) {
+			fail("output index out of range");
+		}
+	}
+	auto check_offsets = [&](Span<uint32_t> offsets, size_t limit) {
+		if (offsets.size() == 0 || offsets[0] != 0 || offsets[offsets.size() - 1] != limit) {
+			fail("invalid offset table");
+		}
+		for (size_t i = 1; i < offsets.size(); ++i) {
+			if (offsets[i] < offsets[i - 1]) {
+				fail("invalid offset table");
+			}
+		}
+	};
+	check_offsets(name_offsets, names.size());
+	if (has_sparsity()) {
+		check_offsets(dep_offsets, deps.size());
+		for (auto dep : deps) {
+			if (dep >= var_count()) {
+				fail("dependency index out of range");
+			}
+		}
+	}
+}
+
+size_t Program::node_count() const {
+	return nodes.size();
+}
+
+size_t Program::var_count() const {
+	return name_offsets.size() == 0 ? 0 : name_offsets.size() - 1;
+}
+
+size_t Program::output_count() const {
+	return outputs.size();
+}
+
+std::string_view Program::var_name(size_t i) const {
+	return std::string_view(names.ptr + name_offsets[i], name_offsets[i + 1] - name_offsets[i]);
+}
+
+Program::Span<Node> Program::get_nodes() const {
+	return nodes;
+}
+
+Program::Span<double> Program::get_consts() const {
+	return consts;
+}
+
+Program::Span<uint32_t> Program::get_outputs() const {
+	return outputs;
+}
+
+bool Program::has_sparsity() const {
+	return dep_offsets.size() > 0;
+}
+
+Program::Span<uint32_t> Program::dependencies(size_t output) const {
+	Span<uint32_t> span;
+	span.ptr = deps.ptr + dep_offsets[output];
+	span.len = dep_offsets[output + 1] - dep_offsets[output];
+	return span;
+}
+
+void Program::eval(const double* vars, double* out, Scratch& scratch) const {
+	auto& vals = scratch.vals;
+	vals.resize(nodes.size());
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const auto& node = nodes[i];
+		switch (node.op) {
+		case Op::Const:
+			vals[i] = consts[node.lhs];
+			break;
+		case Op::Var:
+			vals[i] = vars[node.lhs];
+			break;
+		default:
+			vals[i] = apply<Float>(node.op, vals[node.lhs], vals[node.rhs]).val;
+			break;
+		}
+	}
+	for (size_t i = 0; i < outputs.size(); ++i) {
+		out[i] = vals[outputs[i]];
+	}
+}
+
+void Program::diff(size_t var, const double* vars, double* out, Scratch& scratch) const {
+	auto& vals = scratch.vals;
+	auto& derivs = scratch.derivs;
+	auto& cons = scratch.cons;
+	vals.resize(nodes.size());
+	derivs.resize(nodes.size());
+	cons.resize(nodes.size());
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const auto& node = nodes[i];
+		Dual res;
+		switch (node.op) {
+		case Op::Const:
+			res = Dual(consts[node.lhs]);
+			break;
+		case Op::Var:
+			res = node.lhs == var
+				? Dual(vars[node.lhs], 1.0, false)
+				: Dual(vars[node.lhs], 0.0, true);
+			break;
+		default: {
+			Dual lhs(vals[node.lhs], derivs[node.lhs], cons[node.lhs]);
+			Dual rhs(vals[node.rhs], derivs[node.rhs], cons[node.rhs]);
+			res = apply<Dual>(node.op, lhs, rhs);
+			break;
+		}
+		}
+		vals[i] = res.val;
+		derivs[i] = res.deriv;
+		cons[i] = res.cons;
+	}
+	for (size_t i = 0; i < outputs.size(); ++i) {
+		out[i] = derivs[outputs[i]];
+	}
+}
+
+void Program::eval_batch(const double* vars, size_t count, double* out,
+		unsigned char* failed, Scratch& scratch) const
+{
+	auto& vals = scratch.vals;
+	vals.resize(nodes.size() * count);
+	std::fill(failed, failed + count, 0);
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const auto& node = nodes[i];
+		double* res = vals.data() + i * count;
+		const double* lhs = vals.data() + node.lhs * count;
+		const double* rhs = vals.data() + node.rhs * count;
+		switch (node.op) {
+		case Op::Const:
+			std::fill(res, res + count, consts[node.lhs]);
+			break;
+		case Op::Var:
+			std::copy(vars + node.lhs * count, vars + (node.lhs + 1) * count, res);
+			break;
+		case Op::Add:
+			for (size_t j = 0; j < count; ++j) {
+				res[j] = lhs[j] + rhs[j];
+			}
+			break;
+		case Op::Sub:
+			for (size_t j = 0; j < count; ++j) {
+				res[j] = lhs[j] - rhs[j];
+			}
+			break;
+		case Op::Mul:
+			for (size_t j = 0; j < count; ++j) {
+				res[j] = lhs[j] * rhs[j];
+			}
+			break;
+		case Op::Div:  vecmath::div(lhs, rhs, res, failed, count); break;
+		case Op::Pow:  vecmath::pow(lhs, rhs, res, failed, count); break;
+		case Op::Neg:
+			for (size_t j = 0; j < count; ++j) {
+				res[j] = -lhs[j];
+			}
+			break;
+		case Op::Sin:  vecmath::sin(lhs, res, count); break;
+		case Op::Cos:  vecmath::cos(lhs, res, count); break;
+		case Op::Ln:   vecmath::ln(lhs, res, failed, count); break;
+		case Op::Exp:  vecmath::exp(lhs, res, count); break;
+		case Op::Sqrt: vecmath::sqrt(lhs, res, failed, count); break;
+		}
+	}
+	for (size_t i = 0; i < outputs.size(); ++i) {
+		const double* res = vals.data() + outputs[i] * count;
+		std::copy(res, res + count, out + i * count);
+	}
+}
+
+// Follows the rules of Dual lane by lane.
+void Program::diff_batch(size_t var, const double* vars, size_t count, double* out,
+		unsigned char* failed, Scratch& scratch) const
+{
+	auto& vals = scratch.vals;
+	auto& derivs = scratch.derivs;
+	auto& cons = scratch.cons;
+	vals.resize(nodes.size() * count);
+	derivs.resize(nodes.size() * count);
+	cons.resize(nodes.size());
+	scratch.tmp.resize(2 * count);
+	double* tmp = scratch.tmp.data();
+	double* tmp2 = tmp + count;
+	std::fill(failed, failed + count, 0);
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const auto& node = nodes[i];
+		double* res = vals.data() + i * count;
+		double* dres = derivs.data() + i * count;
+		const double* lhs = vals.data() + node.lhs * count;
+		const double* rhs = vals.data() + node.rhs * count;
+		const double* dlhs = derivs.data() + node.lhs * count;
+		const double* drhs = derivs.data() + node.rhs * count;
+		switch (node.op) {
+		case Op::Const:
+			std::fill(res, res + count, consts[node.lhs]);
+			std::fill(dres, dres + count, 0.0);
+			cons[i] = true;
+			continue;
+		case Op::Var:
+			std::copy(vars + node.lhs * count, vars + (node.lhs + 1) * count, res);
+			std::fill(dres, dres + count, node.lhs == var ? 1.0 : 0.0);
+			cons[i] = node.lhs != var;
+			continue;
+		default:
+			cons[i] = cons[node.lhs] && (is_unary(node.op) || cons[node.rhs]);
+			break;
+		}
+		switch (node.op) {
+		case Op::Add:
+			for (size_t j = 0; j < count; ++j) {
+				res[j] = lhs[j] + rhs[j];
+				dres[j] = dlhs[j] + drhs[j];
+			}
+			break;
+		case Op::Sub:
+			for (size_t j = 0; j < count; ++j) {
+				res[j] = lhs[j] - rhs[j];
+				dres[j] = dlhs[j] - drhs[j];
+			}
+			break;
+		case Op::Mul:
+			for (size_t j = 0; j < count; ++j) {
+				res[j] = lhs[j] * rhs[j];
+				dres[j] = (dlhs[j] * rhs[j]) + (lhs[j] * drhs[j]);
+			}
+			break;
+		case Op::Div:
+			for (size_t j = 0; j < count; ++j) {
+				dres[j] = (dlhs[j] * rhs[j]) - (lhs[j] * drhs[j]);
+				tmp[j] = rhs[j] * rhs[j];
+			}
+			vecmath::div(lhs, rhs, res, failed, count);
+			vecmath::div(dres, tmp, dres, failed, count);
+			break;
+		case Op::Pow:
+			vecmath::pow(lhs, rhs, res, failed, count);
+			if (cons[node.rhs]) {
+				for (size_t j = 0; j < count; ++j) {
+					tmp[j] = rhs[j] - 1.0;
+				}
+				vecmath::pow(lhs, tmp, tmp, failed, count);
+				for (size_t j = 0; j < count; ++j) {
+					dres[j] = rhs[j] == 1.0 ? dlhs[j] : rhs[j] * tmp[j] * dlhs[j];
+				}
+			}
+			else {
+				for (size_t j = 0; j < count; ++j) {
+					tmp2[j] = dlhs[j] * rhs[j];
+				}
+				vecmath::ln(lhs, tmp, failed, count);
+				vecmath::div(tmp2, lhs, tmp2, failed, count);
+				for (size_t j = 0; j < count; ++j) {
+					dres[j] = res[j] * (drhs[j] * tmp[j] + tmp2[j]);
+				}
+			}
+			break;
+		case Op::Neg:
+			for (size_t j = 0; j < count; ++j) {
+				res[j] = -lhs[j];
+				dres[j] = -dlhs[j];
+			}
+			break;
+		case Op::Sin:  vecmath::sin_dual(lhs, dlhs, res, dres, count); break;
+		case Op::Cos:  vecmath::cos_dual(lhs, dlhs, res, dres, count); break;
+		case Op::Ln:   vecmath::ln_dual(lhs, dlhs, res, dres, failed, count); break;
+		case Op::Exp:  vecmath::exp_dual(lhs, dlhs, res, dres, count); break;
+		case Op::Sqrt: vecmath::sqrt_dual(lhs, dlhs, res, dres, failed, count); break;
+		case Op::Const:
+		case Op::Var:
+			break;
+		}
+	}
+	for (size_t i = 0; i < outputs.size(); ++i) {
+		const double* dres = derivs.data() + outputs[i] * count;
+		std::copy(dres, dres + count, out + i * count);
+	}
+}
+
+IncrementalEval::IncrementalEval(const Program& prog) :
+	prog(prog),
+	var_nodes(prog.var_count(), no_node),
+	vars(prog.var_count(), 0.0),
+	vals(prog.node_count(), 0.0),
+	queued(prog.node_count(), false),
+	valid(false),
+	recomputed(0)
+{
+	auto nodes = prog.get_nodes();
+	// Counting sort of operand edges by operand.
+	user_offsets.assign(nodes.size() + 1, 0);
+	auto for_operands = [&](size_t i, auto f) {
+		const auto& node = nodes[i];
+		if (is_binary(node.op) || is_unary(node.op)) {
+			f(node.lhs);
+		}
+		if (is_binary(node.op) && node.rhs != node.lhs) {
+			f(node.rhs);
+		}
+	};
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		for_operands(i, [&](uint32_t op) { ++user_offsets[op + 1]; });
+		if (nodes[i].op == Op::Var) {
+			var_nodes[nodes[i].lhs] = static_cast<uint32_t>(i);
+		}
+	}
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		user_offsets[i + 1] += user_offsets[i];
+	}
+	users.resize(user_offsets.back());
+	std::vector<uint32_t> fill(user_offsets.begin(), user_offsets.end() - 1);
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		for_operands(i, [&](uint32_t op) { users[fill[op]++] = static_cast<uint32_t>(i); });
+	}
+}
+
+void IncrementalEval::push(uint32_t node) {
+	if (!queued[node]) {
+		queued[node] = true;
+		heap.push_back(node);
+		std::push_heap(heap.begin(), heap.end(), std::greater<uint32_t>());
+	}
+}
+
+void IncrementalEval::set_all(const double* vars) {
+	for (size_t i = 0; i < this->vars.size(); ++i) {
+		set(i, vars[i]);
+	}
+}
+
+void IncrementalEval::set(size_t var, double val) {
+	// Values are compared bitwise, so that changes of the sign of zero and
+	// NaNs are propagated as well.
+	if (std::memcmp(&vars[var], &val, sizeof(val)) == 0) {
+		return;
+	}
+	vars[var] = val;
+	if (valid && var_nodes[var] != no_node) {
+		push(var_nodes[var]);
+	}
+}
+
+void IncrementalEval::eval_all() {
+	auto nodes = prog.get_nodes();
+	auto consts = prog.get_consts();
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const auto& node = nodes[i];
+		switch (node.op) {
+		case Op::Const:
+			vals[i] = consts[node.lhs];
+			break;
+		case Op::Var:
+			vals[i] = vars[node.lhs];
+			break;
+		default:
+			vals[i] = apply<Float>(node.op, vals[node.lhs], vals[node.rhs]).val;
+			break;
+		}
+	}
+	recomputed = nodes.size();
+}
+
+void IncrementalEval::update() {
+	auto nodes = prog.get_nodes();
+	try {
+		if (!valid) {
+			eval_all();
+			valid = true;
+			return;
+		}
+		recomputed = 0;
+		while (!heap.empty()) {
+			std::pop_heap(heap.begin(), heap.end(), std::greater<uint32_t>());
+			uint32_t i = heap.back();
+			heap.pop_back();
+			queued[i] = false;
+			const auto& node = nodes[i];
+			double val = node.op == Op::Var
+				? vars[node.lhs]
+				: apply<Float>(node.op, vals[node.lhs], vals[node.rhs]).val;
+			++recomputed;
+			if (std::memcmp(&vals[i], &val, sizeof(val)) == 0) {
+				continue;
+			}
+			vals[i] = val;
+			for (uint32_t k = user_offsets[i]; k < user_offsets[i + 1]; ++k) {
+				push(users[k]);
+			}
+		}
+	}
+	catch (const MathError&) {
+		for (auto i : heap) {
+			queued[i] = false;
+		}
+		heap.clear();
+		valid = false;
+		throw;
+	}
+}
+
+double IncrementalEval::var(size_t i) const {
+	return vars[i];
+}
+
+double IncrementalEval::output(size_t i) const {
+	return vals[prog.get_outputs()[i]];
+}
+
+size_t IncrementalEval::last_recomputed() const {
+	return recomputed;
+}
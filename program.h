@@ -0,0 +1,199 @@
+#ifndef ROOTS_PROGRAM_H
+#define ROOTS_PROGRAM_H
+
+#include "expr.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class MappedFile;
+
+// System of expressions compiled into a flat list of nodes, which can be
+// evaluated without traversing expression trees, saved to a compact binary
+// file and loaded back by mapping the file into memory.
+//
+// Nodes are stored in topological order: operands of a node always precede it.
+// Shared subtrees, variables, equal constants and equal operations on the same
+// operands, also across functions, are stored once.
+class Program {
+public:
+	enum class Op : uint32_t {
+		Const,
+		Var,
+		Add,
+		Sub,
+		Mul,
+		Div,
+		Pow,
+		Neg,
+		Sin,
+		Cos,
+		Ln,
+		Exp,
+		Sqrt,
+	};
+
+	// For Const nodes lhs is an index into constants, for Var nodes an index
+	// into variables. Otherwise lhs and rhs are indices of operand nodes,
+	// with rhs unused by unary operations.
+	struct Node {
+		Op op;
+		uint32_t lhs;
+		uint32_t rhs;
+	};
+
+	template<typename T>
+	struct Span {
+		const T* ptr = nullptr;
+		size_t len = 0;
+
+		const T& operator[](size_t i) const { return ptr[i]; }
+		const T* begin() const { return ptr; }
+		const T* end() const { return ptr + len; }
+		size_t size() const { return len; }
+	};
+
+	// Buffers for intermediate values, reused between evaluations.
+	struct Scratch {
+		std::vector<double> vals;
+		std::vector<double> derivs;
+		std::vector<char> cons;
+		std::vector<double> tmp;
+	};
+
+private:
+	// Storage of compiled programs. Empty for programs loaded from files.
+	std::vector<Node> node_buf;
+	std::vector<double> const_buf;
+	std::vector<uint32_t> output_buf;
+	std::vector<uint32_t> name_offset_buf;
+	std::string name_buf;
+	std::vector<uint32_t> dep_offset_buf;
+	std::vector<uint32_t> dep_buf;
+	// Mapping of the file the program was loaded from.
+	std::unique_ptr<MappedFile> file;
+
+	// Program data, pointing either to the storage or to the mapped file.
+	Span<Node> nodes;
+	Span<double> consts;
+	Span<uint32_t> outputs;
+	Span<uint32_t> name_offsets;
+	Span<char> names;
+	Span<uint32_t> dep_offsets;
+	Span<uint32_t> deps;
+
+	Program();
+	void attach();
+	void validate() const;
+
+public:
+	Program(Program&&);
+	Program& operator=(Program&&);
+	~Program();
+
+	// Compiles functions using the given variable order. When sparsity is
+	// set, the program also records which variables each function depends on.
+	// Throws MathError if a function uses a variable not in vars.
+	static Program compile(const std::vector<Expr>& funcs,
+			const std::vector<std::string>& vars, bool sparsity = true);
+
+	// Returns the binary representation of the program.
+	std::string serialize() const;
+	// Writes the binary representation to a file.
+	// Throws std::system_error on failure.
+	void save(const std::string& path) const;
+	// Maps a file written by save(). Evaluation reads directly from the
+	// mapping. Throws std::system_error if the file can't be read and
+	// ParseError if it's not a valid program.
+	static Program load(const std::string& path);
+
+	size_t node_count() const;
+	size_t var_count() const;
+	size_t output_count() const;
+	std::string_view var_name(size_t i) const;
+	Span<Node> get_nodes() const;
+	Span<double> get_consts() const;
+	Span<uint32_t> get_outputs() const;
+
+	// Returns true if the program records function dependencies.
+	bool has_sparsity() const;
+	// Returns sorted indices of the variables the function depends on.
+	Span<uint32_t> dependencies(size_t output) const;
+
+	// Evaluates all functions with variables given in program order.
+	// Throws MathError on failure.
+	void eval(const double* vars, double* out, Scratch& scratch) const;
+
+	// Partially differentiates all functions in relation to the given
+	// variable. Throws MathError on failure.
+	void diff(size_t var, const double* vars, double* out, Scratch& scratch) const;
+
+	// Evaluates all functions at count points at once, applying elementary
+	// functions to whole arrays with the SIMD kernels of vecmath.h. Points
+	// are stored by variable, the value of variable i at point j being
+	// vars[i*count + j], and so are the results in out[k*count + j].
+	// Results may differ from eval() by rounding errors of the kernels.
+	// Instead of throwing domain errors, sets failed[j] to 1 if evaluation
+	// fails at point j and to 0 otherwise. Results at failed points are
+	// unspecified.
+	void eval_batch(const double* vars, size_t count, double* out,
+			unsigned char* failed, Scratch& scratch) const;
+
+	// Partially differentiates all functions at count points at once, with
+	// the same layout and failure reporting as eval_batch().
+	void diff_batch(size_t var, const double* vars, size_t count, double* out,
+			unsigned char* failed, Scratch& scratch) const;
+};
+
+// Evaluation context which caches the values of all nodes of a program. After
+// some variables change, update() recomputes only the nodes depending on
+// them, in topological order. Propagation stops at nodes whose values didn't
+// change, so the cost of an update is proportional to the part of the program
+// it affects. The program must outlive the context.
+class IncrementalEval {
+private:
+	const Program& prog;
+	// Nodes using each node as an operand, users of node i being
+	// users[user_offsets[i]] to users[user_offsets[i + 1] - 1].
+	std::vector<uint32_t> user_offsets;
+	std::vector<uint32_t> users;
+	// Node of each variable, or no_node if the program doesn't use it.
+	std::vector<uint32_t> var_nodes;
+	std::vector<double> vars;
+	std::vector<double> vals;
+	// Min-heap of nodes to recompute, with queued marking its members.
+	std::vector<uint32_t> heap;
+	std::vector<char> queued;
+	// False until the first successful update and after failed ones.
+	bool valid;
+	size_t recomputed;
+
+	void push(uint32_t node);
+	void eval_all();
+
+public:
+	static constexpr uint32_t no_node = UINT32_MAX;
+
+	// Creates a context with all variables set to zero.
+	explicit IncrementalEval(const Program& prog);
+
+	// Sets all variables, given in program order, and marks the nodes
+	// depending on those which changed.
+	void set_all(const double* vars);
+	// Sets one variable.
+	void set(size_t var, double val);
+	// Brings all cached values up to date. Throws MathError on failure, after
+	// which outputs are unspecified until a successful update, which then
+	// evaluates the whole program.
+	void update();
+
+	double var(size_t i) const;
+	double output(size_t i) const;
+	// Number of nodes recomputed by the last update.
+	size_t last_recomputed() const;
+};
+
+#endif // ROOTS_PROGRAM_H
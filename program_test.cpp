@@ -0,0 +1,269 @@
+#include "program.h"
+
+#include "common.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const std::vector<std::string> system_vars = {"x", "y", "z"};
+
+std::vector<Expr> system_funcs() {
+	return {
+		Expr::parse("x^3 - 5*x^2 + 2*x - y + 13"),
+		Expr::parse("sin(x)*exp(y) / sqrt(z) - ln(x + 3)"),
+		Expr::parse("2*y - x*z - 1"),
+		Expr::parse("(x + 2)^y + 7"),
+	};
+}
+
+const std::vector<std::vector<double>> points = {
+	{1.0, 2.0, 3.0},
+	{-1.5, 0.25, 4.0},
+	{4.0, 5.0, 2.25},
+};
+
+void expect_program_eq(const Program& prog, const std::vector<Expr>& funcs) {
+	Program::Scratch scratch;
+	std::vector<double> out(funcs.size());
+	for (const auto& p : points) {
+		Expr::Env env;
+		for (size_t i = 0; i < system_vars.size(); ++i) {
+			env[system_vars[i]] = p[i];
+		}
+		prog.eval(p.data(), out.data(), scratch);
+		for (size_t i = 0; i < funcs.size(); ++i) {
+			EXPECT_EQ(out[i], funcs[i].eval(env)) << "value of function " << i;
+		}
+		for (size_t j = 0; j < system_vars.size(); ++j) {
+			prog.diff(j, p.data(), out.data(), scratch);
+			for (size_t i = 0; i < funcs.size(); ++i) {
+				EXPECT_EQ(out[i], funcs[i].diff(system_vars[j], env))
+					<< "derivative of function " << i << " in " << system_vars[j];
+			}
+		}
+	}
+}
+
+std::string temp_path(const std::string& name) {
+	return testing::TempDir() + name;
+}
+
+} // end anon
+
+TEST(ProgramTest, Compile) {
+	auto funcs = system_funcs();
+	auto prog = Program::compile(funcs, system_vars);
+	EXPECT_EQ(prog.output_count(), funcs.size()) << "number of outputs";
+	EXPECT_EQ(prog.var_count(), system_vars.size()) << "number of variables";
+	EXPECT_EQ(prog.var_name(1), "y") << "variable name";
+	expect_program_eq(prog, funcs);
+}
+
+TEST(ProgramTest, SharedNodes) {
+	auto prog = Program::compile({Expr::parse("x*x + 2*x + 2")}, {"x"});
+	// x, x*x, 2, 2*x, x*x + 2*x, (x*x + 2*x) + 2
+	EXPECT_EQ(prog.node_count(), 6) << "number of nodes";
+	prog = Program::compile({Expr::parse("sin(x*y) + 1"), Expr::parse("2 - sin(x*y)")}, {"x", "y"});
+	// x, y, x*y, sin(x*y), 1, sin(x*y) + 1, 2, 2 - sin(x*y)
+	EXPECT_EQ(prog.node_count(), 8) << "number of nodes shared by functions";
+}
+
+TEST(ProgramTest, Sparsity) {
+	auto prog = Program::compile(system_funcs(), system_vars);
+	ASSERT_TRUE(prog.has_sparsity());
+	std::vector<std::vector<uint32_t>> expected = {{0, 1}, {0, 1, 2}, {0, 1, 2}, {0, 1}};
+	for (size_t i = 0; i < expected.size(); ++i) {
+		auto deps = prog.dependencies(i);
+		EXPECT_EQ(std::vector<uint32_t>(deps.begin(), deps.end()), expected[i])
+			<< "dependencies of function " << i;
+	}
+	EXPECT_FALSE(Program::compile(system_funcs(), system_vars, false).has_sparsity());
+}
+
+TEST(ProgramTest, UndefinedVariable) {
+	EXPECT_THROW(Program::compile({Expr::parse("x + w")}, {"x"}), MathError);
+}
+
+TEST(ProgramTest, DomainError) {
+	auto prog = Program::compile({Expr::parse("ln(x)")}, {"x"});
+	Program::Scratch scratch;
+	double x = -1.0;
+	double out;
+	EXPECT_THROW(prog.eval(&x, &out, scratch), MathError);
+	EXPECT_THROW(prog.diff(0, &x, &out, scratch), MathError);
+}
+
+TEST(ProgramTest, Batch) {
+	auto funcs = system_funcs();
+	auto prog = Program::compile(funcs, system_vars);
+	// Points of the other tests followed by points at which some functions
+	// fail: ln(x + 3) for x <= -3, sqrt(z) for z <= 0 and the power for
+	// negative x + 2 with non-integer y.
+	auto batch = points;
+	batch.push_back({-3.0, 1.0, 1.0});
+	batch.push_back({0.5, 1.0, 0.0});
+	batch.push_back({-2.5, 0.5, 1.0});
+	batch.push_back({-2.5, 2.0, 1.0});
+	size_t count = batch.size();
+	std::vector<double> vars(system_vars.size() * count);
+	for (size_t j = 0; j < count; ++j) {
+		for (size_t i = 0; i < system_vars.size(); ++i) {
+			vars[i * count + j] = batch[j][i];
+		}
+	}
+	Program::Scratch scratch;
+	std::vector<double> out(funcs.size() * count);
+	std::vector<unsigned char> failed(count);
+	std::vector<double> scalar_out(funcs.size());
+	auto expect_batch_eq = [&](const std::string& what, auto scalar) {
+		for (size_t j = 0; j < count; ++j) {
+			bool fails = false;
+			try {
+				scalar(batch[j].data(), scalar_out.data());
+			}
+			catch (const MathError&) {
+				fails = true;
+			}
+			EXPECT_EQ(failed[j], fails) << what << " failure at point " << j;
+			if (fails) {
+				continue;
+			}
+			for (size_t i = 0; i < funcs.size(); ++i) {
+				double expected = scalar_out[i];
+				EXPECT_NEAR(out[i * count + j], expected, 1e-14 * (1.0 + std::abs(expected)))
+					<< what << " of function " << i << " at point " << j;
+			}
+		}
+	};
+	prog.eval_batch(vars.data(), count, out.data(), failed.data(), scratch);
+	expect_batch_eq("value", [&](const double* p, double* res) {
+		prog.eval(p, res, scratch);
+	});
+	for (size_t v = 0; v < system_vars.size(); ++v) {
+		prog.diff_batch(v, vars.data(), count, out.data(), failed.data(), scratch);
+		expect_batch_eq("derivative in " + system_vars[v], [&](const double* p, double* res) {
+			prog.diff(v, p, res, scratch);
+		});
+	}
+}
+
+TEST(ProgramTest, Incremental) {
+	auto funcs = system_funcs();
+	auto prog = Program::compile(funcs, system_vars);
+	IncrementalEval inc(prog);
+	Program::Scratch scratch;
+	std::vector<double> out(funcs.size());
+	auto expect_current = [&](const std::string& what) {
+		std::vector<double> vars;
+		for (size_t i = 0; i < system_vars.size(); ++i) {
+			vars.push_back(inc.var(i));
+		}
+		prog.eval(vars.data(), out.data(), scratch);
+		for (size_t i = 0; i < funcs.size(); ++i) {
+			EXPECT_EQ(inc.output(i), out[i]) << "function " << i << " " << what;
+		}
+	};
+	inc.set_all(points[0].data());
+	inc.update();
+	EXPECT_EQ(inc.last_recomputed(), prog.node_count()) << "first update";
+	expect_current("after first update");
+	inc.set(2, 5.0);
+	inc.update();
+	EXPECT_LT(inc.last_recomputed(), prog.node_count()) << "update of z";
+	expect_current("after update of z");
+	inc.set(2, 5.0);
+	inc.update();
+	EXPECT_EQ(inc.last_recomputed(), 0) << "update without changes";
+	for (const auto& p : points) {
+		inc.set_all(p.data());
+		inc.update();
+		expect_current("after update of all variables");
+	}
+	// ln(x + 3) fails, after which the next update evaluates everything.
+	inc.set(0, -4.0);
+	EXPECT_THROW(inc.update(), MathError);
+	inc.set(0, 1.0);
+	inc.update();
+	EXPECT_EQ(inc.last_recomputed(), prog.node_count()) << "update after failure";
+	expect_current("after failure");
+}
+
+TEST(ProgramTest, IncrementalCost) {
+	// Chain of equations, each using two neighbouring variables.
+	constexpr size_t n = 100;
+	std::vector<Expr> funcs;
+	std::vector<std::string> vars;
+	for (size_t i = 0; i < n; ++i) {
+		vars.push_back("x" + std::to_string(i));
+	}
+	for (size_t i = 0; i + 1 < n; ++i) {
+		funcs.push_back(Expr::parse("sin(" + vars[i] + ") * " + vars[i + 1] + " - 1"));
+	}
+	auto prog = Program::compile(funcs, vars);
+	IncrementalEval inc(prog);
+	std::vector<double> init(n, 1.0);
+	inc.set_all(init.data());
+	inc.update();
+	inc.set(50, 2.0);
+	inc.update();
+	// The variable, the sine, two products and two differences.
+	EXPECT_EQ(inc.last_recomputed(), 6);
+	double expected = std::sin(2.0) * 1.0 - 1;
+	EXPECT_EQ(inc.output(50), expected);
+	expected = std::sin(1.0) * 2.0 - 1;
+	EXPECT_EQ(inc.output(49), expected);
+	// With x1 = 0 changing x0 changes its sine, but not the product.
+	inc.set(1, 0.0);
+	inc.update();
+	inc.set(0, 3.0);
+	inc.update();
+	EXPECT_EQ(inc.last_recomputed(), 3) << "propagation past an unchanged value";
+}
+
+TEST(ProgramTest, SaveLoad) {
+	auto funcs = system_funcs();
+	auto path = temp_path("program_test.bin");
+	Program::compile(funcs, system_vars).save(path);
+	auto prog = Program::load(path);
+	EXPECT_EQ(prog.output_count(), funcs.size()) << "number of outputs";
+	ASSERT_EQ(prog.var_count(), system_vars.size()) << "number of variables";
+	for (size_t i = 0; i < system_vars.size(); ++i) {
+		EXPECT_EQ(prog.var_name(i), system_vars[i]) << "name of variable " << i;
+	}
+	EXPECT_TRUE(prog.has_sparsity());
+	expect_program_eq(prog, funcs);
+	std::remove(path.c_str());
+}
+
+TEST(ProgramTest, LoadInvalid) {
+	auto data = Program::compile(system_funcs(), system_vars).serialize();
+	auto path = temp_path("program_test_invalid.bin");
+	auto write = [&](const std::string& contents) {
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out << contents;
+	};
+	write(data.substr(0, data.size() / 2));
+	EXPECT_THROW(Program::load(path), ParseError) << "truncated file";
+	auto bad_magic = data;
+	bad_magic[0] = 'X';
+	write(bad_magic);
+	EXPECT_THROW(Program::load(path), ParseError) << "bad magic";
+	write("");
+	EXPECT_THROW(Program::load(path), ParseError) << "empty file";
+	// Second operand of a unary node pointing outside of the program.
+	auto sine = Program::compile({Expr::parse("sin(x)")}, {"x"}).serialize();
+	Program::Node node{Program::Op::Sin, 0, 0};
+	auto pos = sine.find(std::string(reinterpret_cast<const char*>(&node), sizeof(node)));
+	ASSERT_NE(pos, std::string::npos) << "sine node";
+	node.rhs = 100000000;
+	sine.replace(pos, sizeof(node), reinterpret_cast<const char*>(&node), sizeof(node));
+	write(sine);
+	EXPECT_THROW(Program::load(path), ParseError) << "unary operand out of range";
+	std::remove(path.c_str());
+	EXPECT_THROW(Program::load(path), std::system_error) << "missing file";
+}
@@ -0,0 +1,321 @@
+#include "search.h"
+
+#include "common.h"
+#include "matrix.h"
+#include "num.h"
+#include "pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <optional>
+
+namespace {
+
+using Box = std::vector<Interval>;
+
+struct Outcome {
+	enum Kind {
+		// Box contains no roots.
+		Excluded,
+		// Box contains exactly one root.
+		Verified,
+		// Box is too small to be subdivided.
+		Small,
+		// Box was split into children.
+		Split,
+	};
+
+	Kind kind;
+	Box box;
+	std::vector<Box> children;
+};
+
+struct Candidate {
+	Box box;
+	bool verified;
+};
+
+// Point at which a side of a box is bisected. Sides unbounded on one end are
+// split at twice the magnitude of their finite end, and at least one away
+// from zero, since splitting at the finite end would give back the same side.
+double split_point(const Interval& x) {
+	double max = std::numeric_limits<double>::max();
+	if (std::isinf(x.lo) && !std::isinf(x.hi)) {
+		return -std::min(std::max(1.0, 2 * std::abs(x.hi)), max);
+	}
+	if (std::isinf(x.hi) && !std::isinf(x.lo)) {
+		return std::min(std::max(1.0, 2 * std::abs(x.lo)), max);
+	}
+	return x.mid();
+}
+
+class Searcher {
+private:
+	const std::vector<Expr>& funcs;
+	std::vector<std::string> names;
+	const SearchOptions& opts;
+
+	Expr::IntervalEnv make_env(const Box& box) const;
+	bool krawczyk(Box& box, bool& verified) const;
+
+public:
+	Searcher(const std::vector<Expr>& funcs, std::vector<std::string> names,
+			const SearchOptions& opts);
+
+	Outcome process(Box box) const;
+	bool verify(const Solution& sol) const;
+};
+
+Searcher::Searcher(const std::vector<Expr>& funcs, std::vector<std::string> names,
+		const SearchOptions& opts) :
+	funcs(funcs),
+	names(std::move(names)),
+	opts(opts) {}
+
+Expr::IntervalEnv Searcher::make_env(const Box& box) const {
+	Expr::IntervalEnv env;
+	for (size_t i = 0; i < box.size(); ++i) {
+		env.emplace(names[i], box[i]);
+	}
+	return env;
+}
+
+// Applies the Krawczyk operator
+//   K(X) = m - Y f(m) + (I - Y J(X)) (X - m)
+// where m is the midpoint of X, J(X) encloses the Jacobian over X and Y is the
+// inverse of the Jacobian at m. Every root in X lies in K(X), and if K(X) is
+// in the interior of X, X contains exactly one root.
+// The theorem needs the functions to be differentiable on all of X, so the
+// operator is applied only when interval evaluation didn't ignore any points
+// outside of their domain.
+// Narrows the box to its intersection with K(X). Returns false if the
+// intersection is empty. Leaves the box as it is if the operator can't be
+// computed.
+bool Searcher::krawczyk(Box& box, bool& verified) const {
+	size_t n = box.size();
+	Expr::Env point;
+	Expr::IntervalEnv point_env;
+	std::vector<double> mid(n);
+	for (size_t i = 0; i < n; ++i) {
+		mid[i] = box[i].mid();
+		point.emplace(names[i], mid[i]);
+		point_env.emplace(names[i], Interval(mid[i]));
+	}
+	std::optional<Matrix> y;
+	{
+		FaultTrap trap;
+		Matrix jac(n, n, [&](size_t i, size_t j) {
+			return funcs[i].diff(names[j], point);
+		});
+		if (trap.raised()) {
+			return true;
+		}
+		y = jac.inverse();
+	}
+	if (!y) {
+		return true;
+	}
+	auto env = make_env(box);
+	std::vector<Interval> fm(n);
+	std::vector<Interval> jac(n * n);
+	for (size_t i = 0; i < n; ++i) {
+		fm[i] = funcs[i].eval_interval(point_env);
+		if (!fm[i].defined) {
+			return true;
+		}
+		for (size_t j = 0; j < n; ++j) {
+			jac[i*n + j] = funcs[i].diff_interval(names[j], env);
+			if (!jac[i*n + j].defined) {
+				return true;
+			}
+		}
+	}
+	verified = true;
+	for (size_t i = 0; i < n; ++i) {
+		Interval k = mid[i];
+		for (size_t l = 0; l < n; ++l) {
+			k = k - Interval((*y)[{i, l}]) * fm[l];
+		}
+		for (size_t j = 0; j < n; ++j) {
+			Interval c = i == j ? 1.0 : 0.0;
+			for (size_t l = 0; l < n; ++l) {
+				c = c - Interval((*y)[{i, l}]) * jac[l*n + j];
+			}
+			k = k + c * (box[j] - Interval(mid[j]));
+		}
+		verified = verified && box[i].interior_contains(k);
+		box[i] = intersect(box[i], k);
+		if (box[i].is_empty()) {
+			verified = false;
+			return false;
+		}
+	}
+	return true;
+}
+
+Outcome Searcher::process(Box box) const {
+	auto env = make_env(box);
+	for (const auto& f : funcs) {
+		auto y = f.eval_interval(env);
+		if (y.is_empty() || !y.contains(0.0)) {
+			return Outcome{Outcome::Excluded, {}, {}};
+		}
+	}
+	if (funcs.size() == box.size()) {
+		bool verified = false;
+		if (!krawczyk(box, verified)) {
+			return Outcome{Outcome::Excluded, {}, {}};
+		}
+		if (verified) {
+			return Outcome{Outcome::Verified, std::move(box), {}};
+		}
+	}
+	size_t widest = 0;
+	for (size_t i = 1; i < box.size(); ++i) {
+		if (box[i].width() > box[widest].width()) {
+			widest = i;
+		}
+	}
+	if (box[widest].width() < opts.min_width) {
+		return Outcome{Outcome::Small, std::move(box), {}};
+	}
+	auto left = box;
+	auto right = box;
+	double mid = split_point(box[widest]);
+	left[widest].hi = mid;
+	right[widest].lo = mid;
+	return Outcome{Outcome::Split, {}, {std::move(left), std::move(right)}};
+}
+
+// Roots lying on boundaries of boxes created by bisection can't be verified
+// in these boxes, so roots are verified again in small boxes around them.
+bool Searcher::verify(const Solution& sol) const {
+	if (funcs.size() != names.size()) {
+		return false;
+	}
+	Box box;
+	for (const auto& b : sol.vars) {
+		double r = 1e-8 * (1.0 + std::abs(b.second));
+		box.emplace_back(b.second - r, b.second + r);
+	}
+	bool verified = false;
+	krawczyk(box, verified);
+	return verified;
+}
+
+bool inside(const Solution& sol, const Box& box) {
+	for (size_t i = 0; i < box.size(); ++i) {
+		if (!box[i].contains(sol.vars[i].second)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool same_root(const Solution& a, const Solution& b, double width) {
+	for (size_t i = 0; i < a.vars.size(); ++i) {
+		double x = a.vars[i].second;
+		double y = b.vars[i].second;
+		if (std::abs(x - y) > std::max(width, 1e-12 * std::max(std::abs(x), std::abs(y)))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // end anon
+
+SearchResult
+search(const std::vector<Expr>& funcs, const std::vector<Range>& box,
+		const SearchOptions& opts)
+{
+	std::vector<std::string> names;
+	Box initial;
+	for (const auto& r : box) {
+		names.push_back(r.first);
+		initial.push_back(r.second);
+	}
+	Searcher searcher(funcs, names, opts);
+	ThreadPool pool(opts.threads);
+	SearchResult res;
+
+	std::vector<Candidate> candidates;
+	std::vector<Box> level = {initial};
+	while (!level.empty()) {
+		if (res.boxes + level.size() > opts.max_boxes) {
+			res.incomplete = true;
+			for (auto& b : level) {
+				candidates.push_back(Candidate{std::move(b), false});
+			}
+			break;
+		}
+		std::vector<Outcome> outcomes(level.size());
+		pool.parallel_for(level.size(), [&](size_t i) {
+			outcomes[i] = searcher.process(std::move(level[i]));
+		});
+		res.boxes += level.size();
+		std::vector<Box> next;
+		for (auto& out : outcomes) {
+			switch (out.kind) {
+			case Outcome::Excluded:
+				++res.excluded;
+				break;
+			case Outcome::Verified:
+				candidates.push_back(Candidate{std::move(out.box), true});
+				break;
+			case Outcome::Small:
+				candidates.push_back(Candidate{std::move(out.box), false});
+				break;
+			case Outcome::Split:
+				for (auto& child : out.children) {
+					next.push_back(std::move(child));
+				}
+				break;
+			}
+		}
+		level = std::move(next);
+	}
+
+	std::vector<std::optional<Solution>> solutions(candidates.size());
+	std::atomic<bool> cancelled{false};
+	pool.parallel_for(candidates.size(), [&](size_t i) {
+		std::vector<Binding> init;
+		for (size_t j = 0; j < names.size(); ++j) {
+			init.emplace_back(names[j], candidates[i].box[j].mid());
+		}
+		auto res = try_solve(funcs, init, opts.constr);
+		if (res.ok()) {
+			solutions[i] = std::move(res.solution);
+		}
+		else if (res.status == SolveStatus::Cancelled) {
+			cancelled = true;
+		}
+	});
+	if (cancelled) {
+		throw CancelledError("search cancelled");
+	}
+	for (size_t i = 0; i < candidates.size(); ++i) {
+		auto& sol = solutions[i];
+		if (!sol || !inside(*sol, initial)) {
+			continue;
+		}
+		bool verified = candidates[i].verified && inside(*sol, candidates[i].box);
+		bool found = false;
+		for (size_t j = 0; j < res.roots.size() && !found; ++j) {
+			if (same_root(res.roots[j], *sol, opts.min_width)) {
+				res.verified[j] = res.verified[j] || verified;
+				found = true;
+			}
+		}
+		if (!found) {
+			res.roots.push_back(std::move(*sol));
+			res.verified.push_back(verified);
+		}
+	}
+	for (size_t j = 0; j < res.roots.size(); ++j) {
+		res.verified[j] = res.verified[j] || searcher.verify(res.roots[j]);
+	}
+	return res;
+}
@@ -0,0 +1,57 @@
+#ifndef ROOTS_SEARCH_H
+#define ROOTS_SEARCH_H
+
+#include "expr.h"
+#include "interval.h"
+#include "solve.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using Range = std::pair<std::string, Interval>;
+
+struct SearchOptions {
+	// Boxes narrower than min_width in every variable aren't subdivided
+	// further. Roots closer to each other than min_width are reported once.
+	double min_width = 1e-6;
+	// Maximal number of boxes examined. When the limit is reached, Newton's
+	// method is started from all boxes left unexamined.
+	size_t max_boxes = 100000;
+	// Number of threads used, zero means one per hardware thread.
+	size_t threads = 0;
+	// Constraints of Newton's method run in the surviving boxes. The observer,
+	// if set, is invoked concurrently from multiple threads.
+	Constraints constr;
+};
+
+struct SearchResult {
+	// Distinct roots found inside the bounding box, each with a flag telling
+	// whether it was proven to be the only root in some box.
+	std::vector<Solution> roots;
+	std::vector<bool> verified;
+	// Number of boxes examined and of boxes proven to contain no roots.
+	size_t boxes = 0;
+	size_t excluded = 0;
+	// Set if the search stopped at max_boxes.
+	bool incomplete = false;
+};
+
+// Finds roots of the system inside the bounding box by branch and prune.
+// Boxes are discarded when interval evaluation proves that some function has
+// no zero in them, and, for square systems, narrowed by the Krawczyk operator,
+// which also proves existence and uniqueness of a root in a box. Boxes that
+// survive are bisected until they're proven to contain a single root or become
+// narrower than min_width, then Newton's method is run from their midpoints.
+// Sides of the bounding box may be unbounded, and are then split ever further
+// from zero, so that the search may only end at max_boxes.
+// Boxes of one level and Newton's runs are processed in parallel.
+//
+// Roots of multiplicity greater than one and roots of non-square systems can't
+// be verified, so the same root may be found from many small boxes; duplicates
+// are merged. Throws MathError on undefined variables.
+SearchResult
+search(const std::vector<Expr>& funcs, const std::vector<Range>& box,
+		const SearchOptions& opts = SearchOptions());
+
+#endif // ROOTS_SEARCH_H
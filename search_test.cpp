@@ -0,0 +1,89 @@
+#include "search.h"
+
+#include "expr.h"
+#include "test_util.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace {
+
+std::vector<double> sorted_roots(const SearchResult& res, size_t var) {
+	std::vector<double> xs;
+	for (const auto& r : res.roots) {
+		xs.push_back(r.vars[var].second);
+	}
+	std::sort(xs.begin(), xs.end());
+	return xs;
+}
+
+} // end anon
+
+TEST(SearchTest, CircleLine) {
+	auto funcs = parse_all({"x^2 + y^2 - 16", "y - (2*x - 3)"});
+	auto res = search(funcs, {{"x", Interval(-10, 10)}, {"y", Interval(-10, 10)}});
+	ASSERT_EQ(res.roots.size(), 2u);
+	auto xs = sorted_roots(res, 0);
+	EXPECT_NEAR(xs[0], (12 - std::sqrt(284.0)) / 10, 1e-12);
+	EXPECT_NEAR(xs[1], (12 + std::sqrt(284.0)) / 10, 1e-12);
+	EXPECT_TRUE(res.verified[0]);
+	EXPECT_TRUE(res.verified[1]);
+	EXPECT_GT(res.excluded, 0u);
+	EXPECT_FALSE(res.incomplete);
+}
+
+TEST(SearchTest, Sine) {
+	auto funcs = parse_all({"sin(x)"});
+	auto res = search(funcs, {{"x", Interval(-10, 10)}});
+	auto xs = sorted_roots(res, 0);
+	ASSERT_EQ(xs.size(), 7u);
+	for (size_t i = 0; i < xs.size(); ++i) {
+		EXPECT_NEAR(xs[i], (double(i) - 3) * M_PI, 1e-12);
+	}
+}
+
+TEST(SearchTest, NoRoots) {
+	auto funcs = parse_all({"x^2 + y^2 + 1", "x - y"});
+	auto res = search(funcs, {{"x", Interval(-5, 5)}, {"y", Interval(-5, 5)}});
+	EXPECT_TRUE(res.roots.empty());
+	EXPECT_EQ(res.boxes, res.excluded);
+}
+
+TEST(SearchTest, Domain) {
+	// Roots outside of the domain of sqrt don't exist, and the part of the
+	// box where the function is undefined is discarded.
+	auto funcs = parse_all({"sqrt(x) - 2"});
+	auto res = search(funcs, {{"x", Interval(-10, 10)}});
+	ASSERT_EQ(res.roots.size(), 1u);
+	EXPECT_NEAR(res.roots[0].vars[0].second, 4.0, 1e-12);
+}
+
+TEST(SearchTest, Unbounded) {
+	auto funcs = parse_all({"x^2 - 4"});
+	auto res = search(funcs, {{"x", Interval::entire()}});
+	auto xs = sorted_roots(res, 0);
+	ASSERT_EQ(xs.size(), 2u);
+	EXPECT_NEAR(xs[0], -2.0, 1e-12);
+	EXPECT_NEAR(xs[1], 2.0, 1e-12);
+	EXPECT_FALSE(res.incomplete);
+
+	// Sides unbounded on one end are split ever further out.
+	funcs = parse_all({"x - 1000000"});
+	res = search(funcs, {{"x", Interval(-1.0, std::numeric_limits<double>::infinity())}});
+	ASSERT_EQ(res.roots.size(), 1u);
+	EXPECT_NEAR(res.roots[0].vars[0].second, 1e6, 1e-6);
+	EXPECT_FALSE(res.incomplete);
+}
+
+TEST(SearchTest, Limit) {
+	auto funcs = parse_all({"sin(x)"});
+	SearchOptions opts;
+	opts.max_boxes = 3;
+	auto res = search(funcs, {{"x", Interval(-10, 10)}}, opts);
+	EXPECT_TRUE(res.incomplete);
+	EXPECT_LE(res.boxes, 3u);
+}
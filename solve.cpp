@@ -2,9 +2,20 @@
 
 #include "common.h"
 #include "matrix.h"
+#include "lu.h"
+#include "num.h"
+#include "poly.h"
+#include "pool.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <stdexcept>
+#include <thread>
+#include <utility>
 
 namespace {
 
@@ -14,9 +25,7 @@ bool equals(double a, double b, double abs_eps, double rel_eps) {
 	return delta <= abs_eps || delta <= scale * rel_eps;
 }
 
-bool matrix_equals(const Matrix& a, const Matrix& b, Constraints constr) {
-	double abs_eps = constr.abs_epsilon;
-	double rel_eps = constr.rel_epsilon;
+bool matrix_equals(const Matrix& a, const Matrix& b, double abs_eps, double rel_eps) {
 	for (size_t i = 0; i < a.get_height(); ++i) {
 		for (size_t j = 0; j < a.get_width(); ++j) {
 			if (!equals(a[{i, j}], b[{i, j}], abs_eps, rel_eps)) {
@@ -27,41 +36,656 @@ bool matrix_equals(const Matrix& a, const Matrix& b, Constraints constr) {
 	return true;
 }
 
-} // end anon
+double max_abs(const Matrix& m) {
+	double res = 0.0;
+	for (size_t i = 0; i < m.get_height(); ++i) {
+		for (size_t j = 0; j < m.get_width(); ++j) {
+			res = std::max(res, std::abs(m[{i, j}]));
+		}
+	}
+	return res;
+}
 
-Solution
-solve(const std::vector<Expr>& funcs, const std::vector<Binding>& init, Constraints constr) {
-	Matrix x0(init.size(), 1, [&](size_t i, size_t j) {
-		return init[i].second;
-	});
+double max_abs_diff(const Matrix& a, const Matrix& b) {
+	double res = 0.0;
+	for (size_t i = 0; i < a.get_height(); ++i) {
+		for (size_t j = 0; j < a.get_width(); ++j) {
+			res = std::max(res, std::abs(a[{i, j}] - b[{i, j}]));
+		}
+	}
+	return res;
+}
+
+// Binds workspace environment to the variables of the system, reusing
+// existing entries when the variables haven't changed since the last solve.
+// name(i) returns the name of variable i.
+template<typename Name>
+void bind_env(SolverWorkspace& ws, size_t vars, const Name& name) {
+	bool same = ws.env.size() == vars;
+	for (size_t i = 0; same && i < vars; ++i) {
+		same = ws.env.count(name(i)) > 0;
+	}
+	if (!same) {
+		ws.env.clear();
+		ws.dir.clear();
+	}
+	for (size_t i = 0; i < vars; ++i) {
+		ws.slots[i] = &ws.env[name(i)];
+		ws.dir_slots[i] = &ws.dir[name(i)];
+	}
+}
+
+// Residual and predicted error tests, see Constraints::residual_abs and
+// Constraints::predicted_error, which are checked in addition to equality of
+// successive iterates.
+class Stopping {
+private:
+	const Constraints& constr;
+	double residual_tol = 0.0;
+	double prev_step = std::numeric_limits<double>::infinity();
+
+public:
+	const bool residual_enabled;
+	// Set if norms of steps are needed, by either of the tests.
+	const bool tracks_steps;
+	// Norm of the last step taken, if tracked.
+	double last_step = 0.0;
+
+	Stopping(const Constraints& constr) :
+		constr(constr),
+		residual_enabled(constr.residual_abs > 0.0 || constr.residual_rel > 0.0),
+		tracks_steps(residual_enabled || constr.predicted_error) {}
+
+	// Checks the residual norm of the iterate from which iteration k steps.
+	bool residual(size_t k, double norm) {
+		if (k == 1) {
+			residual_tol = std::max(constr.residual_abs, constr.residual_rel * norm);
+		}
+		return k > constr.min_iters && norm <= residual_tol;
+	}
+
+	// Records the norm of the step of iteration k and checks the predicted
+	// error of the new iterate, whose largest absolute value is scale.
+	bool predicted(size_t k, double step, double scale) {
+		double theta = step / prev_step;
+		prev_step = step;
+		last_step = step;
+		if (!constr.predicted_error || k < 2 || k < constr.min_iters || !(theta < 1.0)) {
+			return false;
+		}
+		double error = theta * theta * step;
+		return error <= constr.abs_epsilon || error <= scale * constr.rel_epsilon;
+	}
+};
+
+// Ways of solving linear systems with the Jacobian.
+enum class Linear {
+	// Multiplication by the inverse.
+	Inverse,
+	// MixedSolver, see Constraints::mixed_precision.
+	Mixed,
+	// BandLU, for square systems with a narrow band.
+	Band,
+	// LU<double>, for large square systems.
+	LU,
+};
+
+// Square systems from this many variables on are solved with the LU
+// factorization rather than the inverse of the Jacobian, which takes about
+// four times longer at this size, and the gap grows with it. Smaller systems
+// keep the inverse, whose steps round the same as they always did.
+constexpr size_t lu_vars = 32;
+// From this many variables on the blocked factorization beats the unblocked
+// one even on a single thread, and runs on the workspace's pool with more.
+constexpr size_t parallel_lu_vars = 256;
+
+// Allocates the dense Jacobian, and with inverse also its inverse and the
+// scratch space of the inversion, unless the workspace already holds them.
+void reserve_dense(SolverWorkspace& ws, size_t funcs, size_t vars, bool inverse) {
+	if (ws.jac.get_height() != funcs || ws.jac.get_width() != vars) {
+		ws.jac = Matrix(funcs, vars);
+	}
+	if (inverse && ws.aug.get_height() != funcs) {
+		ws.jac_inv = Matrix(vars, funcs);
+		ws.aug = Matrix(funcs, 2*vars);
+	}
+}
+
+// Solves J x = b for the column vectors b and x with the factorization in the
+// workspace.
+void lu_solve(const SolverWorkspace& ws, const Matrix& b, Matrix& x) {
+	size_t n = b.get_height();
+	for (size_t i = 0; i < n; ++i) {
+		x[{i, 0}] = b[{i, 0}];
+	}
+	// Column vectors are stored contiguously.
+	ws.lu->solve(x.data());
+}
+
+SolveResult failure(SolveStatus status, size_t iter) {
+	SolveResult res{};
+	res.status = status;
+	res.iter = iter;
+	return res;
+}
+
+// Failure recorded by the trap at the given iteration, in evaluation of the
+// function func if it's known.
+SolveResult fault(const FaultTrap& trap, size_t iter, std::optional<size_t> func) {
+	auto status = trap.get_fault() == FaultTrap::Fault::UndefinedVariable
+		? SolveStatus::UndefinedVariable
+		: SolveStatus::DomainError;
+	auto res = failure(status, iter);
+	res.func = func;
+	if (trap.get_var() != nullptr) {
+		res.var = *trap.get_var();
+	}
+	return res;
+}
+
+// Returns the solution or throws the exception the failure used to be
+// reported with before try_solve().
+Solution unwrap(SolveResult&& res) {
+	switch (res.status) {
+	case SolveStatus::Converged:
+		break;
+	case SolveStatus::DomainError:
+		throw MathError("domain error");
+	case SolveStatus::UndefinedVariable:
+		throw MathError("undefined variable " + res.var);
+	case SolveStatus::Singular:
+		throw MathError("division impossible; algorithm stuck at iteration " + std::to_string(res.iter));
+	case SolveStatus::NoConvergence:
+		throw MathError("no solution found for given constraints");
+	case SolveStatus::Cancelled:
+		throw CancelledError("solve cancelled at iteration " + std::to_string(res.iter));
+	case SolveStatus::DimensionMismatch:
+		throw std::invalid_argument("dimension mismatch");
+	}
+	return std::move(res.solution);
+}
+
+// Adds Chebyshev's correction 1/2 * J^-1 * F''[s, s] to the Newton step s.
+// Returns false if the linear system can't be solved. Stops at the first
+// function failing in the trap, setting failed to its index.
+bool chebyshev(const std::vector<Expr>& funcs, size_t vars, Linear linear, SolverWorkspace& ws,
+		const FaultTrap& trap, std::optional<size_t>& failed)
+{
+	for (size_t i = 0; i < vars; ++i) {
+		*ws.dir_slots[i] = ws.step[{i, 0}];
+	}
+	for (size_t i = 0; i < funcs.size(); ++i) {
+		ws.curv[{i, 0}] = funcs[i].second_diff(ws.dir, ws.env);
+		if (trap.raised()) {
+			failed = i;
+			return true;
+		}
+	}
+	switch (linear) {
+	case Linear::Inverse:
+		multiply(ws.jac_inv, ws.curv, ws.corr);
+		break;
+	case Linear::Mixed:
+		if (!ws.mixed->solve(ws.jac, ws.curv, ws.corr)) {
+			return false;
+		}
+		break;
+	case Linear::Band:
+		ws.band->solve(ws.curv, ws.corr);
+		break;
+	case Linear::LU:
+		lu_solve(ws, ws.curv, ws.corr);
+		break;
+	}
+	for (size_t i = 0; i < vars; ++i) {
+		ws.step[{i, 0}] += 0.5 * ws.corr[{i, 0}];
+	}
+	return true;
+}
+
+// Newton's or Halley's method for a single equation in one variable. Newton's
+// method follows the general algorithm step by step, including the inversion
+// of the 1x1 Jacobian, so that results are the same. Doesn't allocate memory
+// in iterations unless there's an observer.
+// eval(x, order) returns the value of the function with its derivatives, the
+// second one only with order 2.
+template<typename Eval>
+SolveResult solve_scalar(const std::string& var, double init, const Constraints& constr,
+		const Eval& eval)
+{
+	using clock = std::chrono::steady_clock;
+	auto start = clock::now();
+	auto iter_start = start;
+	bool second = constr.method != Method::Newton;
+	std::optional<Matrix> vars;
+	double x0 = init;
+	Stopping stop(constr);
+	auto converged = [&](size_t iters, double x, double max_diff, Criterion criterion) {
+		auto res = failure(SolveStatus::Converged, iters);
+		res.solution.iters = iters;
+		res.solution.max_diff = max_diff;
+		res.solution.vars.emplace_back(var, x);
+		res.solution.criterion = criterion;
+		return res;
+	};
 	for (size_t k = 1; k <= constr.max_iters; ++k) {
-		Expr::Env env;
-		for (size_t i = 0; i < x0.get_height(); ++i) {
-			env[init[i].first] = x0[{i, 0}];
+		Expr::Derivs y;
+		{
+			FaultTrap trap;
+			y = eval(x0, second ? 2 : 1);
+			if (trap.raised()) {
+				return fault(trap, k, 0);
+			}
 		}
-		Matrix jac(funcs.size(), init.size(), [&](size_t i, size_t j) {
-			return funcs[i].diff(init[j].first, env);
-		});
-		Matrix y(funcs.size(), 1, [&](size_t i, size_t j) {
-			return funcs[i].eval(env);
-		});
-		auto jac_inv = jac.inverse();
-		if (!jac_inv) {
-			throw MathError("division impossible; algorithm stuck at iteration " + std::to_string(k));
+		if (stop.residual_enabled && stop.residual(k, std::abs(y.val))) {
+			return converged(k - 1, x0, stop.last_step, Criterion::Residual);
+		}
+		if (std::abs(y.d1) <= std::numeric_limits<double>::epsilon()) {
+			return failure(SolveStatus::Singular, k);
+		}
+		double x1;
+		{
+			PROFILE_SCOPE(Phase::Update);
+			double step = (1.0 / y.d1) * y.val;
+			// Corrections of Newton's step. When the second derivative
+			// couldn't be computed Newton's step is taken.
+			double corrected = step;
+			if (constr.method == Method::Halley) {
+				corrected = step / (1.0 - 0.5 * step * y.d2 / y.d1);
+			}
+			else if (constr.method == Method::Chebyshev) {
+				corrected = step + 0.5 * (y.d2 / y.d1) * step * step;
+			}
+			if (std::isfinite(corrected)) {
+				step = corrected;
+			}
+			x1 = x0 - step;
+		}
+		if (constr.observer) {
+			if (!vars) {
+				vars.emplace(1, 1);
+			}
+			(*vars)[{0, 0}] = x1;
+			auto now = clock::now();
+			Progress progress{
+				k,
+				*vars,
+				std::abs(y.val),
+				std::abs(x1 - x0),
+				now - iter_start,
+				now - start,
+			};
+			iter_start = now;
+			if (!constr.observer(progress)) {
+				return failure(SolveStatus::Cancelled, k);
+			}
+		}
+		bool predicted = stop.tracks_steps && stop.predicted(k, std::abs(x1 - x0), std::abs(x1));
+		if (k >= constr.min_iters && equals(x0, x1, constr.abs_epsilon, constr.rel_epsilon)) {
+			return converged(k, x1, std::abs(x1 - x0), Criterion::Step);
+		}
+		if (predicted) {
+			return converged(k, x1, std::abs(x1 - x0), Criterion::PredictedError);
+		}
+		x0 = x1;
+	}
+	return failure(SolveStatus::NoConvergence, constr.max_iters);
+}
+
+// Dispatches a single equation in one variable to the scalar path, poly being
+// its polynomial form if there's one. The polynomial is evaluated instead of
+// the expression only if that doesn't lose accuracy, see
+// Constraints::expand_polynomials.
+SolveResult solve_single(const Expr& func, const std::optional<Polynomial>& poly,
+		const Binding& init, const Constraints& constr)
+{
+	Profile profile;
+	std::optional<Profiler> profiler;
+#ifdef ROOTS_PROFILE
+	if (constr.profile && Profiler::active() == nullptr) {
+		profiler.emplace(profile);
+	}
+#endif
+	const auto& var = init.first;
+	auto poly_eval = [&](double x, int order) {
+		PROFILE_SCOPE(Phase::Eval);
+		if (order < 2) {
+			auto y = poly->eval_diff(x);
+			return Expr::Derivs{y.first, y.second, 0.0};
+		}
+		return poly->eval_derivs(x);
+	};
+	auto expr_eval = [&](double x, int order) {
+		return func.derivs(var, x, order);
+	};
+	bool horner = poly && poly->get_var() == var
+		&& (constr.expand_polynomials || Polynomial::is_expanded(func));
+	auto res = horner
+		? solve_scalar(var, init.second, constr, poly_eval)
+		: solve_scalar(var, init.second, constr, expr_eval);
+	profiler.reset();
+	if (res.ok()) {
+		res.solution.profile = std::move(profile);
+	}
+	return res;
+}
+
+// Newton iteration starting at ws.x0, shared by systems given as expressions
+// and as System. eval(trap, linear) computes ws.y and the Jacobian at ws.x0,
+// into ws.band_jac for Linear::Band and into ws.jac otherwise, returning the
+// index of the first function whose evaluation failed in the trap if it's
+// known, and name(i) returns the name of variable i. If bound is set, the
+// workspace environment is bound to the variables and kept up to date with
+// ws.x0. bw is the bandwidth of the Jacobian.
+template<typename Name, typename Eval>
+SolveResult solve_newton(const std::vector<Expr>& funcs, size_t vars, Bandwidth bw,
+		const Constraints& constr, SolverWorkspace& ws, bool bound, const Name& name,
+		const Eval& eval)
+{
+	Profile profile;
+	std::optional<Profiler> profiler;
+#ifdef ROOTS_PROFILE
+	if (constr.profile && Profiler::active() == nullptr) {
+		profiler.emplace(profile);
+	}
+#endif
+	using clock = std::chrono::steady_clock;
+	auto start = clock::now();
+	auto iter_start = start;
+	Linear linear = Linear::Inverse;
+	// Pool of the blocked LU factorization, if it runs in parallel.
+	ThreadPool* pool = nullptr;
+	if (funcs.size() == vars && bw.is_narrow(vars)) {
+		linear = Linear::Band;
+		auto ws_bw = ws.band ? ws.band->bandwidth() : Bandwidth();
+		if (!ws.band || ws_bw.lower != bw.lower || ws_bw.upper != bw.upper) {
+			ws.band_jac.emplace(vars, bw);
+			ws.band.emplace(vars, bw);
+		}
+	}
+	else if (constr.mixed_precision && funcs.size() == vars) {
+		linear = Linear::Mixed;
+		if (!ws.mixed) {
+			ws.mixed.emplace(vars);
+		}
+	}
+	else if (funcs.size() == vars && vars >= lu_vars) {
+		linear = Linear::LU;
+		if (!ws.lu) {
+			ws.lu.emplace(vars);
+		}
+		size_t threads = constr.threads;
+		if (threads == 0) {
+			threads = std::max(1u, std::thread::hardware_concurrency());
 		}
-		Matrix x1 = x0 - (*jac_inv) * y;
-		if (k >= constr.min_iters && matrix_equals(x0, x1, constr)) {
-			Solution res;
-			res.iters = k;
-			res.max_diff = 0.0;
-			for (size_t i = 0; i < init.size(); ++i) {
-				res.max_diff = std::max(res.max_diff,
-						std::abs(x1[{i, 0}] - x0[{i, 0}]));
-				res.vars.emplace_back(init[i].first, x1[{i, 0}]);
+		if (vars >= parallel_lu_vars && threads > 1) {
+			if (!ws.pool || ws.pool->size() != threads) {
+				ws.pool = std::make_unique<ThreadPool>(threads);
 			}
-			return res;
+			pool = ws.pool.get();
+		}
+	}
+	if (linear != Linear::Band) {
+		reserve_dense(ws, funcs.size(), vars, linear == Linear::Inverse);
+	}
+	Stopping stop(constr);
+	auto converged = [&](size_t iters, const Matrix& x, double max_diff, Criterion criterion) {
+		auto res = failure(SolveStatus::Converged, iters);
+		res.solution.iters = iters;
+		res.solution.max_diff = max_diff;
+		for (size_t i = 0; i < vars; ++i) {
+			res.solution.vars.emplace_back(name(i), x[{i, 0}]);
 		}
-		x0 = std::move(x1);
+		res.solution.criterion = criterion;
+		profiler.reset();
+		res.solution.profile = std::move(profile);
+		return res;
+	};
+	for (size_t k = 1; k <= constr.max_iters; ++k) {
+		{
+			FaultTrap trap;
+			if (bound) {
+				for (size_t i = 0; i < vars; ++i) {
+					*ws.slots[i] = ws.x0[{i, 0}];
+				}
+			}
+			auto failed = eval(trap, linear);
+			if (trap.raised()) {
+				return fault(trap, k, failed);
+			}
+			if (stop.residual_enabled && stop.residual(k, max_abs(ws.y))) {
+				return converged(k - 1, ws.x0, stop.last_step, Criterion::Residual);
+			}
+			if (linear == Linear::Mixed) {
+				PROFILE_SCOPE(Phase::Inverse);
+				if (!ws.mixed->solve(ws.jac, ws.y, ws.step)) {
+					return failure(SolveStatus::Singular, k);
+				}
+			}
+			else if (linear == Linear::Band) {
+				PROFILE_SCOPE(Phase::Inverse);
+				if (!ws.band->factor(*ws.band_jac)) {
+					return failure(SolveStatus::Singular, k);
+				}
+				ws.band->solve(ws.y, ws.step);
+			}
+			else if (linear == Linear::LU) {
+				PROFILE_SCOPE(Phase::Inverse);
+				bool factored = vars < parallel_lu_vars ? ws.lu->factor(ws.jac)
+					: pool != nullptr ? ws.lu->factor(ws.jac, *pool)
+					: ws.lu->factor_blocked(ws.jac);
+				if (!factored) {
+					return failure(SolveStatus::Singular, k);
+				}
+				lu_solve(ws, ws.y, ws.step);
+			}
+			else if (!ws.jac.inverse(ws.jac_inv, ws.aug)) {
+				return failure(SolveStatus::Singular, k);
+			}
+			PROFILE_SCOPE(Phase::Update);
+			if (linear == Linear::Inverse) {
+				multiply(ws.jac_inv, ws.y, ws.step);
+			}
+			if (constr.method == Method::Chebyshev) {
+				bool solved = chebyshev(funcs, vars, linear, ws, trap, failed);
+				if (trap.raised()) {
+					return fault(trap, k, failed);
+				}
+				if (!solved) {
+					return failure(SolveStatus::Singular, k);
+				}
+			}
+			for (size_t i = 0; i < vars; ++i) {
+				ws.x1[{i, 0}] = ws.x0[{i, 0}] - ws.step[{i, 0}];
+			}
+		}
+		if (constr.observer) {
+			auto now = clock::now();
+			Progress progress{
+				k,
+				ws.x1,
+				max_abs(ws.y),
+				max_abs_diff(ws.x1, ws.x0),
+				now - iter_start,
+				now - start,
+			};
+			iter_start = now;
+			if (!constr.observer(progress)) {
+				return failure(SolveStatus::Cancelled, k);
+			}
+		}
+		bool predicted = stop.tracks_steps
+			&& stop.predicted(k, max_abs_diff(ws.x1, ws.x0), max_abs(ws.x1));
+		if (k >= constr.min_iters && matrix_equals(ws.x0, ws.x1, constr.abs_epsilon, constr.rel_epsilon)) {
+			return converged(k, ws.x1, max_abs_diff(ws.x1, ws.x0), Criterion::Step);
+		}
+		if (predicted) {
+			return converged(k, ws.x1, max_abs_diff(ws.x1, ws.x0), Criterion::PredictedError);
+		}
+		std::swap(ws.x0, ws.x1);
+	}
+	return failure(SolveStatus::NoConvergence, constr.max_iters);
+}
+
+} // end anon
+
+const char* criterion_name(Criterion criterion) {
+	const char* name = "";
+	switch (criterion) {
+	case Criterion::Step:           name = "step"; break;
+	case Criterion::Residual:       name = "residual"; break;
+	case Criterion::PredictedError: name = "predicted_error"; break;
+	}
+	return name;
+}
+
+bool SolveResult::ok() const {
+	return status == SolveStatus::Converged;
+}
+
+SolverWorkspace::SolverWorkspace(size_t funcs, size_t vars) :
+	slots(vars, nullptr),
+	x0(vars, 1),
+	x1(vars, 1),
+	jac(0, 0),
+	jac_inv(0, 0),
+	aug(0, 0),
+	y(funcs, 1),
+	step(vars, 1),
+	dir_slots(vars, nullptr),
+	curv(funcs, 1),
+	corr(vars, 1) {}
+
+SolveResult
+try_solve(const std::vector<Expr>& funcs, const std::vector<Binding>& init,
+		Constraints constr)
+{
+	if (funcs.size() == 1 && init.size() == 1) {
+		return solve_single(funcs[0], Polynomial::from_expr(funcs[0]), init[0], constr);
 	}
-	throw MathError("no solution found for given constraints");
+	SolverWorkspace ws(funcs.size(), init.size());
+	return try_solve(funcs, init, std::move(constr), ws);
+}
+
+Solution
+solve(const std::vector<Expr>& funcs, const std::vector<Binding>& init, Constraints constr) {
+	return unwrap(try_solve(funcs, init, std::move(constr)));
+}
+
+SolveResult
+try_solve(const std::vector<Expr>& funcs, const std::vector<Binding>& init,
+		Constraints constr, SolverWorkspace& ws)
+{
+	if (ws.y.get_height() != funcs.size() || ws.x0.get_height() != init.size()) {
+		return failure(SolveStatus::DimensionMismatch, 0);
+	}
+	if (funcs.size() == 1 && init.size() == 1) {
+		return solve_single(funcs[0], Polynomial::from_expr(funcs[0]), init[0], constr);
+	}
+	auto name = [&](size_t i) -> const std::string& { return init[i].first; };
+	bind_env(ws, init.size(), name);
+	for (size_t i = 0; i < init.size(); ++i) {
+		ws.x0[{i, 0}] = init[i].second;
+	}
+	// Bands can be narrow only for larger systems.
+	Bandwidth bw{init.size(), init.size()};
+	if (funcs.size() == init.size() && init.size() >= 4) {
+		std::vector<std::string> names;
+		for (const auto& b : init) {
+			names.push_back(b.first);
+		}
+		bw = Bandwidth::of(funcs, names);
+	}
+	return solve_newton(funcs, init.size(), bw, constr, ws, true, name,
+		[&](const FaultTrap& trap, Linear linear) -> std::optional<size_t> {
+			for (size_t i = 0; i < funcs.size(); ++i) {
+				if (linear == Linear::Band) {
+					// Derivatives outside of the band are zero.
+					size_t first = i - std::min(i, bw.lower);
+					size_t end = std::min(init.size(), i + bw.upper + 1);
+					for (size_t j = first; j < end; ++j) {
+						(*ws.band_jac)[{i, j}] = funcs[i].diff(init[j].first, ws.env);
+					}
+				}
+				else {
+					for (size_t j = 0; j < init.size(); ++j) {
+						ws.jac[{i, j}] = funcs[i].diff(init[j].first, ws.env);
+					}
+				}
+				ws.y[{i, 0}] = funcs[i].eval(ws.env);
+				if (trap.raised()) {
+					return i;
+				}
+			}
+			return std::nullopt;
+		});
+}
+
+Solution
+solve(const std::vector<Expr>& funcs, const std::vector<Binding>& init, Constraints constr,
+		SolverWorkspace& ws)
+{
+	return unwrap(try_solve(funcs, init, std::move(constr), ws));
+}
+
+SolveResult
+try_solve(const System& sys, const std::vector<double>& init, Constraints constr) {
+	const auto& funcs = sys.get_funcs();
+	const auto& vars = sys.get_vars();
+	if (init.size() != vars.size()) {
+		return failure(SolveStatus::DimensionMismatch, 0);
+	}
+	if (funcs.size() == 1 && vars.size() == 1) {
+		return solve_single(funcs[0], sys.get_poly(), {vars[0], init[0]}, constr);
+	}
+	SolverWorkspace ws(funcs.size(), vars.size());
+	return try_solve(sys, init, std::move(constr), ws);
+}
+
+Solution
+solve(const System& sys, const std::vector<double>& init, Constraints constr) {
+	return unwrap(try_solve(sys, init, std::move(constr)));
+}
+
+SolveResult
+try_solve(const System& sys, const std::vector<double>& init, Constraints constr,
+		SolverWorkspace& ws)
+{
+	const auto& funcs = sys.get_funcs();
+	const auto& vars = sys.get_vars();
+	if (init.size() != vars.size()) {
+		return failure(SolveStatus::DimensionMismatch, 0);
+	}
+	if (ws.y.get_height() != funcs.size() || ws.x0.get_height() != vars.size()) {
+		return failure(SolveStatus::DimensionMismatch, 0);
+	}
+	if (funcs.size() == 1 && vars.size() == 1) {
+		return solve_single(funcs[0], sys.get_poly(), {vars[0], init[0]}, constr);
+	}
+	auto name = [&](size_t i) -> const std::string& { return vars[i]; };
+	// Only Chebyshev's method evaluates expressions in the environment.
+	bool bound = constr.method == Method::Chebyshev;
+	if (bound) {
+		bind_env(ws, vars.size(), name);
+	}
+	for (size_t i = 0; i < vars.size(); ++i) {
+		ws.x0[{i, 0}] = init[i];
+	}
+	return solve_newton(funcs, vars.size(), sys.get_bandwidth(), constr, ws, bound, name,
+		[&](const FaultTrap&, Linear linear) -> std::optional<size_t> {
+			if (linear == Linear::Band) {
+				sys.eval(ws.x0, ws.y, *ws.band_jac, ws.scratch);
+			}
+			else {
+				sys.eval(ws.x0, ws.y, ws.jac, ws.scratch);
+			}
+			return std::nullopt;
+		});
+}
+
+Solution
+solve(const System& sys, const std::vector<double>& init, Constraints constr,
+		SolverWorkspace& ws)
+{
+	return unwrap(try_solve(sys, init, std::move(constr), ws));
 }
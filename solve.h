@@ -1,13 +1,55 @@
 #ifndef ROOTS_SOLVE_H
 #define ROOTS_SOLVE_H
 
+#include "band.h"
 #include "expr.h"
+#include "lu.h"
+#include "matrix.h"
+#include "pool.h"
+#include "profile.h"
+#include "program.h"
+#include "system.h"
 
+#include <chrono>
+#include <functional>
 #include <limits>
+#include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
 using Binding = std::pair<std::string, double>;
 
+// Solver state after an iteration, reported to the observer.
+struct Progress {
+	// Number of the iteration, counting from 1.
+	size_t iter;
+	// Variables computed in this iteration, as a column vector in the order
+	// of initial bindings.
+	const Matrix& vars;
+	// Maximal absolute value of the functions at the previous iterate.
+	double residual_norm;
+	// Maximal absolute difference between variables from this iteration and
+	// their counterparts from the previous one.
+	double step_norm;
+	// Wall time of this iteration and of the whole solve so far.
+	std::chrono::nanoseconds iter_time;
+	std::chrono::nanoseconds total_time;
+};
+
+enum class Method {
+	Newton,
+	// Halley's method, which converges cubically using second derivatives.
+	// Applies only to single equations, systems are solved with Newton's
+	// method.
+	Halley,
+	// Chebyshev's method, which corrects the Newton step s by
+	//   -1/2 * J^-1 * F''[s, s]
+	// where F''[s, s] holds second derivatives of the functions along s,
+	// computed with hyper-dual numbers. Converges cubically.
+	Chebyshev,
+};
+
 struct Constraints {
 	// Minimal number of iterations.
 	size_t min_iters = 1;
@@ -21,10 +63,66 @@ struct Constraints {
 	// Numbers x and y are considered relatively equal when
 	//   abs(x - y) <= max(abs(x), abs(y)) * rel_epsilon
 	double rel_epsilon = std::numeric_limits<double>::epsilon();
+	// Tolerances of the residual test, which accepts an iterate x as soon as
+	//   max(abs(f_i(x))) <= max(residual_abs, residual_rel * r0)
+	// where r0 is the same norm at the initial point, before another step is
+	// taken from x. Saves the last inversion of the Jacobian, which otherwise
+	// only confirms that the step is negligible. Both zero disable the test.
+	double residual_abs = 0.0;
+	double residual_rel = 0.0;
+	// Enables the predicted error test. With the contraction rate
+	//   theta = |s_k| / |s_k-1|
+	// of the maximal absolute values of successive steps, and quadratic
+	// convergence assumed, the error of the iterate after step s_k is
+	// estimated as theta^2 * |s_k|. The iterate is accepted when the
+	// estimate is equal to zero according to the epsilon values, which
+	// usually happens an iteration before the iterates themselves settle.
+	bool predicted_error = false;
+	// Optional callback invoked after every iteration. Returning false
+	// cancels the solve, which then throws CancelledError.
+	std::function<bool(const Progress&)> observer;
+	// Collects profiling data into Solution::profile. Has effect only in
+	// builds with ROOTS_PROFILE defined, and only if no other profiler is
+	// already active on the current thread.
+	bool profile = false;
+	// Computes Newton steps of square systems by factorizing the Jacobian in
+	// single precision and refining the step against double precision
+	// residuals, see MixedSolver. Cheaper than the default double precision
+	// inversion for large systems, with the same accuracy of the step.
+	// Doesn't apply to systems with banded Jacobians.
+	bool mixed_precision = false;
+	// Number of threads factorizing the Jacobians of dense square systems of
+	// several hundred variables, zero means one per hardware thread. More than
+	// one start a pool owned by the workspace. Solves running on a pool
+	// themselves, as in search() and roots-cli, should keep the default, since
+	// nested pools oversubscribe the processors.
+	size_t threads = 1;
+	// Evaluates single polynomial equations in one variable with Horner's
+	// scheme even if their coefficients come from multiplying out products
+	// or powers of sums, see Polynomial::is_expanded(). Faster for such
+	// equations, but may fail to converge near clustered roots.
+	bool expand_polynomials = false;
+	// Iterative method used.
+	Method method = Method::Newton;
+};
+
+// Tests by which a solve converged.
+enum class Criterion {
+	// Successive iterates were equal according to the epsilon values.
+	Step,
+	// The residual was within Constraints::residual_abs or residual_rel.
+	Residual,
+	// The error predicted from the contraction rate was negligible, see
+	// Constraints::predicted_error.
+	PredictedError,
 };
 
+// Returns the name of the criterion.
+const char* criterion_name(Criterion criterion);
+
 struct Solution {
-	// Number of iterations performed.
+	// Number of iterations performed. When the residual test succeeds,
+	// the iteration which would step from the solution isn't counted.
 	size_t iters;
 	// Maximal absolute difference between variable from the last iteration
 	// and its counterpart from the preceding iteration.
@@ -33,16 +131,143 @@ struct Solution {
 	double max_diff;
 	// Computed varibles.
 	std::vector<Binding> vars;
+	// Test which accepted the solution.
+	Criterion criterion = Criterion::Step;
+	// Profiling data, see Constraints::profile.
+	Profile profile;
+};
+
+enum class SolveStatus {
+	Converged,
+	// Evaluation of a function or its derivatives failed with a domain error.
+	DomainError,
+	// A function depends on a variable without an initial value.
+	UndefinedVariable,
+	// The Jacobian couldn't be inverted or factorized.
+	Singular,
+	// Iterations ran out before convergence.
+	NoConvergence,
+	// The observer cancelled the solve.
+	Cancelled,
+	// Initial values or the workspace don't match the system.
+	DimensionMismatch,
+};
+
+struct SolveResult {
+	SolveStatus status;
+	// Iteration at which the solve stopped, counting from 1, or zero if it
+	// stopped before the first one.
+	size_t iter = 0;
+	// Index of the function whose evaluation failed, if known. Systems
+	// evaluated in one sweep, see System, don't tell which function failed.
+	std::optional<size_t> func;
+	// Name of the undefined variable.
+	std::string var;
+	// Solution, set only if the solve converged.
+	Solution solution;
+
+	bool ok() const;
+};
+
+// Preallocated buffers used by solve() for a system with the given number
+// of functions and variables. Reusing a workspace between solves of systems of
+// the same size avoids all heap allocations during Newton iterations.
+struct SolverWorkspace {
+	// Environment with the variables of the last solved system.
+	Expr::Env env;
+	// Pointers to values in env, in the order of initial bindings.
+	std::vector<double*> slots;
+	// Current and next iterate.
+	Matrix x0;
+	Matrix x1;
+	// Dense Jacobian, its inverse and the scratch space for the inversion,
+	// allocated by the first solve needing them. Banded systems use none.
+	Matrix jac;
+	Matrix jac_inv;
+	Matrix aug;
+	// Function values and the Newton step.
+	Matrix y;
+	Matrix step;
+	// Newton step as an environment, with pointers to its values, second
+	// derivatives of functions along the step and the resulting correction,
+	// used by Chebyshev's method.
+	Expr::Env dir;
+	std::vector<double*> dir_slots;
+	Matrix curv;
+	Matrix corr;
+	// Linear solver used with Constraints::mixed_precision, created by the
+	// first solve using it.
+	std::optional<MixedSolver> mixed;
+	// Factorization of large dense Jacobians, and the pool factorizing the
+	// largest ones with Constraints::threads, both created by the first solve
+	// using them.
+	std::optional<LU<double>> lu;
+	std::unique_ptr<ThreadPool> pool;
+	// Band of the Jacobian and its factorization, created for the bandwidth
+	// of the last solved banded system.
+	std::optional<BandMatrix> band_jac;
+	std::optional<BandLU> band;
+	// Buffers of System::eval().
+	Program::Scratch scratch;
+
+	SolverWorkspace(size_t funcs, size_t vars);
 };
 
 // Solves a system of functions using Newton's method, starting with the given
-// initial solution. Throws MathError on failure.
+// initial solution. Single equations in one variable take a separate scalar
+// path, which doesn't use matrices or environments and evaluates polynomials
+// given in expanded form with Horner's scheme, see Polynomial. Square systems
+// whose Jacobian has a narrow band under the order of initial bindings, see
+// Bandwidth, take Newton steps with the banded LU factorization instead of
+// inverting the Jacobian. So do other square systems of more than a few dozen
+// variables, with the dense LU factorization, which is parallel for the
+// largest ones if Constraints::threads allows.
+// Throws MathError on failure and CancelledError when cancelled by the
+// observer, see try_solve() for the non-throwing variant.
 // The algorithm will successfully terminate iff the following conditions are met:
 //  - The number of iterations is in range [min_iters, max_iters].
 //  - Variables computed in the last iteration are approximately equal to their
 //    counterparts from the previous iteration. Equality is determined according
-//    to supplied epsilon values.
+//    to supplied epsilon values. Alternatively the residual or the predicted
+//    error test succeeds if enabled, see Constraints.
 Solution
 solve(const std::vector<Expr>& funcs, const std::vector<Binding>& init, Constraints constr);
 
+// Same as above, but reports failures in the result instead of throwing,
+// which is cheaper when failures are common, as in multi-start searches.
+// Exceptions thrown by the observer and std::bad_alloc still propagate to the
+// caller. The same holds for the try_solve() overloads below, which report
+// mismatched dimensions with SolveStatus::DimensionMismatch.
+SolveResult
+try_solve(const std::vector<Expr>& funcs, const std::vector<Binding>& init,
+		Constraints constr);
+
+// Same as above, but uses the given workspace instead of allocating buffers.
+// Workspace dimensions must match the system, otherwise std::invalid_argument
+// is thrown.
+Solution
+solve(const std::vector<Expr>& funcs, const std::vector<Binding>& init, Constraints constr,
+		SolverWorkspace& ws);
+SolveResult
+try_solve(const std::vector<Expr>& funcs, const std::vector<Binding>& init,
+		Constraints constr, SolverWorkspace& ws);
+
+// Solves a prepared system starting with variables given in the order of
+// System::get_vars(), with results the same as of solving its functions.
+// Iterations compute residuals and the Jacobian in one sweep, without
+// evaluating expression trees or looking up variables. Throws
+// std::invalid_argument if the number of initial values doesn't match.
+Solution
+solve(const System& sys, const std::vector<double>& init, Constraints constr);
+SolveResult
+try_solve(const System& sys, const std::vector<double>& init, Constraints constr);
+
+// Same as above, but uses the given workspace, see SolverWorkspace.
+Solution
+solve(const System& sys, const std::vector<double>& init, Constraints constr,
+		SolverWorkspace& ws);
+SolveResult
+try_solve(const System& sys, const std::vector<double>& init, Constraints constr,
+		SolverWorkspace& ws);
+
 #endif // ROOTS_SOLVE_H
@@ -1,8 +1,13 @@
 #include "solve.h"
 
+#include "alloc_count.h"
 #include "common.h"
 
+#include <array>
 #include <cmath>
+#include <map>
+#include <optional>
+#include <stdexcept>
 
 #include "gtest/gtest.h"
 
@@ -130,3 +135,587 @@ TEST(SolveTest, Failure) {
 	};
 	EXPECT_THROW(solve(funcs, {{"x", 1}, {"y", 1}}, default_constr), MathError);
 }
+
+TEST(SolveTest, TrySolve) {
+	std::vector<Expr> funcs = {
+		Expr::parse("x^2 + y^2 - 16"),
+		Expr::parse("y - (2*x - 3)"),
+	};
+	std::vector<Binding> init = {{"x", 100}, {"y", 130}};
+	auto res = try_solve(funcs, init, default_constr);
+	ASSERT_TRUE(res.ok());
+	EXPECT_EQ(res.iter, res.solution.iters);
+	expect_solution_eq(res.solution, solve(funcs, init, default_constr).vars);
+
+	Constraints short_constr;
+	short_constr.max_iters = 2;
+	res = try_solve(funcs, init, short_constr);
+	EXPECT_EQ(res.status, SolveStatus::NoConvergence);
+	EXPECT_EQ(res.iter, 2);
+	EXPECT_THROW(solve(funcs, init, short_constr), MathError);
+
+	Constraints cancel_constr;
+	cancel_constr.observer = [](const Progress& p) { return p.iter < 3; };
+	res = try_solve(funcs, init, cancel_constr);
+	EXPECT_EQ(res.status, SolveStatus::Cancelled);
+	EXPECT_EQ(res.iter, 3);
+
+	SolverWorkspace ws(3, 3);
+	res = try_solve(funcs, init, default_constr, ws);
+	EXPECT_EQ(res.status, SolveStatus::DimensionMismatch);
+}
+
+TEST(SolveTest, ObserverThrows) {
+	std::vector<Expr> funcs = {
+		Expr::parse("x^2 + y^2 - 16"),
+		Expr::parse("y - (2*x - 3)"),
+	};
+	std::vector<Binding> init = {{"x", 100}, {"y", 130}};
+	System sys(funcs, {"x", "y"});
+	Constraints constr;
+	constr.observer = [](const Progress& p) -> bool {
+		if (p.iter == 2) {
+			throw std::runtime_error("observer failed");
+		}
+		return true;
+	};
+	EXPECT_THROW(solve(funcs, init, constr), std::runtime_error);
+	EXPECT_THROW(try_solve(funcs, init, constr), std::runtime_error);
+	EXPECT_THROW(solve(sys, {100, 130}, constr), std::runtime_error);
+	SolverWorkspace ws(2, 2);
+	EXPECT_THROW(solve(funcs, init, constr, ws), std::runtime_error);
+	EXPECT_THROW(solve({Expr::parse("x^2 - 2")}, {{"x", 5}}, constr), std::runtime_error);
+}
+
+TEST(SolveTest, TrySolveFailures) {
+	struct Case {
+		std::vector<std::string> eqs;
+		SolveStatus status;
+		size_t iter;
+		std::optional<size_t> func;
+		std::string var;
+	};
+	std::vector<Case> cases = {
+		{{"x + y - 1", "ln(x - 5) + y"}, SolveStatus::DomainError, 1, 1, ""},
+		{{"x - y", "x + z"}, SolveStatus::UndefinedVariable, 1, 1, "z"},
+		{{"x + y", "2*x + 2*y - 1"}, SolveStatus::Singular, 1, std::nullopt, ""},
+		// The first step goes from 4 to 4 - 4 * ln(4) < 0.
+		{{"ln(x)"}, SolveStatus::DomainError, 2, 0, ""},
+		{{"x^2 + 1"}, SolveStatus::Singular, 1, std::nullopt, ""},
+	};
+	for (const auto& c : cases) {
+		std::vector<Expr> funcs;
+		for (const auto& eq : c.eqs) {
+			funcs.push_back(Expr::parse(eq));
+		}
+		std::vector<Binding> init = {{"x", c.eqs.size() == 1 ? 0.0 : 1.0}, {"y", 1.0}};
+		init.resize(funcs.size());
+		if (funcs.size() == 1 && c.status == SolveStatus::DomainError) {
+			init[0].second = 4.0;
+		}
+		auto res = try_solve(funcs, init, default_constr);
+		EXPECT_EQ(res.status, c.status) << c.eqs[0];
+		EXPECT_EQ(res.iter, c.iter) << c.eqs[0];
+		EXPECT_EQ(res.func, c.func) << c.eqs[0];
+		EXPECT_EQ(res.var, c.var) << c.eqs[0];
+		EXPECT_THROW(solve(funcs, init, default_constr), MathError) << c.eqs[0];
+	}
+}
+
+TEST(SolveTest, TrySolveSystem) {
+	std::vector<Expr> funcs = {
+		Expr::parse("x + y - 1"),
+		Expr::parse("ln(x - 5) + y"),
+	};
+	System sys(funcs, {"x", "y"});
+	auto res = try_solve(sys, {1.0, 1.0}, default_constr);
+	EXPECT_EQ(res.status, SolveStatus::DomainError);
+	EXPECT_EQ(res.iter, 1);
+	EXPECT_EQ(res.func, std::nullopt) << "functions are evaluated in one sweep";
+	EXPECT_THROW(solve(sys, {1.0, 1.0}, default_constr), MathError);
+	res = try_solve(sys, {1.0}, default_constr);
+	EXPECT_EQ(res.status, SolveStatus::DimensionMismatch);
+}
+
+TEST(SolveTest, Criteria) {
+	std::vector<std::vector<std::string>> systems = {
+		{"x^2 + y^2 - 16", "y - (2*x - 3)"},
+		{"x^3 - 5*x^2 + 2*x - y + 13", "x^3 + x^2 - 14*x - y - 19"},
+		{"x - 0.5*sin(x) - 1"},
+		{"x^2 - 13.11"},
+	};
+	std::vector<Binding> values = {{"x", 100.0}, {"y", 130.0}};
+	for (const auto& eqs : systems) {
+		std::vector<Expr> funcs;
+		for (const auto& eq : eqs) {
+			funcs.push_back(Expr::parse(eq));
+		}
+		std::vector<Binding> init(values.begin(), values.begin() + funcs.size());
+		auto expected = solve(funcs, init, default_constr);
+		EXPECT_EQ(expected.criterion, Criterion::Step) << eqs[0];
+
+		Constraints residual_constr;
+		residual_constr.residual_abs = 1e-12;
+		auto residual = solve(funcs, init, residual_constr);
+		EXPECT_EQ(residual.criterion, Criterion::Residual) << eqs[0];
+		EXPECT_LT(residual.iters, expected.iters) << eqs[0];
+		expect_solution_near(residual, expected.vars, 1e-10);
+
+		Constraints predicted_constr;
+		predicted_constr.predicted_error = true;
+		auto predicted = solve(funcs, init, predicted_constr);
+		EXPECT_EQ(predicted.criterion, Criterion::PredictedError) << eqs[0];
+		EXPECT_LT(predicted.iters, expected.iters) << eqs[0];
+		expect_solution_near(predicted, expected.vars, 1e-14);
+	}
+}
+
+TEST(SolveTest, Workspace) {
+	std::vector<Expr> funcs = {
+		Expr::parse("x^2 + y^2 - 16"),
+		Expr::parse("y - (2*x - 3)"),
+	};
+	std::vector<Binding> init = {{"x", 100}, {"y", 130}};
+	SolverWorkspace ws(funcs.size(), init.size());
+	auto expected = solve(funcs, init, default_constr);
+	auto actual = solve(funcs, init, default_constr, ws);
+	expect_solution_eq(actual, expected.vars);
+	EXPECT_EQ(actual.iters, expected.iters) << "number of iterations";
+}
+
+TEST(SolveTest, WorkspaceMismatch) {
+	std::vector<Expr> funcs = {Expr::parse("x^2 - 13.11")};
+	SolverWorkspace ws(2, 2);
+	EXPECT_THROW(solve(funcs, {{"x", 123.0}}, default_constr, ws), std::invalid_argument);
+}
+
+TEST(SolveTest, WorkspaceAllocations) {
+	std::vector<Expr> funcs = {
+		Expr::parse("x^3 - 5*x^2 + 2*x - y + 13"),
+		Expr::parse("x^3 + x^2 - 14*x - y - 19"),
+	};
+	std::vector<Binding> init = {{"x", 8}, {"y", 10}};
+	SolverWorkspace ws(funcs.size(), init.size());
+	// Warm up the workspace.
+	solve(funcs, init, default_constr, ws);
+	// Forcing additional iterations must not increase the number of allocations.
+	auto count = [&](size_t iters) {
+		Constraints constr;
+		constr.min_iters = iters;
+		size_t before = allocation_count();
+		auto sol = solve(funcs, init, constr, ws);
+		size_t after = allocation_count();
+		EXPECT_EQ(sol.iters, iters) << "number of iterations";
+		return after - before;
+	};
+	size_t short_solve = count(20);
+	size_t long_solve = count(80);
+	EXPECT_EQ(short_solve, long_solve) << "allocations per iteration";
+}
+
+TEST(SolveTest, ObserverAllocations) {
+	std::vector<Expr> funcs = {
+		Expr::parse("x^3 - 5*x^2 + 2*x - y + 13"),
+		Expr::parse("x^3 + x^2 - 14*x - y - 19"),
+	};
+	std::vector<Binding> init = {{"x", 8}, {"y", 10}};
+	SolverWorkspace ws(funcs.size(), init.size());
+	// Too large for the small buffer of std::function, so that every copy of
+	// the observer allocates.
+	std::array<size_t, 16> seen = {};
+	size_t calls = 0;
+	Constraints constr;
+	constr.observer = [seen, &calls](const Progress& p) mutable {
+		seen[p.iter % seen.size()] = p.iter;
+		++calls;
+		return true;
+	};
+	solve(funcs, init, constr, ws);
+	// Iterations past min_iters compare the iterates, so run out of them
+	// instead.
+	constr.abs_epsilon = -1;
+	constr.rel_epsilon = -1;
+	auto count = [&](size_t iters) {
+		constr.max_iters = iters;
+		size_t before = allocation_count();
+		auto res = try_solve(funcs, init, constr, ws);
+		size_t after = allocation_count();
+		EXPECT_EQ(res.status, SolveStatus::NoConvergence);
+		return after - before;
+	};
+	size_t short_solve = count(20);
+	size_t long_solve = count(80);
+	EXPECT_EQ(short_solve, long_solve) << "allocations per iteration";
+	EXPECT_GT(calls, 100u);
+}
+
+TEST(SolveTest, MixedPrecision) {
+	std::vector<Expr> funcs = {
+		Expr::parse("x^3 - 5*x^2 + 2*x - y + 13"),
+		Expr::parse("x^3 + x^2 - 14*x - y - 19"),
+		Expr::parse("2*y - x*z - 1"),
+	};
+	std::vector<Binding> init = {{"x", 20}, {"y", 5}, {"z", 0}};
+	Constraints constr;
+	constr.mixed_precision = true;
+	auto expected = solve(funcs, init, default_constr);
+	auto actual = solve(funcs, init, constr);
+	expect_solution_eq(actual, expected.vars);
+
+	// The mixed precision solver is only created when used.
+	SolverWorkspace ws(funcs.size(), init.size());
+	solve(funcs, init, default_constr, ws);
+	EXPECT_FALSE(ws.mixed);
+	solve(funcs, init, constr, ws);
+	EXPECT_TRUE(ws.mixed);
+
+	// Iterations with mixed precision steps don't allocate either.
+	auto count = [&](size_t iters) {
+		constr.min_iters = iters;
+		size_t before = allocation_count();
+		solve(funcs, init, constr, ws);
+		return allocation_count() - before;
+	};
+	size_t short_solve = count(20);
+	size_t long_solve = count(80);
+	EXPECT_EQ(short_solve, long_solve) << "allocations per iteration";
+}
+
+TEST(SolveTest, System) {
+	std::vector<std::vector<std::string>> systems = {
+		{"x^2 + y^2 - 16", "y - (2*x - 3)"},
+		{"y^2 * (exp 1)^x - 3", "2*y*(exp 1)^x + 10*y^4"},
+		{"x^3 - 5*x^2 + 2*x - y + 13", "x^3 + x^2 - 14*x - y - 19", "2*y - x*z - 1"},
+		{"x - 0.5*sin(x) - 1"},
+		{"x^2 - 13.11"},
+	};
+	std::vector<std::string> names = {"x", "y", "z"};
+	std::vector<double> values = {1.5, -1.0, 0.5};
+	for (const auto& eqs : systems) {
+		std::vector<Expr> funcs;
+		for (const auto& eq : eqs) {
+			funcs.push_back(Expr::parse(eq));
+		}
+		std::vector<std::string> vars(names.begin(), names.begin() + funcs.size());
+		std::vector<double> init(values.begin(), values.begin() + funcs.size());
+		std::vector<Binding> bindings;
+		for (size_t i = 0; i < vars.size(); ++i) {
+			bindings.emplace_back(vars[i], init[i]);
+		}
+		System sys(funcs, vars);
+		for (auto method : {Method::Newton, Method::Chebyshev}) {
+			for (bool mixed : {false, true}) {
+				Constraints constr;
+				constr.method = method;
+				constr.mixed_precision = mixed;
+				auto expected = solve(funcs, bindings, constr);
+				auto actual = solve(sys, init, constr);
+				ASSERT_EQ(actual.vars.size(), expected.vars.size()) << eqs[0];
+				for (size_t i = 0; i < vars.size(); ++i) {
+					EXPECT_EQ(actual.vars[i], expected.vars[i]) << eqs[0];
+				}
+				EXPECT_EQ(actual.iters, expected.iters) << eqs[0];
+				EXPECT_EQ(actual.max_diff, expected.max_diff) << eqs[0];
+			}
+		}
+	}
+}
+
+TEST(SolveTest, SystemMismatch) {
+	System sys({Expr::parse("x + y"), Expr::parse("x - y")}, {"x", "y"});
+	EXPECT_THROW(solve(sys, {1.0}, default_constr), std::invalid_argument);
+	SolverWorkspace ws(3, 3);
+	EXPECT_THROW(solve(sys, {1.0, 2.0}, default_constr, ws), std::invalid_argument);
+}
+
+TEST(SolveTest, LargeDense) {
+	// Every variable appears in its own equation and in one far away.
+	for (size_t n : {40, 300}) {
+		std::vector<std::string> vars;
+		for (size_t i = 0; i < n; ++i) {
+			vars.push_back("x" + std::to_string(i));
+		}
+		std::vector<Expr> funcs;
+		for (size_t i = 0; i < n; ++i) {
+			funcs.push_back(Expr::parse(vars[i] + "^2 + " + vars[(7*i + 3) % n] + " - 2"));
+		}
+		System sys(funcs, vars);
+		ASSERT_FALSE(sys.get_bandwidth().is_narrow(n)) << n;
+		SolverWorkspace ws(n, n);
+		Constraints constr;
+		constr.threads = 2;
+		auto sol = solve(sys, std::vector<double>(n, 1.5), constr, ws);
+		for (const auto& b : sol.vars) {
+			EXPECT_NEAR(b.second, 1.0, 1e-15) << n << ", " << b.first;
+		}
+		EXPECT_TRUE(ws.lu) << n;
+		EXPECT_EQ(bool(ws.pool), n >= 256) << n;
+		if (ws.pool) {
+			EXPECT_EQ(ws.pool->size(), 2u);
+		}
+		// By default the factorization runs on the calling thread, with the
+		// same results.
+		SolverWorkspace serial_ws(n, n);
+		auto serial = solve(sys, std::vector<double>(n, 1.5), default_constr, serial_ws);
+		EXPECT_FALSE(serial_ws.pool) << n;
+		EXPECT_EQ(serial.vars, sol.vars) << n;
+		constr.method = Method::Chebyshev;
+		sol = solve(sys, std::vector<double>(n, 1.5), constr, ws);
+		EXPECT_NEAR(sol.vars.back().second, 1.0, 1e-15) << n;
+
+		// Neither does the factorization allocate in iterations, in parallel
+		// or not.
+		for (size_t threads : {1, 2}) {
+			constr.threads = threads;
+			auto count = [&](size_t iters) {
+				constr.min_iters = iters;
+				size_t before = allocation_count();
+				solve(sys, std::vector<double>(n, 1.5), constr, ws);
+				return allocation_count() - before;
+			};
+			size_t short_solve = count(5);
+			size_t long_solve = count(20);
+			EXPECT_EQ(short_solve, long_solve)
+				<< "allocations per iteration, " << n << " variables, " << threads << " threads";
+		}
+	}
+}
+
+TEST(SolveTest, SystemAllocations) {
+	System sys({
+		Expr::parse("x^3 - 5*x^2 + 2*x - y + 13"),
+		Expr::parse("x^3 + x^2 - 14*x - y - 19"),
+	}, {"x", "y"});
+	std::vector<double> init = {8, 10};
+	SolverWorkspace ws(2, 2);
+	solve(sys, init, default_constr, ws);
+	auto count = [&](size_t iters) {
+		Constraints constr;
+		constr.min_iters = iters;
+		size_t before = allocation_count();
+		solve(sys, init, constr, ws);
+		return allocation_count() - before;
+	};
+	size_t short_solve = count(20);
+	size_t long_solve = count(80);
+	EXPECT_EQ(short_solve, long_solve) << "allocations per iteration";
+}
+
+TEST(SolveTest, Banded) {
+	// Broyden tridiagonal function, whose Jacobian has a band of width three
+	// with variables in order and is dense with the order shuffled.
+	constexpr size_t n = 40;
+	std::vector<Expr> funcs;
+	std::vector<std::string> names;
+	for (size_t i = 1; i <= n; ++i) {
+		auto x = [](size_t i) { return "x" + std::to_string(i); };
+		std::string eq = "(3 - 2*" + x(i) + ")*" + x(i) + " + 1";
+		if (i > 1) {
+			eq += " - " + x(i - 1);
+		}
+		if (i < n) {
+			eq += " - 2*" + x(i + 1);
+		}
+		funcs.push_back(Expr::parse(eq));
+		names.push_back(x(i));
+	}
+	std::vector<Binding> init;
+	std::vector<Binding> shuffled;
+	for (size_t i = 0; i < n; ++i) {
+		init.emplace_back(names[i], -1.0);
+		shuffled.emplace_back(names[(i * 7) % n], -1.0);
+	}
+	EXPECT_TRUE(Bandwidth::of(funcs, names).is_narrow(n));
+	std::vector<std::string> shuffled_names;
+	for (const auto& b : shuffled) {
+		shuffled_names.push_back(b.first);
+	}
+	EXPECT_FALSE(Bandwidth::of(funcs, shuffled_names).is_narrow(n));
+
+	auto banded = solve(funcs, init, default_constr);
+	auto dense = solve(funcs, shuffled, default_constr);
+	std::map<std::string, double> expected(dense.vars.begin(), dense.vars.end());
+	for (const auto& b : banded.vars) {
+		EXPECT_NEAR(b.second, expected[b.first], 1e-12) << b.first;
+	}
+	System sys(funcs, names);
+	auto system = solve(sys, std::vector<double>(n, -1.0), default_constr);
+	for (size_t i = 0; i < n; ++i) {
+		EXPECT_EQ(system.vars[i], banded.vars[i]) << "solution of System";
+	}
+
+	// Banded solves don't allocate dense matrices, nor in iterations.
+	SolverWorkspace ws(n, n);
+	solve(funcs, init, default_constr, ws);
+	solve(sys, std::vector<double>(n, -1.0), default_constr, ws);
+	EXPECT_EQ(ws.jac.get_height(), 0u);
+	EXPECT_EQ(ws.jac_inv.get_height(), 0u);
+	EXPECT_EQ(ws.aug.get_height(), 0u);
+	ASSERT_TRUE(ws.band_jac);
+	auto count = [&](size_t iters) {
+		Constraints constr;
+		constr.min_iters = iters;
+		size_t before = allocation_count();
+		solve(sys, std::vector<double>(n, -1.0), constr, ws);
+		return allocation_count() - before;
+	};
+	EXPECT_EQ(count(20), count(80)) << "allocations per iteration";
+	solve(funcs, shuffled, default_constr, ws);
+	EXPECT_EQ(ws.jac.get_height(), n);
+}
+
+TEST(SolveTest, Polynomial) {
+	// The same equation once detected as a polynomial and once evaluated as
+	// an expression tree.
+	std::vector<Expr> poly = {Expr::parse("x^3 - 2*x - 5")};
+	std::vector<Expr> tree = {Expr::parse("x^3 - 2*x - 5 + 0*sin(x)")};
+	std::vector<Binding> init = {{"x", 10}};
+	auto expected = solve(tree, init, default_constr);
+	auto actual = solve(poly, init, default_constr);
+	ASSERT_EQ(actual.vars.size(), 1u);
+	EXPECT_NEAR(actual.vars[0].second, expected.vars[0].second, 1e-15);
+	EXPECT_EQ(actual.iters, expected.iters) << "number of iterations";
+	EXPECT_THROW(solve({Expr::parse("x^2 + 1")}, {{"x", 0}}, default_constr), MathError);
+}
+
+TEST(SolveTest, FactoredPolynomial) {
+	// Expanding the powers loses most digits of the coefficients to
+	// cancellation, so that Horner's scheme misses the roots.
+	Constraints constr;
+	constr.max_iters = 200;
+	std::vector<Expr> funcs = {Expr::parse("(x - 2)^20 - 1")};
+	System sys(funcs, {"x"});
+	for (bool system : {false, true}) {
+		auto res = system
+			? try_solve(sys, {3.5}, constr)
+			: try_solve(funcs, {{"x", 3.5}}, constr);
+		ASSERT_TRUE(res.ok()) << "system " << system;
+		EXPECT_NEAR(res.solution.vars[0].second, 3.0, 1e-15) << "system " << system;
+		EXPECT_EQ(res.iter, 14) << "system " << system;
+	}
+	auto res = try_solve({Expr::parse("(x - 1)^12")}, {{"x", 3.5}}, constr);
+	EXPECT_EQ(res.status, SolveStatus::Singular);
+	EXPECT_EQ(res.iter, 52);
+
+	constr.expand_polynomials = true;
+	res = try_solve(funcs, {{"x", 3.5}}, constr);
+	EXPECT_FALSE(res.ok()) << "expanded polynomial";
+}
+
+TEST(SolveTest, Scalar) {
+	std::vector<Expr> funcs = {Expr::parse("x - cos(x)")};
+	std::vector<Binding> init = {{"x", 3}};
+	auto newton = solve(funcs, init, default_constr);
+	Constraints constr;
+	constr.method = Method::Halley;
+	auto halley = solve(funcs, init, constr);
+	ASSERT_EQ(halley.vars.size(), 1u);
+	EXPECT_NEAR(halley.vars[0].second, newton.vars[0].second, 1e-15);
+	EXPECT_LT(halley.iters, newton.iters) << "number of iterations";
+
+	// Single polynomial equations can use Halley's method as well.
+	funcs = {Expr::parse("x^3 - 2*x - 5")};
+	newton = solve(funcs, init, default_constr);
+	halley = solve(funcs, init, constr);
+	EXPECT_NEAR(halley.vars[0].second, newton.vars[0].second, 1e-15);
+	EXPECT_LE(halley.iters, newton.iters) << "number of iterations";
+
+	EXPECT_THROW(solve({Expr::parse("x + y")}, init, default_constr), MathError);
+}
+
+TEST(SolveTest, ScalarAllocations) {
+	std::vector<Expr> funcs = {Expr::parse("x - cos(x)")};
+	std::vector<Binding> init = {{"x", 3}};
+	for (auto method : {Method::Newton, Method::Halley}) {
+		auto count = [&](size_t iters) {
+			Constraints constr;
+			constr.min_iters = iters;
+			constr.method = method;
+			size_t before = allocation_count();
+			solve(funcs, init, constr);
+			return allocation_count() - before;
+		};
+		size_t short_solve = count(20);
+		size_t long_solve = count(80);
+		EXPECT_EQ(short_solve, long_solve) << "allocations per iteration";
+	}
+}
+
+TEST(SolveTest, Chebyshev) {
+	std::vector<Expr> funcs = {
+		Expr::parse("x^3 - 5*x^2 + 2*x - y + 13"),
+		Expr::parse("x^3 + x^2 - 14*x - y - 19"),
+		Expr::parse("2*y - x*z - 1"),
+	};
+	std::vector<Binding> init = {{"x", 20}, {"y", 5}, {"z", 0}};
+	Constraints constr;
+	constr.method = Method::Chebyshev;
+	auto newton = solve(funcs, init, default_constr);
+	auto chebyshev = solve(funcs, init, constr);
+	expect_solution_near(chebyshev, newton.vars, 1e-12);
+	EXPECT_LT(chebyshev.iters, newton.iters) << "number of iterations";
+
+	// Correction computed with mixed precision solves.
+	constr.mixed_precision = true;
+	auto mixed = solve(funcs, init, constr);
+	expect_solution_near(mixed, newton.vars, 1e-12);
+
+	// Single equations. Unlike Halley's method, Chebyshev's method diverges
+	// from x = 3.
+	std::vector<Expr> scalar = {Expr::parse("x - cos(x)")};
+	newton = solve(scalar, {{"x", 1}}, default_constr);
+	chebyshev = solve(scalar, {{"x", 1}}, constr);
+	EXPECT_NEAR(chebyshev.vars[0].second, newton.vars[0].second, 1e-15);
+	EXPECT_LT(chebyshev.iters, newton.iters) << "number of iterations";
+
+	// Iterations don't allocate.
+	constr.mixed_precision = false;
+	SolverWorkspace ws(funcs.size(), init.size());
+	solve(funcs, init, constr, ws);
+	auto count = [&](size_t iters) {
+		constr.min_iters = iters;
+		size_t before = allocation_count();
+		solve(funcs, init, constr, ws);
+		return allocation_count() - before;
+	};
+	size_t short_solve = count(20);
+	size_t long_solve = count(80);
+	EXPECT_EQ(short_solve, long_solve) << "allocations per iteration";
+}
+
+TEST(SolveTest, Observer) {
+	std::vector<Expr> funcs = {
+		Expr::parse("x^2 + y^2 - 16"),
+		Expr::parse("y - (2*x - 3)"),
+	};
+	std::vector<Binding> init = {{"x", 100}, {"y", 130}};
+	std::vector<Progress> reported;
+	Constraints constr;
+	constr.observer = [&](const Progress& p) {
+		EXPECT_EQ(p.iter, reported.size() + 1) << "iteration number";
+		EXPECT_EQ(p.vars.get_height(), init.size()) << "number of variables";
+		EXPECT_LE(p.iter_time, p.total_time) << "iteration time";
+		reported.push_back(p);
+		return true;
+	};
+	auto actual = solve(funcs, init, constr);
+	ASSERT_EQ(reported.size(), actual.iters) << "number of observer calls";
+	EXPECT_EQ(reported.back().step_norm, actual.max_diff) << "last step norm";
+	EXPECT_GT(reported.front().residual_norm, reported.back().residual_norm)
+		<< "residual norm decrease";
+}
+
+TEST(SolveTest, ObserverCancel) {
+	std::vector<Expr> funcs = {
+		Expr::parse("y = x - 3"),
+		Expr::parse("y = x^2"),
+	};
+	size_t calls = 0;
+	Constraints constr;
+	constr.observer = [&](const Progress& p) {
+		++calls;
+		return p.iter < 3;
+	};
+	EXPECT_THROW(solve(funcs, {{"x", 1}, {"y", 1}}, constr), CancelledError);
+	EXPECT_EQ(calls, 3) << "number of observer calls";
+}
@@ -0,0 +1,66 @@
+#include "solveworker.h"
+
+#include "common.h"
+
+#include <chrono>
+#include <exception>
+
+namespace {
+
+// Minimal interval between progress reports, so that fast iterations don't
+// flood the GUI event loop.
+constexpr std::chrono::milliseconds progressInterval(50);
+
+} // end anon
+
+SolveWorker::SolveWorker(std::vector<Expr> funcs, std::vector<Binding> inits, Constraints constr,
+		std::shared_ptr<std::atomic<bool>> cancelRequested)
+	: funcs(std::move(funcs))
+	, inits(std::move(inits))
+	, constr(std::move(constr))
+	, cancelRequested(std::move(cancelRequested))
+{
+}
+
+void SolveWorker::registerTypes()
+{
+	qRegisterMetaType<Solution>("Solution");
+	qRegisterMetaType<QVector<double>>("QVector<double>");
+}
+
+void SolveWorker::run()
+{
+	std::chrono::nanoseconds lastReport(0);
+	constr.observer = [&](const Progress& p) {
+		if (p.iter == 1 || p.total_time - lastReport >= progressInterval) {
+			lastReport = p.total_time;
+			emit progress(static_cast<int>(p.iter), p.step_norm);
+		}
+		return !cancelRequested->load();
+	};
+	try {
+		Solution solution = solve(funcs, inits, constr);
+		auto env = Expr::Env(solution.vars.begin(), solution.vars.end());
+		QVector<double> values;
+		for (const auto& f : funcs) {
+			values.push_back(f.eval(env));
+		}
+		emit progress(static_cast<int>(solution.iters), solution.max_diff);
+		emit solved(solution, values);
+	}
+	catch (const CancelledError&) {
+		emit cancelled();
+	}
+	catch (const BaseError& err) {
+		emit failed(QString::fromStdString(err.what()));
+	}
+	catch (const std::exception& err) {
+		// Such as std::bad_alloc, which would otherwise escape the event loop
+		// of the worker thread and never let the GUI know the solve ended.
+		emit failed(QString::fromStdString(err.what()));
+	}
+	catch (...) {
+		emit failed(QString("unknown error"));
+	}
+	emit finished();
+}
@@ -0,0 +1,57 @@
+#ifndef SOLVEWORKER_H
+#define SOLVEWORKER_H
+
+#include "expr.h"
+#include "solve.h"
+
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+Q_DECLARE_METATYPE(Solution)
+
+// Runs solve() outside of the GUI thread. The worker is meant to be moved to
+// a QThread, with run() connected to QThread::started. Results are delivered
+// through signals, which the GUI receives as queued connections.
+// Cancellation is requested by setting the shared flag, which stays valid
+// even after the worker gets deleted on its thread.
+class SolveWorker : public QObject
+{
+	Q_OBJECT
+
+public:
+	SolveWorker(std::vector<Expr> funcs, std::vector<Binding> inits, Constraints constr,
+		std::shared_ptr<std::atomic<bool>> cancelRequested);
+
+	// Registers types passed through signals, must be called before any
+	// worker is connected.
+	static void registerTypes();
+
+public slots:
+	void run();
+
+signals:
+	// Reported periodically with the current iteration and the maximal
+	// difference between the last two iterates.
+	void progress(int iteration, double maxDiff);
+	// Emitted on success, together with values of the functions at the solution.
+	void solved(Solution solution, QVector<double> values);
+	// Emitted when solve() throws anything but CancelledError.
+	void failed(QString message);
+	void cancelled();
+	// Emitted after any of the above.
+	void finished();
+
+private:
+	std::vector<Expr> funcs;
+	std::vector<Binding> inits;
+	Constraints constr;
+	std::shared_ptr<std::atomic<bool>> cancelRequested;
+};
+
+#endif // SOLVEWORKER_H
@@ -0,0 +1,282 @@
+#include "system.h"
+
+#include "common.h"
+#include "num.h"
+#include "profile.h"
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+
+using Op = Program::Op;
+
+// Derivatives of an operand, walked along the variables of the node using it,
+// which include the variables of the operand.
+struct Operand {
+	const uint32_t* dep = nullptr;
+	const uint32_t* end = nullptr;
+	const double* deriv = nullptr;
+	// Derivative by variables the operand doesn't depend on.
+	double other = 0.0;
+	double val = 0.0;
+
+	// Returns the derivative by variable k, which must be greater than the
+	// variable of the preceding call. Sets cons if the operand doesn't depend
+	// on k, in which case it's constant for Dual.
+	double next(uint32_t k, bool& cons) {
+		if (dep != end && *dep == k) {
+			++dep;
+			cons = false;
+			return *deriv++;
+		}
+		cons = true;
+		return other;
+	}
+};
+
+} // end anon
+
+System::System(std::vector<Expr> funcs, std::vector<std::string> vars) :
+	funcs(std::move(funcs)),
+	vars(std::move(vars)),
+	prog(Program::compile(this->funcs, this->vars, false))
+{
+	auto nodes = prog.get_nodes();
+	std::vector<uint32_t> merged;
+	dep_offsets.push_back(0);
+	slot_offsets.push_back(0);
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const auto& node = nodes[i];
+		merged.clear();
+		if (node.op == Op::Var) {
+			merged.push_back(node.lhs);
+		}
+		else if (node.op != Op::Const) {
+			auto lhs_begin = deps.begin() + dep_offsets[node.lhs];
+			auto lhs_end = deps.begin() + dep_offsets[node.lhs + 1];
+			// Unary operations have rhs set to 0, with an empty range used
+			// in its place.
+			bool binary = node.op >= Op::Add && node.op <= Op::Pow;
+			auto rhs_begin = deps.begin() + (binary ? dep_offsets[node.rhs] : 0);
+			auto rhs_end = deps.begin() + (binary ? dep_offsets[node.rhs + 1] : 0);
+			std::set_union(lhs_begin, lhs_end, rhs_begin, rhs_end, std::back_inserter(merged));
+		}
+		deps.insert(deps.end(), merged.begin(), merged.end());
+		dep_offsets.push_back(static_cast<uint32_t>(deps.size()));
+		size_t slots = merged.size() + (merged.size() < this->vars.size() ? 1 : 0);
+		slot_offsets.push_back(static_cast<uint32_t>(slot_offsets.back() + slots));
+	}
+	if (this->funcs.size() == 1 && this->vars.size() == 1) {
+		poly = Polynomial::from_expr(this->funcs[0]);
+	}
+	auto outputs = prog.get_outputs();
+	for (size_t i = 0; i < outputs.size(); ++i) {
+		for (size_t k = dep_offsets[outputs[i]]; k < dep_offsets[outputs[i] + 1]; ++k) {
+			size_t j = deps[k];
+			bw.lower = std::max(bw.lower, i > j ? i - j : 0);
+			bw.upper = std::max(bw.upper, j > i ? j - i : 0);
+		}
+	}
+}
+
+const std::vector<Expr>& System::get_funcs() const {
+	return funcs;
+}
+
+const std::vector<std::string>& System::get_vars() const {
+	return vars;
+}
+
+const Program& System::get_program() const {
+	return prog;
+}
+
+const std::optional<Polynomial>& System::get_poly() const {
+	return poly;
+}
+
+Bandwidth System::get_bandwidth() const {
+	return bw;
+}
+
+// Derivatives follow the rules of Dual, with every node computing the
+// derivatives by all variables at once. Operations which don't depend on
+// the variable see constant operands, exactly as Expr::diff() does, so that
+// they compute the same values and fail in the same cases.
+void System::sweep(const Matrix& x, Program::Scratch& scratch) const {
+	auto nodes = prog.get_nodes();
+	auto consts = prog.get_consts();
+	auto& vals = scratch.vals;
+	auto& derivs = scratch.derivs;
+	vals.resize(nodes.size());
+	derivs.resize(slot_offsets.back());
+	auto operand = [&](uint32_t i) {
+		Operand op;
+		op.dep = deps.data() + dep_offsets[i];
+		op.end = deps.data() + dep_offsets[i + 1];
+		op.deriv = derivs.data() + slot_offsets[i];
+		size_t count = dep_offsets[i + 1] - dep_offsets[i];
+		if (slot_offsets[i + 1] - slot_offsets[i] > count) {
+			op.other = op.deriv[count];
+		}
+		op.val = vals[i];
+		return op;
+	};
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const auto& node = nodes[i];
+		double* out = derivs.data() + slot_offsets[i];
+		size_t slots = slot_offsets[i + 1] - slot_offsets[i];
+		if (node.op == Op::Const) {
+			vals[i] = consts[node.lhs];
+			std::fill(out, out + slots, 0.0);
+			continue;
+		}
+		if (node.op == Op::Var) {
+			vals[i] = x[{node.lhs, 0}];
+			out[0] = 1.0;
+			std::fill(out + 1, out + slots, 0.0);
+			continue;
+		}
+		bool binary = node.op >= Op::Add && node.op <= Op::Pow;
+		Operand lhs = operand(node.lhs);
+		Operand rhs = binary ? operand(node.rhs) : Operand();
+		const uint32_t* dep = deps.data() + dep_offsets[i];
+		size_t count = dep_offsets[i + 1] - dep_offsets[i];
+		// Calls f(dl, cl, dr, cr) with derivatives of the operands and their
+		// constness for every slot.
+		auto sweep = [&](auto f) {
+			for (size_t s = 0; s < count; ++s) {
+				bool cl, cr;
+				double dl = lhs.next(dep[s], cl);
+				double dr = rhs.next(dep[s], cr);
+				out[s] = f(dl, cl, dr, cr);
+			}
+			if (slots > count) {
+				out[count] = f(lhs.other, true, rhs.other, true);
+			}
+		};
+		double l = lhs.val;
+		double r = rhs.val;
+		switch (node.op) {
+		case Op::Add:
+			vals[i] = l + r;
+			sweep([](double dl, bool, double dr, bool) { return dl + dr; });
+			break;
+		case Op::Sub:
+			vals[i] = l - r;
+			sweep([](double dl, bool, double dr, bool) { return dl - dr; });
+			break;
+		case Op::Mul:
+			vals[i] = l * r;
+			sweep([&](double dl, bool, double dr, bool) { return (dl * r) + (l * dr); });
+			break;
+		case Op::Div:
+			vals[i] = ediv(l, r);
+			sweep([&](double dl, bool, double dr, bool) {
+				return ediv((dl * r) - (l * dr), r * r);
+			});
+			break;
+		case Op::Pow: {
+			double val = epow(l, r);
+			vals[i] = val;
+			// Shared by all slots, computed only if some slot needs them.
+			std::optional<double> lower;
+			std::optional<double> log;
+			sweep([&](double dl, bool, double dr, bool cr) {
+				if (cr) {
+					if (r == 1.0) {
+						return dl;
+					}
+					if (!lower) {
+						lower = epow(l, r - 1.0);
+					}
+					return r * *lower * dl;
+				}
+				if (!log) {
+					log = elog(l);
+				}
+				return val * (dr * *log + ediv(dl * r, l));
+			});
+			break;
+		}
+		case Op::Neg:
+			vals[i] = -l;
+			sweep([](double dl, bool, double, bool) { return -dl; });
+			break;
+		case Op::Sin: {
+			double s, c;
+			sin_cos(l, s, c);
+			vals[i] = s;
+			sweep([&](double dl, bool, double, bool) { return c * dl; });
+			break;
+		}
+		case Op::Cos: {
+			double s, c;
+			sin_cos(l, s, c);
+			vals[i] = c;
+			sweep([&](double dl, bool, double, bool) { return -s * dl; });
+			break;
+		}
+		case Op::Ln:
+			vals[i] = elog(l);
+			sweep([&](double dl, bool, double, bool) { return ediv(dl, l); });
+			break;
+		case Op::Exp: {
+			double e = std::exp(l);
+			vals[i] = e;
+			sweep([&](double dl, bool, double, bool) { return e * dl; });
+			break;
+		}
+		case Op::Sqrt: {
+			double root = esqrt(l);
+			vals[i] = root;
+			sweep([&](double dl, bool, double, bool) { return ediv(dl, 2 * root); });
+			break;
+		}
+		case Op::Const:
+		case Op::Var:
+			break;
+		}
+	}
+}
+
+template<typename Jacobian>
+void System::store(Matrix& y, Jacobian& jac, size_t lower, size_t upper,
+		const Program::Scratch& scratch) const
+{
+	auto outputs = prog.get_outputs();
+	for (size_t k = 0; k < outputs.size(); ++k) {
+		uint32_t o = outputs[k];
+		y[{k, 0}] = scratch.vals[o];
+		const double* out = scratch.derivs.data() + slot_offsets[o];
+		size_t count = dep_offsets[o + 1] - dep_offsets[o];
+		double other = slot_offsets[o + 1] - slot_offsets[o] > count ? out[count] : 0.0;
+		size_t first = k - std::min(k, lower);
+		size_t end = std::min(vars.size(), k + upper + 1);
+		for (size_t j = first; j < end; ++j) {
+			jac[{k, j}] = other;
+		}
+		for (size_t s = 0; s < count; ++s) {
+			jac[{k, deps[dep_offsets[o] + s]}] = out[s];
+		}
+	}
+}
+
+void System::eval(const Matrix& x, Matrix& y, Matrix& jac, Program::Scratch& scratch) const {
+	PROFILE_SCOPE(Phase::Diff);
+	sweep(x, scratch);
+	store(y, jac, funcs.size(), vars.size(), scratch);
+}
+
+void System::eval(const Matrix& x, Matrix& y, BandMatrix& jac, Program::Scratch& scratch) const {
+	auto jbw = jac.bandwidth();
+	if (jac.size() != vars.size() || jbw.lower != bw.lower || jbw.upper != bw.upper) {
+		throw std::invalid_argument("band matrix dimension mismatch in evaluation");
+	}
+	PROFILE_SCOPE(Phase::Diff);
+	sweep(x, scratch);
+	store(y, jac, bw.lower, bw.upper, scratch);
+}
@@ -0,0 +1,70 @@
+#ifndef ROOTS_SYSTEM_H
+#define ROOTS_SYSTEM_H
+
+#include "band.h"
+#include "expr.h"
+#include "matrix.h"
+#include "poly.h"
+#include "program.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// System of equations prepared for repeated solving. Functions are compiled
+// into a single Program, sharing subexpressions across equations, and
+// residuals are computed together with the whole Jacobian in one sweep over
+// its nodes. Every node carries derivatives only by the variables it depends
+// on, plus one derivative shared by all other variables.
+class System {
+private:
+	std::vector<Expr> funcs;
+	std::vector<std::string> vars;
+	Program prog;
+	// Sorted indices of the variables each node depends on, those of node i
+	// starting at deps[dep_offsets[i]].
+	std::vector<uint32_t> dep_offsets;
+	std::vector<uint32_t> deps;
+	// Derivatives of node i start at slot_offsets[i], one for each variable
+	// it depends on, followed by the derivative by other variables if there
+	// are any.
+	std::vector<uint32_t> slot_offsets;
+	// Polynomial form of a single equation in one variable.
+	std::optional<Polynomial> poly;
+	Bandwidth bw;
+
+	// Computes values and derivatives of all nodes into the scratch buffers.
+	void sweep(const Matrix& x, Program::Scratch& scratch) const;
+	// Stores values of the functions into y and their derivatives into rows
+	// of jac, within lower and upper diagonals of the main one.
+	template<typename Jacobian>
+	void store(Matrix& y, Jacobian& jac, size_t lower, size_t upper,
+			const Program::Scratch& scratch) const;
+
+public:
+	// Throws MathError if a function uses a variable not in vars.
+	System(std::vector<Expr> funcs, std::vector<std::string> vars);
+
+	const std::vector<Expr>& get_funcs() const;
+	const std::vector<std::string>& get_vars() const;
+	const Program& get_program() const;
+	// Returns the polynomial form of single equations in one variable
+	// recognized by Polynomial::from_expr(), nullopt for other systems.
+	const std::optional<Polynomial>& get_poly() const;
+	// Returns the bandwidth of the Jacobian, see Bandwidth::of().
+	Bandwidth get_bandwidth() const;
+
+	// Evaluates the functions at x, a column vector of variables, storing
+	// their values in the column vector y and their Jacobian in jac. Results
+	// and domain errors are exactly the same as with Expr::eval() and
+	// Expr::diff() of every function by every variable. Scratch buffers are
+	// resized on first use. Throws MathError on failure.
+	void eval(const Matrix& x, Matrix& y, Matrix& jac, Program::Scratch& scratch) const;
+	// Same as above, storing only the band of the Jacobian, which must be a
+	// square matrix of the bandwidth returned by get_bandwidth(). Takes time
+	// and memory proportional to the band rather than to the whole Jacobian.
+	// Throws std::invalid_argument if the bandwidth doesn't match.
+	void eval(const Matrix& x, Matrix& y, BandMatrix& jac, Program::Scratch& scratch) const;
+};
+
+#endif // ROOTS_SYSTEM_H
@@ -0,0 +1,154 @@
+#include "system.h"
+
+#include "common.h"
+#include "test_util.h"
+
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Expects System::eval() to compute exactly what Expr::eval() and
+// Expr::diff() compute, including failures.
+void expect_system_eq(const System& sys, const std::vector<double>& point) {
+	const auto& funcs = sys.get_funcs();
+	const auto& vars = sys.get_vars();
+	Expr::Env env;
+	Matrix x(vars.size(), 1);
+	for (size_t j = 0; j < vars.size(); ++j) {
+		env[vars[j]] = point[j];
+		x[{j, 0}] = point[j];
+	}
+	std::optional<MathError> expected_error;
+	Matrix expected_y(funcs.size(), 1);
+	Matrix expected_jac(funcs.size(), vars.size());
+	try {
+		for (size_t i = 0; i < funcs.size(); ++i) {
+			for (size_t j = 0; j < vars.size(); ++j) {
+				expected_jac[{i, j}] = funcs[i].diff(vars[j], env);
+			}
+			expected_y[{i, 0}] = funcs[i].eval(env);
+		}
+	}
+	catch (const MathError& e) {
+		expected_error = e;
+	}
+	Matrix y(funcs.size(), 1);
+	Matrix jac(funcs.size(), vars.size());
+	Program::Scratch scratch;
+	if (expected_error) {
+		EXPECT_THROW(sys.eval(x, y, jac, scratch), MathError) << "at " << x.show();
+		return;
+	}
+	ASSERT_NO_THROW(sys.eval(x, y, jac, scratch)) << "at " << x.show();
+	for (size_t i = 0; i < funcs.size(); ++i) {
+		double actual = y[{i, 0}];
+		double expected = expected_y[{i, 0}];
+		EXPECT_EQ(actual, expected) << "value of function " << i;
+		for (size_t j = 0; j < vars.size(); ++j) {
+			actual = jac[{i, j}];
+			expected = expected_jac[{i, j}];
+			EXPECT_EQ(actual, expected) << "derivative of function " << i << " by " << vars[j];
+		}
+	}
+}
+
+} // end anon
+
+TEST(SystemTest, Eval) {
+	System sys(parse_all({
+		"x^3 - 5*x^2 + 2*x - y + 13",
+		"sin(x)*exp(y) / sqrt(z) - ln(x + 3)",
+		"2*y - x*z - 1",
+		"(x + 2)^y + 7",
+		"cos(z) - 4",
+	}), {"x", "y", "z", "w"});
+	for (auto point : std::vector<std::vector<double>>{
+			{1.0, 2.0, 3.0, 0.0},
+			{-1.5, 0.25, 4.0, 1.0},
+			{4.0, 5.0, 2.25, -2.0},
+			{-2.5, 2.0, 1.0, 0.0}}) {
+		expect_system_eq(sys, point);
+	}
+}
+
+TEST(SystemTest, DomainErrors) {
+	System sys(parse_all({"x^0.5 + y", "sqrt(y) - x", "x^y - 1", "1 / x + y"}), {"x", "y"});
+	// Derivatives fail at points where values don't, also by variables the
+	// failing subexpression doesn't depend on.
+	double tiny = std::numeric_limits<double>::min();
+	for (auto point : std::vector<std::vector<double>>{
+			{0.0, 1.0},
+			{1.0, 0.0},
+			{-1.0, 0.5},
+			{tiny, 1.0},
+			{2.0, 3.0}}) {
+		expect_system_eq(sys, point);
+	}
+}
+
+TEST(SystemTest, SharedSubexpressions) {
+	System sys(parse_all({"sin(x*y) + y", "sin(x*y) - x"}), {"x", "y"});
+	// x, y, x*y, sin(x*y), sin(x*y) + y, sin(x*y) - x
+	EXPECT_EQ(sys.get_program().node_count(), 6) << "number of nodes";
+	expect_system_eq(sys, {0.5, 2.0});
+}
+
+TEST(SystemTest, Band) {
+	std::vector<std::string> eqs;
+	std::vector<std::string> vars;
+	constexpr size_t n = 12;
+	for (size_t i = 0; i < n; ++i) {
+		auto x = [](size_t i) { return "x" + std::to_string(i); };
+		std::string eq = "sin(" + x(i) + ")*" + x(i) + " + 1";
+		if (i > 0) {
+			eq += " - " + x(i - 1) + "^2";
+		}
+		if (i + 2 < n) {
+			eq += " - 3/" + x(i + 2);
+		}
+		eqs.push_back(eq);
+		vars.push_back(x(i));
+	}
+	System sys(parse_all(eqs), vars);
+	auto bw = sys.get_bandwidth();
+	ASSERT_EQ(bw.lower, 1u);
+	ASSERT_EQ(bw.upper, 2u);
+	Matrix x(n, 1);
+	for (size_t j = 0; j < n; ++j) {
+		x[{j, 0}] = 1.0 + 0.25 * j;
+	}
+	Matrix expected_y(n, 1);
+	Matrix expected_jac(n, n);
+	Program::Scratch scratch;
+	sys.eval(x, expected_y, expected_jac, scratch);
+	Matrix y(n, 1);
+	BandMatrix jac(n, bw);
+	sys.eval(x, y, jac, scratch);
+	for (size_t i = 0; i < n; ++i) {
+		double actual = y[{i, 0}];
+		double expected = expected_y[{i, 0}];
+		EXPECT_EQ(actual, expected) << "value of function " << i;
+		for (size_t j = 0; j < n; ++j) {
+			actual = static_cast<const BandMatrix&>(jac)[{i, j}];
+			expected = expected_jac[{i, j}];
+			EXPECT_EQ(actual, expected) << "derivative of function " << i << " by " << vars[j];
+		}
+	}
+	BandMatrix wide(n, {2, 2});
+	EXPECT_THROW(sys.eval(x, y, wide, scratch), std::invalid_argument);
+}
+
+TEST(SystemTest, Polynomial) {
+	EXPECT_TRUE(System(parse_all({"x^2 - 2"}), {"x"}).get_poly());
+	EXPECT_FALSE(System(parse_all({"sin(x)"}), {"x"}).get_poly());
+	EXPECT_FALSE(System(parse_all({"x - y", "x + y"}), {"x", "y"}).get_poly());
+}
+
+TEST(SystemTest, UndefinedVariable) {
+	EXPECT_THROW(System(parse_all({"x + w"}), {"x"}), MathError);
+}
@@ -0,0 +1,20 @@
+#ifndef ROOTS_TEST_UTIL_H
+#define ROOTS_TEST_UTIL_H
+
+#include "expr.h"
+
+#include <string>
+#include <vector>
+
+// Helpers shared by the tests.
+
+// Parses every function of a system.
+inline std::vector<Expr> parse_all(const std::vector<std::string>& funcs) {
+	std::vector<Expr> res;
+	for (const auto& f : funcs) {
+		res.push_back(Expr::parse(f));
+	}
+	return res;
+}
+
+#endif // ROOTS_TEST_UTIL_H
@@ -0,0 +1,553 @@
+#include "vecmath.h"
+
+#include "num.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr double inf = std::numeric_limits<double>::infinity();
+constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+
+// Adding and subtracting 1.5 * 2^52 rounds numbers below 2^51 in magnitude to
+// integers, which then occupy the low bits of the sum's representation.
+constexpr double shifter = 0x1.8p52;
+
+// Operations on scalars. Vector types below provide the same operations, so
+// that kernels are written once as templates.
+
+using Mask = bool;
+
+inline double fmadd(double a, double b, double c) {
+#ifdef __FMA__
+	return std::fma(a, b, c);
+#else
+	return a * b + c;
+#endif
+}
+
+inline double select(bool m, double a, double b) { return m ? a : b; }
+inline double abs(double x) { return std::abs(x); }
+inline double min(double x, double y) { return std::min(x, y); }
+inline double max(double x, double y) { return std::max(x, y); }
+inline double sqroot(double x) { return std::sqrt(x); }
+inline bool is_nan(double x) { return std::isnan(x); }
+inline unsigned bits(bool m) { return m ? 1 : 0; }
+
+inline uint64_t to_bits(double x) {
+	uint64_t b;
+	std::memcpy(&b, &x, sizeof(b));
+	return b;
+}
+
+inline double from_bits(uint64_t b) {
+	double x;
+	std::memcpy(&x, &b, sizeof(x));
+	return x;
+}
+
+// Computes 2^k for integers k in [-1022, 1023].
+inline double pow2(double k) {
+	return from_bits(to_bits(k + (shifter + 1023)) << 52);
+}
+
+// Splits normal numbers into the unbiased exponent and the mantissa in [1, 2).
+inline void split(double x, double& e, double& m) {
+	uint64_t b = to_bits(x);
+	e = from_bits((b >> 52) | to_bits(0x1p52)) - (0x1p52 + 1023);
+	m = from_bits((b & 0xfffffffffffffULL) | to_bits(1.0));
+}
+
+template<typename V> V load(const double* p);
+template<> inline double load<double>(const double* p) { return *p; }
+inline void store(double* p, double x) { *p = x; }
+
+template<typename V> constexpr size_t width = 1;
+
+#if defined(__AVX512F__)
+
+struct Avx512 {
+	__m512d v;
+
+	Avx512() = default;
+	Avx512(__m512d v) : v(v) {}
+	Avx512(double x) : v(_mm512_set1_pd(x)) {}
+};
+
+struct Avx512Mask {
+	__mmask8 m;
+};
+
+template<> constexpr size_t width<Avx512> = 8;
+
+// Some operations use their zero-masking variants with all lanes enabled,
+// because the unmasked ones trigger false uninitialized variable warnings
+// in GCC 12.
+constexpr __mmask8 all = 0xff;
+
+template<> inline Avx512 load<Avx512>(const double* p) { return _mm512_loadu_pd(p); }
+inline void store(double* p, Avx512 x) { _mm512_storeu_pd(p, x.v); }
+
+inline Avx512 operator+(Avx512 x, Avx512 y) { return _mm512_add_pd(x.v, y.v); }
+inline Avx512 operator-(Avx512 x, Avx512 y) { return _mm512_sub_pd(x.v, y.v); }
+inline Avx512 operator*(Avx512 x, Avx512 y) { return _mm512_mul_pd(x.v, y.v); }
+inline Avx512 operator/(Avx512 x, Avx512 y) { return _mm512_div_pd(x.v, y.v); }
+inline Avx512 operator-(Avx512 x) {
+	return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(x.v),
+			_mm512_set1_epi64(int64_t(1) << 63)));
+}
+inline Avx512 fmadd(Avx512 a, Avx512 b, Avx512 c) { return _mm512_fmadd_pd(a.v, b.v, c.v); }
+inline Avx512 abs(Avx512 x) { return _mm512_abs_pd(x.v); }
+inline Avx512 min(Avx512 x, Avx512 y) { return _mm512_maskz_min_pd(all, x.v, y.v); }
+inline Avx512 max(Avx512 x, Avx512 y) { return _mm512_maskz_max_pd(all, x.v, y.v); }
+inline Avx512 sqroot(Avx512 x) { return _mm512_maskz_sqrt_pd(all, x.v); }
+
+inline Avx512Mask operator<(Avx512 x, Avx512 y) { return {_mm512_cmp_pd_mask(x.v, y.v, _CMP_LT_OQ)}; }
+inline Avx512Mask operator<=(Avx512 x, Avx512 y) { return {_mm512_cmp_pd_mask(x.v, y.v, _CMP_LE_OQ)}; }
+inline Avx512Mask operator>(Avx512 x, Avx512 y) { return {_mm512_cmp_pd_mask(x.v, y.v, _CMP_GT_OQ)}; }
+inline Avx512Mask operator>=(Avx512 x, Avx512 y) { return {_mm512_cmp_pd_mask(x.v, y.v, _CMP_GE_OQ)}; }
+inline Avx512Mask operator==(Avx512 x, Avx512 y) { return {_mm512_cmp_pd_mask(x.v, y.v, _CMP_EQ_OQ)}; }
+inline Avx512Mask operator!=(Avx512 x, Avx512 y) { return {_mm512_cmp_pd_mask(x.v, y.v, _CMP_NEQ_OQ)}; }
+inline Avx512Mask is_nan(Avx512 x) { return {_mm512_cmp_pd_mask(x.v, x.v, _CMP_UNORD_Q)}; }
+inline Avx512Mask operator&(Avx512Mask x, Avx512Mask y) { return {__mmask8(x.m & y.m)}; }
+inline Avx512Mask operator|(Avx512Mask x, Avx512Mask y) { return {__mmask8(x.m | y.m)}; }
+inline Avx512 select(Avx512Mask m, Avx512 a, Avx512 b) { return _mm512_mask_blend_pd(m.m, b.v, a.v); }
+inline unsigned bits(Avx512Mask m) { return m.m; }
+
+inline Avx512 pow2(Avx512 k) {
+	auto b = _mm512_castpd_si512((k + Avx512(shifter + 1023)).v);
+	return _mm512_castsi512_pd(_mm512_maskz_slli_epi64(all, b, 52));
+}
+
+inline void split(Avx512 x, Avx512& e, Avx512& m) {
+	auto b = _mm512_castpd_si512(x.v);
+	auto exp = _mm512_or_si512(_mm512_maskz_srli_epi64(all, b, 52),
+			_mm512_set1_epi64(int64_t(to_bits(0x1p52))));
+	e = Avx512(_mm512_castsi512_pd(exp)) - Avx512(0x1p52 + 1023);
+	auto mant = _mm512_or_si512(_mm512_and_si512(b, _mm512_set1_epi64(0xfffffffffffffLL)),
+			_mm512_set1_epi64(int64_t(to_bits(1.0))));
+	m = _mm512_castsi512_pd(mant);
+}
+
+using Vec = Avx512;
+constexpr const char* isa_name = "avx512";
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+struct Avx2 {
+	__m256d v;
+
+	Avx2() = default;
+	Avx2(__m256d v) : v(v) {}
+	Avx2(double x) : v(_mm256_set1_pd(x)) {}
+};
+
+struct Avx2Mask {
+	__m256d m;
+};
+
+template<> constexpr size_t width<Avx2> = 4;
+
+template<> inline Avx2 load<Avx2>(const double* p) { return _mm256_loadu_pd(p); }
+inline void store(double* p, Avx2 x) { _mm256_storeu_pd(p, x.v); }
+
+inline Avx2 operator+(Avx2 x, Avx2 y) { return _mm256_add_pd(x.v, y.v); }
+inline Avx2 operator-(Avx2 x, Avx2 y) { return _mm256_sub_pd(x.v, y.v); }
+inline Avx2 operator*(Avx2 x, Avx2 y) { return _mm256_mul_pd(x.v, y.v); }
+inline Avx2 operator/(Avx2 x, Avx2 y) { return _mm256_div_pd(x.v, y.v); }
+inline Avx2 operator-(Avx2 x) { return _mm256_xor_pd(x.v, _mm256_set1_pd(-0.0)); }
+inline Avx2 fmadd(Avx2 a, Avx2 b, Avx2 c) { return _mm256_fmadd_pd(a.v, b.v, c.v); }
+inline Avx2 abs(Avx2 x) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x.v); }
+inline Avx2 min(Avx2 x, Avx2 y) { return _mm256_min_pd(x.v, y.v); }
+inline Avx2 max(Avx2 x, Avx2 y) { return _mm256_max_pd(x.v, y.v); }
+inline Avx2 sqroot(Avx2 x) { return _mm256_sqrt_pd(x.v); }
+
+inline Avx2Mask operator<(Avx2 x, Avx2 y) { return {_mm256_cmp_pd(x.v, y.v, _CMP_LT_OQ)}; }
+inline Avx2Mask operator<=(Avx2 x, Avx2 y) { return {_mm256_cmp_pd(x.v, y.v, _CMP_LE_OQ)}; }
+inline Avx2Mask operator>(Avx2 x, Avx2 y) { return {_mm256_cmp_pd(x.v, y.v, _CMP_GT_OQ)}; }
+inline Avx2Mask operator>=(Avx2 x, Avx2 y) { return {_mm256_cmp_pd(x.v, y.v, _CMP_GE_OQ)}; }
+inline Avx2Mask operator==(Avx2 x, Avx2 y) { return {_mm256_cmp_pd(x.v, y.v, _CMP_EQ_OQ)}; }
+inline Avx2Mask operator!=(Avx2 x, Avx2 y) { return {_mm256_cmp_pd(x.v, y.v, _CMP_NEQ_OQ)}; }
+inline Avx2Mask is_nan(Avx2 x) { return {_mm256_cmp_pd(x.v, x.v, _CMP_UNORD_Q)}; }
+inline Avx2Mask operator&(Avx2Mask x, Avx2Mask y) { return {_mm256_and_pd(x.m, y.m)}; }
+inline Avx2Mask operator|(Avx2Mask x, Avx2Mask y) { return {_mm256_or_pd(x.m, y.m)}; }
+inline Avx2 select(Avx2Mask m, Avx2 a, Avx2 b) { return _mm256_blendv_pd(b.v, a.v, m.m); }
+inline unsigned bits(Avx2Mask m) { return unsigned(_mm256_movemask_pd(m.m)); }
+
+inline Avx2 pow2(Avx2 k) {
+	auto b = _mm256_castpd_si256((k + Avx2(shifter + 1023)).v);
+	return _mm256_castsi256_pd(_mm256_slli_epi64(b, 52));
+}
+
+inline void split(Avx2 x, Avx2& e, Avx2& m) {
+	auto b = _mm256_castpd_si256(x.v);
+	auto exp = _mm256_or_si256(_mm256_srli_epi64(b, 52),
+			_mm256_set1_epi64x(int64_t(to_bits(0x1p52))));
+	e = Avx2(_mm256_castsi256_pd(exp)) - Avx2(0x1p52 + 1023);
+	auto mant = _mm256_or_si256(_mm256_and_si256(b, _mm256_set1_epi64x(0xfffffffffffffLL)),
+			_mm256_set1_epi64x(int64_t(to_bits(1.0))));
+	m = _mm256_castsi256_pd(mant);
+}
+
+using Vec = Avx2;
+constexpr const char* isa_name = "avx2";
+
+#else
+
+using Vec = double;
+constexpr const char* isa_name = "scalar";
+
+#endif
+
+template<typename V>
+V round(V x) {
+	return (x + V(shifter)) - V(shifter);
+}
+
+template<typename V>
+auto is_inf(V x) {
+	return abs(x) == V(inf);
+}
+
+template<typename V>
+auto is_finite(V x) {
+	return abs(x) < V(inf);
+}
+
+// Failure of x / y, as detected by ediv.
+template<typename V>
+auto div_fails(V x, V y) {
+	return ((y == V(0.0)) & is_finite(x)) | (is_inf(x) & is_inf(y));
+}
+
+// Calls f(i + j) for lanes j set in the mask.
+template<typename F>
+void for_mask(unsigned mask, size_t i, F f) {
+	for (size_t j = 0; mask != 0; ++j, mask >>= 1) {
+		if (mask & 1) {
+			f(i + j);
+		}
+	}
+}
+
+void set_bad(unsigned char* bad, size_t i, unsigned mask) {
+	for_mask(mask, i, [&](size_t k) { bad[k] = 1; });
+}
+
+// Reduction x = k*ln2 + r with |r| <= ln2/2, so that exp(x) = 2^k * exp(r).
+// exp(r) is approximated with its Taylor polynomial of degree 13, whose
+// truncation error is below 2^-57.
+template<typename V>
+V exp_kernel(V x) {
+	constexpr double inv_ln2 = 1.44269504088896338700e+00;
+	// ln2_hi has 32 significant bits, so k*ln2_hi is exact.
+	constexpr double ln2_hi = 6.93147180369123816490e-01;
+	constexpr double ln2_lo = 1.90821492927058770002e-10;
+	// exp overflows above 709.79 and underflows below -745.14.
+	V xc = min(max(x, V(-746.0)), V(710.0));
+	V k = round(xc * V(inv_ln2));
+	V r = fmadd(k, V(-ln2_hi), xc);
+	r = fmadd(k, V(-ln2_lo), r);
+	V p = V(1.0 / 6227020800.0);
+	p = fmadd(p, r, V(1.0 / 479001600.0));
+	p = fmadd(p, r, V(1.0 / 39916800.0));
+	p = fmadd(p, r, V(1.0 / 3628800.0));
+	p = fmadd(p, r, V(1.0 / 362880.0));
+	p = fmadd(p, r, V(1.0 / 40320.0));
+	p = fmadd(p, r, V(1.0 / 5040.0));
+	p = fmadd(p, r, V(1.0 / 720.0));
+	p = fmadd(p, r, V(1.0 / 120.0));
+	p = fmadd(p, r, V(1.0 / 24.0));
+	p = fmadd(p, r, V(1.0 / 6.0));
+	p = fmadd(p, r, V(0.5));
+	// The leading terms are added last, so that rounding errors of the
+	// others are small relative to the result.
+	p = V(1.0) + fmadd(r * r, p, r);
+	// 2^k is applied in two steps, so that neither factor overflows and
+	// subnormal results are rounded once.
+	V k1 = round(k * V(0.5));
+	V res = p * pow2(k1) * pow2(k - k1);
+	return select(is_nan(x), x, res);
+}
+
+// Logarithm as in fdlibm: x = 2^e * m with m in [sqrt(2)/2, sqrt(2)), and
+// ln(m) = 2*atanh(s) with s = (m - 1)/(m + 1), using a minimax polynomial.
+template<typename V>
+V ln_kernel(V x) {
+	constexpr double ln2_hi = 6.93147180369123816490e-01;
+	constexpr double ln2_lo = 1.90821492927058770002e-10;
+	constexpr double lg1 = 6.666666666666735130e-01;
+	constexpr double lg2 = 3.999999999940941908e-01;
+	constexpr double lg3 = 2.857142874366239149e-01;
+	constexpr double lg4 = 2.222219843214978396e-01;
+	constexpr double lg5 = 1.818357216161805012e-01;
+	constexpr double lg6 = 1.531383769920937332e-01;
+	constexpr double lg7 = 1.479819860511658591e-01;
+	// Subnormal arguments are scaled to the normal range.
+	auto sub = x < V(0x1p-1022);
+	V e, m;
+	split(select(sub, x * V(0x1p54), x), e, m);
+	e = select(sub, e - V(54.0), e);
+	auto big = m > V(1.41421356237309504880);
+	m = select(big, m * V(0.5), m);
+	e = select(big, e + V(1.0), e);
+	V f = m - V(1.0);
+	V s = f / (V(2.0) + f);
+	V z = s * s;
+	V w = z * z;
+	V t1 = w * (V(lg2) + w * (V(lg4) + w * V(lg6)));
+	V t2 = z * (V(lg1) + w * (V(lg3) + w * (V(lg5) + w * V(lg7))));
+	V hfsq = V(0.5) * f * f;
+	V res = e * V(ln2_hi) - ((hfsq - (s * (hfsq + t1 + t2) + e * V(ln2_lo))) - f);
+	res = select(x == V(inf), x, res);
+	res = select(x == V(0.0), V(-inf), res);
+	res = select(x < V(0.0), V(nan), res);
+	return select(is_nan(x), x, res);
+}
+
+// Reduction x = k*pi/2 + r with |r| <= pi/4 using pi/2 split into parts of
+// 33 bits, so that products with k below 2^20 are exact, followed by fdlibm
+// polynomials for sin and cos on [-pi/4, pi/4]. The rounding error of r is
+// kept separately and corrects the polynomials. Returns the mask of lanes
+// which need a more precise reduction.
+template<typename V>
+auto sincos_kernel(V x, V& s, V& c) {
+	constexpr double two_over_pi = 6.36619772367581382433e-01;
+	constexpr double pio2_1 = 1.57079632673412561417e+00;
+	constexpr double pio2_2 = 6.07710050630396597660e-11;
+	constexpr double pio2_3 = 2.02226624871116645580e-21;
+	constexpr double pio2_3t = 8.47842766036889956997e-32;
+	constexpr double s1 = -1.66666666666666324348e-01;
+	constexpr double s2 = 8.33333333332248946124e-03;
+	constexpr double s3 = -1.98412698298579493134e-04;
+	constexpr double s4 = 2.75573137070700676789e-06;
+	constexpr double s5 = -2.50507602534068634195e-08;
+	constexpr double s6 = 1.58969099521155010221e-10;
+	constexpr double c1 = 4.16666666666666019037e-02;
+	constexpr double c2 = -1.38888888888741095749e-03;
+	constexpr double c3 = 2.48015872894767294178e-05;
+	constexpr double c4 = -2.75573143513906633035e-07;
+	constexpr double c5 = 2.08757232129817482790e-09;
+	constexpr double c6 = -1.13596475577881948265e-11;
+	V k = round(x * V(two_over_pi));
+	// x - k*pio2_1 is exact, the next part is subtracted exactly into the sum
+	// r + y, which then gets the remaining parts.
+	V t = fmadd(k, V(-pio2_1), x);
+	V w = k * V(pio2_2);
+	V r = t - w;
+	V b = r - t;
+	V y = (t - (r - b)) - (w + b);
+	y = fmadd(k, V(-pio2_3), y);
+	y = fmadd(k, V(-pio2_3t), y);
+	V rn = r + y;
+	y = y - (rn - r);
+	r = rn;
+	// Kernels of fdlibm, with y correcting the argument r.
+	V z = r * r;
+	V v = z * r;
+	V ps = V(s2) + z * (V(s3) + z * (V(s4) + z * (V(s5) + z * V(s6))));
+	V sr = r - ((z * (V(0.5) * y - v * ps) - y) - v * V(s1));
+	V pc = z * (V(c1) + z * (V(c2) + z * (V(c3) + z * (V(c4) + z * (V(c5) + z * V(c6))))));
+	V hz = V(0.5) * z;
+	w = V(1.0) - hz;
+	V cr = w + (((V(1.0) - w) - hz) + (z * pc - r * y));
+	// Quadrant k mod 4.
+	V q = k - V(4.0) * round(k * V(0.25));
+	q = select(q < V(0.0), q + V(4.0), q);
+	auto odd = (q == V(1.0)) | (q == V(3.0));
+	s = select(odd, cr, sr);
+	c = select(odd, sr, cr);
+	s = select(q >= V(2.0), -s, s);
+	c = select((q == V(1.0)) | (q == V(2.0)), -c, c);
+	// Cancellation in the reduction loses relative precision of r.
+	return (abs(x) > V(0x1p20)) | ((abs(r) < V(0x1p-26)) & (k != V(0.0)));
+}
+
+// Single elements are passed to the C library, which is faster than the
+// kernels without SIMD instructions and at least as accurate. Domain errors
+// are resolved here, so that no floating point exceptions are raised.
+double exp_kernel(double x) {
+	return std::exp(x);
+}
+
+double ln_kernel(double x) {
+	if (x == 0.0) {
+		return -inf;
+	}
+	return x < 0.0 ? nan : std::log(x);
+}
+
+bool sincos_kernel(double x, double& s, double& c) {
+	sin_cos(x, s, c);
+	return false;
+}
+
+// Applies f(tag, i) to vectors at offsets i and then to the remaining
+// elements one by one, with the type of tag selecting the width.
+template<typename F>
+void for_lanes(size_t n, F f) {
+	size_t i = 0;
+	for (; i + width<Vec> <= n; i += width<Vec>) {
+		f(Vec(), i);
+	}
+	for (; i < n; ++i) {
+		f(double(), i);
+	}
+}
+
+} // end anon
+
+namespace vecmath {
+
+const char* isa() {
+	return isa_name;
+}
+
+void sin(const double* x, double* out, size_t n) {
+	for_lanes(n, [&](auto tag, size_t i) {
+		using V = decltype(tag);
+		V s, c;
+		auto slow = sincos_kernel(load<V>(x + i), s, c);
+		store(out + i, s);
+		for_mask(bits(slow), i, [&](size_t k) { out[k] = std::sin(x[k]); });
+	});
+}
+
+void cos(const double* x, double* out, size_t n) {
+	for_lanes(n, [&](auto tag, size_t i) {
+		using V = decltype(tag);
+		V s, c;
+		auto slow = sincos_kernel(load<V>(x + i), s, c);
+		store(out + i, c);
+		for_mask(bits(slow), i, [&](size_t k) { out[k] = std::cos(x[k]); });
+	});
+}
+
+void exp(const double* x, double* out, size_t n) {
+	for_lanes(n, [&](auto tag, size_t i) {
+		using V = decltype(tag);
+		store(out + i, exp_kernel(load<V>(x + i)));
+	});
+}
+
+void ln(const double* x, double* out, unsigned char* bad, size_t n) {
+	for_lanes(n, [&](auto tag, size_t i) {
+		using V = decltype(tag);
+		V xv = load<V>(x + i);
+		store(out + i, ln_kernel(xv));
+		set_bad(bad, i, bits(xv <= V(0.0)));
+	});
+}
+
+void sqrt(const double* x, double* out, unsigned char* bad, size_t n) {
+	for_lanes(n, [&](auto tag, size_t i) {
+		using V = decltype(tag);
+		V xv = load<V>(x + i);
+		store(out + i, sqroot(xv));
+		set_bad(bad, i, bits(xv < V(0.0)));
+	});
+}
+
+void div(const double* x, const double* y, double* out, unsigned char* bad, size_t n) {
+	for_lanes(n, [&](auto tag, size_t i) {
+		using V = decltype(tag);
+		V xv = load<V>(x + i);
+		V yv = load<V>(y + i);
+		store(out + i, xv / yv);
+		set_bad(bad, i, bits(div_fails(xv, yv)));
+	});
+}
+
+// Powers are rarely worth vectorizing, most of them are reduced to
+// multiplications and the rest needs the C library anyway.
+void pow(const double* x, const double* y, double* out, unsigned char* bad, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		if (reduced_pow(x[i], y[i], out[i])) {
+			continue;
+		}
+		out[i] = std::pow(x[i], y[i]);
+		bool finite = std::isfinite(y[i]);
+		if ((x[i] < 0.0 && std::isfinite(x[i]) && finite && y[i] != std::trunc(y[i])) ||
+				(x[i] == 0.0 && y[i] < 0.0 && finite)) {
+			bad[i] = 1;
+		}
+	}
+}
+
+void sin_dual(const double* x, const double* dx, double* out, double* dout, size_t n) {
+	for_lanes(n, [&](auto tag, size_t i) {
+		using V = decltype(tag);
+		V s, c;
+		auto slow = sincos_kernel(load<V>(x + i), s, c);
+		store(out + i, s);
+		store(dout + i, c * load<V>(dx + i));
+		for_mask(bits(slow), i, [&](size_t k) {
+			double s, c;
+			sin_cos(x[k], s, c);
+			out[k] = s;
+			dout[k] = c * dx[k];
+		});
+	});
+}
+
+void cos_dual(const double* x, const double* dx, double* out, double* dout, size_t n) {
+	for_lanes(n, [&](auto tag, size_t i) {
+		using V = decltype(tag);
+		V s, c;
+		auto slow = sincos_kernel(load<V>(x + i), s, c);
+		store(out + i, c);
+		store(dout + i, -s * load<V>(dx + i));
+		for_mask(bits(slow), i, [&](size_t k) {
+			double s, c;
+			sin_cos(x[k], s, c);
+			out[k] = c;
+			dout[k] = -s * dx[k];
+		});
+	});
+}
+
+void exp_dual(const double* x, const double* dx, double* out, double* dout, size_t n) {
+	for_lanes(n, [&](auto tag, size_t i) {
+		using V = decltype(tag);
+		V y = exp_kernel(load<V>(x + i));
+		store(out + i, y);
+		store(dout + i, y * load<V>(dx + i));
+	});
+}
+
+void ln_dual(const double* x, const double* dx, double* out, double* dout,
+		unsigned char* bad, size_t n)
+{
+	for_lanes(n, [&](auto tag, size_t i) {
+		using V = decltype(tag);
+		V xv = load<V>(x + i);
+		V dxv = load<V>(dx + i);
+		store(out + i, ln_kernel(xv));
+		store(dout + i, dxv / xv);
+		set_bad(bad, i, bits((xv <= V(0.0)) | div_fails(dxv, xv)));
+	});
+}
+
+void sqrt_dual(const double* x, const double* dx, double* out, double* dout,
+		unsigned char* bad, size_t n)
+{
+	for_lanes(n, [&](auto tag, size_t i) {
+		using V = decltype(tag);
+		V xv = load<V>(x + i);
+		V dxv = load<V>(dx + i);
+		V y = sqroot(xv);
+		V den = V(2.0) * y;
+		store(out + i, y);
+		store(dout + i, dxv / den);
+		set_bad(bad, i, bits((xv < V(0.0)) | div_fails(dxv, den)));
+	});
+}
+
+} // end vecmath
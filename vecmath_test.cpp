@@ -0,0 +1,205 @@
+#include "vecmath.h"
+
+#include "common.h"
+#include "num.h"
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr double inf = std::numeric_limits<double>::infinity();
+constexpr double qnan = std::numeric_limits<double>::quiet_NaN();
+
+// Odd, so that both the vector loops and the remainders are exercised.
+constexpr size_t sample_size = 10001;
+
+std::vector<double> uniform(double lo, double hi) {
+	std::mt19937_64 gen(42);
+	std::uniform_real_distribution<double> dist(lo, hi);
+	std::vector<double> res(sample_size);
+	for (auto& x : res) {
+		x = dist(gen);
+	}
+	return res;
+}
+
+// Error of x in units in the last place of the exact result.
+double ulps(double x, long double exact) {
+	double rounded = double(exact);
+	double ulp = std::nextafter(std::abs(rounded), inf) - std::abs(rounded);
+	return double(std::abs(x - exact) / ulp);
+}
+
+template<typename Fun, typename Ref>
+void expect_accurate(Fun fun, Ref ref, const std::vector<double>& x, double max_ulps) {
+	std::vector<double> out(x.size());
+	fun(x.data(), out.data(), x.size());
+	double worst = 0.0;
+	double worst_arg = 0.0;
+	for (size_t i = 0; i < x.size(); ++i) {
+		double err = ulps(out[i], ref((long double) x[i]));
+		if (!(err <= worst)) {
+			worst = err;
+			worst_arg = x[i];
+		}
+	}
+	EXPECT_LE(worst, max_ulps) << "at " << worst_arg << " with " << vecmath::isa();
+}
+
+// Binds a function which can fail, expecting that it doesn't.
+template<typename Fun>
+auto no_fail(Fun fun) {
+	return [=](const double* x, double* out, size_t n) {
+		std::vector<unsigned char> bad(n, 0);
+		fun(x, out, bad.data(), n);
+		for (size_t i = 0; i < n; ++i) {
+			EXPECT_EQ(bad[i], 0) << "at " << x[i];
+		}
+	};
+}
+
+bool same(double x, double y) {
+	return x == y || (std::isnan(x) && std::isnan(y));
+}
+
+} // end anon
+
+TEST(VecmathTest, Accuracy) {
+	auto sin_ref = [](long double x) { return sinl(x); };
+	auto cos_ref = [](long double x) { return cosl(x); };
+	for (auto range : {1.0, 100.0, 1e6, 1e300}) {
+		expect_accurate(vecmath::sin, sin_ref, uniform(-range, range), 1.0);
+		expect_accurate(vecmath::cos, cos_ref, uniform(-range, range), 1.0);
+	}
+	auto exp_ref = [](long double x) { return expl(x); };
+	expect_accurate(vecmath::exp, exp_ref, uniform(-1.0, 1.0), 1.0);
+	expect_accurate(vecmath::exp, exp_ref, uniform(-700.0, 700.0), 1.0);
+	auto ln_ref = [](long double x) { return logl(x); };
+	expect_accurate(no_fail(vecmath::ln), ln_ref, uniform(0.5, 2.0), 1.0);
+	expect_accurate(no_fail(vecmath::ln), ln_ref, uniform(0.0, 1e300), 1.0);
+	auto sqrt_ref = [](long double x) { return sqrtl(x); };
+	expect_accurate(no_fail(vecmath::sqrt), sqrt_ref, uniform(0.0, 1e10), 0.5);
+}
+
+TEST(VecmathTest, SpecialValues) {
+	double sub = std::numeric_limits<double>::denorm_min();
+	double max = std::numeric_limits<double>::max();
+	std::vector<double> x = {0.0, -0.0, 1.0, -1.0, inf, -inf, qnan, sub, 1e-310, max,
+		-max, 710.0, -746.0, 709.5, -745.0, 1e-20, M_PI, 1e22};
+	size_t n = x.size();
+	std::vector<double> out(n);
+	std::vector<unsigned char> bad(n);
+	auto check = [&](const char* name, double (*ref)(double)) {
+		for (size_t i = 0; i < n; ++i) {
+			double expected = ref(x[i]);
+			if (std::isfinite(expected) && expected != 0.0) {
+				EXPECT_LE(ulps(out[i], expected), 1.0) << name << " at " << x[i];
+			}
+			else {
+				EXPECT_PRED2(same, out[i], expected) << name << " at " << x[i];
+			}
+		}
+	};
+	vecmath::sin(x.data(), out.data(), n);
+	check("sin", [](double x) { return std::sin(x); });
+	vecmath::cos(x.data(), out.data(), n);
+	check("cos", [](double x) { return std::cos(x); });
+	vecmath::exp(x.data(), out.data(), n);
+	check("exp", [](double x) { return std::exp(x); });
+	std::fill(bad.begin(), bad.end(), 0);
+	vecmath::ln(x.data(), out.data(), bad.data(), n);
+	for (size_t i = 0; i < n; ++i) {
+		if (x[i] > 0.0 || std::isnan(x[i])) {
+			EXPECT_EQ(bad[i], 0) << "ln at " << x[i];
+			double expected = std::log(x[i]);
+			if (std::isfinite(expected) && expected != 0.0) {
+				EXPECT_LE(ulps(out[i], expected), 1.0) << "ln at " << x[i];
+			}
+			else {
+				EXPECT_PRED2(same, out[i], expected) << "ln at " << x[i];
+			}
+		}
+		else {
+			EXPECT_EQ(bad[i], 1) << "ln at " << x[i];
+		}
+	}
+}
+
+TEST(VecmathTest, Failures) {
+	std::vector<double> x = {1.0, -1.0, 0.0, -0.0, inf, -inf, 2.0, -8.0, qnan};
+	std::vector<double> y = {0.0, 0.5, -1.0, 0.0, inf, 3.0, -inf, 1.0 / 3, 1.0};
+	size_t n = x.size();
+	std::vector<double> out(n);
+	auto expect_fails = [&](const char* name, auto op, auto scalar) {
+		std::vector<unsigned char> bad(n, 0);
+		op(bad.data());
+		for (size_t i = 0; i < n; ++i) {
+			bool fails = false;
+			double expected = 0.0;
+			try {
+				expected = scalar(x[i], y[i]);
+			}
+			catch (const MathError&) {
+				fails = true;
+			}
+			EXPECT_EQ(bad[i], fails) << name << " at " << x[i] << ", " << y[i];
+			if (!fails) {
+				EXPECT_PRED2(same, out[i], expected) << name << " at " << x[i] << ", " << y[i];
+			}
+		}
+		// Flags are only ever set.
+		std::fill(bad.begin(), bad.end(), 1);
+		op(bad.data());
+		for (size_t i = 0; i < n; ++i) {
+			EXPECT_EQ(bad[i], 1) << name << " cleared a flag";
+		}
+	};
+	expect_fails("div", [&](unsigned char* bad) {
+		vecmath::div(x.data(), y.data(), out.data(), bad, n);
+	}, ediv);
+	expect_fails("pow", [&](unsigned char* bad) {
+		vecmath::pow(x.data(), y.data(), out.data(), bad, n);
+	}, epow);
+	expect_fails("sqrt", [&](unsigned char* bad) {
+		vecmath::sqrt(x.data(), out.data(), bad, n);
+	}, [](double x, double) { return esqrt(x); });
+	expect_fails("ln", [&](unsigned char* bad) {
+		vecmath::ln(x.data(), out.data(), bad, n);
+	}, [](double x, double) { return elog(x); });
+}
+
+TEST(VecmathTest, Dual) {
+	auto x = uniform(0.1, 50.0);
+	auto dx = uniform(-2.0, 2.0);
+	size_t n = x.size();
+	std::vector<double> out(n);
+	std::vector<double> dout(n);
+	std::vector<unsigned char> bad(n, 0);
+	auto check = [&](const char* name, Dual (Dual::*fun)() const) {
+		for (size_t i = 0; i < n; ++i) {
+			auto expected = (Dual(x[i], dx[i], false).*fun)();
+			EXPECT_NEAR(out[i], expected.val, 1e-15 * std::abs(expected.val))
+				<< name << " at " << x[i];
+			EXPECT_NEAR(dout[i], expected.deriv, 1e-15 * std::abs(expected.deriv))
+				<< name << " derivative at " << x[i];
+		}
+	};
+	vecmath::sin_dual(x.data(), dx.data(), out.data(), dout.data(), n);
+	check("sin", &Dual::sin);
+	vecmath::cos_dual(x.data(), dx.data(), out.data(), dout.data(), n);
+	check("cos", &Dual::cos);
+	vecmath::exp_dual(x.data(), dx.data(), out.data(), dout.data(), n);
+	check("exp", &Dual::exp);
+	vecmath::ln_dual(x.data(), dx.data(), out.data(), dout.data(), bad.data(), n);
+	check("ln", &Dual::ln);
+	vecmath::sqrt_dual(x.data(), dx.data(), out.data(), dout.data(), bad.data(), n);
+	check("sqrt", &Dual::sqrt);
+	for (size_t i = 0; i < n; ++i) {
+		EXPECT_EQ(bad[i], 0) << "at " << x[i];
+	}
+}